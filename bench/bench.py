@@ -5,8 +5,14 @@ Uses hyperfine for accurate measurements.
 """
 import argparse
 import json
+import multiprocessing
+import os
+import re
+import socket
 import subprocess
 import sys
+import tempfile
+import time
 from pathlib import Path
 
 # Benchmark configurations: (name, input)
@@ -16,11 +22,54 @@ BENCHMARKS = [
     ("fib.iterative", 2_000_000),
     ("primes", 1_000),
     ("matmul", 200),
+    ("matmul.memory64", 200),
     ("bulk-ops", 5_000),
+    ("dot.scalar", 2_000),
+    ("dot.simd", 2_000),
+    ("throw.depth1", 1_000_000),
+    ("throw.depth10", 200_000),
+    ("throw.depth100", 20_000),
+    ("throw.depth1000", 2_000),
+    ("generator", 10_000_000),
 ]
 
+# Benchmarks of proposals wasmi does not implement (exception handling,
+# stack switching); they are timed on wasm5 alone
+WASM5_ONLY = {
+    "throw.depth1",
+    "throw.depth10",
+    "throw.depth100",
+    "throw.depth1000",
+    "generator",
+}
+
+# WASI I/O benchmarks comparing wasm5's sync and io_uring backends:
+# (name, stdin size in MiB); each runs `wasm5 run wasi-<name>.wasm`
+WASI_IO_BENCHMARKS = [
+    ("cat", 256),
+    ("records", 0),
+]
+
+# WASI socket benchmark: `wasm5 run --listen` serving wasi-http.wasm, loaded by wrk
+WASI_HTTP_ADDR = ("127.0.0.1", 18080)
+
+# WASI directory benchmark: `wasm5 run --dir` listing a directory of this many
+# empty files with wasi-readdir.wasm
+WASI_READDIR_ENTRIES = 100_000
+
+# Scheduler benchmark: `wasm5 sched` running this many calls of
+# fib.recursive(SCHED_INPUT) on 1, 2, 4, ... workers up to the CPU count
+SCHED_TASKS = 20_000
+SCHED_INPUT = 20
+
+# Server benchmark: `wasm5 serve` answering `call fib run SERVE_INPUT` requests
+# on fib.recursive.wasm from a local load generator
+SERVE_SOCKET = "/tmp/wasm5-bench.sock"
+SERVE_INPUT = 20
+
 BENCH_DIR = Path(__file__).parent
 WAT_DIR = BENCH_DIR / "wat"
+WASI_WAT_DIR = BENCH_DIR / "wasi"
 WASM_DIR = BENCH_DIR / "benches"
 
 
@@ -28,13 +77,17 @@ def convert_wat_files():
     """Convert all .wat files to .wasm using wasm-tools."""
     WASM_DIR.mkdir(exist_ok=True)
 
-    wat_files = list(WAT_DIR.glob("*.wat"))
+    # WASI guests get a "wasi-" prefix to keep them apart from --invoke benchmarks
+    wat_files = [(f, f.with_suffix(".wasm").name) for f in WAT_DIR.glob("*.wat")]
+    wat_files += [
+        (f, "wasi-" + f.with_suffix(".wasm").name) for f in WASI_WAT_DIR.glob("*.wat")
+    ]
     if not wat_files:
         print(f"No .wat files found in {WAT_DIR}")
         sys.exit(1)
 
-    for wat_file in wat_files:
-        wasm_file = WASM_DIR / wat_file.with_suffix(".wasm").name
+    for wat_file, wasm_name in wat_files:
+        wasm_file = WASM_DIR / wasm_name
         try:
             subprocess.run(
                 ["wasm-tools", "parse", str(wat_file), "-o", str(wasm_file)],
@@ -67,6 +120,14 @@ def check_wasm_files():
         sys.exit(1)
 
 
+def wasmi_can_run(wasmi_cmd: str) -> bool:
+    """Whether wasmi runs a benchmark to completion."""
+    try:
+        return subprocess.run(wasmi_cmd, shell=True, capture_output=True).returncode == 0
+    except OSError:
+        return False
+
+
 def run_benchmarks(wasmi_bin: str, wasm5_bin: str, output: str, warmup: int, runs: int):
     """Run all benchmarks using hyperfine."""
     check_wasm_files()
@@ -84,6 +145,14 @@ def run_benchmarks(wasmi_bin: str, wasm5_bin: str, output: str, warmup: int, run
         print(f"Benchmarking: {name} (input={input_val})")
         print(f"{'='*60}")
 
+        commands = ["-n", "wasm5", wasm5_cmd]
+        if name in WASM5_ONLY:
+            print("wasm5 only")
+        elif wasmi_can_run(wasmi_cmd):
+            commands = ["-n", "wasmi", wasmi_cmd] + commands
+        else:
+            print(f"wasmi cannot run {name}, timing wasm5 only")
+
         try:
             subprocess.run(
                 [
@@ -91,9 +160,7 @@ def run_benchmarks(wasmi_bin: str, wasm5_bin: str, output: str, warmup: int, run
                     "--warmup", str(warmup),
                     "--min-runs", str(runs),
                     "--export-json", tmp_json,
-                    "-n", "wasmi", wasmi_cmd,
-                    "-n", "wasm5", wasm5_cmd,
-                ],
+                ] + commands,
                 check=True,
             )
         except FileNotFoundError:
@@ -142,11 +209,346 @@ def print_summary(results: list):
     for r in results:
         name = r["benchmark"]
         data = r.get("results", {}).get("results", [])
-        if len(data) >= 2:
-            wasmi_time = data[0].get("mean", 0) * 1000  # Convert to ms
-            wasm5_time = data[1].get("mean", 0) * 1000
+        means = {d.get("command"): d.get("mean", 0) * 1000 for d in data}  # ms
+        if "wasm5" not in means:
+            continue
+        wasm5_time = means["wasm5"]
+        if "wasmi" in means:
+            wasmi_time = means["wasmi"]
             ratio = wasm5_time / wasmi_time if wasmi_time > 0 else float("inf")
             print(f"{name:<20} {wasmi_time:<15.2f} {wasm5_time:<15.2f} {ratio:<10.2f}x")
+        else:
+            print(f"{name:<20} {'-':<15} {wasm5_time:<15.2f} {'-':<10}")
+
+
+def run_wasi_io_benchmarks(wasm5_bin: str, output: str, warmup: int, runs: int):
+    """Compare wasm5's sync and io_uring WASI backends with stdio redirected to files."""
+    missing = [
+        f"wasi-{name}.wasm"
+        for name, _ in WASI_IO_BENCHMARKS
+        if not (WASM_DIR / f"wasi-{name}.wasm").exists()
+    ]
+    if missing:
+        print(f"Error: Missing .wasm files: {', '.join(missing)}")
+        print("Run 'python bench.py convert' first to generate them.")
+        sys.exit(1)
+
+    results = []
+
+    with tempfile.TemporaryDirectory(prefix="wasm5_wasi_io_") as tmp:
+        for name, input_mib in WASI_IO_BENCHMARKS:
+            wasm_file = WASM_DIR / f"wasi-{name}.wasm"
+            input_file = Path(tmp) / f"{name}.in"
+            output_file = Path(tmp) / f"{name}.out"
+            tmp_json = f"/tmp/bench_wasi_{name}.json"
+
+            with open(input_file, "wb") as f:
+                for _ in range(input_mib):
+                    f.write(os.urandom(1 << 20))
+
+            cmd = f"{wasm5_bin} run {wasm_file} < {input_file} > {output_file}"
+
+            print(f"\n{'='*60}")
+            print(f"Benchmarking: wasi-{name} (stdin={input_mib} MiB)")
+            print(f"{'='*60}")
+
+            try:
+                subprocess.run(
+                    [
+                        "hyperfine",
+                        "--warmup", str(warmup),
+                        "--min-runs", str(runs),
+                        "--export-json", tmp_json,
+                        "-n", "sync", f"WASM5_WASI_IO=sync {cmd}",
+                        "-n", "io_uring", f"WASM5_WASI_IO=io_uring {cmd}",
+                    ],
+                    check=True,
+                )
+            except FileNotFoundError:
+                print("Error: hyperfine not found. Install it:")
+                print("  cargo install hyperfine")
+                sys.exit(1)
+            except subprocess.CalledProcessError as e:
+                print(f"Error running benchmark wasi-{name}: {e}")
+                continue
+
+            try:
+                with open(tmp_json) as f:
+                    results.append({
+                        "benchmark": f"wasi-{name}",
+                        "input": input_mib,
+                        "results": json.load(f),
+                    })
+            except (FileNotFoundError, json.JSONDecodeError) as e:
+                print(f"Warning: Could not read results for wasi-{name}: {e}")
+
+    output_path = BENCH_DIR / output
+    with open(output_path, "w") as f:
+        json.dump(results, f, indent=2)
+    print(f"\nResults saved to {output_path}")
+
+    if not results:
+        return
+    print("\nSummary:")
+    print(f"{'Benchmark':<20} {'sync (ms)':<15} {'io_uring (ms)':<15} {'Speedup':<10}")
+    print("-" * 60)
+    for r in results:
+        data = r["results"].get("results", [])
+        if len(data) >= 2:
+            sync_time = data[0].get("mean", 0) * 1000
+            uring_time = data[1].get("mean", 0) * 1000
+            speedup = sync_time / uring_time if uring_time > 0 else float("inf")
+            print(f"{r['benchmark']:<20} {sync_time:<15.2f} {uring_time:<15.2f} {speedup:<10.2f}x")
+
+
+def run_wasi_http_benchmark(
+    wasm5_bin: str, output: str, duration: int, connections: int, threads: int
+):
+    """Measure request throughput of a WASI HTTP server with wrk."""
+    wasm_file = WASM_DIR / "wasi-http.wasm"
+    if not wasm_file.exists():
+        print("Error: Missing .wasm files: wasi-http.wasm")
+        print("Run 'python bench.py convert' first to generate them.")
+        sys.exit(1)
+
+    host, port = WASI_HTTP_ADDR
+    server = subprocess.Popen(
+        [wasm5_bin, "run", "--listen", f"{host}:{port}", str(wasm_file)]
+    )
+    try:
+        # Wait for the listener to come up
+        for _ in range(100):
+            try:
+                socket.create_connection((host, port), timeout=0.1).close()
+                break
+            except OSError:
+                if server.poll() is not None:
+                    print(f"Error: wasm5 exited with code {server.returncode}")
+                    sys.exit(1)
+                time.sleep(0.05)
+
+        print(f"\n{'='*60}")
+        print(f"Benchmarking: wasi-http ({connections} connections, {duration}s)")
+        print(f"{'='*60}")
+        try:
+            result = subprocess.run(
+                [
+                    "wrk",
+                    "-t", str(threads),
+                    "-c", str(connections),
+                    "-d", f"{duration}s",
+                    f"http://{host}:{port}/",
+                ],
+                check=True,
+                capture_output=True,
+                text=True,
+            )
+        except FileNotFoundError:
+            print("Error: wrk not found. Install it from your package manager")
+            print("  or https://github.com/wg/wrk")
+            sys.exit(1)
+        except subprocess.CalledProcessError as e:
+            print(f"Error running benchmark wasi-http: {e}")
+            return
+    finally:
+        server.kill()
+        server.wait()
+
+    print(result.stdout)
+    match = re.search(r"Requests/sec:\s*([\d.]+)", result.stdout)
+    output_path = BENCH_DIR / output
+    with open(output_path, "w") as f:
+        json.dump(
+            {
+                "benchmark": "wasi-http",
+                "connections": connections,
+                "duration": duration,
+                "requests_per_sec": float(match.group(1)) if match else None,
+                "wrk_output": result.stdout,
+            },
+            f,
+            indent=2,
+        )
+    print(f"Results saved to {output_path}")
+
+
+def run_wasi_readdir_benchmark(wasm5_bin: str, output: str, warmup: int, runs: int):
+    """Measure listing a large preopened directory with fd_readdir."""
+    wasm_file = WASM_DIR / "wasi-readdir.wasm"
+    if not wasm_file.exists():
+        print("Error: Missing .wasm files: wasi-readdir.wasm")
+        print("Run 'python bench.py convert' first to generate them.")
+        sys.exit(1)
+
+    with tempfile.TemporaryDirectory(prefix="wasm5_wasi_readdir_") as tmp:
+        for i in range(WASI_READDIR_ENTRIES):
+            (Path(tmp) / f"entry-{i:06}").touch()
+
+        print(f"\n{'='*60}")
+        print(f"Benchmarking: wasi-readdir ({WASI_READDIR_ENTRIES} entries)")
+        print(f"{'='*60}")
+        try:
+            subprocess.run(
+                [
+                    "hyperfine",
+                    "--warmup", str(warmup),
+                    "--min-runs", str(runs),
+                    "--export-json", str(BENCH_DIR / output),
+                    "-n", "wasi-readdir",
+                    f"{wasm5_bin} run --dir {tmp} {wasm_file}",
+                ],
+                check=True,
+            )
+        except FileNotFoundError:
+            print("Error: hyperfine not found. Install it:")
+            print("  cargo install hyperfine")
+            sys.exit(1)
+        except subprocess.CalledProcessError as e:
+            print(f"Error running benchmark wasi-readdir: {e}")
+            return
+
+    print(f"\nResults saved to {BENCH_DIR / output}")
+
+
+def run_sched_benchmark(wasm5_bin: str, output: str, warmup: int, runs: int):
+    """Measure how `wasm5 sched` throughput scales with worker threads."""
+    wasm_file = WASM_DIR / "fib.recursive.wasm"
+    if not wasm_file.exists():
+        print("Error: Missing .wasm files: fib.recursive.wasm")
+        print("Run 'python bench.py convert' first to generate them.")
+        sys.exit(1)
+
+    cpus = os.cpu_count() or 1
+    workers = [1]
+    while workers[-1] * 2 <= cpus:
+        workers.append(workers[-1] * 2)
+    if workers[-1] != cpus:
+        workers.append(cpus)
+
+    print(f"\n{'='*60}")
+    print(f"Benchmarking: sched ({SCHED_TASKS} x fib.recursive {SCHED_INPUT})")
+    print(f"{'='*60}")
+    cmd = ["hyperfine", "--warmup", str(warmup), "--min-runs", str(runs)]
+    cmd += ["--export-json", str(BENCH_DIR / output)]
+    for w in workers:
+        cmd += [
+            "-n", f"workers={w}",
+            f"{wasm5_bin} sched --workers {w} --tasks {SCHED_TASKS} "
+            f"{wasm_file} run {SCHED_INPUT}",
+        ]
+    try:
+        subprocess.run(cmd, check=True)
+    except FileNotFoundError:
+        print("Error: hyperfine not found. Install it:")
+        print("  cargo install hyperfine")
+        sys.exit(1)
+    except subprocess.CalledProcessError as e:
+        print(f"Error running benchmark sched: {e}")
+        return
+
+    with open(BENCH_DIR / output) as f:
+        data = json.load(f).get("results", [])
+    if data:
+        base = data[0].get("mean", 0)
+        print("\nSummary:")
+        print(f"{'Workers':<10} {'Time (ms)':<15} {'Speedup':<10}")
+        print("-" * 35)
+        for w, r in zip(workers, data):
+            mean = r.get("mean", 0)
+            speedup = base / mean if mean > 0 else float("inf")
+            print(f"{w:<10} {mean * 1000:<15.2f} {speedup:<10.2f}x")
+    print(f"\nResults saved to {BENCH_DIR / output}")
+
+
+def serve_load(connection: int, requests: int) -> list:
+    """One load-generator connection: send requests one at a time and return
+    their round-trip latencies in seconds."""
+    request = f"call fib run {SERVE_INPUT}\n".encode()
+    latencies = []
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(SERVE_SOCKET)
+        reader = sock.makefile("rb")
+        for _ in range(requests):
+            start = time.perf_counter()
+            sock.sendall(request)
+            response = reader.readline()
+            latencies.append(time.perf_counter() - start)
+            if not response.startswith(b"ok"):
+                raise RuntimeError(f"connection {connection}: {response!r}")
+    return latencies
+
+
+def percentile(sorted_values: list, p: float) -> float:
+    """Nearest-rank percentile of an ascending list."""
+    rank = max(0, min(len(sorted_values) - 1, round(p / 100 * len(sorted_values)) - 1))
+    return sorted_values[rank]
+
+
+def run_serve_benchmark(
+    wasm5_bin: str, output: str, connections: int, requests: int, workers: int
+):
+    """Measure request throughput and latency of `wasm5 serve`."""
+    wasm_file = WASM_DIR / "fib.recursive.wasm"
+    if not wasm_file.exists():
+        print("Error: Missing .wasm files: fib.recursive.wasm")
+        print("Run 'python bench.py convert' first to generate them.")
+        sys.exit(1)
+
+    cmd = [wasm5_bin, "serve"]
+    if workers > 0:
+        cmd += ["--workers", str(workers)]
+    cmd += [SERVE_SOCKET, f"fib={wasm_file}"]
+    if os.path.exists(SERVE_SOCKET):
+        os.unlink(SERVE_SOCKET)
+    server = subprocess.Popen(cmd, stdout=subprocess.DEVNULL)
+    try:
+        # Wait for the listener to come up
+        for _ in range(100):
+            if os.path.exists(SERVE_SOCKET):
+                break
+            if server.poll() is not None:
+                print(f"Error: wasm5 exited with code {server.returncode}")
+                sys.exit(1)
+            time.sleep(0.05)
+
+        print(f"\n{'='*60}")
+        print(
+            f"Benchmarking: serve ({connections} connections x {requests} "
+            f"requests, fib.recursive {SERVE_INPUT})"
+        )
+        print(f"{'='*60}")
+        try:
+            with multiprocessing.Pool(connections) as pool:
+                start = time.perf_counter()
+                per_connection = pool.starmap(
+                    serve_load, [(c, requests) for c in range(connections)]
+                )
+                elapsed = time.perf_counter() - start
+        except (OSError, RuntimeError) as e:
+            print(f"Error running benchmark serve: {e}")
+            return
+    finally:
+        server.kill()
+        server.wait()
+
+    latencies = sorted(l for ls in per_connection for l in ls)
+    result = {
+        "benchmark": "serve",
+        "connections": connections,
+        "requests": len(latencies),
+        "seconds": elapsed,
+        "requests_per_sec": len(latencies) / elapsed,
+        "latency_ms": {
+            f"p{p}": percentile(latencies, p) * 1000 for p in (50, 90, 99, 99.9)
+        },
+    }
+    print(f"Requests/sec: {result['requests_per_sec']:.0f}")
+    for name, ms in result["latency_ms"].items():
+        print(f"Latency {name:<6} {ms:.3f} ms")
+    output_path = BENCH_DIR / output
+    with open(output_path, "w") as f:
+        json.dump(result, f, indent=2)
+    print(f"Results saved to {output_path}")
 
 
 def run_all(wasmi_bin: str = "wasmi_cli", wasm5_bin: str = "wasm5"):
@@ -178,12 +580,20 @@ def clean():
         except OSError:
             pass  # Directory not empty or doesn't exist
 
-    # Remove results.json
-    results_file = BENCH_DIR / "results.json"
-    if results_file.exists():
-        results_file.unlink()
-        print("Removed results.json")
-        removed += 1
+    # Remove results files
+    for results_name in (
+        "results.json",
+        "results-wasi-io.json",
+        "results-wasi-http.json",
+        "results-wasi-readdir.json",
+        "results-sched.json",
+        "results-serve.json",
+    ):
+        results_file = BENCH_DIR / results_name
+        if results_file.exists():
+            results_file.unlink()
+            print(f"Removed {results_name}")
+            removed += 1
 
     if removed == 0:
         print("Nothing to clean.")
@@ -234,6 +644,153 @@ def main():
         help="Minimum number of benchmark runs (default: 10)",
     )
 
+    # WASI I/O backend subcommand
+    wasi_io_parser = subparsers.add_parser(
+        "wasi-io", help="Compare wasm5's sync and io_uring WASI I/O backends"
+    )
+    wasi_io_parser.add_argument(
+        "--wasm5",
+        default="wasm5",
+        help="Path to wasm5 binary (default: wasm5)",
+    )
+    wasi_io_parser.add_argument(
+        "--output",
+        default="results-wasi-io.json",
+        help="Output file for benchmark results (default: results-wasi-io.json)",
+    )
+    wasi_io_parser.add_argument(
+        "--warmup",
+        type=int,
+        default=1,
+        help="Number of warmup runs (default: 1)",
+    )
+    wasi_io_parser.add_argument(
+        "--runs",
+        type=int,
+        default=10,
+        help="Minimum number of benchmark runs (default: 10)",
+    )
+
+    # WASI socket subcommand
+    wasi_http_parser = subparsers.add_parser(
+        "wasi-http", help="Measure request throughput of a WASI HTTP server with wrk"
+    )
+    wasi_http_parser.add_argument(
+        "--wasm5",
+        default="wasm5",
+        help="Path to wasm5 binary (default: wasm5)",
+    )
+    wasi_http_parser.add_argument(
+        "--output",
+        default="results-wasi-http.json",
+        help="Output file for benchmark results (default: results-wasi-http.json)",
+    )
+    wasi_http_parser.add_argument(
+        "--duration",
+        type=int,
+        default=10,
+        help="Load duration in seconds (default: 10)",
+    )
+    wasi_http_parser.add_argument(
+        "--connections",
+        type=int,
+        default=16,
+        help="Concurrent connections (default: 16)",
+    )
+    wasi_http_parser.add_argument(
+        "--threads",
+        type=int,
+        default=2,
+        help="wrk threads (default: 2)",
+    )
+
+    # WASI directory listing subcommand
+    wasi_readdir_parser = subparsers.add_parser(
+        "wasi-readdir", help="Measure listing a 100k-entry directory with fd_readdir"
+    )
+    wasi_readdir_parser.add_argument(
+        "--wasm5",
+        default="wasm5",
+        help="Path to wasm5 binary (default: wasm5)",
+    )
+    wasi_readdir_parser.add_argument(
+        "--output",
+        default="results-wasi-readdir.json",
+        help="Output file for benchmark results (default: results-wasi-readdir.json)",
+    )
+    wasi_readdir_parser.add_argument(
+        "--warmup",
+        type=int,
+        default=1,
+        help="Number of warmup runs (default: 1)",
+    )
+    wasi_readdir_parser.add_argument(
+        "--runs",
+        type=int,
+        default=10,
+        help="Minimum number of benchmark runs (default: 10)",
+    )
+
+    # Scheduler scaling subcommand
+    sched_parser = subparsers.add_parser(
+        "sched", help="Measure wasm5 sched throughput on 1..N worker threads"
+    )
+    sched_parser.add_argument(
+        "--wasm5",
+        default="wasm5",
+        help="Path to wasm5 binary (default: wasm5)",
+    )
+    sched_parser.add_argument(
+        "--output",
+        default="results-sched.json",
+        help="Output file for benchmark results (default: results-sched.json)",
+    )
+    sched_parser.add_argument(
+        "--warmup",
+        type=int,
+        default=1,
+        help="Number of warmup runs (default: 1)",
+    )
+    sched_parser.add_argument(
+        "--runs",
+        type=int,
+        default=10,
+        help="Minimum number of benchmark runs (default: 10)",
+    )
+
+    # Server throughput and latency subcommand
+    serve_parser = subparsers.add_parser(
+        "serve", help="Measure wasm5 serve requests/sec and latency percentiles"
+    )
+    serve_parser.add_argument(
+        "--wasm5",
+        default="wasm5",
+        help="Path to wasm5 binary (default: wasm5)",
+    )
+    serve_parser.add_argument(
+        "--output",
+        default="results-serve.json",
+        help="Output file for benchmark results (default: results-serve.json)",
+    )
+    serve_parser.add_argument(
+        "--connections",
+        type=int,
+        default=8,
+        help="Number of concurrent client connections (default: 8)",
+    )
+    serve_parser.add_argument(
+        "--requests",
+        type=int,
+        default=5_000,
+        help="Requests sent on each connection (default: 5000)",
+    )
+    serve_parser.add_argument(
+        "--workers",
+        type=int,
+        default=0,
+        help="Server worker threads, 0 for one per CPU (default: 0)",
+    )
+
     args = parser.parse_args()
 
     if args.command == "convert":
@@ -242,6 +799,20 @@ def main():
         clean()
     elif args.command == "run":
         run_benchmarks(args.wasmi, args.wasm5, args.output, args.warmup, args.runs)
+    elif args.command == "wasi-io":
+        run_wasi_io_benchmarks(args.wasm5, args.output, args.warmup, args.runs)
+    elif args.command == "wasi-http":
+        run_wasi_http_benchmark(
+            args.wasm5, args.output, args.duration, args.connections, args.threads
+        )
+    elif args.command == "wasi-readdir":
+        run_wasi_readdir_benchmark(args.wasm5, args.output, args.warmup, args.runs)
+    elif args.command == "sched":
+        run_sched_benchmark(args.wasm5, args.output, args.warmup, args.runs)
+    elif args.command == "serve":
+        run_serve_benchmark(
+            args.wasm5, args.output, args.connections, args.requests, args.workers
+        )
     elif args.command is None:
         # Default: run full workflow (convert -> run -> clean)
         run_all()
@@ -0,0 +1,30 @@
+;; Copy stdin to stdout in 4 KiB chunks
+(module
+    (import "wasi_snapshot_preview1" "fd_read"
+        (func $fd_read (param i32 i32 i32 i32) (result i32)))
+    (import "wasi_snapshot_preview1" "fd_write"
+        (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+    (memory (export "memory") 1)
+
+    (func (export "_start")
+        (local $n i32)
+        (block $done
+            (loop $copy
+                ;; iovec at 0: (ptr=1024, len=4096)
+                (i32.store (i32.const 0) (i32.const 1024))
+                (i32.store (i32.const 4) (i32.const 4096))
+                ;; fd_read(stdin, iovs=0, 1, nread=16)
+                (br_if $done
+                    (call $fd_read (i32.const 0) (i32.const 0) (i32.const 1) (i32.const 16)))
+                (local.set $n (i32.load (i32.const 16)))
+                (br_if $done (i32.eqz (local.get $n)))
+                ;; fd_write(stdout, iovs=0 with len=n, 1, nwritten=20)
+                (i32.store (i32.const 4) (local.get $n))
+                (br_if $done
+                    (call $fd_write (i32.const 1) (i32.const 0) (i32.const 1) (i32.const 20)))
+                (br $copy)
+            )
+        )
+    )
+)
@@ -0,0 +1,58 @@
+;; Minimal HTTP server on the preopened listener (fd 3, `wasm5 run --listen`)
+;; Waits in poll_oneoff, then accepts until the listener would block; every
+;; connection gets one fixed response and is closed. Runs until killed.
+(module
+    (import "wasi_snapshot_preview1" "poll_oneoff"
+        (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+    (import "wasi_snapshot_preview1" "sock_accept"
+        (func $sock_accept (param i32 i32 i32) (result i32)))
+    (import "wasi_snapshot_preview1" "sock_recv"
+        (func $sock_recv (param i32 i32 i32 i32 i32 i32) (result i32)))
+    (import "wasi_snapshot_preview1" "sock_send"
+        (func $sock_send (param i32 i32 i32 i32 i32) (result i32)))
+    (import "wasi_snapshot_preview1" "fd_close"
+        (func $fd_close (param i32) (result i32)))
+
+    (memory (export "memory") 1)
+
+    ;; 71 bytes
+    (data (i32.const 1024)
+        "HTTP/1.1 200 OK\r\nContent-Length: 13\r\nConnection: close\r\n\r\nHello, world\n")
+
+    (func (export "_start")
+        (local $conn i32)
+        ;; Subscription at 0: fd_read on the listener
+        (i64.store (i32.const 0) (i64.const 0))
+        (i32.store8 (i32.const 8) (i32.const 1))
+        (i32.store (i32.const 16) (i32.const 3))
+        (loop $serve
+            ;; poll_oneoff(subs=0, events=64, 1, nevents=96)
+            (if (call $poll_oneoff (i32.const 0) (i32.const 64) (i32.const 1) (i32.const 96))
+                (then (return)))
+            (block $drained
+                (loop $accept
+                    ;; sock_accept(3, flags=0, fd=100); AGAIN ends the batch
+                    (br_if $drained
+                        (call $sock_accept (i32.const 3) (i32.const 0) (i32.const 100)))
+                    (local.set $conn (i32.load (i32.const 100)))
+                    ;; iovec at 128: (ptr=2048, len=4096); datalen at 136, flags at 140
+                    (i32.store (i32.const 128) (i32.const 2048))
+                    (i32.store (i32.const 132) (i32.const 4096))
+                    (if (i32.eqz
+                            (call $sock_recv (local.get $conn) (i32.const 128) (i32.const 1)
+                                (i32.const 0) (i32.const 136) (i32.const 140)))
+                        (then
+                            (if (i32.load (i32.const 136))
+                                (then
+                                    (i32.store (i32.const 128) (i32.const 1024))
+                                    (i32.store (i32.const 132) (i32.const 71))
+                                    (drop (call $sock_send (local.get $conn) (i32.const 128)
+                                        (i32.const 1) (i32.const 0) (i32.const 144)))))))
+                    (drop (call $fd_close (local.get $conn)))
+                    (br $accept)
+                )
+            )
+            (br $serve)
+        )
+    )
+)
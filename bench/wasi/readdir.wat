@@ -0,0 +1,45 @@
+;; List the preopened directory at fd 3 with fd_readdir in 4 KiB buffers,
+;; resuming from the cookie of the last complete entry like wasi-libc's readdir
+(module
+    (import "wasi_snapshot_preview1" "fd_readdir"
+        (func $fd_readdir (param i32 i32 i32 i64 i32) (result i32)))
+
+    (memory (export "memory") 1)
+
+    (func (export "_start")
+        (local $cookie i64)
+        (local $used i32)
+        (local $off i32)
+        (local $size i32)
+        (local $count i32)
+        (block $done
+            (loop $fill
+                ;; fd_readdir(3, buf=1024, 4096, cookie, bufused=16)
+                (br_if $done
+                    (call $fd_readdir (i32.const 3) (i32.const 1024) (i32.const 4096)
+                        (local.get $cookie) (i32.const 16)))
+                (local.set $used (i32.load (i32.const 16)))
+                (local.set $off (i32.const 0))
+                (block $parsed
+                    (loop $entry
+                        ;; 24-byte dirent header, then d_namlen bytes of name
+                        (br_if $parsed
+                            (i32.gt_u (i32.add (local.get $off) (i32.const 24)) (local.get $used)))
+                        (local.set $size
+                            (i32.add (i32.const 24)
+                                (i32.load offset=1040 (local.get $off))))
+                        (br_if $parsed
+                            (i32.gt_u (i32.add (local.get $off) (local.get $size)) (local.get $used)))
+                        (local.set $cookie (i64.load offset=1024 (local.get $off)))
+                        (local.set $count (i32.add (local.get $count) (i32.const 1)))
+                        (local.set $off (i32.add (local.get $off) (local.get $size)))
+                        (br $entry)
+                    )
+                )
+                ;; A short buffer means the end of the directory
+                (br_if $fill (i32.eq (local.get $used) (i32.const 4096)))
+            )
+        )
+        (i32.store (i32.const 0) (local.get $count))
+    )
+)
@@ -0,0 +1,29 @@
+;; Write 1,000,000 64-byte records to stdout, one fd_write per record
+(module
+    (import "wasi_snapshot_preview1" "fd_write"
+        (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+    (memory (export "memory") 1)
+
+    (func (export "_start")
+        (local $i i32)
+        ;; Record at 1024: 63 x 'r' followed by '\n'
+        (memory.fill (i32.const 1024) (i32.const 114) (i32.const 63))
+        (i32.store8 (i32.const 1087) (i32.const 10))
+        ;; iovec at 0: (ptr=1024, len=64)
+        (i32.store (i32.const 0) (i32.const 1024))
+        (i32.store (i32.const 4) (i32.const 64))
+        (block $done
+            (loop $write
+                (br_if $done (i32.ge_u (local.get $i) (i32.const 1000000)))
+                ;; Stamp the record number so records differ
+                (i32.store (i32.const 1024) (local.get $i))
+                ;; fd_write(stdout, iovs=0, 1, nwritten=16)
+                (br_if $done
+                    (call $fd_write (i32.const 1) (i32.const 0) (i32.const 1) (i32.const 16)))
+                (local.set $i (i32.add (local.get $i) (i32.const 1)))
+                (br $write)
+            )
+        )
+    )
+)
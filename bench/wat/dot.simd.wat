@@ -0,0 +1,53 @@
+(module
+    (memory 2 2)
+
+    ;; Lanes per array: a at 0, b at 65536
+    (global $LEN i32 (i32.const 16384))
+
+    ;; a[i] = i, b[i] = 3 - i
+    (func $init
+        (local $i i32)
+        (block $break
+            (loop $continue
+                (br_if $break (i32.ge_u (local.get $i) (global.get $LEN)))
+                (i32.store (i32.shl (local.get $i) (i32.const 2)) (local.get $i))
+                (i32.store offset=65536 (i32.shl (local.get $i) (i32.const 2))
+                    (i32.sub (i32.const 3) (local.get $i)))
+                (local.set $i (i32.add (local.get $i) (i32.const 1)))
+                (br $continue)
+            )
+        )
+    )
+
+    ;; Same dot product as dot.scalar.wat, four lanes at a time
+    (func (export "run") (param $N i64) (result i64)
+        (local $round i64)
+        (local $p i32)
+        (local $acc v128)
+        (call $init)
+        (block $done
+            (loop $rounds
+                (br_if $done (i64.ge_u (local.get $round) (local.get $N)))
+                (local.set $p (i32.const 0))
+                (block $break
+                    (loop $continue
+                        (br_if $break (i32.ge_u (local.get $p) (i32.const 65536)))
+                        (local.set $acc
+                            (i32x4.add (local.get $acc)
+                                (i32x4.mul
+                                    (v128.load (local.get $p))
+                                    (v128.load offset=65536 (local.get $p)))))
+                        (local.set $p (i32.add (local.get $p) (i32.const 16)))
+                        (br $continue)
+                    )
+                )
+                (local.set $round (i64.add (local.get $round) (i64.const 1)))
+                (br $rounds)
+            )
+        )
+        (i64.extend_i32_u
+            (i32.add
+                (i32.add (i32x4.extract_lane 0 (local.get $acc)) (i32x4.extract_lane 1 (local.get $acc)))
+                (i32.add (i32x4.extract_lane 2 (local.get $acc)) (i32x4.extract_lane 3 (local.get $acc)))))
+    )
+)
@@ -0,0 +1,44 @@
+(module
+    ;; Suspend/resume latency: a generator continuation yields 0..N-1 and
+    ;; the caller resumes it once per value
+    (type $ft (func))
+    (type $ct (cont $ft))
+    (type $gft (func (param i64)))
+    (type $gct (cont $gft))
+    (tag $yield (param i64))
+    (elem declare func $gen)
+
+    (func $gen (type $gft) (param $n i64)
+        (local $i i64)
+        (block $break
+            (loop $continue
+                (br_if $break (i64.ge_u (local.get $i) (local.get $n)))
+                (suspend $yield (local.get $i))
+                (local.set $i (i64.add (local.get $i) (i64.const 1)))
+                (br $continue)
+            )
+        )
+    )
+
+    (func (export "run") (param $N i64) (result i64)
+        (local $k (ref null $ct))
+        (local $sum i64)
+        (block $done
+            (block $on_yield (result i64 (ref $ct))
+                (resume $gct (on $yield $on_yield)
+                    (local.get $N) (cont.new $gct (ref.func $gen)))
+                (br $done))
+            (local.set $k)
+            (local.set $sum)
+            (loop $next
+                (block $on_yield (result i64 (ref $ct))
+                    (resume $ct (on $yield $on_yield) (local.get $k))
+                    (br $done))
+                (local.set $k)
+                (local.set $sum (i64.add (local.get $sum)))
+                (br $next)
+            )
+        )
+        (local.get $sum)
+    )
+)
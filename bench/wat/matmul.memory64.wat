@@ -0,0 +1,114 @@
+(module
+    ;; Same as matmul.wat on a memory64 memory: addresses and the index
+    ;; arithmetic that produces them are i64.
+    ;; 8 pages satisfy the memory requirement for roughly N <= 200.
+    (memory i64 8 8)
+    (global $size_of_f32 i64 (i64.const 4))
+    ;; Matrix multiplication of 2 NxN matrices.
+    ;; The function returns 0 to keep it aligned to other benchmark functions.
+    ;;
+    ;; This function uses the linear memory in the following way:
+    ;;
+    ;; - mem[0..N*N): `lhs` matrix
+    ;; - mem[N*N..N*N*2): `rhs` matrix
+    ;; - mem[N*N*2..N*N*3): `result` matrix
+    (func (export "run") (param $N i64) (result i64)
+        (local $offset_lhs i64) ;; offset in elements to `lhs` matrix
+        (local $offset_rhs i64) ;; offset in elements to `rhs` matrix
+        (local $offset_res i64) ;; offset in elements to result matrix
+        (local $i i64)
+        (local $j i64)
+        (local $k i64)
+        (local $tmp i64)
+        ;; offset_lhs = 0
+        (local.set $offset_lhs (i64.const 0))
+        ;; offset_rhs = N * N
+        (local.set $offset_rhs (i64.mul (local.get $N) (local.get $N)))
+        ;; offset_res = offset_rhs * 2
+        (local.set $offset_res (i64.mul (local.get $offset_rhs) (i64.const 2)))
+        (block $break_i
+            ;; i = 0
+            (local.set $i (i64.const 0))
+            (loop $continue_i
+                ;; if i >= N: break
+                (br_if $break_i (i64.ge_u (local.get $i) (local.get $N)))
+                (block $break_j
+                    ;; j = 0
+                    (local.set $j (i64.const 0))
+                    (loop $continue_j
+                        ;; if j >= N: break
+                        (br_if $break_j (i64.ge_u (local.get $j) (local.get $N)))
+                        ;; tmp = offset_res + (i * N) + j
+                        (local.set $tmp
+                            (i64.mul
+                                (i64.add
+                                    (local.get $offset_res)
+                                    (i64.add
+                                        (i64.mul (local.get $i) (local.get $N))
+                                        (local.get $j)
+                                    )
+                                )
+                                (global.get $size_of_f32)
+                            )
+                        )
+                        ;; mem[tmp] = 0
+                        (f32.store (local.get $tmp) (f32.const 0.0))
+                        (block $break_k
+                            ;; k = 0
+                            (local.set $k (i64.const 0))
+                            (loop $continue_k
+                                ;; if k >= N: break
+                                (br_if $break_k (i64.ge_u (local.get $k) (local.get $N)))
+                                ;; mem[tmp] += mem[offset_lhs + (i * N) + k] * mem[offset_rhs + (k * N) + j]
+                                (f32.store
+                                    (local.get $tmp)
+                                    (f32.add
+                                        (f32.load (local.get $tmp))
+                                        (f32.mul
+                                            (f32.load
+                                                (i64.mul
+                                                    ;; offset_lhs + (i * N) + k
+                                                    (i64.add
+                                                        (local.get $offset_lhs)
+                                                        (i64.add
+                                                            (i64.mul (local.get $i) (local.get $N))
+                                                            (local.get $k)
+                                                        )
+                                                    )
+                                                    (global.get $size_of_f32)
+                                                )
+                                            )
+                                            (f32.load
+                                                (i64.mul
+                                                    ;; offset_rhs + (k * N) + j
+                                                    (i64.add
+                                                        (local.get $offset_rhs)
+                                                        (i64.add
+                                                            (i64.mul (local.get $k) (local.get $N))
+                                                            (local.get $j)
+                                                        )
+                                                    )
+                                                    (global.get $size_of_f32)
+                                                )
+                                            )
+                                        )
+                                    )
+                                )
+                                ;; k += 1
+                                (local.set $k (i64.add (local.get $k) (i64.const 1)))
+                                (br $continue_k)
+                            )
+                        )
+                        ;; j += 1
+                        (local.set $j (i64.add (local.get $j) (i64.const 1)))
+                        (br $continue_j)
+                    )
+                )
+                ;; i += 1
+                (local.set $i (i64.add (local.get $i) (i64.const 1)))
+                (br $continue_i)
+            )
+        )
+        (i64.const 0)
+    )
+)
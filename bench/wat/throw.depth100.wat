@@ -0,0 +1,31 @@
+(module
+    ;; Throw/catch latency: every iteration throws from 100 frame(s) below
+    ;; the try_table that catches it
+    (tag $e (param i64))
+
+    (func $dive (param $depth i32) (param $v i64)
+        (if (i32.eqz (local.get $depth))
+            (then (throw $e (local.get $v))))
+        (call $dive (i32.sub (local.get $depth) (i32.const 1)) (local.get $v))
+    )
+
+    (func (export "run") (param $N i64) (result i64)
+        (local $i i64)
+        (local $sum i64)
+        (block $break
+            (loop $continue
+                (br_if $break (i64.ge_u (local.get $i) (local.get $N)))
+                (local.set $sum
+                    (i64.add
+                        (local.get $sum)
+                        (block $caught (result i64)
+                            (try_table (catch $e $caught)
+                                (call $dive (i32.const 99) (local.get $i)))
+                            (i64.const 0))))
+                (local.set $i (i64.add (local.get $i) (i64.const 1)))
+                (br $continue)
+            )
+        )
+        (local.get $sum)
+    )
+)
@@ -1,4 +1,5 @@
 #include "gc.h"
+#include "threads.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +32,7 @@ typedef struct {
     size_t collect_threshold;
     int initialized;
     int disable_collect;
+    int roots_incomplete;  // A pointer or stack range could not be recorded
 
     GcPtrSet ptrs;
     GcStackRange* stacks;
@@ -39,7 +41,8 @@ typedef struct {
     int num_globals;
 } GcHeap;
 
-static GcHeap g_gc_heap;
+// One heap per host thread (wasi-threads instances do not share GC objects)
+static THREAD_LOCAL GcHeap g_gc_heap;
 
 static size_t hash_ptr(uintptr_t p) {
     p >>= 3;
@@ -166,7 +169,7 @@ void gc_init(void) {
     g_gc_heap.disable_collect = 1;
     ptrset_init(&g_gc_heap.ptrs, GC_PTRSET_MIN_CAP);
     if (g_gc_heap.ptrs.cap == 0) {
-        g_gc_heap.disable_collect = 1;
+        g_gc_heap.roots_incomplete = 1;
     }
 }
 
@@ -204,6 +207,16 @@ static int gc_is_ptr(uint64_t val) {
     return ptrset_contains(&g_gc_heap.ptrs, (uintptr_t)val);
 }
 
+// Object a slot value refers to, or NULL. extern.convert_any and
+// any.convert_extern keep the object pointer under EXTERNREF_TAG, and that
+// form must keep the object alive as well
+static GcHeader* gc_ref_object(uint64_t val) {
+    if (val != REF_NULL && (val & REF_TAG_MASK) == EXTERNREF_TAG) {
+        val &= ~EXTERNREF_TAG;
+    }
+    return gc_is_ptr(val) ? (GcHeader*)(uintptr_t)val : NULL;
+}
+
 int gc_is_managed_ptr(uint64_t value) {
     if (!g_gc_heap.initialized) {
         return 0;
@@ -218,6 +231,7 @@ void gc_push_stack(uint64_t* base, size_t slots) {
     GcStackRange* range = (GcStackRange*)malloc(sizeof(GcStackRange));
     if (!range) {
         g_gc_heap.disable_collect = 1;
+        g_gc_heap.roots_incomplete = 1;
         return;
     }
     range->base = base;
@@ -274,6 +288,7 @@ GcArray* gc_alloc_array(uint32_t type_idx, int32_t length) {
 
     if (!ptrset_add(&g_gc_heap.ptrs, (uintptr_t)arr)) {
         g_gc_heap.disable_collect = 1;
+        g_gc_heap.roots_incomplete = 1;
     }
 
     return arr;
@@ -310,11 +325,51 @@ GcStruct* gc_alloc_struct(uint32_t type_idx, int32_t field_count) {
 
     if (!ptrset_add(&g_gc_heap.ptrs, (uintptr_t)st)) {
         g_gc_heap.disable_collect = 1;
+        g_gc_heap.roots_incomplete = 1;
     }
 
     return st;
 }
 
+// The code units are left for the caller to fill in
+GcString* gc_alloc_string(int32_t length) {
+    if (!g_gc_heap.initialized) {
+        gc_init();
+    }
+    if (length < 0) {
+        return NULL;
+    }
+    if (!g_gc_heap.disable_collect &&
+        g_gc_heap.alloc_since_gc >= g_gc_heap.collect_threshold) {
+        gc_collect();
+    }
+
+    size_t size = sizeof(GcString) + (size_t)length * sizeof(uint16_t);
+    GcString* str = (GcString*)malloc(size);
+    if (!str) {
+        return NULL;
+    }
+
+    str->header.type_idx = UINT32_MAX;
+    str->header.obj_type = GC_TYPE_STRING;
+    str->header.mark = 0;
+    str->header.age = 0;
+    str->header.gc_next = g_gc_heap.all_objects;
+    g_gc_heap.all_objects = &str->header;
+
+    str->length = length;
+    str->_pad = 0;
+    g_gc_heap.num_objects++;
+    g_gc_heap.alloc_since_gc++;
+
+    if (!ptrset_add(&g_gc_heap.ptrs, (uintptr_t)str)) {
+        g_gc_heap.disable_collect = 1;
+        g_gc_heap.roots_incomplete = 1;
+    }
+
+    return str;
+}
+
 uint64_t gc_alloc_array_const(uint32_t type_idx, int32_t length, uint64_t init_val) {
     GcArray* arr = gc_alloc_array(type_idx, length);
     if (!arr) {
@@ -374,25 +429,19 @@ static void gc_mark_object(GcHeader* obj, GcHeader** stack, size_t* top, size_t
         if (cur->obj_type == GC_TYPE_ARRAY) {
             GcArray* arr = (GcArray*)cur;
             for (int32_t i = 0; i < arr->length; i++) {
-                uint64_t val = arr->elements[i];
-                if (gc_is_ptr(val)) {
-                    GcHeader* child = (GcHeader*)val;
-                    if (!child->mark) {
-                        child->mark = 1;
-                        stack[(*top)++] = child;
-                    }
+                GcHeader* child = gc_ref_object(arr->elements[i]);
+                if (child && !child->mark) {
+                    child->mark = 1;
+                    stack[(*top)++] = child;
                 }
             }
         } else if (cur->obj_type == GC_TYPE_STRUCT) {
             GcStruct* st = (GcStruct*)cur;
             for (int32_t i = 0; i < st->field_count; i++) {
-                uint64_t val = st->fields[i];
-                if (gc_is_ptr(val)) {
-                    GcHeader* child = (GcHeader*)val;
-                    if (!child->mark) {
-                        child->mark = 1;
-                        stack[(*top)++] = child;
-                    }
+                GcHeader* child = gc_ref_object(st->fields[i]);
+                if (child && !child->mark) {
+                    child->mark = 1;
+                    stack[(*top)++] = child;
                 }
             }
         }
@@ -406,19 +455,13 @@ static void gc_mark_roots(GcHeader** stack, size_t* top, size_t cap) {
         }
         uint64_t* end = range->base + range->slots;
         for (uint64_t* p = range->base; p < end; p++) {
-            uint64_t val = *p;
-            if (gc_is_ptr(val)) {
-                gc_mark_object((GcHeader*)val, stack, top, cap);
-            }
+            gc_mark_object(gc_ref_object(*p), stack, top, cap);
         }
     }
 
     if (g_gc_heap.globals && g_gc_heap.num_globals > 0) {
         for (int i = 0; i < g_gc_heap.num_globals; i++) {
-            uint64_t val = g_gc_heap.globals[i];
-            if (gc_is_ptr(val)) {
-                gc_mark_object((GcHeader*)val, stack, top, cap);
-            }
+            gc_mark_object(gc_ref_object(g_gc_heap.globals[i]), stack, top, cap);
         }
     }
 }
@@ -470,3 +513,15 @@ void gc_collect(void) {
         g_gc_heap.collect_threshold *= 2;
     }
 }
+
+// Collect now, also while automatic collection is off. Tables are not
+// scanned as roots, so objects only a table references are freed as well
+void gc_collect_forced(void) {
+    if (!g_gc_heap.initialized || g_gc_heap.roots_incomplete) {
+        return;
+    }
+    int disabled = g_gc_heap.disable_collect;
+    g_gc_heap.disable_collect = 0;
+    gc_collect();
+    g_gc_heap.disable_collect = disabled;
+}
@@ -6,6 +6,7 @@
 
 #define GC_TYPE_ARRAY 1
 #define GC_TYPE_STRUCT 2
+#define GC_TYPE_STRING 3
 
 typedef struct GcHeader {
     uint32_t type_idx;
@@ -29,12 +30,23 @@ typedef struct GcStruct {
     uint64_t fields[];
 } GcStruct;
 
+// A wasm:js-string string: immutable UTF-16 code units, two bytes each.
+// Strings are externref values and hold no references
+typedef struct GcString {
+    GcHeader header;
+    int32_t length;
+    uint32_t _pad;
+    uint16_t chars[];
+} GcString;
+
 void gc_init(void);
 void gc_cleanup(void);
 
 GcArray* gc_alloc_array(uint32_t type_idx, int32_t length);
 GcStruct* gc_alloc_struct(uint32_t type_idx, int32_t field_count);
+GcString* gc_alloc_string(int32_t length);
 void gc_collect(void);
+void gc_collect_forced(void);
 
 void gc_push_stack(uint64_t* base, size_t slots);
 void gc_pop_stack(void);
@@ -0,0 +1,109 @@
+// Native host functions for wasm5
+// Embedders register C functions that modules can import; calls to them
+// go straight through a function pointer, with no handler id dispatch.
+
+#ifndef WASM5_HOST_H
+#define WASM5_HOST_H
+
+#include <stdint.h>
+
+// Value type codes for host function signatures (WebAssembly binary encoding)
+#define HOST_TYPE_I32        0x7F
+#define HOST_TYPE_I64        0x7E
+#define HOST_TYPE_F32        0x7D
+#define HOST_TYPE_F64        0x7C
+#define HOST_TYPE_V128       0x7B
+#define HOST_TYPE_FUNCREF    0x70
+#define HOST_TYPE_EXTERNREF  0x6F
+#define HOST_TYPE_ANYREF     0x6E  // Any other reference type
+
+// Most results a host function may return
+#define HOST_FUNC_MAX_RESULTS 16
+
+// Returned by a host function whose results are not ready yet
+#define HOST_FUNC_PENDING 0x70656E64  // 'pend'
+
+// A native host function. args holds one raw 64-bit slot per parameter
+// (i32/f32 in the low 32 bits, floats as bit patterns, references as the
+// runtime encodes them); the function writes one slot per result to
+// results. mem and mem_size are the caller's linear memory (memory 0; its
+// size is 64-bit since memory64 memories may exceed 4 GiB). Returns 0,
+// HOST_FUNC_PENDING, or any other nonzero value to trap ("host function
+// trap").
+//
+// HOST_FUNC_PENDING suspends the wasm call, which must be running as an
+// invocation (invocation_run) and call the import directly: its frames are
+// kept and invocation_run returns INVOCATION_PENDING. The embedder resumes
+// it later with the results, so one thread can interleave many calls that
+// wait on the host. Elsewhere, and for calls through a table or reference,
+// a pending result traps.
+typedef int (*HostFunc)(void* env, const uint64_t* args, uint64_t* results,
+                        uint8_t* mem, uint64_t mem_size);
+
+// Register fn (called with env) for imports of module.name whose signature
+// is types[0..num_params-1] -> types[num_params..num_params+num_results-1].
+// Registering the same name and signature again replaces the function, also
+// for modules already loaded. Returns the function's index or -1 on error
+int host_func_register(const uint8_t* module, int module_len,
+                       const uint8_t* name, int name_len,
+                       const uint8_t* types, int num_params, int num_results,
+                       HostFunc fn, void* env);
+
+// Find the function registered for module.name with exactly this signature
+// Returns its index, or -1 if there is none
+int host_func_find(const uint8_t* module, int module_len,
+                   const uint8_t* name, int name_len,
+                   const uint8_t* types, int num_params, int num_results);
+
+// invocation_run results while the invocation waits on a host function,
+// and when it has used up its time slice
+#define INVOCATION_PENDING (-1)
+#define INVOCATION_YIELDED (-2)
+
+// Prepare a call of local function func_idx of the instance whose runtime
+// context is ctx, on a stack of its own. Returns the invocation, or 0 if
+// out of memory
+int64_t invocation_new(int64_t ctx, int func_idx, const uint64_t* args,
+                       int num_args);
+
+// Start or continue an invocation. When it is pending, results are the
+// pending host function's results. Returns INVOCATION_PENDING,
+// INVOCATION_YIELDED, or the trap code (0 = none) once the call has finished
+int invocation_run(int64_t inv, const uint64_t* results, int num_results);
+
+// Limit each invocation_run to epochs increments of the global epoch (0 = no
+// limit). Only code compiled with epoch checks yields
+void invocation_set_slice(int64_t inv, uint64_t epochs);
+
+// Serve the invocation's WASI stdin and stdout from host fds (-1 = the
+// process's own) while it runs
+void invocation_set_stdio(int64_t inv, int stdin_fd, int stdout_fd);
+
+// Advance the global epoch; returns the new value
+uint64_t epoch_increment(void);
+
+// The invocation running on this thread, or 0; a host function reads it
+// before returning HOST_FUNC_PENDING to know what to resume
+int64_t invocation_current(void);
+
+// Index of the host function a pending invocation waits on; its argument
+// slots are copied to args
+int invocation_pending_host(int64_t inv, uint64_t* args, int num_args);
+
+// Copy the results of a finished invocation
+void invocation_results(int64_t inv, uint64_t* results, int num_results);
+
+// Release an invocation, finished or not
+void invocation_free(int64_t inv);
+
+// Snapshot the mutable state (globals, memories, tables, segment drops) of
+// the instance whose context is ctx, which has num_globals globals.
+// Returns the snapshot, or 0 if out of memory
+int64_t runtime_context_snapshot(int64_t ctx, int num_globals);
+
+// Put an instance that is not running back into a snapshot's state; fds
+// its guest opened are closed
+void runtime_context_restore(int64_t ctx, int64_t snapshot);
+void runtime_context_snapshot_free(int64_t snapshot);
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -7,6 +8,27 @@
 
 #include "wasi.h"
 #include "gc.h"
+#include "host.h"
+#include "threads.h"
+
+// x86 vector intrinsics for the SIMD ops; SSE2 is baseline on x86-64 and the
+// newer sets are used when the compiler targets them
+#if !defined(WASM5_NO_SIMD_INTRINSICS) && (defined(__SSE2__) || defined(_M_X64))
+#  define SIMD_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__SSSE3__)
+#    define SIMD_SSSE3 1
+#    include <tmmintrin.h>
+#  endif
+#  if defined(__SSE4_1__)
+#    define SIMD_SSE41 1
+#    include <smmintrin.h>
+#  endif
+#  if defined(__SSE4_2__)
+#    define SIMD_SSE42 1
+#    include <nmmintrin.h>
+#  endif
+#endif
 
 // Debug flag - set to 1 to enable tracing
 #define DEBUG_TRACE 0
@@ -37,6 +59,15 @@
 #define TRAP_NULL_I31_REFERENCE         17 // "null i31 reference"
 #define TRAP_CAST_FAILURE               18 // "cast failure"
 #define TRAP_NULL_STRUCT_REFERENCE      19 // "null structure reference"
+#define TRAP_HOST_FUNCTION              20 // A native host function trapped
+#define TRAP_UNALIGNED_ATOMIC           21 // Atomic access not naturally aligned
+#define TRAP_EXPECTED_SHARED_MEMORY     22 // memory.atomic.wait on unshared memory
+#define TRAP_EXCEPTION                  23 // A wasm exception is in flight (uncaught if it escapes)
+#define TRAP_CONT_CONSUMED              24 // "continuation already consumed"
+#define TRAP_UNHANDLED_TAG              25 // suspend or switch with no enclosing handler
+#define TRAP_OUT_OF_MEMORY              26 // A runtime allocation failed
+#define TRAP_SUSPEND                    27 // Internal: a continuation is suspending
+#define TRAP_HOST_PENDING               28 // Internal: a native host function is pending
 
 // Reference tags and null
 #define REF_NULL 0xFFFFFFFFFFFFFFFFULL
@@ -44,9 +75,12 @@
 #define EXTERNREF_TAG 0x2000000000000000ULL
 #define REF_TAG_MASK 0x6000000000000000ULL
 
-// Memory bounds check helper - use 64-bit arithmetic to avoid overflow
+// Memory bounds check helper - use 64-bit arithmetic to avoid overflow.
+// A shared memory may have been grown by another thread, so the size is
+// reloaded before trapping
 #define CHECK_MEMORY(addr, size) \
-    if ((uint64_t)(addr) + (uint64_t)(size) > (uint64_t)g_memory_size) { \
+    if ((uint64_t)(addr) + (uint64_t)(size) > g_memory_size && \
+        (uint64_t)(addr) + (uint64_t)(size) > memory_refresh_size()) { \
         TRAP(TRAP_OUT_OF_BOUNDS_MEMORY); \
     }
 
@@ -201,7 +235,7 @@ typedef int (*OpFn)(CRuntime*, uint64_t*, uint64_t*, uint64_t*);
 #  define MUSTTAIL
 #endif
 
-static int g_validate_code = 0;
+static THREAD_LOCAL int g_validate_code = 0;
 
 // NEXT: fetch next opcode and tail-call with updated pc
 #define NEXT() do { \
@@ -215,46 +249,149 @@ static int g_validate_code = 0;
 
 #define TRAP(code) return (code)
 
+// A call returned trap code `trap`. An exception looks for a handler in the
+// calling frame first (pc is past the call's immediates); a suspension saves
+// the calling frame in the running continuation; any other trap, or an
+// exception with no handler here, unwinds to our caller
+typedef struct Cont Cont;
+static int exn_dispatch(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp);
+static int cont_save_frame(uint64_t* pc, uint64_t* sp, uint64_t* fp, Cont* child);
+#define CALLEE_TRAP(trap) do { \
+    if ((trap) == TRAP_EXCEPTION) { \
+        MUSTTAIL return exn_dispatch(crt, pc, sp, fp); \
+    } \
+    if ((trap) == TRAP_SUSPEND) { \
+        return cont_save_frame(pc, sp, fp, NULL); \
+    } \
+    return (trap); \
+} while(0)
+
 // Stack size: 64K slots = 512KB
 #define STACK_SIZE 65536
 
+// A v128 value keeps its high 64 bits V128_HI slots above its slot, so the
+// stacks of modules that hold v128 values are allocated at twice STACK_SIZE
+#define V128_HI STACK_SIZE
+
+// The instance state below is per host thread: a thread started by
+// wasi-threads thread-spawn runs its own instance of the module, sharing
+// only the linear memory (and tables) with the thread that spawned it.
+
 // Memory pages info (shared across calls within same instance)
-static int* g_memory_pages = NULL;
-static int g_memory_size = 0;
-static int g_memory_max_size = 0;  // Maximum memory size (pre-allocated)
+static THREAD_LOCAL int* g_memory_pages = NULL;
+static THREAD_LOCAL uint64_t g_memory_size = 0;  // Bytes; memory64 memories may pass 4 GiB
+static THREAD_LOCAL int g_memory_max_size = 0;  // Maximum memory size (pre-allocated)
+
+// Reload g_memory_size from the page count, which memory.grow on another
+// thread may have raised. Returns the current size in bytes
+static uint64_t memory_refresh_size(void) {
+    if (g_memory_pages) {
+        int pages = atomic_load_explicit((_Atomic int*)g_memory_pages, memory_order_acquire);
+        g_memory_size = (uint64_t)(uint32_t)pages * 65536;
+    }
+    return g_memory_size;
+}
+
+// Multi-memory: every memory of the instance, indexed by memory index.
+// Memory 0 stays on the fast path above (crt->mem, g_memory_size), so only
+// the *_mem handler variants, which the transform selects for a nonzero
+// memory index, and the *_m64 variants for memory64 memories look memories
+// up here. NULL for modules with a single memory32 memory
+typedef struct MemoryDesc {
+    uint8_t* base;
+    int* pages;        // Current size in pages (shared with MoonBit)
+    int64_t max_size;  // Bytes pre-allocated or reserved (memory.grow limit)
+    int memory64;      // 64-bit addresses; base is a reservation (memory64_new)
+} MemoryDesc;
+
+typedef struct MemoryTable {
+    int num_memories;
+    MemoryDesc memories[];
+} MemoryTable;
+
+static THREAD_LOCAL MemoryTable* g_memories = NULL;
+
+// Descriptor of memory idx (validated, never 0 in *_mem handlers)
+#define MEMORY_DESC(idx) (&g_memories->memories[(idx)])
+
+// Current size of a memory in bytes; grows on other threads show up here
+static inline uint64_t memory_desc_size(const MemoryDesc* mem) {
+    return (uint64_t)(uint32_t)atomic_load_explicit((_Atomic int*)mem->pages, memory_order_acquire) * 65536;
+}
+
+// Memory 0 as host functions and WASI see it: base and current size in
+// bytes. A memory64 memory 0 lives in the memory table, not in mem0
+static inline uint8_t* host_memory(uint8_t* mem0, uint64_t* size) {
+    if (g_memories && g_memories->num_memories > 0 && g_memories->memories[0].memory64) {
+        *size = memory_desc_size(&g_memories->memories[0]);
+        return g_memories->memories[0].base;
+    }
+    *size = memory_refresh_size();
+    return mem0;
+}
+
+// Bounds check against a memory of the table
+#define CHECK_MEMORY_DESC(mem, addr, size) \
+    if ((uint64_t)(addr) + (uint64_t)(size) > memory_desc_size(mem)) { \
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY); \
+    }
+
+// Memory access in handlers generated for both memory 0 (MEMORY0) and a
+// memory of the table (MEMORYN, index given to M##_SELECT)
+#define MEMORY0_SELECT(idx) (void)(idx)
+#define MEMORY0_BASE crt->mem
+#define MEMORY0_ADDR(slot, offset) ((uint64_t)(uint32_t)(slot) + (uint64_t)(uint32_t)(offset))
+#define MEMORY0_CHECK(addr, size) CHECK_MEMORY(addr, size)
+#define MEMORYN_SELECT(idx) MemoryDesc* mem = MEMORY_DESC(idx)
+#define MEMORYN_BASE mem->base
+#define MEMORYN_ADDR(slot, offset) MEMORY0_ADDR(slot, offset)
+#define MEMORYN_CHECK(addr, size) CHECK_MEMORY_DESC(mem, addr, size)
+
+// memory64 memories (MEMORY64) are memories of the table addressed by the
+// full 64-bit slot. A memory64 memory is far smaller than 2^48 bytes, so
+// larger addresses are clamped to one that fails the bounds check without
+// overflowing it: the check stays a single add and compare
+#define MEMORY64_ADDR_LIMIT (UINT64_C(1) << 48)
+static inline uint64_t memory64_addr(uint64_t slot, uint32_t offset) {
+    return slot < MEMORY64_ADDR_LIMIT ? slot + offset : MEMORY64_ADDR_LIMIT;
+}
+#define MEMORY64_SELECT(idx) MEMORYN_SELECT(idx)
+#define MEMORY64_BASE MEMORYN_BASE
+#define MEMORY64_ADDR(slot, offset) memory64_addr(slot, (uint32_t)(offset))
+#define MEMORY64_CHECK(addr, size) MEMORYN_CHECK(addr, size)
 
 // Multiple tables support (for call_indirect and table ops)
-static int* g_tables_flat = NULL;      // All tables concatenated (funcref indices)
-static uint64_t* g_tables_flat_u64 = NULL; // All tables concatenated (full refs)
-static int* g_table_offsets = NULL;    // Offset of each table in g_tables_flat
-static int* g_table_sizes = NULL;      // Current size of each table
-static int* g_table_max_sizes = NULL;  // Maximum size (capacity) of each table for table.grow
-static int* g_table_elem_is_funcref = NULL;  // 1 for funcref tables, 0 for externref
-static int g_num_tables = 0;
+static THREAD_LOCAL int* g_tables_flat = NULL;      // All tables concatenated (funcref indices)
+static THREAD_LOCAL uint64_t* g_tables_flat_u64 = NULL; // All tables concatenated (full refs)
+static THREAD_LOCAL int* g_table_offsets = NULL;    // Offset of each table in g_tables_flat
+static THREAD_LOCAL int* g_table_sizes = NULL;      // Current size of each table
+static THREAD_LOCAL int* g_table_max_sizes = NULL;  // Maximum size (capacity) of each table for table.grow
+static THREAD_LOCAL int* g_table_elem_is_funcref = NULL;  // 1 for funcref tables, 0 for externref
+static THREAD_LOCAL int g_num_tables = 0;
 
 // Function metadata (for call_indirect)
-static int* g_func_entries = NULL;
-static int* g_func_num_locals = NULL;
-static int g_num_funcs = 0;
-static int g_num_imported_funcs = 0;
+static THREAD_LOCAL int* g_func_entries = NULL;
+static THREAD_LOCAL int* g_func_num_locals = NULL;
+static THREAD_LOCAL int g_num_funcs = 0;
+static THREAD_LOCAL int g_num_imported_funcs = 0;
 
 // Type information (for call_indirect type checking)
-static int* g_func_type_idxs = NULL;       // Type index for each function
-static int* g_type_sig_hash1 = NULL;       // Primary signature hash for each type
-static int* g_type_sig_hash2 = NULL;       // Secondary signature hash for each type
-static int* g_type_subtype_matrix = NULL;  // type_idx -> target_idx subtype matrix (num_types x num_types)
-static int g_num_types = 0;
+static THREAD_LOCAL int* g_func_type_idxs = NULL;       // Type index for each function
+static THREAD_LOCAL int* g_type_sig_hash1 = NULL;       // Primary signature hash for each type
+static THREAD_LOCAL int* g_type_sig_hash2 = NULL;       // Secondary signature hash for each type
+static THREAD_LOCAL int* g_type_subtype_matrix = NULL;  // type_idx -> target_idx subtype matrix (num_types x num_types)
+static THREAD_LOCAL int g_num_types = 0;
 
 // Import function metadata (for op_call_import)
-static int* g_import_num_params = NULL;    // Number of params for each imported function
-static int* g_import_num_results = NULL;   // Number of results for each imported function
-static int* g_import_handler_ids = NULL;   // Host handler id for each imported function
-static uint8_t* g_output_buffer = NULL;    // Output buffer for spectest handlers
-static int* g_output_length = NULL;        // Current output length
-static int g_output_capacity = 0;          // Output buffer capacity
+static THREAD_LOCAL int* g_import_num_params = NULL;    // Number of params for each imported function
+static THREAD_LOCAL int* g_import_num_results = NULL;   // Number of results for each imported function
+static THREAD_LOCAL int* g_import_handler_ids = NULL;   // Host handler id for each imported function
+static THREAD_LOCAL uint8_t* g_output_buffer = NULL;    // Output buffer for spectest handlers
+static THREAD_LOCAL int* g_output_length = NULL;        // Current output length
+static THREAD_LOCAL int g_output_capacity = 0;          // Output buffer capacity
 // Cross-module resolved imports (for call_indirect with imported functions)
-static int64_t* g_import_context_ptrs = NULL;  // Target context pointer for each import (-1 if not resolved)
-static int* g_import_target_func_idxs = NULL;  // Function index in target module for each import
+static THREAD_LOCAL int64_t* g_import_context_ptrs = NULL;  // Target context pointer for each import (-1 if not resolved)
+static THREAD_LOCAL int* g_import_target_func_idxs = NULL;  // Function index in target module for each import
 
 static int func_type_is_subtype(int actual_type_idx, int expected_type_idx) {
     if (actual_type_idx == expected_type_idx) {
@@ -273,19 +410,22 @@ static int func_type_is_subtype(int actual_type_idx, int expected_type_idx) {
 }
 
 // Data segments for bulk memory operations (memory.init, data.drop)
-static uint8_t* g_data_segments_flat = NULL;   // All data segments concatenated
-static int* g_data_segment_offsets = NULL;     // Offset of each segment in data_segments_flat
-static int* g_data_segment_sizes = NULL;       // Size of each segment (mutable for data.drop)
-static int g_num_data_segments = 0;
+static THREAD_LOCAL uint8_t* g_data_segments_flat = NULL;   // All data segments concatenated
+static THREAD_LOCAL int* g_data_segment_offsets = NULL;     // Offset of each segment in data_segments_flat
+static THREAD_LOCAL int* g_data_segment_sizes = NULL;       // Size of each segment (mutable for data.drop)
+static THREAD_LOCAL int g_num_data_segments = 0;
 
 // Element segments for bulk table operations (table.init, elem.drop)
-static int* g_elem_segments_flat = NULL;       // All element segments concatenated (func indices, -1 for null)
-static uint64_t* g_elem_segments_flat_u64 = NULL; // All element segments concatenated (GC refs)
-static int* g_elem_segment_offsets = NULL;     // Offset of each segment in elem_segments_flat
-static int* g_elem_segment_sizes = NULL;       // Size of each segment (mutable for elem.drop)
-static int* g_elem_segment_dropped = NULL;     // Whether each segment has been dropped
-static int g_num_elem_segments = 0;
-static int g_num_external_funcrefs = 0;
+static THREAD_LOCAL int* g_elem_segments_flat = NULL;       // All element segments concatenated (func indices, -1 for null)
+static THREAD_LOCAL uint64_t* g_elem_segments_flat_u64 = NULL; // All element segments concatenated (GC refs)
+static THREAD_LOCAL int* g_elem_segment_offsets = NULL;     // Offset of each segment in elem_segments_flat
+static THREAD_LOCAL int* g_elem_segment_sizes = NULL;       // Size of each segment (mutable for elem.drop)
+static THREAD_LOCAL int* g_elem_segment_dropped = NULL;     // Whether each segment has been dropped
+static THREAD_LOCAL int g_num_elem_segments = 0;
+static THREAD_LOCAL int g_num_external_funcrefs = 0;
+
+// Exception handler table (see CompiledModule::eh_table in MoonBit)
+static THREAD_LOCAL int* g_eh_table = NULL;
 
 // Host import handler ids (kept in sync with runtime.mbt)
 #define HOST_IMPORT_SPECTEST_PRINT 0
@@ -296,10 +436,29 @@ static int g_num_external_funcrefs = 0;
 #define HOST_IMPORT_SPECTEST_PRINT_I32_F32 5
 #define HOST_IMPORT_SPECTEST_PRINT_F64_F64 6
 #define HOST_IMPORT_SPECTEST_PRINT_CHAR 7
+// wasm:js-string builtin i (JS_STRING_*) is handler id
+// HOST_IMPORT_JS_STRING_BASE + i
+#define HOST_IMPORT_JS_STRING_BASE 64
+// wasi-threads thread-spawn of registration i is handler id
+// HOST_IMPORT_THREAD_SPAWN_BASE + i
+#define HOST_IMPORT_THREAD_SPAWN_BASE 2048
+#define THREAD_SPAWN_MAX (HOST_IMPORT_NATIVE_BASE - HOST_IMPORT_THREAD_SPAWN_BASE)
+// Native host function i is handler id HOST_IMPORT_NATIVE_BASE + i
+#define HOST_IMPORT_NATIVE_BASE 4096
 
 // Stack base for result extraction after execution
-static uint64_t* g_stack_base = NULL;
-static int g_num_globals = 0;
+static THREAD_LOCAL uint64_t* g_stack_base = NULL;
+static THREAD_LOCAL int g_num_globals = 0;
+
+// Whether the running module holds v128 values (CompiledModule uses_v128).
+// Such a module only runs on a stack with room for the high halves, and
+// ops that move whole slots move the high halves only when this is set
+static THREAD_LOCAL int g_uses_v128 = 0;
+
+// Allocate a value stack, with room for v128 high halves if v128 is set
+static uint64_t* stack_alloc(int v128) {
+    return (uint64_t*)malloc((size_t)(v128 ? 2 : 1) * STACK_SIZE * sizeof(uint64_t));
+}
 
 // ============================================================================
 // Cross-module call support (context switching)
@@ -311,9 +470,10 @@ typedef struct CRuntimeContext {
     uint64_t* globals;
     int num_globals;
     uint8_t* memory;
-    int memory_size;
+    uint64_t memory_size;
     int memory_max_size;
     int* memory_pages;
+    MemoryTable* memories;    // All memories of a multi-memory module (NULL = memory 0 only)
     int* tables_flat;
     uint64_t* tables_flat_u64;
     int* table_offsets;
@@ -349,12 +509,25 @@ typedef struct CRuntimeContext {
     int* elem_segment_dropped;
     int num_elem_segments;
     int num_external_funcrefs;
+    int* eh_table;
+    WasiFdTable* wasi_fds;    // Instance's WASI fd table (NULL = shared default)
+    int uses_v128;            // The module holds v128 values (g_uses_v128)
 } CRuntimeContext;
 
 // Maximum nesting depth for cross-module calls
 #define MAX_CONTEXT_DEPTH 16
-static CRuntimeContext g_saved_contexts[MAX_CONTEXT_DEPTH];
-static int g_context_depth = 0;
+static THREAD_LOCAL CRuntimeContext g_saved_contexts[MAX_CONTEXT_DEPTH];
+static THREAD_LOCAL int g_context_depth = 0;
+
+// Innermost resume in progress on this thread (see Stack switching)
+typedef struct ResumeRecord ResumeRecord;
+static THREAD_LOCAL ResumeRecord* g_resume_top = NULL;
+
+// Invocation running on this thread (see Async invocations)
+typedef struct Invocation Invocation;
+static THREAD_LOCAL Invocation* g_invocation = NULL;
+static int host_pending(int host_idx, uint64_t* args, uint64_t* pc,
+                        uint64_t* sp, uint64_t* fp);
 
 // Save current global state to a context structure
 static void save_context(CRuntimeContext* ctx, CRuntime* crt) {
@@ -365,6 +538,7 @@ static void save_context(CRuntimeContext* ctx, CRuntime* crt) {
     ctx->memory_size = g_memory_size;
     ctx->memory_max_size = g_memory_max_size;
     ctx->memory_pages = g_memory_pages;
+    ctx->memories = g_memories;
     ctx->tables_flat = g_tables_flat;
     ctx->tables_flat_u64 = g_tables_flat_u64;
     ctx->table_offsets = g_table_offsets;
@@ -400,6 +574,9 @@ static void save_context(CRuntimeContext* ctx, CRuntime* crt) {
     ctx->elem_segment_dropped = g_elem_segment_dropped;
     ctx->num_elem_segments = g_num_elem_segments;
     ctx->num_external_funcrefs = g_num_external_funcrefs;
+    ctx->eh_table = g_eh_table;
+    ctx->wasi_fds = wasi_fd_table_current();
+    ctx->uses_v128 = g_uses_v128;
 }
 
 // Load global state from a context structure
@@ -412,6 +589,7 @@ static void load_context(const CRuntimeContext* ctx, CRuntime* crt) {
     g_memory_size = ctx->memory_size;
     g_memory_max_size = ctx->memory_max_size;
     g_memory_pages = ctx->memory_pages;
+    g_memories = ctx->memories;
     g_tables_flat = ctx->tables_flat;
     g_tables_flat_u64 = ctx->tables_flat_u64;
     g_table_offsets = ctx->table_offsets;
@@ -447,6 +625,9 @@ static void load_context(const CRuntimeContext* ctx, CRuntime* crt) {
     g_elem_segment_dropped = ctx->elem_segment_dropped;
     g_num_elem_segments = ctx->num_elem_segments;
     g_num_external_funcrefs = ctx->num_external_funcrefs;
+    g_eh_table = ctx->eh_table;
+    g_uses_v128 = ctx->uses_v128;
+    wasi_fd_table_activate(ctx->wasi_fds);
 }
 
 // Create a new context from module data (called from MoonBit)
@@ -463,7 +644,8 @@ CRuntimeContext* create_runtime_context(
     int64_t* import_context_ptrs, int* import_target_func_idxs,
     uint8_t* data_segments_flat, int* data_segment_offsets, int* data_segment_sizes, int num_data_segments,
     int* elem_segments_flat, uint64_t* elem_segments_flat_u64, int* elem_segment_offsets, int* elem_segment_sizes,
-    int* elem_segment_dropped, int num_elem_segments, int num_external_funcrefs
+    int* elem_segment_dropped, int num_elem_segments, int num_external_funcrefs,
+    int* eh_table
 ) {
     CRuntimeContext* ctx = (CRuntimeContext*)malloc(sizeof(CRuntimeContext));
     if (!ctx) return NULL;
@@ -472,9 +654,10 @@ CRuntimeContext* create_runtime_context(
     ctx->globals = globals;
     ctx->num_globals = 0;
     ctx->memory = memory;
-    ctx->memory_size = memory_size;
+    ctx->memory_size = (uint64_t)(uint32_t)memory_size;
     ctx->memory_max_size = memory_max_size;
     ctx->memory_pages = memory_pages;
+    ctx->memories = NULL;
     ctx->tables_flat = tables_flat;
     ctx->tables_flat_u64 = tables_flat_u64;
     ctx->table_offsets = table_offsets;
@@ -510,15 +693,253 @@ CRuntimeContext* create_runtime_context(
     ctx->elem_segment_dropped = elem_segment_dropped;
     ctx->num_elem_segments = num_elem_segments;
     ctx->num_external_funcrefs = num_external_funcrefs;
+    ctx->eh_table = eh_table;
+    ctx->wasi_fds = NULL;
+    ctx->uses_v128 = 0;
 
     return ctx;
 }
 
+// Mark a context's module as holding v128 values (called from MoonBit)
+void runtime_context_set_v128(CRuntimeContext* ctx, int uses_v128) {
+    ctx->uses_v128 = uses_v128;
+}
+
+// Attach an instance's WASI fd table to its context (called from MoonBit)
+void runtime_context_set_wasi_fds(CRuntimeContext* ctx, WasiFdTable* wasi_fds) {
+    ctx->wasi_fds = wasi_fds;
+}
+
+// Attach an instance's memory table to its context (called from MoonBit)
+void runtime_context_set_memories(CRuntimeContext* ctx, MemoryTable* memories) {
+    ctx->memories = memories;
+}
+
+// A table for num_memories memories, to be filled with memory_table_set.
+// Returns it or NULL if out of memory
+MemoryTable* memory_table_new(int num_memories) {
+    MemoryTable* table = (MemoryTable*)calloc(1, sizeof(MemoryTable) + (size_t)num_memories * sizeof(MemoryDesc));
+    if (table) {
+        table->num_memories = num_memories;
+    }
+    return table;
+}
+
+// Describe memory idx: base pre-allocated to max_size bytes, pages its
+// current size in pages. Both stay owned by the caller
+void memory_table_set(MemoryTable* table, int idx, uint8_t* base, int* pages, int max_size) {
+    table->memories[idx].base = base;
+    table->memories[idx].pages = pages;
+    table->memories[idx].max_size = max_size;
+    table->memories[idx].memory64 = 0;
+}
+
+// Describe memory64 memory idx: base a reservation of max_size bytes from
+// memory64_new, pages its current size in pages (owned by the caller)
+void memory_table_set64(MemoryTable* table, int idx, uint8_t* base, int* pages, int64_t max_size) {
+    table->memories[idx].base = base;
+    table->memories[idx].pages = pages;
+    table->memories[idx].max_size = max_size;
+    table->memories[idx].memory64 = 1;
+}
+
+// Bytes of inaccessible address space kept after each memory64 reservation,
+// so a stray access past its end faults instead of reaching a neighbour
+#define MEMORY64_GUARD_SIZE ((uint64_t)1 << 31)
+
+// Backing store for a memory64 memory: max_size bytes of address space are
+// reserved up front, so memory.grow commits pages in place and the base
+// never moves, and the first initial_pages pages are committed (zeroed).
+// Memory a pre-allocated FixedArray can't hold (2 GiB and up) fits, and
+// untouched pages cost nothing. The reservation lasts until memory64_free
+// (memory_table_free). Returns the base or NULL
+uint8_t* memory64_new(int64_t max_size, int initial_pages) {
+    if (max_size < 0 || (uint64_t)max_size >= MEMORY64_ADDR_LIMIT) {
+        return NULL;
+    }
+    uint64_t reserved = (uint64_t)max_size + MEMORY64_GUARD_SIZE;
+    uint8_t* base = (uint8_t*)threads_memory_reserve(reserved);
+    if (base && threads_memory_commit(base, (uint64_t)initial_pages * 65536) != 0) {
+        threads_memory_release(base, reserved);
+        return NULL;
+    }
+    return base;
+}
+
+// Release a memory64 memory of max_size bytes from memory64_new
+void memory64_free(uint8_t* base, int64_t max_size) {
+    threads_memory_release(base, (uint64_t)max_size + MEMORY64_GUARD_SIZE);
+}
+
+// Free a memory table and the memory64 memories it describes; memory32
+// memories belong to MoonBit and stay (NULL is ignored)
+void memory_table_free(MemoryTable* table) {
+    if (!table) return;
+    for (int i = 0; i < table->num_memories; i++) {
+        if (table->memories[i].memory64) {
+            memory64_free(table->memories[i].base, table->memories[i].max_size);
+        }
+    }
+    free(table);
+}
+
+// Copy len bytes of data to offset of a memory64 memory (data segments);
+// the caller keeps them within its committed size
+void memory64_write(uint8_t* base, int64_t offset, const uint8_t* data, int len) {
+    if (len > 0) {
+        memcpy(base + offset, data, (size_t)len);
+    }
+}
+
+// Make table the memory table of calls executed on this thread without a
+// context (execute, execute_batch). Returns the previous one
+MemoryTable* memory_table_activate(MemoryTable* table) {
+    MemoryTable* prev = g_memories;
+    g_memories = table;
+    return prev;
+}
+
 // Free a context (called from MoonBit)
+// Free a context with its memory table (memory_table_free)
 void free_runtime_context(CRuntimeContext* ctx) {
+    memory_table_free(ctx->memories);
     free(ctx);
 }
 
+// ============================================================================
+// Instance snapshots
+// ============================================================================
+//
+// A snapshot holds the mutable state of an instance (globals, memories,
+// tables and segment drops) so a pooled instance can start a call as if it
+// were freshly instantiated. Memory beyond a memory's snapshot size is
+// zeroed and the memory shrinks back; memory64 pages stay committed.
+
+typedef struct {
+    uint8_t* bytes;
+    int pages;
+} MemorySnapshot;
+
+typedef struct {
+    uint64_t* globals;
+    int num_globals;
+    int num_memories;
+    MemorySnapshot* memories;
+    int table_slots;          // Elements of tables_flat(_u64)
+    int* tables_flat;
+    uint64_t* tables_flat_u64;
+    int* table_sizes;
+    int* data_segment_sizes;
+    int* elem_segment_sizes;
+    int* elem_segment_dropped;
+} ContextSnapshot;
+
+static void* snapshot_copy(const void* src, size_t size) {
+    void* copy = malloc(size > 0 ? size : 1);
+    if (copy && size > 0) memcpy(copy, src, size);
+    return copy;
+}
+
+// Memory idx of ctx: its base and current size in pages
+static uint8_t* context_memory(const CRuntimeContext* ctx, int idx, int** pages) {
+    if (ctx->memories) {
+        *pages = ctx->memories->memories[idx].pages;
+        return ctx->memories->memories[idx].base;
+    }
+    *pages = ctx->memory_pages;
+    return ctx->memory;
+}
+
+void runtime_context_snapshot_free(int64_t snapshot) {
+    ContextSnapshot* snap = (ContextSnapshot*)(uintptr_t)snapshot;
+    if (!snap) return;
+    if (snap->memories) {
+        for (int i = 0; i < snap->num_memories; i++) free(snap->memories[i].bytes);
+    }
+    free(snap->memories);
+    free(snap->globals);
+    free(snap->tables_flat);
+    free(snap->tables_flat_u64);
+    free(snap->table_sizes);
+    free(snap->data_segment_sizes);
+    free(snap->elem_segment_sizes);
+    free(snap->elem_segment_dropped);
+    free(snap);
+}
+
+// Snapshot the instance whose context is ctx, which has num_globals globals
+// (called from MoonBit). Returns the snapshot, or 0 if out of memory
+int64_t runtime_context_snapshot(int64_t ctx_ptr, int num_globals) {
+    const CRuntimeContext* ctx = (const CRuntimeContext*)(uintptr_t)ctx_ptr;
+    ContextSnapshot* snap = (ContextSnapshot*)calloc(1, sizeof(ContextSnapshot));
+    if (!snap) return 0;
+    snap->num_globals = num_globals;
+    snap->globals = (uint64_t*)snapshot_copy(ctx->globals, (size_t)num_globals * sizeof(uint64_t));
+    snap->num_memories = ctx->memories ? ctx->memories->num_memories : 1;
+    snap->memories = (MemorySnapshot*)calloc((size_t)snap->num_memories, sizeof(MemorySnapshot));
+    int ok = snap->globals && snap->memories;
+    for (int i = 0; ok && i < snap->num_memories; i++) {
+        int* pages;
+        uint8_t* base = context_memory(ctx, i, &pages);
+        snap->memories[i].pages = *pages;
+        snap->memories[i].bytes = (uint8_t*)snapshot_copy(base, (size_t)(uint32_t)*pages * 65536);
+        ok = snap->memories[i].bytes != NULL;
+    }
+    if (ok && ctx->num_tables > 0) {
+        int last = ctx->num_tables - 1;
+        snap->table_slots = ctx->table_offsets[last] + ctx->table_max_sizes[last];
+        snap->tables_flat = (int*)snapshot_copy(ctx->tables_flat, (size_t)snap->table_slots * sizeof(int));
+        snap->tables_flat_u64 = (uint64_t*)snapshot_copy(ctx->tables_flat_u64, (size_t)snap->table_slots * sizeof(uint64_t));
+        snap->table_sizes = (int*)snapshot_copy(ctx->table_sizes, (size_t)ctx->num_tables * sizeof(int));
+        ok = snap->tables_flat && snap->tables_flat_u64 && snap->table_sizes;
+    }
+    if (ok) {
+        snap->data_segment_sizes = (int*)snapshot_copy(ctx->data_segment_sizes, (size_t)ctx->num_data_segments * sizeof(int));
+        snap->elem_segment_sizes = (int*)snapshot_copy(ctx->elem_segment_sizes, (size_t)ctx->num_elem_segments * sizeof(int));
+        snap->elem_segment_dropped = (int*)snapshot_copy(ctx->elem_segment_dropped, (size_t)ctx->num_elem_segments * sizeof(int));
+        ok = snap->data_segment_sizes && snap->elem_segment_sizes && snap->elem_segment_dropped;
+    }
+    if (!ok) {
+        runtime_context_snapshot_free((int64_t)(uintptr_t)snap);
+        return 0;
+    }
+    return (int64_t)(uintptr_t)snap;
+}
+
+// Put the instance whose context is ctx back into the state of snapshot,
+// closing the fds its guest left open. The instance must not be running
+void runtime_context_restore(int64_t ctx_ptr, int64_t snapshot) {
+    CRuntimeContext* ctx = (CRuntimeContext*)(uintptr_t)ctx_ptr;
+    const ContextSnapshot* snap = (const ContextSnapshot*)(uintptr_t)snapshot;
+    if (snap->num_globals > 0) {
+        memcpy(ctx->globals, snap->globals, (size_t)snap->num_globals * sizeof(uint64_t));
+    }
+    for (int i = 0; i < snap->num_memories; i++) {
+        int* pages;
+        uint8_t* base = context_memory(ctx, i, &pages);
+        size_t size = (size_t)(uint32_t)snap->memories[i].pages * 65536;
+        size_t current = (size_t)(uint32_t)*pages * 65536;
+        memcpy(base, snap->memories[i].bytes, size);
+        if (current > size) memset(base + size, 0, current - size);
+        *pages = snap->memories[i].pages;
+    }
+    if (snap->table_slots > 0) {
+        memcpy(ctx->tables_flat, snap->tables_flat, (size_t)snap->table_slots * sizeof(int));
+        memcpy(ctx->tables_flat_u64, snap->tables_flat_u64, (size_t)snap->table_slots * sizeof(uint64_t));
+        memcpy(ctx->table_sizes, snap->table_sizes, (size_t)ctx->num_tables * sizeof(int));
+    }
+    if (ctx->num_data_segments > 0) {
+        memcpy(ctx->data_segment_sizes, snap->data_segment_sizes, (size_t)ctx->num_data_segments * sizeof(int));
+    }
+    if (ctx->num_elem_segments > 0) {
+        memcpy(ctx->elem_segment_sizes, snap->elem_segment_sizes, (size_t)ctx->num_elem_segments * sizeof(int));
+        memcpy(ctx->elem_segment_dropped, snap->elem_segment_dropped, (size_t)ctx->num_elem_segments * sizeof(int));
+    }
+    if (ctx->wasi_fds) {
+        wasi_fd_table_close_all(ctx->wasi_fds);
+    }
+}
+
 // ============================================================================
 
 // Internal execution helper - starts the tail-call chain
@@ -551,6 +972,9 @@ static int call_cross_module_with_stack(
         return TRAP_STACK_OVERFLOW;
     }
 
+    // v128 values cross only between modules that both hold them
+    int copy_v128 = g_uses_v128 && target_ctx->uses_v128;
+
     // Save current context and load target
     save_context(&g_saved_contexts[g_context_depth++], crt);
     load_context(target_ctx, crt);
@@ -567,7 +991,7 @@ static int call_cross_module_with_stack(
     int callee_num_locals = g_func_num_locals[local_idx];
 
     // Allocate stack for callee
-    uint64_t* callee_stack = (uint64_t*)malloc(STACK_SIZE * sizeof(uint64_t));
+    uint64_t* callee_stack = stack_alloc(g_uses_v128);
     if (!callee_stack) {
         load_context(&g_saved_contexts[--g_context_depth], crt);
         return TRAP_STACK_OVERFLOW;
@@ -576,6 +1000,9 @@ static int call_cross_module_with_stack(
     // Copy arguments to callee stack
     for (int i = 0; i < num_params; i++) {
         callee_stack[i] = args[i];
+        if (copy_v128) {
+            callee_stack[i + V128_HI] = args[i + V128_HI];
+        }
     }
     // Zero remaining locals
     for (int i = num_params; i < callee_num_locals; i++) {
@@ -593,6 +1020,9 @@ static int call_cross_module_with_stack(
     // Copy results (results are at callee_stack[0..num_results-1])
     for (int i = 0; i < num_results; i++) {
         result_dst[i] = callee_stack[i];
+        if (copy_v128) {
+            result_dst[i + V128_HI] = callee_stack[i + V128_HI];
+        }
     }
 
     gc_pop_stack();
@@ -604,6 +1034,13 @@ static int call_cross_module_with_stack(
     return trap;
 }
 
+// Whether a call into target_ctx has to run on a stack of its own: a module
+// that holds v128 values needs room for their high halves, which the stack
+// of a module that does not hold them lacks
+static inline int cross_module_needs_stack(const CRuntimeContext* target_ctx) {
+    return target_ctx->uses_v128 && !g_uses_v128;
+}
+
 // ============================================================================
 
 static int run(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
@@ -647,9 +1084,308 @@ static double f64_from_u64(uint64_t v) {
     return d;
 }
 
-// Host import handlers (spectest formatting)
-static void call_host_import(int handler_id, uint64_t* args, int num_params,
-                             uint64_t* results, int num_results) {
+// ============================================================================
+// Native host functions
+// ============================================================================
+
+// Functions registered with host_func_register, keyed by module, name and
+// signature. Direct calls to an import bound to one are compiled to
+// op_call_host, which calls the function pointer with no dispatch; calls
+// through tables use handler id HOST_IMPORT_NATIVE_BASE + index. Entries
+// are never removed, so compiled code can hold on to indices.
+typedef struct NativeHostFunc {
+    uint8_t* module;
+    int module_len;
+    uint8_t* name;
+    int name_len;
+    uint8_t* types;        // Param types, then result types
+    int num_params;
+    int num_results;
+    HostFunc fn;
+    void* env;
+} NativeHostFunc;
+
+static NativeHostFunc* g_host_funcs = NULL;
+static int g_num_host_funcs = 0;
+static int g_host_funcs_capacity = 0;
+
+static uint8_t* host_copy_bytes(const uint8_t* data, int len) {
+    uint8_t* copy = (uint8_t*)malloc(len > 0 ? (size_t)len : 1);
+    if (copy && len > 0) memcpy(copy, data, (size_t)len);
+    return copy;
+}
+
+int host_func_find(const uint8_t* module, int module_len,
+                   const uint8_t* name, int name_len,
+                   const uint8_t* types, int num_params, int num_results) {
+    int num_types = num_params + num_results;
+    for (int i = 0; i < g_num_host_funcs; i++) {
+        const NativeHostFunc* hf = &g_host_funcs[i];
+        if (hf->module_len == module_len && hf->name_len == name_len &&
+            hf->num_params == num_params && hf->num_results == num_results &&
+            memcmp(hf->module, module, (size_t)module_len) == 0 &&
+            memcmp(hf->name, name, (size_t)name_len) == 0 &&
+            memcmp(hf->types, types, (size_t)num_types) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int host_func_register(const uint8_t* module, int module_len,
+                       const uint8_t* name, int name_len,
+                       const uint8_t* types, int num_params, int num_results,
+                       HostFunc fn, void* env) {
+    if (!fn || module_len < 0 || name_len < 0 || num_params < 0 ||
+        num_results < 0 || num_results > HOST_FUNC_MAX_RESULTS) {
+        return -1;
+    }
+    int idx = host_func_find(module, module_len, name, name_len, types,
+                             num_params, num_results);
+    if (idx >= 0) {
+        g_host_funcs[idx].fn = fn;
+        g_host_funcs[idx].env = env;
+        return idx;
+    }
+    if (g_num_host_funcs == g_host_funcs_capacity) {
+        int capacity = g_host_funcs_capacity ? g_host_funcs_capacity * 2 : 16;
+        NativeHostFunc* funcs = (NativeHostFunc*)realloc(
+            g_host_funcs, (size_t)capacity * sizeof(NativeHostFunc));
+        if (!funcs) return -1;
+        g_host_funcs = funcs;
+        g_host_funcs_capacity = capacity;
+    }
+    NativeHostFunc hf;
+    hf.module = host_copy_bytes(module, module_len);
+    hf.module_len = module_len;
+    hf.name = host_copy_bytes(name, name_len);
+    hf.name_len = name_len;
+    hf.types = host_copy_bytes(types, num_params + num_results);
+    hf.num_params = num_params;
+    hf.num_results = num_results;
+    hf.fn = fn;
+    hf.env = env;
+    if (!hf.module || !hf.name || !hf.types) {
+        free(hf.module);
+        free(hf.name);
+        free(hf.types);
+        return -1;
+    }
+    g_host_funcs[g_num_host_funcs] = hf;
+    return g_num_host_funcs++;
+}
+
+// Call native host function idx with args; results get its result slots
+// Returns trap code (TRAP_HOST_PENDING if the function returned
+// HOST_FUNC_PENDING)
+static int call_native_host(CRuntime* crt, int idx, uint64_t* args, uint64_t* results) {
+    const NativeHostFunc* hf = &g_host_funcs[idx];
+    uint64_t mem_size;
+    uint8_t* mem = host_memory(crt->mem, &mem_size);
+    int status = hf->fn(hf->env, args, results, mem, mem_size);
+    if (status != 0) {
+        return status == HOST_FUNC_PENDING ? TRAP_HOST_PENDING : TRAP_HOST_FUNCTION;
+    }
+    return TRAP_NONE;
+}
+
+// A host function that is always pending: the embedder computes its results
+// and passes them to invocation_run
+static int host_func_deferred(void* env, const uint64_t* args, uint64_t* results,
+                              uint8_t* mem, uint64_t mem_size) {
+    (void)env; (void)args; (void)results; (void)mem; (void)mem_size;
+    return HOST_FUNC_PENDING;
+}
+
+uint64_t host_func_deferred_ptr(void) {
+    return (uint64_t)(uintptr_t)host_func_deferred;
+}
+
+// Bulk copy between linear memory and host buffers (memory views)
+// Bounds are checked by the caller
+void host_memory_copy(uint8_t* dst, int dst_offset, const uint8_t* src,
+                      int src_offset, int len) {
+    if (len > 0) memcpy(dst + dst_offset, src + src_offset, (size_t)len);
+}
+
+void host_memory_fill(uint8_t* mem, int offset, int value, int len) {
+    if (len > 0) memset(mem + offset, value, (size_t)len);
+}
+
+// ============================================================================
+// wasi-threads
+// ============================================================================
+
+// What thread-spawn needs to start a new instance of a module: the function
+// index of its wasi_thread_start export (-1 if it has none) and the
+// module's initial globals. Registered when the module is instantiated,
+// before any code runs; entries are never removed or changed, so threads
+// read them without locking.
+typedef struct ThreadSpawnInfo {
+    int start_func_idx;
+    uint64_t* globals;
+    int num_globals;
+} ThreadSpawnInfo;
+
+static ThreadSpawnInfo* g_thread_spawns[THREAD_SPAWN_MAX];
+static _Atomic int g_num_thread_spawns = 0;
+static _Atomic int32_t g_next_thread_id = 0;
+
+// Register a module that imports wasi.thread-spawn
+// Returns its handler id, or -1 if the registry is full
+int thread_spawn_register(int start_func_idx, uint64_t* globals, int num_globals) {
+    ThreadSpawnInfo* info = (ThreadSpawnInfo*)malloc(sizeof(ThreadSpawnInfo));
+    uint64_t* copy = (uint64_t*)malloc((size_t)(num_globals > 0 ? num_globals : 1) * sizeof(uint64_t));
+    if (!info || !copy) {
+        free(info);
+        free(copy);
+        return -1;
+    }
+    if (num_globals > 0) memcpy(copy, globals, (size_t)num_globals * sizeof(uint64_t));
+    info->start_func_idx = start_func_idx;
+    info->globals = copy;
+    info->num_globals = num_globals;
+    int idx = atomic_fetch_add(&g_num_thread_spawns, 1);
+    if (idx >= THREAD_SPAWN_MAX) {
+        free(copy);
+        free(info);
+        return -1;
+    }
+    g_thread_spawns[idx] = info;
+    return HOST_IMPORT_THREAD_SPAWN_BASE + idx;
+}
+
+// A thread's instance: the spawning instance's state with fresh globals
+typedef struct ThreadStart {
+    CRuntimeContext ctx;
+    int entry;
+    int num_locals;
+    int32_t tid;
+    int32_t start_arg;
+} ThreadStart;
+
+// Body of a spawned host thread: runs wasi_thread_start(tid, start_arg).
+// proc_exit or a trap in any thread ends the whole process
+static void thread_main(void* arg) {
+    ThreadStart* ts = (ThreadStart*)arg;
+    CRuntime crt;
+    load_context(&ts->ctx, &crt);  // Also sets up this thread's GC heap
+    g_validate_code = (getenv("WASM5_VALIDATE_CODE") != NULL);
+
+    int trap = TRAP_STACK_OVERFLOW;
+    uint64_t* stack = stack_alloc(g_uses_v128);
+    if (stack) {
+        g_stack_base = stack;
+        gc_push_stack(stack, STACK_SIZE);
+        stack[0] = (uint64_t)(uint32_t)ts->tid;
+        stack[1] = (uint64_t)(uint32_t)ts->start_arg;
+        for (int i = 2; i < ts->num_locals; i++) {
+            stack[i] = 0;
+        }
+        trap = run(&crt, crt.code + ts->entry, stack + ts->num_locals, stack);
+        gc_pop_stack();
+        free(stack);
+    }
+
+    if (trap != TRAP_NONE) {
+        threads_wasi_lock();
+        wasi_flush_all();
+        if (trap == TRAP_WASI_EXIT) {
+            exit(wasi_get_exit_code());
+        }
+        fprintf(stderr, "wasm5: thread %d trapped (trap code %d)\n", (int)ts->tid, trap);
+        exit(1);
+    }
+    wasi_thread_cleanup();
+    free(ts->ctx.globals);
+    free(ts);
+}
+
+// thread-spawn(start_arg) -> tid: start a new instance of the calling module
+// on a host thread. Returns the new thread id (> 0), or a negative value if
+// the thread could not be created
+static int32_t thread_spawn(CRuntime* crt, int idx, int32_t start_arg) {
+    if (idx < 0 || idx >= atomic_load(&g_num_thread_spawns) || idx >= THREAD_SPAWN_MAX) {
+        return -1;
+    }
+    const ThreadSpawnInfo* info = g_thread_spawns[idx];
+    int local_idx = info->start_func_idx - g_num_imported_funcs;
+    if (info->start_func_idx < 0 || local_idx < 0 || local_idx >= g_num_funcs) {
+        return -1;
+    }
+    // Thread ids are positive and fit in 29 bits
+    int32_t tid = atomic_fetch_add(&g_next_thread_id, 1) + 1;
+    if (tid <= 0 || tid > 0x1FFFFFFF) {
+        return -1;
+    }
+
+    ThreadStart* ts = (ThreadStart*)malloc(sizeof(ThreadStart));
+    uint64_t* globals = (uint64_t*)malloc((size_t)(info->num_globals > 0 ? info->num_globals : 1) * sizeof(uint64_t));
+    if (!ts || !globals) {
+        free(ts);
+        free(globals);
+        return -1;
+    }
+    if (info->num_globals > 0) {
+        memcpy(globals, info->globals, (size_t)info->num_globals * sizeof(uint64_t));
+    }
+    save_context(&ts->ctx, crt);
+    ts->ctx.globals = globals;
+    ts->entry = g_func_entries[local_idx];
+    ts->num_locals = g_func_num_locals[local_idx];
+    ts->tid = tid;
+    ts->start_arg = start_arg;
+    if (threads_start(thread_main, ts) != 0) {
+        free(globals);
+        free(ts);
+        return -1;
+    }
+    return tid;
+}
+
+// wasm:js-string builtins (JS string builtins proposal), kept in sync with
+// js_string_builtins in runtime.mbt
+#define JS_STRING_CAST 0
+#define JS_STRING_TEST 1
+#define JS_STRING_FROM_CHAR_CODE_ARRAY 2
+#define JS_STRING_INTO_CHAR_CODE_ARRAY 3
+#define JS_STRING_FROM_CHAR_CODE 4
+#define JS_STRING_FROM_CODE_POINT 5
+#define JS_STRING_CHAR_CODE_AT 6
+#define JS_STRING_CODE_POINT_AT 7
+#define JS_STRING_LENGTH 8
+#define JS_STRING_CONCAT 9
+#define JS_STRING_SUBSTRING 10
+#define JS_STRING_EQUALS 11
+#define JS_STRING_COMPARE 12
+#define JS_STRING_COUNT 13
+static int js_string_call(int builtin, const uint64_t* args, uint64_t* result);
+
+// Host import handlers (spectest formatting, js-string builtins and native
+// host functions)
+// Returns trap code
+static int call_host_import(CRuntime* crt, int handler_id, uint64_t* args, int num_params,
+                            uint64_t* results, int num_results) {
+    if (handler_id >= HOST_IMPORT_NATIVE_BASE) {
+        int idx = handler_id - HOST_IMPORT_NATIVE_BASE;
+        if (idx >= g_num_host_funcs) return TRAP_UNREACHABLE;
+        // Only direct calls can wait for a pending host function
+        int trap = call_native_host(crt, idx, args, results);
+        return trap == TRAP_HOST_PENDING ? TRAP_HOST_FUNCTION : trap;
+    }
+    if (handler_id >= HOST_IMPORT_THREAD_SPAWN_BASE) {
+        int32_t start_arg = (int32_t)(uint32_t)(num_params > 0 ? args[0] : 0);
+        int32_t tid = thread_spawn(crt, handler_id - HOST_IMPORT_THREAD_SPAWN_BASE, start_arg);
+        if (num_results > 0) results[0] = (uint64_t)(uint32_t)tid;
+        return TRAP_NONE;
+    }
+    if (handler_id >= HOST_IMPORT_JS_STRING_BASE &&
+            handler_id < HOST_IMPORT_JS_STRING_BASE + JS_STRING_COUNT) {
+        uint64_t result;
+        int trap = js_string_call(handler_id - HOST_IMPORT_JS_STRING_BASE, args, &result);
+        if (num_results > 0) results[0] = result;
+        return trap;
+    }
     char buf[128];
     int n = -1;
     switch (handler_id) {
@@ -706,12 +1442,19 @@ static void call_host_import(int handler_id, uint64_t* args, int num_params,
     for (int i = 0; i < num_results; i++) {
         results[i] = 0;
     }
+    return TRAP_NONE;
 }
 
-// Execute threaded code starting at entry point
-// Returns trap code (0 = success), stores results in result_out[0..num_results-1]
-int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_args,
-            uint64_t* result_out, int num_results, uint64_t* globals, uint8_t* mem, int mem_size,
+// Execute threaded code starting at entry point num_calls times in one
+// session: state setup, the stack and teardown are shared by all calls.
+// Call i takes args[i*num_args..] and stores its results in
+// result_out[i*num_results..]. With v128_rows (the function has a v128
+// parameter or result) rows are twice as wide: the slots, then the high
+// 64 bits of each. Stops at the first trap; *calls_done (if not NULL) gets
+// the number of calls that completed. Returns trap code (0 = success)
+int execute_batch(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_args,
+            uint64_t* result_out, int num_results, int num_calls, int* calls_done,
+            uint64_t* globals, uint8_t* mem, int mem_size,
             int mem_max_size, int* memory_pages, int* tables_flat, uint64_t* tables_flat_u64,
             int* table_offsets, int* table_sizes, int* table_max_sizes,
             int* table_elem_is_funcref, int num_tables,
@@ -723,25 +1466,17 @@ int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_a
             uint8_t* data_segments_flat, int* data_segment_offsets, int* data_segment_sizes, int num_data_segments,
             int* elem_segments_flat, uint64_t* elem_segments_flat_u64, int* elem_segment_offsets, int* elem_segment_sizes,
             int* elem_segment_dropped, int num_elem_segments,
-            int num_external_funcrefs) {
+            int num_external_funcrefs, int* eh_table, int uses_v128, int v128_rows) {
     // Allocate stack on heap to avoid C stack limits
-    uint64_t* stack = (uint64_t*)malloc(STACK_SIZE * sizeof(uint64_t));
+    uint64_t* stack = stack_alloc(uses_v128);
     if (!stack) {
         return TRAP_STACK_OVERFLOW;
     }
-
-    // Initialize locals from args
-    for (int i = 0; i < num_args; i++) {
-        stack[i] = args[i];
-    }
-    // Zero remaining locals
-    for (int i = num_args; i < num_locals; i++) {
-        stack[i] = 0;
-    }
+    g_uses_v128 = uses_v128;
 
     // Store memory info for ops
     g_memory_pages = memory_pages;
-    g_memory_size = mem_size;
+    g_memory_size = (uint64_t)(uint32_t)mem_size;
     g_memory_max_size = mem_max_size;
 
     // Store table data for call_indirect and table ops
@@ -790,6 +1525,7 @@ int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_a
     g_elem_segment_dropped = elem_segment_dropped;
     g_num_elem_segments = num_elem_segments;
     g_num_external_funcrefs = num_external_funcrefs;
+    g_eh_table = eh_table;
 
     // Store stack base for result extraction
     g_stack_base = stack;
@@ -804,26 +1540,53 @@ int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_a
     crt.mem = mem;
     crt.globals = globals;
 
-    // Set up hot state as pointers
-    uint64_t* pc = code + entry;
-    uint64_t* fp = stack;
-    uint64_t* sp = stack + num_locals;
-
     g_validate_code = (getenv("WASM5_VALIDATE_CODE") != NULL);
     if (g_validate_code) {
-        fprintf(stderr, "wasm5: entry=%d pc=%p opcode=%llu\n", entry, (void*)pc, (unsigned long long)*pc);
-    }
-
-    // Start execution
-    int trap = run(&crt, pc, sp, fp);
-    g_validate_code = 0;
+        fprintf(stderr, "wasm5: entry=%d pc=%p opcode=%llu\n", entry, (void*)(code + entry), (unsigned long long)code[entry]);
+    }
+
+    int trap = TRAP_NONE;
+    int done = 0;
+    int row_scale = v128_rows ? 2 : 1;
+    for (; done < num_calls; done++) {
+        // Initialize locals from args
+        const uint64_t* call_args = args + (size_t)done * num_args * row_scale;
+        for (int i = 0; i < num_args; i++) {
+            stack[i] = call_args[i];
+            if (v128_rows) {
+                stack[i + V128_HI] = call_args[num_args + i];
+            }
+        }
+        // Zero remaining locals
+        for (int i = num_args; i < num_locals; i++) {
+            stack[i] = 0;
+        }
 
-    // Store results (results are placed at stack[0..num_results-1] by end/return)
-    if (result_out) {
-        for (int i = 0; i < num_results; i++) {
-            result_out[i] = stack[i];
+        // Set up hot state as pointers
+        uint64_t* pc = code + entry;
+        uint64_t* fp = stack;
+        uint64_t* sp = stack + num_locals;
+
+        // Start execution
+        trap = run(&crt, pc, sp, fp);
+        if (trap != TRAP_NONE) break;
+
+        // Store results (results are placed at stack[0..num_results-1] by end/return)
+        if (result_out) {
+            uint64_t* call_results = result_out + (size_t)done * num_results * row_scale;
+            for (int i = 0; i < num_results; i++) {
+                call_results[i] = stack[i];
+                if (v128_rows) {
+                    call_results[num_results + i] = stack[i + V128_HI];
+                }
+            }
         }
     }
+    if (calls_done) *calls_done = done;
+    g_validate_code = 0;
+    threads_wasi_lock();
+    wasi_flush_all();
+    threads_wasi_unlock();
     gc_pop_stack();
     free(stack);
 
@@ -865,11 +1628,43 @@ int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_a
     g_elem_segment_sizes = NULL;
     g_elem_segment_dropped = NULL;
     g_num_elem_segments = 0;
+    g_eh_table = NULL;
+    g_uses_v128 = 0;
     g_stack_base = NULL;
 
     return trap;
 }
 
+// Execute threaded code starting at entry point
+// Returns trap code (0 = success), stores results in result_out[0..num_results-1]
+int execute(uint64_t* code, int entry, int num_locals, uint64_t* args, int num_args,
+            uint64_t* result_out, int num_results, uint64_t* globals, uint8_t* mem, int mem_size,
+            int mem_max_size, int* memory_pages, int* tables_flat, uint64_t* tables_flat_u64,
+            int* table_offsets, int* table_sizes, int* table_max_sizes,
+            int* table_elem_is_funcref, int num_tables,
+            int* func_entries, int* func_num_locals, int num_funcs, int num_imported_funcs,
+            int* func_type_idxs, int* type_sig_hash1, int* type_sig_hash2, int* type_subtype_matrix, int num_types,
+            int* import_num_params, int* import_num_results, int* import_handler_ids,
+            uint8_t* output_buffer, int* output_length, int output_capacity,
+            int64_t* import_context_ptrs, int* import_target_func_idxs,
+            uint8_t* data_segments_flat, int* data_segment_offsets, int* data_segment_sizes, int num_data_segments,
+            int* elem_segments_flat, uint64_t* elem_segments_flat_u64, int* elem_segment_offsets, int* elem_segment_sizes,
+            int* elem_segment_dropped, int num_elem_segments,
+            int num_external_funcrefs, int* eh_table, int uses_v128, int v128_rows) {
+    return execute_batch(code, entry, num_locals, args, num_args, result_out, num_results, 1, NULL,
+                         globals, mem, mem_size, mem_max_size, memory_pages, tables_flat, tables_flat_u64,
+                         table_offsets, table_sizes, table_max_sizes, table_elem_is_funcref, num_tables,
+                         func_entries, func_num_locals, num_funcs, num_imported_funcs,
+                         func_type_idxs, type_sig_hash1, type_sig_hash2, type_subtype_matrix, num_types,
+                         import_num_params, import_num_results, import_handler_ids,
+                         output_buffer, output_length, output_capacity,
+                         import_context_ptrs, import_target_func_idxs,
+                         data_segments_flat, data_segment_offsets, data_segment_sizes, num_data_segments,
+                         elem_segments_flat, elem_segments_flat_u64, elem_segment_offsets, elem_segment_sizes,
+                         elem_segment_dropped, num_elem_segments,
+                         num_external_funcrefs, eh_table, uses_v128, v128_rows);
+}
+
 // Control operations
 
 int op_wasm_unreachable(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
@@ -903,6 +1698,9 @@ int op_func_exit(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 }
 DEFINE_OP(func_exit)
 
+// A frame that only returns, left by a tail call to a pending host function
+static uint64_t g_func_exit_code[1] = {(uint64_t)(uintptr_t)op_func_exit};
+
 // Call a local function (wasm3 style - uses native C stack)
 // Immediates: callee_pc, frame_offset
 // frame_offset: offset from current fp to new frame (computed at compile time)
@@ -921,7 +1719,7 @@ int op_call(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     int trap = run(crt, new_pc, sp, new_fp);
 
     if (trap != TRAP_NONE) {
-        return trap;
+        CALLEE_TRAP(trap);
     }
 
     // Restore caller pc, fp unchanged
@@ -956,6 +1754,18 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             // Save caller pc for return
             uint64_t* caller_pc = pc;
 
+            if (cross_module_needs_stack(target_ctx)) {
+                uint64_t* args_ptr = fp + frame_offset;
+                int trap = call_cross_module_with_stack(crt, target_ctx, target_func_idx,
+                                                        args_ptr, num_params, num_results, args_ptr);
+                if (trap != TRAP_NONE) {
+                    CALLEE_TRAP(trap);
+                }
+                sp = args_ptr + num_results;
+                pc = caller_pc;
+                NEXT();
+            }
+
             if (g_context_depth >= MAX_CONTEXT_DEPTH) {
                 TRAP(TRAP_STACK_OVERFLOW);
             }
@@ -993,7 +1803,7 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             load_context(&g_saved_contexts[--g_context_depth], crt);
 
             if (trap != TRAP_NONE) {
-                return trap;
+                CALLEE_TRAP(trap);
             }
 
             uint64_t* result_dst = fp + frame_offset;
@@ -1015,12 +1825,14 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
         uint64_t results[16];
         int actual_results = num_results < 16 ? num_results : 16;
 
-        // Check if this is a WASI handler (IDs 8-48)
-        if (handler_id >= HOST_IMPORT_WASI_ARGS_GET && handler_id <= HOST_IMPORT_WASI_PATH_SYMLINK) {
+        // Check if this is a WASI handler (IDs 8-53)
+        if (handler_id >= HOST_IMPORT_WASI_ARGS_GET && handler_id <= HOST_IMPORT_WASI_SOCK_SHUTDOWN) {
             uint32_t wasi_ret = WASI_ERRNO_NOSYS;
-            uint8_t* mem = crt->mem;
-            int mem_size = g_memory_size;
+            uint64_t mem_size;
+            uint8_t* mem = host_memory(crt->mem, &mem_size);
 
+            // WASI state (fd tables, buffered output) is process-wide
+            wasi_call_lock();
             switch (handler_id) {
                 case HOST_IMPORT_WASI_ARGS_GET:
                     wasi_ret = wasi_args_get(args_ptr, mem, mem_size);
@@ -1054,6 +1866,7 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
                     break;
                 case HOST_IMPORT_WASI_PROC_EXIT:
                     wasi_proc_exit(args_ptr);
+                    wasi_call_unlock();
                     return TRAP_WASI_EXIT;  // Signal exit to caller
                 case HOST_IMPORT_WASI_CLOCK_TIME_GET:
                     wasi_ret = wasi_clock_time_get(args_ptr, mem, mem_size);
@@ -1145,7 +1958,23 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
                 case HOST_IMPORT_WASI_PATH_SYMLINK:
                     wasi_ret = wasi_path_symlink(args_ptr, mem, mem_size);
                     break;
+                case HOST_IMPORT_WASI_POLL_ONEOFF:
+                    wasi_ret = wasi_poll_oneoff(args_ptr, mem, mem_size);
+                    break;
+                case HOST_IMPORT_WASI_SOCK_ACCEPT:
+                    wasi_ret = wasi_sock_accept(args_ptr, mem, mem_size);
+                    break;
+                case HOST_IMPORT_WASI_SOCK_RECV:
+                    wasi_ret = wasi_sock_recv(args_ptr, mem, mem_size);
+                    break;
+                case HOST_IMPORT_WASI_SOCK_SEND:
+                    wasi_ret = wasi_sock_send(args_ptr, mem, mem_size);
+                    break;
+                case HOST_IMPORT_WASI_SOCK_SHUTDOWN:
+                    wasi_ret = wasi_sock_shutdown(args_ptr);
+                    break;
             }
+            wasi_call_unlock();
 
             // WASI functions return their error code as the result
             if (actual_results > 0) {
@@ -1153,7 +1982,10 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             }
         } else {
             // Spectest or other handlers
-            call_host_import(handler_id, args_ptr, num_params, results, actual_results);
+            int trap = call_host_import(crt, handler_id, args_ptr, num_params, results, actual_results);
+            if (trap != TRAP_NONE) {
+                return trap;
+            }
         }
 
         uint64_t* result_dst = fp + frame_offset;
@@ -1173,6 +2005,30 @@ int op_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 }
 DEFINE_OP(call_import)
 
+// Call an import bound to a native host function
+// Immediates: host_idx, frame_offset
+int op_call_host(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int host_idx = (int)*pc++;
+    int frame_offset = (int)*pc++;
+    uint64_t* args_ptr = fp + frame_offset;
+    int num_results = g_host_funcs[host_idx].num_results;
+    uint64_t results[HOST_FUNC_MAX_RESULTS];
+    int trap = call_native_host(crt, host_idx, args_ptr, results);
+    if (trap != TRAP_NONE) {
+        if (trap == TRAP_HOST_PENDING) {
+            // The results replace the args when the invocation is resumed
+            return host_pending(host_idx, args_ptr, pc, args_ptr + num_results, fp);
+        }
+        return trap;
+    }
+    for (int i = 0; i < num_results; i++) {
+        args_ptr[i] = results[i];
+    }
+    sp = args_ptr + num_results;
+    NEXT();
+}
+DEFINE_OP(call_host)
+
 // Tail-call a local function
 // Immediates: callee_pc, num_params, num_locals
 // Stack: [..., args...] -> (reuse current frame)
@@ -1186,6 +2042,9 @@ int op_return_call(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     if (num_params > 0 && args_start > fp) {
         for (int i = 0; i < num_params; i++) {
             fp[i] = args_start[i];
+            if (g_uses_v128) {
+                fp[i + V128_HI] = args_start[i + V128_HI];
+            }
         }
     }
 
@@ -1213,6 +2072,11 @@ int op_return_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* f
             CRuntimeContext* target_ctx = (CRuntimeContext*)(uintptr_t)target_ctx_ptr;
             int target_func_idx = g_import_target_func_idxs[import_idx];
 
+            if (cross_module_needs_stack(target_ctx)) {
+                return call_cross_module_with_stack(crt, target_ctx, target_func_idx,
+                                                    sp - num_params, num_params, num_results, fp);
+            }
+
             if (g_context_depth >= MAX_CONTEXT_DEPTH) {
                 TRAP(TRAP_STACK_OVERFLOW);
             }
@@ -1267,7 +2131,10 @@ int op_return_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* f
         uint64_t* args_ptr = sp - num_params;
         uint64_t results[16];
         int actual_results = num_results < 16 ? num_results : 16;
-        call_host_import(handler_id, args_ptr, num_params, results, actual_results);
+        int trap = call_host_import(crt, handler_id, args_ptr, num_params, results, actual_results);
+        if (trap != TRAP_NONE) {
+            return trap;
+        }
         for (int i = 0; i < actual_results; i++) {
             fp[i] = results[i];
         }
@@ -1282,6 +2149,30 @@ int op_return_call_import(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* f
 }
 DEFINE_OP(return_call_import)
 
+// Tail-call an import bound to a native host function
+// Immediate: host_idx
+int op_return_call_host(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int host_idx = (int)*pc;
+    int num_params = g_host_funcs[host_idx].num_params;
+    int num_results = g_host_funcs[host_idx].num_results;
+    uint64_t results[HOST_FUNC_MAX_RESULTS];
+    int trap = call_native_host(crt, host_idx, sp - num_params, results);
+    if (trap != TRAP_NONE) {
+        if (trap == TRAP_HOST_PENDING) {
+            // Move the args to the frame base, where the results belong, and
+            // leave a frame that just returns once they arrive
+            memmove(fp, sp - num_params, (size_t)num_params * sizeof(uint64_t));
+            return host_pending(host_idx, fp, g_func_exit_code, fp + num_results, fp);
+        }
+        return trap;
+    }
+    for (int i = 0; i < num_results; i++) {
+        fp[i] = results[i];
+    }
+    return TRAP_NONE;
+}
+DEFINE_OP(return_call_host)
+
 // Tail-call a function via table
 // Immediates: type_idx, table_idx
 // Stack: [..., args..., elem_idx] -> (reuse current frame)
@@ -1344,6 +2235,11 @@ int op_return_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t*
         CRuntimeContext* target_ctx = (CRuntimeContext*)(uintptr_t)target_ctx_ptr;
         int target_func_idx = g_import_target_func_idxs[import_idx];
 
+        if (cross_module_needs_stack(target_ctx)) {
+            return call_cross_module_with_stack(crt, target_ctx, target_func_idx,
+                                                sp - num_params, num_params, num_results, fp);
+        }
+
         if (g_context_depth >= MAX_CONTEXT_DEPTH) {
             TRAP(TRAP_STACK_OVERFLOW);
         }
@@ -1411,6 +2307,11 @@ int op_return_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t*
                 CRuntimeContext* target_ctx = (CRuntimeContext*)(uintptr_t)target_ctx_ptr;
                 int target_func_idx = g_import_target_func_idxs[func_idx];
 
+                if (cross_module_needs_stack(target_ctx)) {
+                    return call_cross_module_with_stack(crt, target_ctx, target_func_idx,
+                                                        sp - num_params, num_params, num_results, fp);
+                }
+
                 if (g_context_depth >= MAX_CONTEXT_DEPTH) {
                     TRAP(TRAP_STACK_OVERFLOW);
                 }
@@ -1465,7 +2366,10 @@ int op_return_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t*
             uint64_t* args_ptr = sp - num_params;
             uint64_t results[16];
             int actual_results = num_results < 16 ? num_results : 16;
-            call_host_import(handler_id, args_ptr, num_params, results, actual_results);
+            int trap = call_host_import(crt, handler_id, args_ptr, num_params, results, actual_results);
+            if (trap != TRAP_NONE) {
+                return trap;
+            }
             for (int i = 0; i < actual_results; i++) {
                 fp[i] = results[i];
             }
@@ -1502,6 +2406,9 @@ int op_return_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t*
     if (num_params > 0 && args_start > fp) {
         for (int i = 0; i < num_params; i++) {
             fp[i] = args_start[i];
+            if (g_uses_v128) {
+                fp[i + V128_HI] = args_start[i + V128_HI];
+            }
         }
     }
 
@@ -1523,6 +2430,19 @@ int op_call_external(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     // Save caller pc for return
     uint64_t* caller_pc = pc;
 
+    if (cross_module_needs_stack(target_ctx)) {
+        uint64_t* args = sp - num_args;
+        int trap = call_cross_module_with_stack(crt, target_ctx,
+                                                func_idx + target_ctx->num_imported_funcs,
+                                                args, num_args, num_results, args);
+        if (trap != TRAP_NONE) {
+            CALLEE_TRAP(trap);
+        }
+        sp = args + num_results;
+        pc = caller_pc;
+        NEXT();
+    }
+
     // Check context depth limit
     if (g_context_depth >= MAX_CONTEXT_DEPTH) {
         TRAP(TRAP_STACK_OVERFLOW);
@@ -1562,7 +2482,7 @@ int op_call_external(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     load_context(&g_saved_contexts[--g_context_depth], crt);
 
     if (trap != TRAP_NONE) {
-        return trap;
+        CALLEE_TRAP(trap);
     }
 
     // Place results where args were (standard calling convention)
@@ -1581,24 +2501,39 @@ int op_call_external(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 DEFINE_OP(call_external)
 
 // FFI function to call a function in another module from MoonBit
-// Used for exported imports
+// Used for exported imports. args and result_out are rows as in
+// execute_batch, twice as wide with v128_rows
 int call_external_ffi(
     int64_t target_context_ptr,
     int func_idx,
     uint64_t* args,
     int num_args,
     uint64_t* result_out,
-    int num_results
+    int num_results,
+    int v128_rows
 ) {
     CRuntimeContext* target_ctx = (CRuntimeContext*)(uintptr_t)target_context_ptr;
 
-    // Allocate a temporary stack for this call
+    // Allocate a temporary stack for this call; a module holding v128
+    // values gets a full one with room for the high halves
     uint64_t temp_stack[256];
-    uint64_t* sp = temp_stack;
-    uint64_t* fp = temp_stack;
+    uint64_t* stack = temp_stack;
+    size_t stack_slots = 256;
+    if (target_ctx->uses_v128) {
+        stack = stack_alloc(1);
+        if (!stack) {
+            return TRAP_STACK_OVERFLOW;
+        }
+        stack_slots = STACK_SIZE;
+    }
+    uint64_t* sp = stack;
+    uint64_t* fp = stack;
 
     // Copy args to the stack
     for (int i = 0; i < num_args; i++) {
+        if (target_ctx->uses_v128) {
+            sp[V128_HI] = v128_rows ? args[num_args + i] : 0;
+        }
         *sp++ = args[i];
     }
 
@@ -1616,21 +2551,29 @@ int call_external_ffi(
         *sp++ = 0;
     }
 
-    // Execute the function using target context's code
-    gc_push_stack(temp_stack, 256);
+    // Execute the function using target context's code. A host call is a
+    // boundary no suspension may cross, so it starts without handlers
+    ResumeRecord* saved_resume_top = g_resume_top;
+    g_resume_top = NULL;
+    gc_push_stack(stack, stack_slots);
     int trap = run(&dummy_crt, target_ctx->code + callee_pc, sp, fp);
     gc_pop_stack();
-
-    if (trap != TRAP_NONE) {
-        return trap;
-    }
+    g_resume_top = saved_resume_top;
 
     // Copy results from frame to output
-    for (int i = 0; i < num_results; i++) {
-        result_out[i] = fp[i];
+    if (trap == TRAP_NONE) {
+        for (int i = 0; i < num_results; i++) {
+            result_out[i] = fp[i];
+            if (v128_rows) {
+                result_out[num_results + i] = target_ctx->uses_v128 ? fp[i + V128_HI] : 0;
+            }
+        }
     }
 
-    return TRAP_NONE;
+    if (stack != temp_stack) {
+        free(stack);
+    }
+    return trap;
 }
 
 // Function entry - set sp and zero non-arg locals
@@ -2803,8 +3746,11 @@ DEFINE_OP(wasm_select)
 
 int op_memory_grow(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)fp;
-    ++pc;  // Skip mem_idx (assume 0)
+    ++pc;  // Skip mem_idx (0; other memories use memory_grow_mem)
     uint32_t delta = (uint32_t)sp[-1];
+
+    // Threads sharing the memory grow it one at a time
+    threads_memory_lock();
     int32_t old_pages = g_memory_pages ? *g_memory_pages : 0;
 
     // Calculate new size
@@ -2813,6 +3759,7 @@ int op_memory_grow(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 
     // Check if growth would exceed max size
     if (new_size > g_memory_max_size) {
+        threads_memory_unlock();
         // Return -1 to indicate failure
         sp[-1] = (uint64_t)(uint32_t)-1;
         NEXT();
@@ -2824,11 +3771,13 @@ int op_memory_grow(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
         memset(crt->mem + old_size, 0, (size_t)(new_size - old_size));
     }
 
-    // Update page count and memory size
+    // Update page count and memory size; other threads pick up the new
+    // page count in memory_refresh_size
     if (g_memory_pages) {
-        *g_memory_pages = (int)new_pages;
+        atomic_store_explicit((_Atomic int*)g_memory_pages, (int)new_pages, memory_order_release);
     }
-    g_memory_size = (int)new_size;
+    g_memory_size = (uint64_t)new_size;
+    threads_memory_unlock();
 
     // Return old page count (success)
     sp[-1] = (uint64_t)(uint32_t)old_pages;
@@ -2838,8 +3787,9 @@ DEFINE_OP(memory_grow)
 
 int op_memory_size(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)crt; (void)fp;
-    ++pc;  // Skip mem_idx (assume 0)
-    int32_t pages = g_memory_pages ? *g_memory_pages : 0;
+    ++pc;  // Skip mem_idx (0; other memories use memory_size_mem)
+    int32_t pages = g_memory_pages
+        ? atomic_load_explicit((_Atomic int*)g_memory_pages, memory_order_acquire) : 0;
     *sp++ = (uint64_t)(uint32_t)pages;
     NEXT();
 }
@@ -3136,22 +4086,142 @@ int op_f64_store(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 }
 DEFINE_OP(f64_store)
 
-// call_indirect - call function via table
-// Immediates: type_idx, table_idx, frame_offset
-// Stack: [..., args..., elem_idx] -> [..., results...]
-int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
-    int expected_type_idx = (int)*pc++;
-    int table_idx = (int)*pc++;
-    int frame_offset = (int)*pc++;
+// Memory ops on a memory other than memory 0 (multi-memory). The transform
+// selects these for a nonzero mem_idx immediate, so code using memory 0
+// never pays for the descriptor lookup
 
-    // Pop element index from stack
-    --sp;
-    int32_t elem_idx = (int32_t)*sp;
+int op_memory_grow_mem(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint32_t delta = (uint32_t)sp[-1];
 
-    // Validate table index
-    if (table_idx < 0 || table_idx >= g_num_tables) {
-        TRAP(TRAP_OUT_OF_BOUNDS_TABLE);
-    }
+    threads_memory_lock();
+    int32_t old_pages = *mem->pages;
+    int64_t new_pages = (int64_t)old_pages + (int64_t)delta;
+    if (new_pages * 65536 > mem->max_size) {
+        threads_memory_unlock();
+        sp[-1] = (uint64_t)(uint32_t)-1;
+        NEXT();
+    }
+    if (delta > 0) {
+        memset(mem->base + (size_t)old_pages * 65536, 0, (size_t)delta * 65536);
+    }
+    atomic_store_explicit((_Atomic int*)mem->pages, (int)new_pages, memory_order_release);
+    threads_memory_unlock();
+
+    sp[-1] = (uint64_t)(uint32_t)old_pages;
+    NEXT();
+}
+DEFINE_OP(memory_grow_mem)
+
+// memory.grow on a memory64 memory: the page count is 64-bit, and pages
+// are committed in the memory's reservation (memory64_new) instead of
+// cleared, as they have never been touched
+int op_memory_grow_m64(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint64_t delta = sp[-1];
+
+    threads_memory_lock();
+    int32_t old_pages = *mem->pages;
+    if (delta > (uint64_t)mem->max_size / 65536 - (uint64_t)old_pages ||
+        threads_memory_commit(mem->base + (size_t)old_pages * 65536, delta * 65536) != 0) {
+        threads_memory_unlock();
+        sp[-1] = UINT64_MAX;
+        NEXT();
+    }
+    atomic_store_explicit((_Atomic int*)mem->pages, old_pages + (int)delta, memory_order_release);
+    threads_memory_unlock();
+
+    sp[-1] = (uint64_t)old_pages;
+    NEXT();
+}
+DEFINE_OP(memory_grow_m64)
+
+// memory.size of a memory of the table (memory64 included)
+int op_memory_size_mem(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    *sp++ = memory_desc_size(mem) / 65536;
+    NEXT();
+}
+DEFINE_OP(memory_size_mem)
+
+// Load of a type from memory mem_idx, widened through wide to a slot
+#define LOAD_MEM_OP(name, type, wide, variant, M) \
+int op_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    uint32_t offset = (uint32_t)*pc++; \
+    M##_SELECT(*pc++); \
+    uint64_t addr = M##_ADDR(sp[-1], offset); \
+    M##_CHECK(addr, sizeof(type)); \
+    type value = *(type*)(M##_BASE + (size_t)addr); \
+    sp[-1] = (uint64_t)(wide)value; \
+    NEXT(); \
+} \
+DEFINE_OP(name##variant)
+
+// Store of the low bits of a slot, as type, to memory mem_idx
+#define STORE_MEM_OP(name, type, variant, M) \
+int op_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    uint32_t offset = (uint32_t)*pc++; \
+    M##_SELECT(*pc++); \
+    type value = (type)sp[-1]; \
+    uint64_t addr = M##_ADDR(sp[-2], offset); \
+    sp -= 2; \
+    M##_CHECK(addr, sizeof(type)); \
+    *(type*)(M##_BASE + (size_t)addr) = value; \
+    NEXT(); \
+} \
+DEFINE_OP(name##variant)
+
+// Every scalar load and store, for memories of the table (variant and M as
+// for the SIMD and atomic handlers)
+#define MEMORY_SCALAR_OPS(variant, M) \
+    LOAD_MEM_OP(i32_load, uint32_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i32_load8_s, int8_t, int32_t, variant, M) \
+    LOAD_MEM_OP(i32_load8_u, uint8_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i32_load16_s, int16_t, int32_t, variant, M) \
+    LOAD_MEM_OP(i32_load16_u, uint16_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i64_load, uint64_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i64_load8_s, int8_t, int64_t, variant, M) \
+    LOAD_MEM_OP(i64_load8_u, uint8_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i64_load16_s, int16_t, int64_t, variant, M) \
+    LOAD_MEM_OP(i64_load16_u, uint16_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(i64_load32_s, int32_t, int64_t, variant, M) \
+    LOAD_MEM_OP(i64_load32_u, uint32_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(f32_load, uint32_t, uint64_t, variant, M) \
+    LOAD_MEM_OP(f64_load, uint64_t, uint64_t, variant, M) \
+    STORE_MEM_OP(i32_store, uint32_t, variant, M) \
+    STORE_MEM_OP(i32_store8, uint8_t, variant, M) \
+    STORE_MEM_OP(i32_store16, uint16_t, variant, M) \
+    STORE_MEM_OP(i64_store, uint64_t, variant, M) \
+    STORE_MEM_OP(i64_store8, uint8_t, variant, M) \
+    STORE_MEM_OP(i64_store16, uint16_t, variant, M) \
+    STORE_MEM_OP(i64_store32, uint32_t, variant, M) \
+    STORE_MEM_OP(f32_store, uint32_t, variant, M) \
+    STORE_MEM_OP(f64_store, uint64_t, variant, M)
+
+MEMORY_SCALAR_OPS(_mem, MEMORYN)
+MEMORY_SCALAR_OPS(_m64, MEMORY64)
+
+// call_indirect - call function via table
+// Immediates: type_idx, table_idx, frame_offset
+// Stack: [..., args..., elem_idx] -> [..., results...]
+int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int expected_type_idx = (int)*pc++;
+    int table_idx = (int)*pc++;
+    int frame_offset = (int)*pc++;
+
+    // Pop element index from stack
+    --sp;
+    int32_t elem_idx = (int32_t)*sp;
+
+    // Validate table index
+    if (table_idx < 0 || table_idx >= g_num_tables) {
+        TRAP(TRAP_OUT_OF_BOUNDS_TABLE);
+    }
 
     // Get table bounds
     int table_offset = g_table_offsets[table_idx];
@@ -3206,7 +4276,7 @@ int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             args_ptr, num_params, num_results, args_ptr
         );
         if (trap != TRAP_NONE) {
-            return trap;
+            CALLEE_TRAP(trap);
         }
         NEXT();
     }
@@ -3234,7 +4304,10 @@ int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             uint64_t* args_ptr = fp + frame_offset;
             uint64_t results[16];
             int actual_results = num_results < 16 ? num_results : 16;
-            call_host_import(handler_id, args_ptr, num_params, results, actual_results);
+            int trap = call_host_import(crt, handler_id, args_ptr, num_params, results, actual_results);
+            if (trap != TRAP_NONE) {
+                return trap;
+            }
             for (int i = 0; i < actual_results; i++) {
                 args_ptr[i] = results[i];
             }
@@ -3269,7 +4342,7 @@ int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             args_ptr, num_params, num_results, args_ptr
         );
         if (trap != TRAP_NONE) {
-            return trap;
+            CALLEE_TRAP(trap);
         }
         NEXT();
     }
@@ -3294,7 +4367,7 @@ int op_call_indirect(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     int trap = run(crt, new_pc, sp, new_fp);
 
     if (trap != TRAP_NONE) {
-        return trap;
+        CALLEE_TRAP(trap);
     }
 
     // Restore caller pc, fp unchanged
@@ -3308,21 +4381,19 @@ DEFINE_OP(call_indirect)
 // =============================================================================
 
 // memory.copy - copy memory region (handles overlapping regions)
+// Immediates: dst_mem, src_mem (both 0; otherwise memory_copy_mem)
 // Stack: [dest, src, n] -> []
 int op_memory_copy(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)fp;
+    pc += 2;
     uint32_t n = (uint32_t)sp[-1];
     uint32_t src = (uint32_t)sp[-2];
     uint32_t dest = (uint32_t)sp[-3];
     sp -= 3;
 
     // Check bounds for both source and destination
-    if ((uint64_t)src + n > (uint64_t)g_memory_size) {
-        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
-    }
-    if ((uint64_t)dest + n > (uint64_t)g_memory_size) {
-        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
-    }
+    CHECK_MEMORY(src, n);
+    CHECK_MEMORY(dest, n);
 
     // Use memmove to handle overlapping regions correctly
     if (n > 0) {
@@ -3333,18 +4404,18 @@ int op_memory_copy(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 DEFINE_OP(memory_copy)
 
 // memory.fill - fill memory region with a byte value
+// Immediate: mem_idx (0; otherwise memory_fill_mem)
 // Stack: [dest, val, n] -> []
 int op_memory_fill(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)fp;
+    ++pc;
     uint32_t n = (uint32_t)sp[-1];
     uint8_t val = (uint8_t)sp[-2];  // Truncate to byte
     uint32_t dest = (uint32_t)sp[-3];
     sp -= 3;
 
     // Check bounds
-    if ((uint64_t)dest + n > (uint64_t)g_memory_size) {
-        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
-    }
+    CHECK_MEMORY(dest, n);
 
     // Fill memory
     if (n > 0) {
@@ -3355,11 +4426,12 @@ int op_memory_fill(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 DEFINE_OP(memory_fill)
 
 // memory.init - initialize memory from data segment
-// Immediate: data_idx
+// Immediates: data_idx, mem_idx (0; otherwise memory_init_mem)
 // Stack: [dest, src, n] -> []
 int op_memory_init(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)fp;
     int data_idx = (int)*pc++;
+    ++pc;
     uint32_t n = (uint32_t)sp[-1];
     uint32_t src = (uint32_t)sp[-2];
     uint32_t dest = (uint32_t)sp[-3];
@@ -3380,9 +4452,7 @@ int op_memory_init(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     }
 
     // Check bounds for memory write
-    if ((uint64_t)dest + n > (uint64_t)g_memory_size) {
-        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
-    }
+    CHECK_MEMORY(dest, n);
 
     // Copy from data segment to memory
     if (n > 0) {
@@ -3392,6 +4462,145 @@ int op_memory_init(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
 }
 DEFINE_OP(memory_init)
 
+// Base and current size in bytes of memory idx, memory 0 included
+static inline uint8_t* memory_base_size(CRuntime* crt, uint64_t idx, uint64_t* size) {
+    if (idx == 0) {
+        *size = memory_refresh_size();
+        return crt->mem;
+    }
+    MemoryDesc* mem = MEMORY_DESC(idx);
+    *size = memory_desc_size(mem);
+    return mem->base;
+}
+
+// memory.copy between memories, at least one of them not memory 0
+int op_memory_copy_mem(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)fp;
+    uint64_t dest_size, src_size;
+    uint8_t* dest_base = memory_base_size(crt, pc[0], &dest_size);
+    uint8_t* src_base = memory_base_size(crt, pc[1], &src_size);
+    pc += 2;
+    uint32_t n = (uint32_t)sp[-1];
+    uint32_t src = (uint32_t)sp[-2];
+    uint32_t dest = (uint32_t)sp[-3];
+    sp -= 3;
+    if ((uint64_t)src + n > src_size || (uint64_t)dest + n > dest_size) {
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
+    }
+    if (n > 0) {
+        memmove(dest_base + dest, src_base + src, n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_copy_mem)
+
+int op_memory_fill_mem(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint32_t n = (uint32_t)sp[-1];
+    uint8_t val = (uint8_t)sp[-2];
+    uint32_t dest = (uint32_t)sp[-3];
+    sp -= 3;
+    CHECK_MEMORY_DESC(mem, dest, n);
+    if (n > 0) {
+        memset(mem->base + dest, val, n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_fill_mem)
+
+int op_memory_init_mem(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    int data_idx = (int)*pc++;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint32_t n = (uint32_t)sp[-1];
+    uint32_t src = (uint32_t)sp[-2];
+    uint32_t dest = (uint32_t)sp[-3];
+    sp -= 3;
+    if (data_idx < 0 || data_idx >= g_num_data_segments ||
+        (uint64_t)src + n > (uint64_t)g_data_segment_sizes[data_idx]) {
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
+    }
+    CHECK_MEMORY_DESC(mem, dest, n);
+    if (n > 0) {
+        memcpy(mem->base + dest, g_data_segments_flat + g_data_segment_offsets[data_idx] + src, n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_init_mem)
+
+// Address operand of a bulk op on a memory of the table: 64-bit for
+// memory64, else the low 32 bits of the slot
+static inline uint64_t memory_desc_addr(const MemoryDesc* mem, uint64_t slot) {
+    return mem->memory64 ? slot : (uint64_t)(uint32_t)slot;
+}
+
+// True if [addr, addr + n) is not within the current size of mem
+static inline int memory_desc_out_of_bounds(const MemoryDesc* mem, uint64_t addr, uint64_t n) {
+    uint64_t size = memory_desc_size(mem);
+    return addr > size || n > size - addr;
+}
+
+// memory.copy involving a memory64 memory. Each address has the type of
+// its memory, the length is 64-bit only between two memory64 memories
+int op_memory_copy_m64(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* dst_mem = MEMORY_DESC(pc[0]);
+    MemoryDesc* src_mem = MEMORY_DESC(pc[1]);
+    pc += 2;
+    uint64_t n = dst_mem->memory64 && src_mem->memory64 ? sp[-1] : (uint64_t)(uint32_t)sp[-1];
+    uint64_t src = memory_desc_addr(src_mem, sp[-2]);
+    uint64_t dest = memory_desc_addr(dst_mem, sp[-3]);
+    sp -= 3;
+    if (memory_desc_out_of_bounds(src_mem, src, n) || memory_desc_out_of_bounds(dst_mem, dest, n)) {
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
+    }
+    if (n > 0) {
+        memmove(dst_mem->base + dest, src_mem->base + src, (size_t)n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_copy_m64)
+
+int op_memory_fill_m64(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint64_t n = sp[-1];
+    uint8_t val = (uint8_t)sp[-2];
+    uint64_t dest = sp[-3];
+    sp -= 3;
+    if (memory_desc_out_of_bounds(mem, dest, n)) {
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
+    }
+    if (n > 0) {
+        memset(mem->base + dest, val, (size_t)n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_fill_m64)
+
+// memory.init on a memory64 memory: 64-bit destination, the data segment
+// offset and length stay 32-bit
+int op_memory_init_m64(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt; (void)fp;
+    int data_idx = (int)*pc++;
+    MemoryDesc* mem = MEMORY_DESC(*pc++);
+    uint32_t n = (uint32_t)sp[-1];
+    uint32_t src = (uint32_t)sp[-2];
+    uint64_t dest = sp[-3];
+    sp -= 3;
+    if (data_idx < 0 || data_idx >= g_num_data_segments ||
+        (uint64_t)src + n > (uint64_t)g_data_segment_sizes[data_idx] ||
+        memory_desc_out_of_bounds(mem, dest, n)) {
+        TRAP(TRAP_OUT_OF_BOUNDS_MEMORY);
+    }
+    if (n > 0) {
+        memcpy(mem->base + dest, g_data_segments_flat + g_data_segment_offsets[data_idx] + src, n);
+    }
+    NEXT();
+}
+DEFINE_OP(memory_init_m64)
+
 // data.drop - drop a data segment (make it unusable for memory.init)
 // Immediate: data_idx
 // Stack: [] -> []
@@ -3749,7 +4958,7 @@ int op_call_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
             args_ptr, num_params, num_results, args_ptr
         );
         if (trap != TRAP_NONE) {
-            return trap;
+            CALLEE_TRAP(trap);
         }
         sp = args_ptr + num_results;
         NEXT();
@@ -3792,7 +5001,7 @@ int op_call_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     int trap = run(crt, new_pc, sp, new_fp);
 
     if (trap != TRAP_NONE) {
-        return trap;
+        CALLEE_TRAP(trap);
     }
 
     // Restore caller pc, fp unchanged
@@ -3840,6 +5049,11 @@ int op_return_call_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp)
                 CRuntimeContext* target_ctx = (CRuntimeContext*)(uintptr_t)target_ctx_ptr;
                 int target_func_idx = g_import_target_func_idxs[func_idx];
 
+                if (cross_module_needs_stack(target_ctx)) {
+                    return call_cross_module_with_stack(crt, target_ctx, target_func_idx,
+                                                        sp - num_params, num_params, num_results, fp);
+                }
+
                 if (g_context_depth >= MAX_CONTEXT_DEPTH) {
                     TRAP(TRAP_STACK_OVERFLOW);
                 }
@@ -3894,7 +5108,10 @@ int op_return_call_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp)
             uint64_t* args_ptr = sp - num_params;
             uint64_t results[16];
             int actual_results = num_results < 16 ? num_results : 16;
-            call_host_import(handler_id, args_ptr, num_params, results, actual_results);
+            int trap = call_host_import(crt, handler_id, args_ptr, num_params, results, actual_results);
+            if (trap != TRAP_NONE) {
+                return trap;
+            }
             for (int i = 0; i < actual_results; i++) {
                 fp[i] = results[i];
             }
@@ -3925,6 +5142,9 @@ int op_return_call_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp)
     if (num_params > 0 && args_start > fp) {
         for (int i = 0; i < num_params; i++) {
             fp[i] = args_start[i];
+            if (g_uses_v128) {
+                fp[i + V128_HI] = args_start[i + V128_HI];
+            }
         }
     }
 
@@ -3966,6 +5186,256 @@ static GcStruct* gc_checked_struct(uint64_t ref) {
     return (GcStruct*)header;
 }
 
+// =============================================================================
+// wasm:js-string builtins
+// =============================================================================
+//
+// Strings are GcString objects (gc.h) passed as externref. A string that went
+// through any.convert_extern carries EXTERNREF_TAG, so both forms are strings.
+// Char code arrays are (array (mut i16)), one code unit per element.
+
+static GcString* js_string_checked(uint64_t ref) {
+    if (ref == REF_NULL) {
+        return NULL;
+    }
+    uint64_t ptr = ref & ~EXTERNREF_TAG;
+    if (!gc_is_managed_ptr(ptr)) {
+        return NULL;
+    }
+    GcHeader* header = (GcHeader*)ptr;
+    if (header->obj_type != GC_TYPE_STRING) {
+        return NULL;
+    }
+    return (GcString*)header;
+}
+
+// A new string of length code units, or NULL when out of memory
+static GcString* js_string_new(int64_t length) {
+    if (length < 0 || length > INT32_MAX) {
+        return NULL;
+    }
+    return gc_alloc_string((int32_t)length);
+}
+
+// Code unit order, as JS relational comparison of strings
+static int js_string_compare(const GcString* a, const GcString* b) {
+    int32_t n = a->length < b->length ? a->length : b->length;
+    for (int32_t i = 0; i < n; i++) {
+        if (a->chars[i] != b->chars[i]) {
+            return a->chars[i] < b->chars[i] ? -1 : 1;
+        }
+    }
+    if (a->length == b->length) {
+        return 0;
+    }
+    return a->length < b->length ? -1 : 1;
+}
+
+// Run js-string builtin on args, storing its single result. Non-string
+// arguments trap with a cast failure, as do null ones except for equals and
+// test. Returns trap code
+static int js_string_call(int builtin, const uint64_t* args, uint64_t* result) {
+    switch (builtin) {
+        case JS_STRING_CAST: {
+            if (!js_string_checked(args[0])) return TRAP_CAST_FAILURE;
+            *result = args[0];
+            return TRAP_NONE;
+        }
+        case JS_STRING_TEST:
+            *result = js_string_checked(args[0]) ? 1 : 0;
+            return TRAP_NONE;
+        case JS_STRING_FROM_CHAR_CODE_ARRAY: {
+            GcArray* arr = gc_checked_array(args[0]);
+            if (!arr) {
+                return args[0] == REF_NULL ? TRAP_NULL_ARRAY_REFERENCE : TRAP_INVALID_ARRAY_REFERENCE;
+            }
+            uint32_t start = (uint32_t)args[1];
+            uint32_t end = (uint32_t)args[2];
+            if (start > end || end > (uint32_t)arr->length) return TRAP_OUT_OF_BOUNDS_ARRAY_ACCESS;
+            GcString* str = js_string_new((int64_t)(end - start));
+            if (!str) return TRAP_OUT_OF_MEMORY;
+            for (int32_t i = 0; i < str->length; i++) {
+                str->chars[i] = (uint16_t)arr->elements[start + (uint32_t)i];
+            }
+            *result = (uint64_t)str;
+            return TRAP_NONE;
+        }
+        case JS_STRING_INTO_CHAR_CODE_ARRAY: {
+            GcString* str = js_string_checked(args[0]);
+            GcArray* arr = gc_checked_array(args[1]);
+            if (!arr) {
+                return args[1] == REF_NULL ? TRAP_NULL_ARRAY_REFERENCE : TRAP_INVALID_ARRAY_REFERENCE;
+            }
+            if (!str) return TRAP_CAST_FAILURE;
+            uint64_t start = (uint32_t)args[2];
+            if (start + (uint64_t)str->length > (uint64_t)arr->length) return TRAP_OUT_OF_BOUNDS_ARRAY_ACCESS;
+            for (int32_t i = 0; i < str->length; i++) {
+                arr->elements[start + (uint64_t)i] = str->chars[i];
+            }
+            *result = (uint64_t)(uint32_t)str->length;
+            return TRAP_NONE;
+        }
+        case JS_STRING_FROM_CHAR_CODE: {
+            GcString* str = js_string_new(1);
+            if (!str) return TRAP_OUT_OF_MEMORY;
+            str->chars[0] = (uint16_t)args[0];
+            *result = (uint64_t)str;
+            return TRAP_NONE;
+        }
+        case JS_STRING_FROM_CODE_POINT: {
+            uint32_t cp = (uint32_t)args[0];
+            if (cp > 0x10FFFF) return TRAP_UNREACHABLE;
+            GcString* str = js_string_new(cp >= 0x10000 ? 2 : 1);
+            if (!str) return TRAP_OUT_OF_MEMORY;
+            if (cp >= 0x10000) {
+                str->chars[0] = (uint16_t)(0xD800 + ((cp - 0x10000) >> 10));
+                str->chars[1] = (uint16_t)(0xDC00 + ((cp - 0x10000) & 0x3FF));
+            } else {
+                str->chars[0] = (uint16_t)cp;
+            }
+            *result = (uint64_t)str;
+            return TRAP_NONE;
+        }
+        case JS_STRING_CHAR_CODE_AT:
+        case JS_STRING_CODE_POINT_AT: {
+            GcString* str = js_string_checked(args[0]);
+            if (!str) return TRAP_CAST_FAILURE;
+            uint32_t idx = (uint32_t)args[1];
+            if (idx >= (uint32_t)str->length) return TRAP_OUT_OF_BOUNDS_ARRAY_ACCESS;
+            uint32_t c = str->chars[idx];
+            if (builtin == JS_STRING_CODE_POINT_AT && c >= 0xD800 && c < 0xDC00 &&
+                    idx + 1 < (uint32_t)str->length) {
+                uint32_t lo = str->chars[idx + 1];
+                if (lo >= 0xDC00 && lo < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                }
+            }
+            *result = c;
+            return TRAP_NONE;
+        }
+        case JS_STRING_LENGTH: {
+            GcString* str = js_string_checked(args[0]);
+            if (!str) return TRAP_CAST_FAILURE;
+            *result = (uint64_t)(uint32_t)str->length;
+            return TRAP_NONE;
+        }
+        case JS_STRING_CONCAT: {
+            GcString* a = js_string_checked(args[0]);
+            GcString* b = js_string_checked(args[1]);
+            if (!a || !b) return TRAP_CAST_FAILURE;
+            GcString* str = js_string_new((int64_t)a->length + b->length);
+            if (!str) return TRAP_OUT_OF_MEMORY;
+            memcpy(str->chars, a->chars, (size_t)a->length * sizeof(uint16_t));
+            memcpy(str->chars + a->length, b->chars, (size_t)b->length * sizeof(uint16_t));
+            *result = (uint64_t)str;
+            return TRAP_NONE;
+        }
+        case JS_STRING_SUBSTRING: {
+            GcString* src = js_string_checked(args[0]);
+            if (!src) return TRAP_CAST_FAILURE;
+            uint32_t start = (uint32_t)args[1];
+            uint32_t end = (uint32_t)args[2];
+            if (end > (uint32_t)src->length) end = (uint32_t)src->length;
+            if (start > end) start = end;
+            GcString* str = js_string_new((int64_t)(end - start));
+            if (!str) return TRAP_OUT_OF_MEMORY;
+            memcpy(str->chars, src->chars + start, (size_t)(end - start) * sizeof(uint16_t));
+            *result = (uint64_t)str;
+            return TRAP_NONE;
+        }
+        case JS_STRING_EQUALS: {
+            GcString* a = js_string_checked(args[0]);
+            GcString* b = js_string_checked(args[1]);
+            if ((!a && args[0] != REF_NULL) || (!b && args[1] != REF_NULL)) return TRAP_CAST_FAILURE;
+            if (!a || !b) {
+                *result = (!a && !b) ? 1 : 0;
+            } else {
+                *result = (a == b || (a->length == b->length &&
+                    memcmp(a->chars, b->chars, (size_t)a->length * sizeof(uint16_t)) == 0)) ? 1 : 0;
+            }
+            return TRAP_NONE;
+        }
+        case JS_STRING_COMPARE: {
+            GcString* a = js_string_checked(args[0]);
+            GcString* b = js_string_checked(args[1]);
+            if (!a || !b) return TRAP_CAST_FAILURE;
+            *result = (uint64_t)(uint32_t)js_string_compare(a, b);
+            return TRAP_NONE;
+        }
+        default:
+            return TRAP_UNREACHABLE;
+    }
+}
+
+// String of the given UTF-8 bytes (for imported string constants). Invalid
+// sequences become U+FFFD. Returns the string ref, or a null ref when out of
+// memory
+uint64_t js_string_from_utf8(const uint8_t* bytes, int len) {
+    GcString* str = js_string_new(len);
+    if (!str) {
+        return REF_NULL;
+    }
+    int32_t n = 0;
+    int i = 0;
+    while (i < len) {
+        uint32_t c = bytes[i];
+        int extra = c >= 0xF0 && c < 0xF5 ? 3 : c >= 0xE0 && c < 0xF0 ? 2 : c >= 0xC2 && c < 0xE0 ? 1 : 0;
+        uint32_t cp = extra == 3 ? c & 0x07 : extra == 2 ? c & 0x0F : c & 0x1F;
+        int ok = c < 0x80 || extra > 0;
+        if (c < 0x80) {
+            cp = c;
+        } else if (ok && i + extra < len) {
+            for (int k = 1; k <= extra; k++) {
+                if ((bytes[i + k] & 0xC0) != 0x80) {
+                    ok = 0;
+                    break;
+                }
+                cp = (cp << 6) | (bytes[i + k] & 0x3F);
+            }
+            // Overlong encodings, surrogates and code points past U+10FFFF
+            if ((extra == 2 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) ||
+                    (extra == 3 && (cp < 0x10000 || cp > 0x10FFFF))) {
+                ok = 0;
+            }
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            str->chars[n++] = 0xFFFD;
+            i++;
+            continue;
+        }
+        i += 1 + (c < 0x80 ? 0 : extra);
+        if (cp >= 0x10000) {
+            str->chars[n++] = (uint16_t)(0xD800 + ((cp - 0x10000) >> 10));
+            str->chars[n++] = (uint16_t)(0xDC00 + ((cp - 0x10000) & 0x3FF));
+        } else {
+            str->chars[n++] = (uint16_t)cp;
+        }
+    }
+    // UTF-16 never takes more code units than UTF-8 takes bytes
+    str->length = n;
+    return (uint64_t)str;
+}
+
+// Call a wasm:js-string builtin directly
+// Immediates: builtin (JS_STRING_*), frame_offset
+int op_call_js_string(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt;
+    int builtin = (int)*pc++;
+    int frame_offset = (int)*pc++;
+    uint64_t* args_ptr = fp + frame_offset;
+    uint64_t result;
+    int trap = js_string_call(builtin, args_ptr, &result);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    args_ptr[0] = result;
+    sp = args_ptr + 1;
+    NEXT();
+}
+DEFINE_OP(call_js_string)
+
 // struct.new
 int op_struct_new(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     (void)crt; (void)fp;
@@ -4617,12 +6087,14 @@ DEFINE_OP(extern_convert_any)
 
 static int ref_matches_type(uint64_t ref, int target_type, int target_nullable) {
     if (ref == REF_NULL) {
-        if (target_type == -10 || target_type == -11 || target_type == -12 || target_type == -13) {
+        if (target_type == -10 || target_type == -11 || target_type == -12 || target_type == -13 ||
+                target_type == -15) {
             return 1;
         }
         return target_nullable != 0;
     }
-    if (target_type == -10 || target_type == -11 || target_type == -12 || target_type == -13) {
+    if (target_type == -10 || target_type == -11 || target_type == -12 || target_type == -13 ||
+            target_type == -15) {
         return 0;
     }
     if ((ref & FUNCREF_TAG) == FUNCREF_TAG) {
@@ -4666,6 +6138,9 @@ static int ref_matches_type(uint64_t ref, int target_type, int target_nullable)
     }
     if (gc_is_managed_ptr(ref)) {
         GcHeader* header = (GcHeader*)ref;
+        if (header->obj_type == GC_TYPE_STRING) {
+            return (target_type == -8 || target_type == -2);
+        }
         if (target_type >= 0) {
             int actual = (int)header->type_idx;
             if (g_type_subtype_matrix && actual >= 0 && actual < g_num_types &&
@@ -4906,3 +6381,2499 @@ int op_table_grow(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
     NEXT();
 }
 DEFINE_OP(table_grow)
+
+// =============================================================================
+// SIMD operations (v128)
+// =============================================================================
+// A v128 takes one value slot like every other type: the slot holds the low
+// 64 bits and the slot V128_HI entries above it holds the high 64 bits. Ops
+// on scalars never touch the shadow half, so only the ops that move values
+// around (locals, slot copies, select, function results) have v128 variants.
+//
+// Every SIMD instruction has its own handler, with immediates
+// [simd_opcode, imm_a, imm_b]; simd_op() maps an opcode to its handler.
+// Kernels use SSE2 (baseline on x86-64) and switch to SSSE3/SSE4.1 forms when
+// the C compiler targets them (-msse4.1, -mavx2, -march=native); on other
+// targets, or with WASM5_NO_SIMD_INTRINSICS, every kernel is a scalar lane
+// loop. Lanes are in memory order, which assumes a little-endian host.
+
+typedef union {
+    uint8_t u8[16];
+    int8_t i8[16];
+    uint16_t u16[8];
+    int16_t i16[8];
+    uint32_t u32[4];
+    int32_t i32[4];
+    uint64_t u64[2];
+    int64_t i64[2];
+    float f32[4];
+    double f64[2];
+#ifdef SIMD_SSE2
+    __m128i m;
+    __m128 ps;
+    __m128d pd;
+#endif
+} V128;
+
+#define LANES(n) for (int i = 0; i < (n); i++)
+
+static inline V128 v128_get(const uint64_t* slot) {
+    V128 v;
+    v.u64[0] = slot[0];
+    v.u64[1] = slot[V128_HI];
+    return v;
+}
+
+static inline void v128_put(uint64_t* slot, V128 v) {
+    slot[0] = v.u64[0];
+    slot[V128_HI] = v.u64[1];
+}
+
+// Moving v128 values
+
+int op_local_get_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int64_t idx = (int64_t)*pc++;
+    sp[0] = fp[idx];
+    sp[V128_HI] = fp[idx + V128_HI];
+    sp++;
+    NEXT();
+}
+DEFINE_OP(local_get_v128)
+
+int op_local_set_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int64_t idx = (int64_t)*pc++;
+    sp--;
+    fp[idx] = sp[0];
+    fp[idx + V128_HI] = sp[V128_HI];
+    NEXT();
+}
+DEFINE_OP(local_set_v128)
+
+int op_local_tee_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int64_t idx = (int64_t)*pc++;
+    fp[idx] = sp[-1];
+    fp[idx + V128_HI] = sp[V128_HI - 1];
+    NEXT();
+}
+DEFINE_OP(local_tee_v128)
+
+// fp[dst_slot] = fp[src_slot], both halves
+int op_copy_slot_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int src_slot = (int)*pc++;
+    int dst_slot = (int)*pc++;
+    fp[dst_slot] = fp[src_slot];
+    fp[dst_slot + V128_HI] = fp[src_slot + V128_HI];
+    NEXT();
+}
+DEFINE_OP(copy_slot_v128)
+
+// A v128 global keeps its high 64 bits in a second globals entry
+// Immediates: global_idx, high_idx
+int op_global_get_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)fp;
+    int idx = (int)*pc++;
+    int hi = (int)*pc++;
+    sp[0] = crt->globals[idx];
+    sp[V128_HI] = crt->globals[hi];
+    sp++;
+    NEXT();
+}
+DEFINE_OP(global_get_v128)
+
+int op_global_set_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)fp;
+    int idx = (int)*pc++;
+    int hi = (int)*pc++;
+    sp--;
+    crt->globals[idx] = sp[0];
+    crt->globals[hi] = sp[V128_HI];
+    NEXT();
+}
+DEFINE_OP(global_set_v128)
+
+int op_select_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)fp;
+    uint32_t c = (uint32_t)sp[-1];
+    if (!c) {
+        sp[-3] = sp[-2];
+        sp[V128_HI - 3] = sp[V128_HI - 2];
+    }
+    sp -= 2;
+    NEXT();
+}
+DEFINE_OP(select_v128)
+
+// End/return of a function with v128 results: like op_end/op_wasm_return,
+// also copying the high halves
+// Immediate: num_results
+int op_end_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt;
+    int num_results = (int)*pc;
+    for (int i = 0; i < num_results; i++) {
+        fp[i] = sp[i - num_results];
+        fp[i + V128_HI] = sp[i - num_results + V128_HI];
+    }
+    return TRAP_NONE;
+}
+DEFINE_OP(end_v128)
+
+int op_return_v128(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    return op_end_v128(crt, pc, sp, fp);
+}
+DEFINE_OP(return_v128)
+
+// Scalar helpers
+
+static inline int8_t sat_s8(int v) { return (int8_t)(v < -128 ? -128 : v > 127 ? 127 : v); }
+static inline uint8_t sat_u8(int v) { return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v); }
+static inline int16_t sat_s16(int v) { return (int16_t)(v < -32768 ? -32768 : v > 32767 ? 32767 : v); }
+static inline uint16_t sat_u16(int v) { return (uint16_t)(v < 0 ? 0 : v > 65535 ? 65535 : v); }
+
+// WebAssembly min/max: NaN if either operand is NaN, -0 < +0
+static inline float simd_fminf(float a, float b) {
+    if (isnan(a) || isnan(b)) return as_f32(CANONICAL_NAN_F32);
+    if (a == b) return signbit(a) ? a : b;
+    return a < b ? a : b;
+}
+
+static inline float simd_fmaxf(float a, float b) {
+    if (isnan(a) || isnan(b)) return as_f32(CANONICAL_NAN_F32);
+    if (a == b) return signbit(a) ? b : a;
+    return a > b ? a : b;
+}
+
+static inline double simd_fmin(double a, double b) {
+    if (isnan(a) || isnan(b)) return as_f64(CANONICAL_NAN_F64);
+    if (a == b) return signbit(a) ? a : b;
+    return a < b ? a : b;
+}
+
+static inline double simd_fmax(double a, double b) {
+    if (isnan(a) || isnan(b)) return as_f64(CANONICAL_NAN_F64);
+    if (a == b) return signbit(a) ? b : a;
+    return a > b ? a : b;
+}
+
+static inline int32_t trunc_sat_s32(double x) {
+    if (isnan(x)) return 0;
+    if (x >= 2147483648.0) return INT32_MAX;
+    if (x <= -2147483649.0) return INT32_MIN;
+    return (int32_t)x;
+}
+
+static inline uint32_t trunc_sat_u32(double x) {
+    if (isnan(x) || x <= -1.0) return 0;
+    if (x >= 4294967296.0) return UINT32_MAX;
+    return (uint32_t)x;
+}
+
+// SSE helpers
+
+#ifdef SIMD_SSE2
+static inline __m128i sse_not(__m128i x) {
+    return _mm_xor_si128(x, _mm_set1_epi32(-1));
+}
+
+// mask ? a : b, per bit
+static inline __m128i sse_select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Unsigned compares flip the sign bit and compare signed
+#define SSE_BIAS8  _mm_set1_epi8((char)0x80)
+#define SSE_BIAS16 _mm_set1_epi16((short)0x8000)
+#define SSE_BIAS32 _mm_set1_epi32((int)0x80000000)
+
+static inline __m128i sse_lo_s8(__m128i x) { return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8); }
+static inline __m128i sse_hi_s8(__m128i x) { return _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8); }
+static inline __m128i sse_lo_u8(__m128i x) { return _mm_unpacklo_epi8(x, _mm_setzero_si128()); }
+static inline __m128i sse_hi_u8(__m128i x) { return _mm_unpackhi_epi8(x, _mm_setzero_si128()); }
+static inline __m128i sse_lo_s16(__m128i x) { return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16); }
+static inline __m128i sse_hi_s16(__m128i x) { return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16); }
+static inline __m128i sse_lo_u16(__m128i x) { return _mm_unpacklo_epi16(x, _mm_setzero_si128()); }
+static inline __m128i sse_hi_u16(__m128i x) { return _mm_unpackhi_epi16(x, _mm_setzero_si128()); }
+static inline __m128i sse_lo_s32(__m128i x) { return _mm_unpacklo_epi32(x, _mm_srai_epi32(x, 31)); }
+static inline __m128i sse_hi_s32(__m128i x) { return _mm_unpackhi_epi32(x, _mm_srai_epi32(x, 31)); }
+static inline __m128i sse_lo_u32(__m128i x) { return _mm_unpacklo_epi32(x, _mm_setzero_si128()); }
+static inline __m128i sse_hi_u32(__m128i x) { return _mm_unpackhi_epi32(x, _mm_setzero_si128()); }
+
+static inline __m128i sse_min_epi8(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_min_epi8(a, b);
+#else
+    return sse_select(_mm_cmpgt_epi8(a, b), b, a);
+#endif
+}
+
+static inline __m128i sse_max_epi8(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_max_epi8(a, b);
+#else
+    return sse_select(_mm_cmpgt_epi8(a, b), a, b);
+#endif
+}
+
+static inline __m128i sse_min_epu16(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_min_epu16(a, b);
+#else
+    return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+#endif
+}
+
+static inline __m128i sse_max_epu16(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_max_epu16(a, b);
+#else
+    return _mm_add_epi16(b, _mm_subs_epu16(a, b));
+#endif
+}
+
+static inline __m128i sse_min_epi32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_min_epi32(a, b);
+#else
+    return sse_select(_mm_cmpgt_epi32(a, b), b, a);
+#endif
+}
+
+static inline __m128i sse_max_epi32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_max_epi32(a, b);
+#else
+    return sse_select(_mm_cmpgt_epi32(a, b), a, b);
+#endif
+}
+
+static inline __m128i sse_min_epu32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_min_epu32(a, b);
+#else
+    __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(a, SSE_BIAS32), _mm_xor_si128(b, SSE_BIAS32));
+    return sse_select(gt, b, a);
+#endif
+}
+
+static inline __m128i sse_max_epu32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_max_epu32(a, b);
+#else
+    __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(a, SSE_BIAS32), _mm_xor_si128(b, SSE_BIAS32));
+    return sse_select(gt, a, b);
+#endif
+}
+
+static inline __m128i sse_mullo_epi32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i sse_cmpeq_epi64(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_cmpeq_epi64(a, b);
+#else
+    __m128i eq = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+#endif
+}
+
+static inline __m128i sse_cmpgt_epi64(__m128i a, __m128i b) {
+#ifdef SIMD_SSE42
+    return _mm_cmpgt_epi64(a, b);
+#else
+    V128 x, y, r;
+    x.m = a;
+    y.m = b;
+    LANES(2) r.i64[i] = -(int64_t)(x.i64[i] > y.i64[i]);
+    return r.m;
+#endif
+}
+
+// Signed 32x32->64 multiply of lanes 0 and 2
+static inline __m128i sse_mul_epi32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_mul_epi32(a, b);
+#else
+    V128 x, y, r;
+    x.m = a;
+    y.m = b;
+    LANES(2) r.i64[i] = (int64_t)x.i32[2 * i] * y.i32[2 * i];
+    return r.m;
+#endif
+}
+
+static inline __m128i sse_packus_epi32(__m128i a, __m128i b) {
+#ifdef SIMD_SSE41
+    return _mm_packus_epi32(a, b);
+#else
+    V128 x, y, r;
+    x.m = a;
+    y.m = b;
+    LANES(8) r.u16[i] = sat_u16(i < 4 ? x.i32[i] : y.i32[i - 4]);
+    return r.m;
+#endif
+}
+
+static inline __m128i sse_abs_epi8(__m128i a) {
+#ifdef SIMD_SSSE3
+    return _mm_abs_epi8(a);
+#else
+    return _mm_min_epu8(a, _mm_sub_epi8(_mm_setzero_si128(), a));
+#endif
+}
+
+static inline __m128i sse_abs_epi32(__m128i a) {
+#ifdef SIMD_SSSE3
+    return _mm_abs_epi32(a);
+#else
+    __m128i sign = _mm_srai_epi32(a, 31);
+    return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+#endif
+}
+
+static inline __m128i sse_q15mulr_sat(__m128i a, __m128i b) {
+#ifdef SIMD_SSSE3
+    __m128i r = _mm_mulhrs_epi16(a, b);
+    // 0x8000 * 0x8000 is the only overflow and comes out as 0x8000
+    return _mm_xor_si128(r, _mm_cmpeq_epi16(r, _mm_set1_epi16((short)0x8000)));
+#else
+    V128 x, y, r;
+    x.m = a;
+    y.m = b;
+    LANES(8) r.i16[i] = sat_s16((x.i16[i] * y.i16[i] + 0x4000) >> 15);
+    return r.m;
+#endif
+}
+
+static inline __m128 sse_round_ps(__m128 a, int mode) {
+#ifdef SIMD_SSE41
+    switch (mode) {
+        case 0: return _mm_round_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+        case 1: return _mm_round_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        case 2: return _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        default: return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+#else
+    V128 x;
+    x.ps = a;
+    LANES(4) {
+        float f = x.f32[i];
+        x.f32[i] = mode == 0 ? ceilf(f) : mode == 1 ? floorf(f) : mode == 2 ? truncf(f) : rintf(f);
+    }
+    return x.ps;
+#endif
+}
+
+static inline __m128d sse_round_pd(__m128d a, int mode) {
+#ifdef SIMD_SSE41
+    switch (mode) {
+        case 0: return _mm_round_pd(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+        case 1: return _mm_round_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        case 2: return _mm_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        default: return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+#else
+    V128 x;
+    x.pd = a;
+    LANES(2) {
+        double f = x.f64[i];
+        x.f64[i] = mode == 0 ? ceil(f) : mode == 1 ? floor(f) : mode == 2 ? trunc(f) : rint(f);
+    }
+    return x.pd;
+#endif
+}
+
+// minps/maxps return their second operand for NaNs and equal zeros; running
+// them both ways and merging gives WebAssembly's NaN and -0/+0 rules
+// (NaN lanes come out as a canonical NaN)
+static inline __m128 sse_wasm_min_ps(__m128 a, __m128 b) {
+    __m128 ab = _mm_min_ps(a, b);
+    __m128 ba = _mm_min_ps(b, a);
+    __m128 merged = _mm_or_ps(ba, ab);
+    __m128 nan = _mm_cmpunord_ps(ab, merged);
+    merged = _mm_or_ps(merged, nan);
+    nan = _mm_castsi128_ps(_mm_srli_epi32(_mm_castps_si128(nan), 10));
+    return _mm_andnot_ps(nan, merged);
+}
+
+static inline __m128 sse_wasm_max_ps(__m128 a, __m128 b) {
+    __m128 ab = _mm_max_ps(a, b);
+    __m128 ba = _mm_max_ps(b, a);
+    __m128 diff = _mm_xor_ps(ab, ba);
+    __m128 merged = _mm_sub_ps(_mm_or_ps(ba, diff), diff);
+    __m128 nan = _mm_cmpunord_ps(diff, merged);
+    nan = _mm_castsi128_ps(_mm_srli_epi32(_mm_castps_si128(nan), 10));
+    return _mm_andnot_ps(nan, merged);
+}
+
+static inline __m128d sse_wasm_min_pd(__m128d a, __m128d b) {
+    __m128d ab = _mm_min_pd(a, b);
+    __m128d ba = _mm_min_pd(b, a);
+    __m128d merged = _mm_or_pd(ba, ab);
+    __m128d nan = _mm_cmpunord_pd(ab, merged);
+    merged = _mm_or_pd(merged, nan);
+    nan = _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(nan), 13));
+    return _mm_andnot_pd(nan, merged);
+}
+
+static inline __m128d sse_wasm_max_pd(__m128d a, __m128d b) {
+    __m128d ab = _mm_max_pd(a, b);
+    __m128d ba = _mm_max_pd(b, a);
+    __m128d diff = _mm_xor_pd(ab, ba);
+    __m128d merged = _mm_sub_pd(_mm_or_pd(ba, diff), diff);
+    __m128d nan = _mm_cmpunord_pd(diff, merged);
+    nan = _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(nan), 13));
+    return _mm_andnot_pd(nan, merged);
+}
+#endif
+
+// Kernel generators: SIMD_OP1/SIMD_OP2 take an SSE2 statement computing r
+// from a/b and a scalar per-lane expression for r.lane[i]; only the one
+// matching the build is compiled. Compares set lanes to all ones via -(cond).
+
+#ifdef SIMD_SSE2
+#define SIMD_OP1(name, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a) { V128 r; sse; return r; }
+#define SIMD_OP2(name, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a, V128 b) { V128 r; sse; return r; }
+#else
+#define SIMD_OP1(name, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a) { V128 r; LANES(n) r.lane[i] = (expr); return r; }
+#define SIMD_OP2(name, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a, V128 b) { V128 r; LANES(n) r.lane[i] = (expr); return r; }
+#endif
+
+#define SIMD_OP2_SCALAR(name, n, lane, expr) \
+    static inline V128 simd_##name(V128 a, V128 b) { V128 r; LANES(n) r.lane[i] = (expr); return r; }
+#define SIMD_OP1_SCALAR(name, n, lane, expr) \
+    static inline V128 simd_##name(V128 a) { V128 r; LANES(n) r.lane[i] = (expr); return r; }
+
+// Integer compares for one lane width: eq ne lt_s lt_u gt_s gt_u le_s le_u ge_s ge_u
+#define SIMD_INT_CMPS(shape, n, s, u, cmpeq, cmpgt, bias) \
+    SIMD_OP2(shape##_eq, r.m = cmpeq(a.m, b.m), n, u, -(a.u[i] == b.u[i])) \
+    SIMD_OP2(shape##_ne, r.m = sse_not(cmpeq(a.m, b.m)), n, u, -(a.u[i] != b.u[i])) \
+    SIMD_OP2(shape##_lt_s, r.m = cmpgt(b.m, a.m), n, u, -(a.s[i] < b.s[i])) \
+    SIMD_OP2(shape##_lt_u, r.m = cmpgt(_mm_xor_si128(b.m, bias), _mm_xor_si128(a.m, bias)), n, u, -(a.u[i] < b.u[i])) \
+    SIMD_OP2(shape##_gt_s, r.m = cmpgt(a.m, b.m), n, u, -(a.s[i] > b.s[i])) \
+    SIMD_OP2(shape##_gt_u, r.m = cmpgt(_mm_xor_si128(a.m, bias), _mm_xor_si128(b.m, bias)), n, u, -(a.u[i] > b.u[i])) \
+    SIMD_OP2(shape##_le_s, r.m = sse_not(cmpgt(a.m, b.m)), n, u, -(a.s[i] <= b.s[i])) \
+    SIMD_OP2(shape##_le_u, r.m = sse_not(cmpgt(_mm_xor_si128(a.m, bias), _mm_xor_si128(b.m, bias))), n, u, -(a.u[i] <= b.u[i])) \
+    SIMD_OP2(shape##_ge_s, r.m = sse_not(cmpgt(b.m, a.m)), n, u, -(a.s[i] >= b.s[i])) \
+    SIMD_OP2(shape##_ge_u, r.m = sse_not(cmpgt(_mm_xor_si128(b.m, bias), _mm_xor_si128(a.m, bias))), n, u, -(a.u[i] >= b.u[i]))
+
+SIMD_INT_CMPS(i8x16, 16, i8, u8, _mm_cmpeq_epi8, _mm_cmpgt_epi8, SSE_BIAS8)
+SIMD_INT_CMPS(i16x8, 8, i16, u16, _mm_cmpeq_epi16, _mm_cmpgt_epi16, SSE_BIAS16)
+SIMD_INT_CMPS(i32x4, 4, i32, u32, _mm_cmpeq_epi32, _mm_cmpgt_epi32, SSE_BIAS32)
+
+SIMD_OP2(i64x2_eq, r.m = sse_cmpeq_epi64(a.m, b.m), 2, u64, -(uint64_t)(a.u64[i] == b.u64[i]))
+SIMD_OP2(i64x2_ne, r.m = sse_not(sse_cmpeq_epi64(a.m, b.m)), 2, u64, -(uint64_t)(a.u64[i] != b.u64[i]))
+SIMD_OP2(i64x2_lt_s, r.m = sse_cmpgt_epi64(b.m, a.m), 2, u64, -(uint64_t)(a.i64[i] < b.i64[i]))
+SIMD_OP2(i64x2_gt_s, r.m = sse_cmpgt_epi64(a.m, b.m), 2, u64, -(uint64_t)(a.i64[i] > b.i64[i]))
+SIMD_OP2(i64x2_le_s, r.m = sse_not(sse_cmpgt_epi64(a.m, b.m)), 2, u64, -(uint64_t)(a.i64[i] <= b.i64[i]))
+SIMD_OP2(i64x2_ge_s, r.m = sse_not(sse_cmpgt_epi64(b.m, a.m)), 2, u64, -(uint64_t)(a.i64[i] >= b.i64[i]))
+
+SIMD_OP2(f32x4_eq, r.ps = _mm_cmpeq_ps(a.ps, b.ps), 4, u32, -(a.f32[i] == b.f32[i]))
+SIMD_OP2(f32x4_ne, r.ps = _mm_cmpneq_ps(a.ps, b.ps), 4, u32, -(a.f32[i] != b.f32[i]))
+SIMD_OP2(f32x4_lt, r.ps = _mm_cmplt_ps(a.ps, b.ps), 4, u32, -(a.f32[i] < b.f32[i]))
+SIMD_OP2(f32x4_gt, r.ps = _mm_cmpgt_ps(a.ps, b.ps), 4, u32, -(a.f32[i] > b.f32[i]))
+SIMD_OP2(f32x4_le, r.ps = _mm_cmple_ps(a.ps, b.ps), 4, u32, -(a.f32[i] <= b.f32[i]))
+SIMD_OP2(f32x4_ge, r.ps = _mm_cmpge_ps(a.ps, b.ps), 4, u32, -(a.f32[i] >= b.f32[i]))
+SIMD_OP2(f64x2_eq, r.pd = _mm_cmpeq_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] == b.f64[i]))
+SIMD_OP2(f64x2_ne, r.pd = _mm_cmpneq_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] != b.f64[i]))
+SIMD_OP2(f64x2_lt, r.pd = _mm_cmplt_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] < b.f64[i]))
+SIMD_OP2(f64x2_gt, r.pd = _mm_cmpgt_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] > b.f64[i]))
+SIMD_OP2(f64x2_le, r.pd = _mm_cmple_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] <= b.f64[i]))
+SIMD_OP2(f64x2_ge, r.pd = _mm_cmpge_pd(a.pd, b.pd), 2, u64, -(uint64_t)(a.f64[i] >= b.f64[i]))
+
+// Bitwise
+SIMD_OP1(v128_not, r.m = sse_not(a.m), 2, u64, ~a.u64[i])
+SIMD_OP2(v128_and, r.m = _mm_and_si128(a.m, b.m), 2, u64, a.u64[i] & b.u64[i])
+SIMD_OP2(v128_andnot, r.m = _mm_andnot_si128(b.m, a.m), 2, u64, a.u64[i] & ~b.u64[i])
+SIMD_OP2(v128_or, r.m = _mm_or_si128(a.m, b.m), 2, u64, a.u64[i] | b.u64[i])
+SIMD_OP2(v128_xor, r.m = _mm_xor_si128(a.m, b.m), 2, u64, a.u64[i] ^ b.u64[i])
+
+static inline V128 simd_v128_bitselect(V128 a, V128 b, V128 c) {
+    V128 r;
+#ifdef SIMD_SSE2
+    r.m = sse_select(c.m, a.m, b.m);
+#else
+    LANES(2) r.u64[i] = (a.u64[i] & c.u64[i]) | (b.u64[i] & ~c.u64[i]);
+#endif
+    return r;
+}
+
+// i8x16 arithmetic
+SIMD_OP1(i8x16_abs, r.m = sse_abs_epi8(a.m), 16, u8, a.i8[i] < 0 ? (uint8_t)(0 - a.u8[i]) : a.u8[i])
+SIMD_OP1(i8x16_neg, r.m = _mm_sub_epi8(_mm_setzero_si128(), a.m), 16, u8, (uint8_t)(0 - a.u8[i]))
+SIMD_OP2(i8x16_add, r.m = _mm_add_epi8(a.m, b.m), 16, u8, (uint8_t)(a.u8[i] + b.u8[i]))
+SIMD_OP2(i8x16_add_sat_s, r.m = _mm_adds_epi8(a.m, b.m), 16, i8, sat_s8(a.i8[i] + b.i8[i]))
+SIMD_OP2(i8x16_add_sat_u, r.m = _mm_adds_epu8(a.m, b.m), 16, u8, sat_u8(a.u8[i] + b.u8[i]))
+SIMD_OP2(i8x16_sub, r.m = _mm_sub_epi8(a.m, b.m), 16, u8, (uint8_t)(a.u8[i] - b.u8[i]))
+SIMD_OP2(i8x16_sub_sat_s, r.m = _mm_subs_epi8(a.m, b.m), 16, i8, sat_s8(a.i8[i] - b.i8[i]))
+SIMD_OP2(i8x16_sub_sat_u, r.m = _mm_subs_epu8(a.m, b.m), 16, u8, sat_u8(a.u8[i] - b.u8[i]))
+SIMD_OP2(i8x16_min_s, r.m = sse_min_epi8(a.m, b.m), 16, i8, a.i8[i] < b.i8[i] ? a.i8[i] : b.i8[i])
+SIMD_OP2(i8x16_min_u, r.m = _mm_min_epu8(a.m, b.m), 16, u8, a.u8[i] < b.u8[i] ? a.u8[i] : b.u8[i])
+SIMD_OP2(i8x16_max_s, r.m = sse_max_epi8(a.m, b.m), 16, i8, a.i8[i] > b.i8[i] ? a.i8[i] : b.i8[i])
+SIMD_OP2(i8x16_max_u, r.m = _mm_max_epu8(a.m, b.m), 16, u8, a.u8[i] > b.u8[i] ? a.u8[i] : b.u8[i])
+SIMD_OP2(i8x16_avgr_u, r.m = _mm_avg_epu8(a.m, b.m), 16, u8, (uint8_t)((a.u8[i] + b.u8[i] + 1) >> 1))
+SIMD_OP2(i8x16_narrow_i16x8_s, r.m = _mm_packs_epi16(a.m, b.m), 16, i8, sat_s8(i < 8 ? a.i16[i] : b.i16[i - 8]))
+SIMD_OP2(i8x16_narrow_i16x8_u, r.m = _mm_packus_epi16(a.m, b.m), 16, u8, sat_u8(i < 8 ? a.i16[i] : b.i16[i - 8]))
+
+static inline V128 simd_i8x16_popcnt(V128 a) {
+    V128 r;
+#ifdef SIMD_SSE2
+    // Bitwise popcount per byte; the masks keep the 16-bit shifts in-byte
+    __m128i x = a.m;
+    x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi8(0x55)));
+    x = _mm_add_epi8(_mm_and_si128(x, _mm_set1_epi8(0x33)),
+                     _mm_and_si128(_mm_srli_epi16(x, 2), _mm_set1_epi8(0x33)));
+    r.m = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), _mm_set1_epi8(0x0F));
+#else
+    LANES(16) r.u8[i] = (uint8_t)__builtin_popcount(a.u8[i]);
+#endif
+    return r;
+}
+
+static inline V128 simd_i8x16_swizzle(V128 a, V128 b) {
+    V128 r;
+#ifdef SIMD_SSSE3
+    // Indices >= 16 get the high bit set, which pshufb turns into zero
+    r.m = _mm_shuffle_epi8(a.m, _mm_adds_epu8(b.m, _mm_set1_epi8(0x70)));
+#else
+    LANES(16) r.u8[i] = b.u8[i] < 16 ? a.u8[b.u8[i]] : 0;
+#endif
+    return r;
+}
+
+// Lane indices come from the instruction and are validated to be < 32
+static inline V128 simd_i8x16_shuffle(V128 a, V128 b, uint64_t lo, uint64_t hi) {
+    V128 s, r;
+    s.u64[0] = lo;
+    s.u64[1] = hi;
+#ifdef SIMD_SSSE3
+    __m128i from_a = _mm_or_si128(s.m, _mm_cmpgt_epi8(s.m, _mm_set1_epi8(15)));
+    __m128i from_b = _mm_or_si128(_mm_sub_epi8(s.m, _mm_set1_epi8(16)),
+                                  _mm_cmplt_epi8(s.m, _mm_set1_epi8(16)));
+    r.m = _mm_or_si128(_mm_shuffle_epi8(a.m, from_a), _mm_shuffle_epi8(b.m, from_b));
+#else
+    LANES(16) {
+        uint8_t idx = s.u8[i] & 31;
+        r.u8[i] = idx < 16 ? a.u8[idx] : b.u8[idx - 16];
+    }
+#endif
+    return r;
+}
+
+// i16x8 arithmetic
+SIMD_OP1(i16x8_abs, r.m = _mm_max_epi16(a.m, _mm_sub_epi16(_mm_setzero_si128(), a.m)), 8, u16, a.i16[i] < 0 ? (uint16_t)(0 - a.u16[i]) : a.u16[i])
+SIMD_OP1(i16x8_neg, r.m = _mm_sub_epi16(_mm_setzero_si128(), a.m), 8, u16, (uint16_t)(0 - a.u16[i]))
+SIMD_OP2(i16x8_add, r.m = _mm_add_epi16(a.m, b.m), 8, u16, (uint16_t)(a.u16[i] + b.u16[i]))
+SIMD_OP2(i16x8_add_sat_s, r.m = _mm_adds_epi16(a.m, b.m), 8, i16, sat_s16(a.i16[i] + b.i16[i]))
+SIMD_OP2(i16x8_add_sat_u, r.m = _mm_adds_epu16(a.m, b.m), 8, u16, sat_u16(a.u16[i] + b.u16[i]))
+SIMD_OP2(i16x8_sub, r.m = _mm_sub_epi16(a.m, b.m), 8, u16, (uint16_t)(a.u16[i] - b.u16[i]))
+SIMD_OP2(i16x8_sub_sat_s, r.m = _mm_subs_epi16(a.m, b.m), 8, i16, sat_s16(a.i16[i] - b.i16[i]))
+SIMD_OP2(i16x8_sub_sat_u, r.m = _mm_subs_epu16(a.m, b.m), 8, u16, sat_u16(a.u16[i] - b.u16[i]))
+SIMD_OP2(i16x8_mul, r.m = _mm_mullo_epi16(a.m, b.m), 8, u16, (uint16_t)((uint32_t)a.u16[i] * b.u16[i]))
+SIMD_OP2(i16x8_min_s, r.m = _mm_min_epi16(a.m, b.m), 8, i16, a.i16[i] < b.i16[i] ? a.i16[i] : b.i16[i])
+SIMD_OP2(i16x8_min_u, r.m = sse_min_epu16(a.m, b.m), 8, u16, a.u16[i] < b.u16[i] ? a.u16[i] : b.u16[i])
+SIMD_OP2(i16x8_max_s, r.m = _mm_max_epi16(a.m, b.m), 8, i16, a.i16[i] > b.i16[i] ? a.i16[i] : b.i16[i])
+SIMD_OP2(i16x8_max_u, r.m = sse_max_epu16(a.m, b.m), 8, u16, a.u16[i] > b.u16[i] ? a.u16[i] : b.u16[i])
+SIMD_OP2(i16x8_avgr_u, r.m = _mm_avg_epu16(a.m, b.m), 8, u16, (uint16_t)((a.u16[i] + b.u16[i] + 1) >> 1))
+SIMD_OP2(i16x8_q15mulr_sat_s, r.m = sse_q15mulr_sat(a.m, b.m), 8, i16, sat_s16((a.i16[i] * b.i16[i] + 0x4000) >> 15))
+SIMD_OP2(i16x8_narrow_i32x4_s, r.m = _mm_packs_epi32(a.m, b.m), 8, i16, sat_s16(i < 4 ? a.i32[i] : b.i32[i - 4]))
+SIMD_OP2(i16x8_narrow_i32x4_u, r.m = sse_packus_epi32(a.m, b.m), 8, u16, sat_u16(i < 4 ? a.i32[i] : b.i32[i - 4]))
+SIMD_OP1(i16x8_extend_low_i8x16_s, r.m = sse_lo_s8(a.m), 8, i16, a.i8[i])
+SIMD_OP1(i16x8_extend_high_i8x16_s, r.m = sse_hi_s8(a.m), 8, i16, a.i8[i + 8])
+SIMD_OP1(i16x8_extend_low_i8x16_u, r.m = sse_lo_u8(a.m), 8, u16, a.u8[i])
+SIMD_OP1(i16x8_extend_high_i8x16_u, r.m = sse_hi_u8(a.m), 8, u16, a.u8[i + 8])
+SIMD_OP1(i16x8_extadd_pairwise_i8x16_s, r.m = _mm_add_epi16(_mm_srai_epi16(_mm_slli_epi16(a.m, 8), 8), _mm_srai_epi16(a.m, 8)), 8, i16, a.i8[2 * i] + a.i8[2 * i + 1])
+SIMD_OP1(i16x8_extadd_pairwise_i8x16_u, r.m = _mm_add_epi16(_mm_and_si128(a.m, _mm_set1_epi16(0xFF)), _mm_srli_epi16(a.m, 8)), 8, u16, a.u8[2 * i] + a.u8[2 * i + 1])
+SIMD_OP2(i16x8_extmul_low_i8x16_s, r.m = _mm_mullo_epi16(sse_lo_s8(a.m), sse_lo_s8(b.m)), 8, i16, a.i8[i] * b.i8[i])
+SIMD_OP2(i16x8_extmul_high_i8x16_s, r.m = _mm_mullo_epi16(sse_hi_s8(a.m), sse_hi_s8(b.m)), 8, i16, a.i8[i + 8] * b.i8[i + 8])
+SIMD_OP2(i16x8_extmul_low_i8x16_u, r.m = _mm_mullo_epi16(sse_lo_u8(a.m), sse_lo_u8(b.m)), 8, u16, a.u8[i] * b.u8[i])
+SIMD_OP2(i16x8_extmul_high_i8x16_u, r.m = _mm_mullo_epi16(sse_hi_u8(a.m), sse_hi_u8(b.m)), 8, u16, a.u8[i + 8] * b.u8[i + 8])
+
+// i32x4 arithmetic
+SIMD_OP1(i32x4_abs, r.m = sse_abs_epi32(a.m), 4, u32, a.i32[i] < 0 ? 0u - a.u32[i] : a.u32[i])
+SIMD_OP1(i32x4_neg, r.m = _mm_sub_epi32(_mm_setzero_si128(), a.m), 4, u32, 0u - a.u32[i])
+SIMD_OP2(i32x4_add, r.m = _mm_add_epi32(a.m, b.m), 4, u32, a.u32[i] + b.u32[i])
+SIMD_OP2(i32x4_sub, r.m = _mm_sub_epi32(a.m, b.m), 4, u32, a.u32[i] - b.u32[i])
+SIMD_OP2(i32x4_mul, r.m = sse_mullo_epi32(a.m, b.m), 4, u32, a.u32[i] * b.u32[i])
+SIMD_OP2(i32x4_min_s, r.m = sse_min_epi32(a.m, b.m), 4, i32, a.i32[i] < b.i32[i] ? a.i32[i] : b.i32[i])
+SIMD_OP2(i32x4_min_u, r.m = sse_min_epu32(a.m, b.m), 4, u32, a.u32[i] < b.u32[i] ? a.u32[i] : b.u32[i])
+SIMD_OP2(i32x4_max_s, r.m = sse_max_epi32(a.m, b.m), 4, i32, a.i32[i] > b.i32[i] ? a.i32[i] : b.i32[i])
+SIMD_OP2(i32x4_max_u, r.m = sse_max_epu32(a.m, b.m), 4, u32, a.u32[i] > b.u32[i] ? a.u32[i] : b.u32[i])
+SIMD_OP2(i32x4_dot_i16x8_s, r.m = _mm_madd_epi16(a.m, b.m), 4, u32, (uint32_t)(a.i16[2 * i] * b.i16[2 * i]) + (uint32_t)(a.i16[2 * i + 1] * b.i16[2 * i + 1]))
+SIMD_OP1(i32x4_extend_low_i16x8_s, r.m = sse_lo_s16(a.m), 4, i32, a.i16[i])
+SIMD_OP1(i32x4_extend_high_i16x8_s, r.m = sse_hi_s16(a.m), 4, i32, a.i16[i + 4])
+SIMD_OP1(i32x4_extend_low_i16x8_u, r.m = sse_lo_u16(a.m), 4, u32, a.u16[i])
+SIMD_OP1(i32x4_extend_high_i16x8_u, r.m = sse_hi_u16(a.m), 4, u32, a.u16[i + 4])
+SIMD_OP1(i32x4_extadd_pairwise_i16x8_s, r.m = _mm_madd_epi16(a.m, _mm_set1_epi16(1)), 4, i32, a.i16[2 * i] + a.i16[2 * i + 1])
+SIMD_OP1(i32x4_extadd_pairwise_i16x8_u, r.m = _mm_add_epi32(_mm_and_si128(a.m, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(a.m, 16)), 4, u32, (uint32_t)a.u16[2 * i] + a.u16[2 * i + 1])
+SIMD_OP2(i32x4_extmul_low_i16x8_s, r.m = _mm_unpacklo_epi16(_mm_mullo_epi16(a.m, b.m), _mm_mulhi_epi16(a.m, b.m)), 4, i32, a.i16[i] * b.i16[i])
+SIMD_OP2(i32x4_extmul_high_i16x8_s, r.m = _mm_unpackhi_epi16(_mm_mullo_epi16(a.m, b.m), _mm_mulhi_epi16(a.m, b.m)), 4, i32, a.i16[i + 4] * b.i16[i + 4])
+SIMD_OP2(i32x4_extmul_low_i16x8_u, r.m = _mm_unpacklo_epi16(_mm_mullo_epi16(a.m, b.m), _mm_mulhi_epu16(a.m, b.m)), 4, u32, (uint32_t)a.u16[i] * b.u16[i])
+SIMD_OP2(i32x4_extmul_high_i16x8_u, r.m = _mm_unpackhi_epi16(_mm_mullo_epi16(a.m, b.m), _mm_mulhi_epu16(a.m, b.m)), 4, u32, (uint32_t)a.u16[i + 4] * b.u16[i + 4])
+
+// i64x2 arithmetic
+SIMD_OP1(i64x2_abs, r.m = _mm_sub_epi64(_mm_xor_si128(a.m, _mm_srai_epi32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(3, 3, 1, 1)), 31)), _mm_srai_epi32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(3, 3, 1, 1)), 31)), 2, u64, a.i64[i] < 0 ? 0 - a.u64[i] : a.u64[i])
+SIMD_OP1(i64x2_neg, r.m = _mm_sub_epi64(_mm_setzero_si128(), a.m), 2, u64, 0 - a.u64[i])
+SIMD_OP2(i64x2_add, r.m = _mm_add_epi64(a.m, b.m), 2, u64, a.u64[i] + b.u64[i])
+SIMD_OP2(i64x2_sub, r.m = _mm_sub_epi64(a.m, b.m), 2, u64, a.u64[i] - b.u64[i])
+SIMD_OP2_SCALAR(i64x2_mul, 2, u64, a.u64[i] * b.u64[i])
+SIMD_OP1(i64x2_extend_low_i32x4_s, r.m = sse_lo_s32(a.m), 2, i64, a.i32[i])
+SIMD_OP1(i64x2_extend_high_i32x4_s, r.m = sse_hi_s32(a.m), 2, i64, a.i32[i + 2])
+SIMD_OP1(i64x2_extend_low_i32x4_u, r.m = sse_lo_u32(a.m), 2, u64, a.u32[i])
+SIMD_OP1(i64x2_extend_high_i32x4_u, r.m = sse_hi_u32(a.m), 2, u64, a.u32[i + 2])
+SIMD_OP2(i64x2_extmul_low_i32x4_s, r.m = sse_mul_epi32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_epi32(b.m, _MM_SHUFFLE(1, 1, 0, 0))), 2, i64, (int64_t)a.i32[i] * b.i32[i])
+SIMD_OP2(i64x2_extmul_high_i32x4_s, r.m = sse_mul_epi32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_epi32(b.m, _MM_SHUFFLE(3, 3, 2, 2))), 2, i64, (int64_t)a.i32[i + 2] * b.i32[i + 2])
+SIMD_OP2(i64x2_extmul_low_i32x4_u, r.m = _mm_mul_epu32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_epi32(b.m, _MM_SHUFFLE(1, 1, 0, 0))), 2, u64, (uint64_t)a.u32[i] * b.u32[i])
+SIMD_OP2(i64x2_extmul_high_i32x4_u, r.m = _mm_mul_epu32(_mm_shuffle_epi32(a.m, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_epi32(b.m, _MM_SHUFFLE(3, 3, 2, 2))), 2, u64, (uint64_t)a.u32[i + 2] * b.u32[i + 2])
+
+// f32x4 arithmetic
+SIMD_OP1(f32x4_abs, r.m = _mm_and_si128(a.m, _mm_set1_epi32(0x7FFFFFFF)), 4, u32, a.u32[i] & 0x7FFFFFFFu)
+SIMD_OP1(f32x4_neg, r.m = _mm_xor_si128(a.m, _mm_set1_epi32((int)0x80000000)), 4, u32, a.u32[i] ^ 0x80000000u)
+SIMD_OP1(f32x4_sqrt, r.ps = _mm_sqrt_ps(a.ps), 4, f32, sqrtf(a.f32[i]))
+SIMD_OP1(f32x4_ceil, r.ps = sse_round_ps(a.ps, 0), 4, f32, ceilf(a.f32[i]))
+SIMD_OP1(f32x4_floor, r.ps = sse_round_ps(a.ps, 1), 4, f32, floorf(a.f32[i]))
+SIMD_OP1(f32x4_trunc, r.ps = sse_round_ps(a.ps, 2), 4, f32, truncf(a.f32[i]))
+SIMD_OP1(f32x4_nearest, r.ps = sse_round_ps(a.ps, 3), 4, f32, rintf(a.f32[i]))
+SIMD_OP2(f32x4_add, r.ps = _mm_add_ps(a.ps, b.ps), 4, f32, a.f32[i] + b.f32[i])
+SIMD_OP2(f32x4_sub, r.ps = _mm_sub_ps(a.ps, b.ps), 4, f32, a.f32[i] - b.f32[i])
+SIMD_OP2(f32x4_mul, r.ps = _mm_mul_ps(a.ps, b.ps), 4, f32, a.f32[i] * b.f32[i])
+SIMD_OP2(f32x4_div, r.ps = _mm_div_ps(a.ps, b.ps), 4, f32, a.f32[i] / b.f32[i])
+SIMD_OP2(f32x4_min, r.ps = sse_wasm_min_ps(a.ps, b.ps), 4, f32, simd_fminf(a.f32[i], b.f32[i]))
+SIMD_OP2(f32x4_max, r.ps = sse_wasm_max_ps(a.ps, b.ps), 4, f32, simd_fmaxf(a.f32[i], b.f32[i]))
+SIMD_OP2(f32x4_pmin, r.ps = _mm_min_ps(b.ps, a.ps), 4, f32, b.f32[i] < a.f32[i] ? b.f32[i] : a.f32[i])
+SIMD_OP2(f32x4_pmax, r.ps = _mm_max_ps(b.ps, a.ps), 4, f32, a.f32[i] < b.f32[i] ? b.f32[i] : a.f32[i])
+
+// f64x2 arithmetic
+SIMD_OP1(f64x2_abs, r.m = _mm_and_si128(a.m, _mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL)), 2, u64, a.u64[i] & ~F64_SIGN_MASK)
+SIMD_OP1(f64x2_neg, r.m = _mm_xor_si128(a.m, _mm_set1_epi64x((long long)F64_SIGN_MASK)), 2, u64, a.u64[i] ^ F64_SIGN_MASK)
+SIMD_OP1(f64x2_sqrt, r.pd = _mm_sqrt_pd(a.pd), 2, f64, sqrt(a.f64[i]))
+SIMD_OP1(f64x2_ceil, r.pd = sse_round_pd(a.pd, 0), 2, f64, ceil(a.f64[i]))
+SIMD_OP1(f64x2_floor, r.pd = sse_round_pd(a.pd, 1), 2, f64, floor(a.f64[i]))
+SIMD_OP1(f64x2_trunc, r.pd = sse_round_pd(a.pd, 2), 2, f64, trunc(a.f64[i]))
+SIMD_OP1(f64x2_nearest, r.pd = sse_round_pd(a.pd, 3), 2, f64, rint(a.f64[i]))
+SIMD_OP2(f64x2_add, r.pd = _mm_add_pd(a.pd, b.pd), 2, f64, a.f64[i] + b.f64[i])
+SIMD_OP2(f64x2_sub, r.pd = _mm_sub_pd(a.pd, b.pd), 2, f64, a.f64[i] - b.f64[i])
+SIMD_OP2(f64x2_mul, r.pd = _mm_mul_pd(a.pd, b.pd), 2, f64, a.f64[i] * b.f64[i])
+SIMD_OP2(f64x2_div, r.pd = _mm_div_pd(a.pd, b.pd), 2, f64, a.f64[i] / b.f64[i])
+SIMD_OP2(f64x2_min, r.pd = sse_wasm_min_pd(a.pd, b.pd), 2, f64, simd_fmin(a.f64[i], b.f64[i]))
+SIMD_OP2(f64x2_max, r.pd = sse_wasm_max_pd(a.pd, b.pd), 2, f64, simd_fmax(a.f64[i], b.f64[i]))
+SIMD_OP2(f64x2_pmin, r.pd = _mm_min_pd(b.pd, a.pd), 2, f64, b.f64[i] < a.f64[i] ? b.f64[i] : a.f64[i])
+SIMD_OP2(f64x2_pmax, r.pd = _mm_max_pd(b.pd, a.pd), 2, f64, a.f64[i] < b.f64[i] ? b.f64[i] : a.f64[i])
+
+// Conversions
+static inline V128 simd_i32x4_trunc_sat_f32x4_s(V128 a) {
+    V128 r;
+#ifdef SIMD_SSE2
+    // NaN lanes become 0; cvttps gives 0x80000000 on overflow, which the
+    // positive-overflow mask flips to 0x7FFFFFFF
+    __m128 x = _mm_and_ps(a.ps, _mm_cmpeq_ps(a.ps, a.ps));
+    __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(2147483648.0f)));
+    r.m = _mm_xor_si128(_mm_cvttps_epi32(x), overflow);
+#else
+    LANES(4) r.i32[i] = trunc_sat_s32(a.f32[i]);
+#endif
+    return r;
+}
+
+SIMD_OP1_SCALAR(i32x4_trunc_sat_f32x4_u, 4, u32, trunc_sat_u32(a.f32[i]))
+SIMD_OP1(f32x4_convert_i32x4_s, r.ps = _mm_cvtepi32_ps(a.m), 4, f32, (float)a.i32[i])
+SIMD_OP1_SCALAR(f32x4_convert_i32x4_u, 4, f32, (float)a.u32[i])
+SIMD_OP1_SCALAR(i32x4_trunc_sat_f64x2_s_zero, 4, i32, i < 2 ? trunc_sat_s32(a.f64[i]) : 0)
+SIMD_OP1_SCALAR(i32x4_trunc_sat_f64x2_u_zero, 4, u32, i < 2 ? trunc_sat_u32(a.f64[i]) : 0)
+SIMD_OP1(f64x2_convert_low_i32x4_s, r.pd = _mm_cvtepi32_pd(a.m), 2, f64, (double)a.i32[i])
+SIMD_OP1_SCALAR(f64x2_convert_low_i32x4_u, 2, f64, (double)a.u32[i])
+SIMD_OP1(f32x4_demote_f64x2_zero, r.ps = _mm_cvtpd_ps(a.pd), 4, f32, i < 2 ? (float)a.f64[i] : 0.0f)
+SIMD_OP1(f64x2_promote_low_f32x4, r.pd = _mm_cvtps_pd(a.ps), 2, f64, (double)a.f32[i])
+
+// Shifts: the count is taken modulo the lane width
+
+static inline V128 simd_i8x16_shl(V128 a, uint32_t count) {
+    int s = (int)(count & 7);
+    V128 r;
+#ifdef SIMD_SSE2
+    r.m = _mm_and_si128(_mm_sll_epi16(a.m, _mm_cvtsi32_si128(s)), _mm_set1_epi8((char)(0xFF << s)));
+#else
+    LANES(16) r.u8[i] = (uint8_t)(a.u8[i] << s);
+#endif
+    return r;
+}
+
+static inline V128 simd_i8x16_shr_s(V128 a, uint32_t count) {
+    int s = (int)(count & 7);
+    V128 r;
+#ifdef SIMD_SSE2
+    // Each byte sits in the high half of a 16-bit lane, shift by 8 more
+    __m128i c = _mm_cvtsi32_si128(s + 8);
+    r.m = _mm_packs_epi16(_mm_sra_epi16(_mm_unpacklo_epi8(a.m, a.m), c),
+                          _mm_sra_epi16(_mm_unpackhi_epi8(a.m, a.m), c));
+#else
+    LANES(16) r.i8[i] = (int8_t)(a.i8[i] >> s);
+#endif
+    return r;
+}
+
+static inline V128 simd_i8x16_shr_u(V128 a, uint32_t count) {
+    int s = (int)(count & 7);
+    V128 r;
+#ifdef SIMD_SSE2
+    r.m = _mm_and_si128(_mm_srl_epi16(a.m, _mm_cvtsi32_si128(s)), _mm_set1_epi8((char)(0xFF >> s)));
+#else
+    LANES(16) r.u8[i] = (uint8_t)(a.u8[i] >> s);
+#endif
+    return r;
+}
+
+#ifdef SIMD_SSE2
+#define SIMD_SHIFT_KERNEL(name, bits, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a, uint32_t count) { \
+        int s = (int)(count & (bits - 1)); \
+        V128 r; \
+        r.m = sse(a.m, _mm_cvtsi32_si128(s)); \
+        return r; \
+    }
+#else
+#define SIMD_SHIFT_KERNEL(name, bits, sse, n, lane, expr) \
+    static inline V128 simd_##name(V128 a, uint32_t count) { \
+        int s = (int)(count & (bits - 1)); \
+        V128 r; \
+        LANES(n) r.lane[i] = (expr); \
+        return r; \
+    }
+#endif
+
+SIMD_SHIFT_KERNEL(i16x8_shl, 16, _mm_sll_epi16, 8, u16, (uint16_t)(a.u16[i] << s))
+SIMD_SHIFT_KERNEL(i16x8_shr_s, 16, _mm_sra_epi16, 8, i16, (int16_t)(a.i16[i] >> s))
+SIMD_SHIFT_KERNEL(i16x8_shr_u, 16, _mm_srl_epi16, 8, u16, (uint16_t)(a.u16[i] >> s))
+SIMD_SHIFT_KERNEL(i32x4_shl, 32, _mm_sll_epi32, 4, u32, a.u32[i] << s)
+SIMD_SHIFT_KERNEL(i32x4_shr_s, 32, _mm_sra_epi32, 4, i32, a.i32[i] >> s)
+SIMD_SHIFT_KERNEL(i32x4_shr_u, 32, _mm_srl_epi32, 4, u32, a.u32[i] >> s)
+SIMD_SHIFT_KERNEL(i64x2_shl, 64, _mm_sll_epi64, 2, u64, a.u64[i] << s)
+SIMD_SHIFT_KERNEL(i64x2_shr_u, 64, _mm_srl_epi64, 2, u64, a.u64[i] >> s)
+
+static inline V128 simd_i64x2_shr_s(V128 a, uint32_t count) {
+    int s = (int)(count & 63);
+    V128 r;
+#ifdef SIMD_SSE2
+    // No 64-bit arithmetic shift before AVX-512: shift logically, then
+    // sign-extend from bit 63 - s
+    __m128i c = _mm_cvtsi32_si128(s);
+    __m128i sign = _mm_srl_epi64(_mm_set1_epi64x((long long)F64_SIGN_MASK), c);
+    r.m = _mm_sub_epi64(_mm_xor_si128(_mm_srl_epi64(a.m, c), sign), sign);
+#else
+    LANES(2) r.i64[i] = a.i64[i] >> s;
+#endif
+    return r;
+}
+
+// Reductions to i32
+
+static inline uint32_t simd_v128_any_true(V128 a) {
+    return (a.u64[0] | a.u64[1]) != 0;
+}
+
+#ifdef SIMD_SSE2
+#define SIMD_ALL_TRUE(name, n, lane, cmpeq) \
+    static inline uint32_t simd_##name(V128 a) { \
+        return _mm_movemask_epi8(cmpeq(a.m, _mm_setzero_si128())) == 0; \
+    }
+#else
+#define SIMD_ALL_TRUE(name, n, lane, cmpeq) \
+    static inline uint32_t simd_##name(V128 a) { \
+        LANES(n) if (a.lane[i] == 0) return 0; \
+        return 1; \
+    }
+#endif
+
+SIMD_ALL_TRUE(i8x16_all_true, 16, u8, _mm_cmpeq_epi8)
+SIMD_ALL_TRUE(i16x8_all_true, 8, u16, _mm_cmpeq_epi16)
+SIMD_ALL_TRUE(i32x4_all_true, 4, u32, _mm_cmpeq_epi32)
+SIMD_ALL_TRUE(i64x2_all_true, 2, u64, sse_cmpeq_epi64)
+
+static inline uint32_t simd_i8x16_bitmask(V128 a) {
+#ifdef SIMD_SSE2
+    return (uint32_t)_mm_movemask_epi8(a.m);
+#else
+    uint32_t mask = 0;
+    LANES(16) mask |= (uint32_t)(a.u8[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+static inline uint32_t simd_i16x8_bitmask(V128 a) {
+#ifdef SIMD_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(a.m, _mm_setzero_si128()));
+#else
+    uint32_t mask = 0;
+    LANES(8) mask |= (uint32_t)(a.u16[i] >> 15) << i;
+    return mask;
+#endif
+}
+
+static inline uint32_t simd_i32x4_bitmask(V128 a) {
+#ifdef SIMD_SSE2
+    return (uint32_t)_mm_movemask_ps(a.ps);
+#else
+    uint32_t mask = 0;
+    LANES(4) mask |= (a.u32[i] >> 31) << i;
+    return mask;
+#endif
+}
+
+static inline uint32_t simd_i64x2_bitmask(V128 a) {
+#ifdef SIMD_SSE2
+    return (uint32_t)_mm_movemask_pd(a.pd);
+#else
+    return (uint32_t)((a.u64[0] >> 63) | ((a.u64[1] >> 63) << 1));
+#endif
+}
+
+// Splat, extract and replace; f32/f64 lanes move as raw bits
+
+static inline V128 simd_i8x16_splat(uint64_t x) {
+    V128 r;
+    LANES(16) r.u8[i] = (uint8_t)x;
+    return r;
+}
+
+static inline V128 simd_i16x8_splat(uint64_t x) {
+    V128 r;
+    LANES(8) r.u16[i] = (uint16_t)x;
+    return r;
+}
+
+static inline V128 simd_i32x4_splat(uint64_t x) {
+    V128 r;
+    LANES(4) r.u32[i] = (uint32_t)x;
+    return r;
+}
+
+static inline V128 simd_i64x2_splat(uint64_t x) {
+    V128 r;
+    LANES(2) r.u64[i] = x;
+    return r;
+}
+
+static inline V128 simd_f32x4_splat(uint64_t x) { return simd_i32x4_splat(x); }
+static inline V128 simd_f64x2_splat(uint64_t x) { return simd_i64x2_splat(x); }
+
+static inline uint64_t simd_i8x16_extract_lane_s(V128 a, int lane) { return (uint32_t)(int32_t)a.i8[lane & 15]; }
+static inline uint64_t simd_i8x16_extract_lane_u(V128 a, int lane) { return a.u8[lane & 15]; }
+static inline uint64_t simd_i16x8_extract_lane_s(V128 a, int lane) { return (uint32_t)(int32_t)a.i16[lane & 7]; }
+static inline uint64_t simd_i16x8_extract_lane_u(V128 a, int lane) { return a.u16[lane & 7]; }
+static inline uint64_t simd_i32x4_extract_lane(V128 a, int lane) { return a.u32[lane & 3]; }
+static inline uint64_t simd_i64x2_extract_lane(V128 a, int lane) { return a.u64[lane & 1]; }
+static inline uint64_t simd_f32x4_extract_lane(V128 a, int lane) { return a.u32[lane & 3]; }
+static inline uint64_t simd_f64x2_extract_lane(V128 a, int lane) { return a.u64[lane & 1]; }
+
+static inline V128 simd_i8x16_replace_lane(V128 a, int lane, uint64_t x) { a.u8[lane & 15] = (uint8_t)x; return a; }
+static inline V128 simd_i16x8_replace_lane(V128 a, int lane, uint64_t x) { a.u16[lane & 7] = (uint16_t)x; return a; }
+static inline V128 simd_i32x4_replace_lane(V128 a, int lane, uint64_t x) { a.u32[lane & 3] = (uint32_t)x; return a; }
+static inline V128 simd_i64x2_replace_lane(V128 a, int lane, uint64_t x) { a.u64[lane & 1] = x; return a; }
+static inline V128 simd_f32x4_replace_lane(V128 a, int lane, uint64_t x) { a.u32[lane & 3] = (uint32_t)x; return a; }
+static inline V128 simd_f64x2_replace_lane(V128 a, int lane, uint64_t x) { a.u64[lane & 1] = x; return a; }
+
+// Loads from an already bounds-checked address
+
+static inline V128 simd_v128_load(const uint8_t* p) {
+    V128 r;
+    memcpy(&r, p, 16);
+    return r;
+}
+
+static inline V128 simd_load_low64(const uint8_t* p) {
+    V128 r;
+    memcpy(&r.u64[0], p, 8);
+    r.u64[1] = 0;
+    return r;
+}
+
+static inline V128 simd_v128_load8x8_s(const uint8_t* p) { return simd_i16x8_extend_low_i8x16_s(simd_load_low64(p)); }
+static inline V128 simd_v128_load8x8_u(const uint8_t* p) { return simd_i16x8_extend_low_i8x16_u(simd_load_low64(p)); }
+static inline V128 simd_v128_load16x4_s(const uint8_t* p) { return simd_i32x4_extend_low_i16x8_s(simd_load_low64(p)); }
+static inline V128 simd_v128_load16x4_u(const uint8_t* p) { return simd_i32x4_extend_low_i16x8_u(simd_load_low64(p)); }
+static inline V128 simd_v128_load32x2_s(const uint8_t* p) { return simd_i64x2_extend_low_i32x4_s(simd_load_low64(p)); }
+static inline V128 simd_v128_load32x2_u(const uint8_t* p) { return simd_i64x2_extend_low_i32x4_u(simd_load_low64(p)); }
+static inline V128 simd_v128_load8_splat(const uint8_t* p) { return simd_i8x16_splat(p[0]); }
+
+static inline V128 simd_v128_load16_splat(const uint8_t* p) {
+    uint16_t x;
+    memcpy(&x, p, 2);
+    return simd_i16x8_splat(x);
+}
+
+static inline V128 simd_v128_load32_splat(const uint8_t* p) {
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return simd_i32x4_splat(x);
+}
+
+static inline V128 simd_v128_load64_splat(const uint8_t* p) {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    return simd_i64x2_splat(x);
+}
+
+static inline V128 simd_v128_load32_zero(const uint8_t* p) {
+    V128 r;
+    r.u64[0] = 0;
+    r.u64[1] = 0;
+    memcpy(&r.u32[0], p, 4);
+    return r;
+}
+
+static inline V128 simd_v128_load64_zero(const uint8_t* p) { return simd_load_low64(p); }
+
+// Handlers, one per kind of SIMD instruction. pc points at
+// [simd_opcode, imm_a, imm_b]; memory ops use imm_a as the offset and the
+// bits of imm_b above the lane as the memory index.
+
+// Memory handlers are generated for memory 0 (M = MEMORY0) and, with the
+// _mem suffix, for the other memories of a multi-memory module (MEMORYN),
+// and with _m64 for memory64 memories (MEMORY64)
+#define SIMD_HANDLER_LOAD(name, size) SIMD_MEMORY_HANDLER_LOAD(name, size, , MEMORY0)
+#define SIMD_HANDLER_STORE(name, size) SIMD_MEMORY_HANDLER_STORE(name, size, , MEMORY0)
+#define SIMD_HANDLER_LOAD_LANE(name, size) SIMD_MEMORY_HANDLER_LOAD_LANE(name, size, , MEMORY0)
+#define SIMD_HANDLER_STORE_LANE(name, size) SIMD_MEMORY_HANDLER_STORE_LANE(name, size, , MEMORY0)
+
+#define SIMD_MEMORY_HANDLER_LOAD(name, size, variant, M) \
+static int op_simd_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-1], pc[1]); \
+    M##_CHECK(addr, size); \
+    v128_put(sp - 1, simd_##name(M##_BASE + (size_t)addr)); \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_MEMORY_HANDLER_STORE(name, size, variant, M) \
+static int op_simd_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    V128 v = v128_get(sp - 1); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    M##_CHECK(addr, size); \
+    memcpy(M##_BASE + (size_t)addr, &v, size); \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// The low bits of imm_b are the lane
+#define SIMD_MEMORY_HANDLER_LOAD_LANE(name, size, variant, M) \
+static int op_simd_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    V128 v = v128_get(sp - 1); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    M##_CHECK(addr, size); \
+    memcpy(v.u8 + (pc[2] & (16 / size - 1)) * size, M##_BASE + (size_t)addr, size); \
+    v128_put(sp - 2, v); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_MEMORY_HANDLER_STORE_LANE(name, size, variant, M) \
+static int op_simd_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    V128 v = v128_get(sp - 1); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    M##_CHECK(addr, size); \
+    memcpy(M##_BASE + (size_t)addr, v.u8 + (pc[2] & (16 / size - 1)) * size, size); \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_CONST(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    sp[0] = pc[1]; \
+    sp[V128_HI] = pc[2]; \
+    sp++; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_SHUFFLE(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    V128 b = v128_get(sp - 1); \
+    V128 a = v128_get(sp - 2); \
+    v128_put(sp - 2, simd_##name(a, b, pc[1], pc[2])); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_SPLAT(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    v128_put(sp - 1, simd_##name(sp[-1])); \
+    pc += 3; \
+    NEXT(); \
+}
+
+// imm_a is the lane
+#define SIMD_HANDLER_EXTRACT(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    sp[-1] = simd_##name(v128_get(sp - 1), (int)pc[1]); \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_REPLACE(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    uint64_t x = sp[-1]; \
+    v128_put(sp - 2, simd_##name(v128_get(sp - 2), (int)pc[1], x)); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_UNARY(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    v128_put(sp - 1, simd_##name(v128_get(sp - 1))); \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_BINARY(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    V128 b = v128_get(sp - 1); \
+    V128 a = v128_get(sp - 2); \
+    v128_put(sp - 2, simd_##name(a, b)); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_TERNARY(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    V128 c = v128_get(sp - 1); \
+    V128 b = v128_get(sp - 2); \
+    V128 a = v128_get(sp - 3); \
+    v128_put(sp - 3, simd_##name(a, b, c)); \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_SHIFT(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    uint32_t count = (uint32_t)sp[-1]; \
+    v128_put(sp - 2, simd_##name(v128_get(sp - 2), count)); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define SIMD_HANDLER_TO_I32(name, size) \
+static int op_simd_##name(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    sp[-1] = (uint64_t)simd_##name(v128_get(sp - 1)); \
+    pc += 3; \
+    NEXT(); \
+}
+
+// SIMD instructions that access memory: X(opcode, name, handler kind,
+// memory access size)
+#define SIMD_MEMORY_OPS(X) \
+    X(0x00, v128_load, LOAD, 16) \
+    X(0x01, v128_load8x8_s, LOAD, 8) \
+    X(0x02, v128_load8x8_u, LOAD, 8) \
+    X(0x03, v128_load16x4_s, LOAD, 8) \
+    X(0x04, v128_load16x4_u, LOAD, 8) \
+    X(0x05, v128_load32x2_s, LOAD, 8) \
+    X(0x06, v128_load32x2_u, LOAD, 8) \
+    X(0x07, v128_load8_splat, LOAD, 1) \
+    X(0x08, v128_load16_splat, LOAD, 2) \
+    X(0x09, v128_load32_splat, LOAD, 4) \
+    X(0x0A, v128_load64_splat, LOAD, 8) \
+    X(0x0B, v128_store, STORE, 16) \
+    X(0x54, v128_load8_lane, LOAD_LANE, 1) \
+    X(0x55, v128_load16_lane, LOAD_LANE, 2) \
+    X(0x56, v128_load32_lane, LOAD_LANE, 4) \
+    X(0x57, v128_load64_lane, LOAD_LANE, 8) \
+    X(0x58, v128_store8_lane, STORE_LANE, 1) \
+    X(0x59, v128_store16_lane, STORE_LANE, 2) \
+    X(0x5A, v128_store32_lane, STORE_LANE, 4) \
+    X(0x5B, v128_store64_lane, STORE_LANE, 8) \
+    X(0x5C, v128_load32_zero, LOAD, 4) \
+    X(0x5D, v128_load64_zero, LOAD, 8)
+
+// Every SIMD instruction: X(opcode, name, handler kind, memory access size)
+#define SIMD_OPS(X) \
+    SIMD_MEMORY_OPS(X) \
+    X(0x0C, v128_const, CONST, 0) \
+    X(0x0D, i8x16_shuffle, SHUFFLE, 0) \
+    X(0x0E, i8x16_swizzle, BINARY, 0) \
+    X(0x0F, i8x16_splat, SPLAT, 0) \
+    X(0x10, i16x8_splat, SPLAT, 0) \
+    X(0x11, i32x4_splat, SPLAT, 0) \
+    X(0x12, i64x2_splat, SPLAT, 0) \
+    X(0x13, f32x4_splat, SPLAT, 0) \
+    X(0x14, f64x2_splat, SPLAT, 0) \
+    X(0x15, i8x16_extract_lane_s, EXTRACT, 0) \
+    X(0x16, i8x16_extract_lane_u, EXTRACT, 0) \
+    X(0x17, i8x16_replace_lane, REPLACE, 0) \
+    X(0x18, i16x8_extract_lane_s, EXTRACT, 0) \
+    X(0x19, i16x8_extract_lane_u, EXTRACT, 0) \
+    X(0x1A, i16x8_replace_lane, REPLACE, 0) \
+    X(0x1B, i32x4_extract_lane, EXTRACT, 0) \
+    X(0x1C, i32x4_replace_lane, REPLACE, 0) \
+    X(0x1D, i64x2_extract_lane, EXTRACT, 0) \
+    X(0x1E, i64x2_replace_lane, REPLACE, 0) \
+    X(0x1F, f32x4_extract_lane, EXTRACT, 0) \
+    X(0x20, f32x4_replace_lane, REPLACE, 0) \
+    X(0x21, f64x2_extract_lane, EXTRACT, 0) \
+    X(0x22, f64x2_replace_lane, REPLACE, 0) \
+    X(0x23, i8x16_eq, BINARY, 0) \
+    X(0x24, i8x16_ne, BINARY, 0) \
+    X(0x25, i8x16_lt_s, BINARY, 0) \
+    X(0x26, i8x16_lt_u, BINARY, 0) \
+    X(0x27, i8x16_gt_s, BINARY, 0) \
+    X(0x28, i8x16_gt_u, BINARY, 0) \
+    X(0x29, i8x16_le_s, BINARY, 0) \
+    X(0x2A, i8x16_le_u, BINARY, 0) \
+    X(0x2B, i8x16_ge_s, BINARY, 0) \
+    X(0x2C, i8x16_ge_u, BINARY, 0) \
+    X(0x2D, i16x8_eq, BINARY, 0) \
+    X(0x2E, i16x8_ne, BINARY, 0) \
+    X(0x2F, i16x8_lt_s, BINARY, 0) \
+    X(0x30, i16x8_lt_u, BINARY, 0) \
+    X(0x31, i16x8_gt_s, BINARY, 0) \
+    X(0x32, i16x8_gt_u, BINARY, 0) \
+    X(0x33, i16x8_le_s, BINARY, 0) \
+    X(0x34, i16x8_le_u, BINARY, 0) \
+    X(0x35, i16x8_ge_s, BINARY, 0) \
+    X(0x36, i16x8_ge_u, BINARY, 0) \
+    X(0x37, i32x4_eq, BINARY, 0) \
+    X(0x38, i32x4_ne, BINARY, 0) \
+    X(0x39, i32x4_lt_s, BINARY, 0) \
+    X(0x3A, i32x4_lt_u, BINARY, 0) \
+    X(0x3B, i32x4_gt_s, BINARY, 0) \
+    X(0x3C, i32x4_gt_u, BINARY, 0) \
+    X(0x3D, i32x4_le_s, BINARY, 0) \
+    X(0x3E, i32x4_le_u, BINARY, 0) \
+    X(0x3F, i32x4_ge_s, BINARY, 0) \
+    X(0x40, i32x4_ge_u, BINARY, 0) \
+    X(0x41, f32x4_eq, BINARY, 0) \
+    X(0x42, f32x4_ne, BINARY, 0) \
+    X(0x43, f32x4_lt, BINARY, 0) \
+    X(0x44, f32x4_gt, BINARY, 0) \
+    X(0x45, f32x4_le, BINARY, 0) \
+    X(0x46, f32x4_ge, BINARY, 0) \
+    X(0x47, f64x2_eq, BINARY, 0) \
+    X(0x48, f64x2_ne, BINARY, 0) \
+    X(0x49, f64x2_lt, BINARY, 0) \
+    X(0x4A, f64x2_gt, BINARY, 0) \
+    X(0x4B, f64x2_le, BINARY, 0) \
+    X(0x4C, f64x2_ge, BINARY, 0) \
+    X(0x4D, v128_not, UNARY, 0) \
+    X(0x4E, v128_and, BINARY, 0) \
+    X(0x4F, v128_andnot, BINARY, 0) \
+    X(0x50, v128_or, BINARY, 0) \
+    X(0x51, v128_xor, BINARY, 0) \
+    X(0x52, v128_bitselect, TERNARY, 0) \
+    X(0x53, v128_any_true, TO_I32, 0) \
+    X(0x5E, f32x4_demote_f64x2_zero, UNARY, 0) \
+    X(0x5F, f64x2_promote_low_f32x4, UNARY, 0) \
+    X(0x60, i8x16_abs, UNARY, 0) \
+    X(0x61, i8x16_neg, UNARY, 0) \
+    X(0x62, i8x16_popcnt, UNARY, 0) \
+    X(0x63, i8x16_all_true, TO_I32, 0) \
+    X(0x64, i8x16_bitmask, TO_I32, 0) \
+    X(0x65, i8x16_narrow_i16x8_s, BINARY, 0) \
+    X(0x66, i8x16_narrow_i16x8_u, BINARY, 0) \
+    X(0x67, f32x4_ceil, UNARY, 0) \
+    X(0x68, f32x4_floor, UNARY, 0) \
+    X(0x69, f32x4_trunc, UNARY, 0) \
+    X(0x6A, f32x4_nearest, UNARY, 0) \
+    X(0x6B, i8x16_shl, SHIFT, 0) \
+    X(0x6C, i8x16_shr_s, SHIFT, 0) \
+    X(0x6D, i8x16_shr_u, SHIFT, 0) \
+    X(0x6E, i8x16_add, BINARY, 0) \
+    X(0x6F, i8x16_add_sat_s, BINARY, 0) \
+    X(0x70, i8x16_add_sat_u, BINARY, 0) \
+    X(0x71, i8x16_sub, BINARY, 0) \
+    X(0x72, i8x16_sub_sat_s, BINARY, 0) \
+    X(0x73, i8x16_sub_sat_u, BINARY, 0) \
+    X(0x74, f64x2_ceil, UNARY, 0) \
+    X(0x75, f64x2_floor, UNARY, 0) \
+    X(0x76, i8x16_min_s, BINARY, 0) \
+    X(0x77, i8x16_min_u, BINARY, 0) \
+    X(0x78, i8x16_max_s, BINARY, 0) \
+    X(0x79, i8x16_max_u, BINARY, 0) \
+    X(0x7A, f64x2_trunc, UNARY, 0) \
+    X(0x7B, i8x16_avgr_u, BINARY, 0) \
+    X(0x7C, i16x8_extadd_pairwise_i8x16_s, UNARY, 0) \
+    X(0x7D, i16x8_extadd_pairwise_i8x16_u, UNARY, 0) \
+    X(0x7E, i32x4_extadd_pairwise_i16x8_s, UNARY, 0) \
+    X(0x7F, i32x4_extadd_pairwise_i16x8_u, UNARY, 0) \
+    X(0x80, i16x8_abs, UNARY, 0) \
+    X(0x81, i16x8_neg, UNARY, 0) \
+    X(0x82, i16x8_q15mulr_sat_s, BINARY, 0) \
+    X(0x83, i16x8_all_true, TO_I32, 0) \
+    X(0x84, i16x8_bitmask, TO_I32, 0) \
+    X(0x85, i16x8_narrow_i32x4_s, BINARY, 0) \
+    X(0x86, i16x8_narrow_i32x4_u, BINARY, 0) \
+    X(0x87, i16x8_extend_low_i8x16_s, UNARY, 0) \
+    X(0x88, i16x8_extend_high_i8x16_s, UNARY, 0) \
+    X(0x89, i16x8_extend_low_i8x16_u, UNARY, 0) \
+    X(0x8A, i16x8_extend_high_i8x16_u, UNARY, 0) \
+    X(0x8B, i16x8_shl, SHIFT, 0) \
+    X(0x8C, i16x8_shr_s, SHIFT, 0) \
+    X(0x8D, i16x8_shr_u, SHIFT, 0) \
+    X(0x8E, i16x8_add, BINARY, 0) \
+    X(0x8F, i16x8_add_sat_s, BINARY, 0) \
+    X(0x90, i16x8_add_sat_u, BINARY, 0) \
+    X(0x91, i16x8_sub, BINARY, 0) \
+    X(0x92, i16x8_sub_sat_s, BINARY, 0) \
+    X(0x93, i16x8_sub_sat_u, BINARY, 0) \
+    X(0x94, f64x2_nearest, UNARY, 0) \
+    X(0x95, i16x8_mul, BINARY, 0) \
+    X(0x96, i16x8_min_s, BINARY, 0) \
+    X(0x97, i16x8_min_u, BINARY, 0) \
+    X(0x98, i16x8_max_s, BINARY, 0) \
+    X(0x99, i16x8_max_u, BINARY, 0) \
+    X(0x9B, i16x8_avgr_u, BINARY, 0) \
+    X(0x9C, i16x8_extmul_low_i8x16_s, BINARY, 0) \
+    X(0x9D, i16x8_extmul_high_i8x16_s, BINARY, 0) \
+    X(0x9E, i16x8_extmul_low_i8x16_u, BINARY, 0) \
+    X(0x9F, i16x8_extmul_high_i8x16_u, BINARY, 0) \
+    X(0xA0, i32x4_abs, UNARY, 0) \
+    X(0xA1, i32x4_neg, UNARY, 0) \
+    X(0xA3, i32x4_all_true, TO_I32, 0) \
+    X(0xA4, i32x4_bitmask, TO_I32, 0) \
+    X(0xA7, i32x4_extend_low_i16x8_s, UNARY, 0) \
+    X(0xA8, i32x4_extend_high_i16x8_s, UNARY, 0) \
+    X(0xA9, i32x4_extend_low_i16x8_u, UNARY, 0) \
+    X(0xAA, i32x4_extend_high_i16x8_u, UNARY, 0) \
+    X(0xAB, i32x4_shl, SHIFT, 0) \
+    X(0xAC, i32x4_shr_s, SHIFT, 0) \
+    X(0xAD, i32x4_shr_u, SHIFT, 0) \
+    X(0xAE, i32x4_add, BINARY, 0) \
+    X(0xB1, i32x4_sub, BINARY, 0) \
+    X(0xB5, i32x4_mul, BINARY, 0) \
+    X(0xB6, i32x4_min_s, BINARY, 0) \
+    X(0xB7, i32x4_min_u, BINARY, 0) \
+    X(0xB8, i32x4_max_s, BINARY, 0) \
+    X(0xB9, i32x4_max_u, BINARY, 0) \
+    X(0xBA, i32x4_dot_i16x8_s, BINARY, 0) \
+    X(0xBC, i32x4_extmul_low_i16x8_s, BINARY, 0) \
+    X(0xBD, i32x4_extmul_high_i16x8_s, BINARY, 0) \
+    X(0xBE, i32x4_extmul_low_i16x8_u, BINARY, 0) \
+    X(0xBF, i32x4_extmul_high_i16x8_u, BINARY, 0) \
+    X(0xC0, i64x2_abs, UNARY, 0) \
+    X(0xC1, i64x2_neg, UNARY, 0) \
+    X(0xC3, i64x2_all_true, TO_I32, 0) \
+    X(0xC4, i64x2_bitmask, TO_I32, 0) \
+    X(0xC7, i64x2_extend_low_i32x4_s, UNARY, 0) \
+    X(0xC8, i64x2_extend_high_i32x4_s, UNARY, 0) \
+    X(0xC9, i64x2_extend_low_i32x4_u, UNARY, 0) \
+    X(0xCA, i64x2_extend_high_i32x4_u, UNARY, 0) \
+    X(0xCB, i64x2_shl, SHIFT, 0) \
+    X(0xCC, i64x2_shr_s, SHIFT, 0) \
+    X(0xCD, i64x2_shr_u, SHIFT, 0) \
+    X(0xCE, i64x2_add, BINARY, 0) \
+    X(0xD1, i64x2_sub, BINARY, 0) \
+    X(0xD5, i64x2_mul, BINARY, 0) \
+    X(0xD6, i64x2_eq, BINARY, 0) \
+    X(0xD7, i64x2_ne, BINARY, 0) \
+    X(0xD8, i64x2_lt_s, BINARY, 0) \
+    X(0xD9, i64x2_gt_s, BINARY, 0) \
+    X(0xDA, i64x2_le_s, BINARY, 0) \
+    X(0xDB, i64x2_ge_s, BINARY, 0) \
+    X(0xDC, i64x2_extmul_low_i32x4_s, BINARY, 0) \
+    X(0xDD, i64x2_extmul_high_i32x4_s, BINARY, 0) \
+    X(0xDE, i64x2_extmul_low_i32x4_u, BINARY, 0) \
+    X(0xDF, i64x2_extmul_high_i32x4_u, BINARY, 0) \
+    X(0xE0, f32x4_abs, UNARY, 0) \
+    X(0xE1, f32x4_neg, UNARY, 0) \
+    X(0xE3, f32x4_sqrt, UNARY, 0) \
+    X(0xE4, f32x4_add, BINARY, 0) \
+    X(0xE5, f32x4_sub, BINARY, 0) \
+    X(0xE6, f32x4_mul, BINARY, 0) \
+    X(0xE7, f32x4_div, BINARY, 0) \
+    X(0xE8, f32x4_min, BINARY, 0) \
+    X(0xE9, f32x4_max, BINARY, 0) \
+    X(0xEA, f32x4_pmin, BINARY, 0) \
+    X(0xEB, f32x4_pmax, BINARY, 0) \
+    X(0xEC, f64x2_abs, UNARY, 0) \
+    X(0xED, f64x2_neg, UNARY, 0) \
+    X(0xEF, f64x2_sqrt, UNARY, 0) \
+    X(0xF0, f64x2_add, BINARY, 0) \
+    X(0xF1, f64x2_sub, BINARY, 0) \
+    X(0xF2, f64x2_mul, BINARY, 0) \
+    X(0xF3, f64x2_div, BINARY, 0) \
+    X(0xF4, f64x2_min, BINARY, 0) \
+    X(0xF5, f64x2_max, BINARY, 0) \
+    X(0xF6, f64x2_pmin, BINARY, 0) \
+    X(0xF7, f64x2_pmax, BINARY, 0) \
+    X(0xF8, i32x4_trunc_sat_f32x4_s, UNARY, 0) \
+    X(0xF9, i32x4_trunc_sat_f32x4_u, UNARY, 0) \
+    X(0xFA, f32x4_convert_i32x4_s, UNARY, 0) \
+    X(0xFB, f32x4_convert_i32x4_u, UNARY, 0) \
+    X(0xFC, i32x4_trunc_sat_f64x2_s_zero, UNARY, 0) \
+    X(0xFD, i32x4_trunc_sat_f64x2_u_zero, UNARY, 0) \
+    X(0xFE, f64x2_convert_low_i32x4_s, UNARY, 0) \
+    X(0xFF, f64x2_convert_low_i32x4_u, UNARY, 0)
+
+#define SIMD_DEFINE_HANDLER(opcode, name, kind, size) SIMD_HANDLER_##kind(name, size)
+SIMD_OPS(SIMD_DEFINE_HANDLER)
+
+#define SIMD_TABLE_ENTRY(opcode, name, kind, size) [opcode] = op_simd_##name,
+static const OpFn g_simd_ops[256] = {
+    SIMD_OPS(SIMD_TABLE_ENTRY)
+};
+
+// Handler for a SIMD opcode (the 0xFD-prefixed sub-opcode); opcodes the
+// validator rejects map to unreachable
+uint64_t simd_op(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_simd_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_simd_ops[opcode];
+}
+
+#define SIMD_DEFINE_MEM_HANDLER(opcode, name, kind, size) \
+    SIMD_MEMORY_HANDLER_##kind(name, size, _mem, MEMORYN)
+SIMD_MEMORY_OPS(SIMD_DEFINE_MEM_HANDLER)
+
+#define SIMD_MEM_TABLE_ENTRY(opcode, name, kind, size) [opcode] = op_simd_##name##_mem,
+static const OpFn g_simd_mem_ops[256] = {
+    SIMD_MEMORY_OPS(SIMD_MEM_TABLE_ENTRY)
+};
+
+// Handler for a SIMD memory opcode on a memory other than memory 0
+uint64_t simd_op_mem(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_simd_mem_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_simd_mem_ops[opcode];
+}
+
+#define SIMD_DEFINE_M64_HANDLER(opcode, name, kind, size) \
+    SIMD_MEMORY_HANDLER_##kind(name, size, _m64, MEMORY64)
+SIMD_MEMORY_OPS(SIMD_DEFINE_M64_HANDLER)
+
+#define SIMD_M64_TABLE_ENTRY(opcode, name, kind, size) [opcode] = op_simd_##name##_m64,
+static const OpFn g_simd_m64_ops[256] = {
+    SIMD_MEMORY_OPS(SIMD_M64_TABLE_ENTRY)
+};
+
+// Handler for a SIMD memory opcode on a memory64 memory
+uint64_t simd_op_m64(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_simd_m64_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_simd_m64_ops[opcode];
+}
+
+// ============================================================================
+// Atomic memory ops (0xFE prefix)
+// ============================================================================
+
+// Every atomic op has three immediates: atomic opcode, offset and flags.
+// The flags above bit 7 are the memory index
+#define ATOMIC_FLAG_SHARED 1  // The memory is a shared memory
+
+#define ATOMIC_PTR(M, type, addr) ((_Atomic type*)(M##_BASE + (size_t)(addr)))
+
+// Bounds first, then natural alignment
+#define CHECK_ATOMIC(M, addr, size) \
+    M##_CHECK(addr, size); \
+    if ((addr) & ((size) - 1)) { \
+        TRAP(TRAP_UNALIGNED_ATOMIC); \
+    }
+
+// Handlers are generated for memory 0 (M = MEMORY0) and, with the _mem
+// suffix, for the other memories of a multi-memory module (MEMORYN), and
+// with _m64 for memory64 memories (MEMORY64)
+#define ATOMIC_HANDLER_LOAD(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-1], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    sp[-1] = (uint64_t)atomic_load(ATOMIC_PTR(M, type, addr)); \
+    pc += 3; \
+    NEXT(); \
+}
+
+#define ATOMIC_HANDLER_STORE(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    atomic_store(ATOMIC_PTR(M, type, addr), (type)sp[-1]); \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// op is the C11 generic: fetch_add, fetch_sub, fetch_and, fetch_or,
+// fetch_xor or exchange. The result is the old value, zero-extended
+#define ATOMIC_HANDLER_RMW(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    sp[-2] = (uint64_t)atomic_##op(ATOMIC_PTR(M, type, addr), (type)sp[-1]); \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// The expected value is wrapped to the access width before comparing
+#define ATOMIC_HANDLER_CMPXCHG(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-3], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    type expected = (type)sp[-2]; \
+    atomic_compare_exchange_strong(ATOMIC_PTR(M, type, addr), &expected, (type)sp[-1]); \
+    sp[-3] = (uint64_t)expected; \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// memory.atomic.notify: [addr, count] -> [woken]. An unshared memory has
+// no waiters
+#define ATOMIC_HANDLER_NOTIFY(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-2], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    uint32_t woken = 0; \
+    if (pc[2] & ATOMIC_FLAG_SHARED) { \
+        woken = threads_notify(M##_BASE + (size_t)addr, (uint32_t)sp[-1]); \
+    } \
+    sp[-2] = (uint64_t)woken; \
+    sp--; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// memory.atomic.wait32/64: [addr, expected, timeout_ns] -> [0 ok,
+// 1 not-equal, 2 timed-out]; a negative timeout waits forever
+#define ATOMIC_HANDLER_WAIT(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)crt; (void)fp; \
+    M##_SELECT(pc[2] >> 8); \
+    uint64_t addr = M##_ADDR(sp[-3], pc[1]); \
+    CHECK_ATOMIC(M, addr, size); \
+    if (!(pc[2] & ATOMIC_FLAG_SHARED)) { \
+        TRAP(TRAP_EXPECTED_SHARED_MEMORY); \
+    } \
+    int64_t timeout = (int64_t)sp[-1]; \
+    sp[-3] = (uint64_t)op((const type*)(M##_BASE + (size_t)addr), (type)sp[-2], timeout); \
+    sp -= 2; \
+    pc += 3; \
+    NEXT(); \
+}
+
+// A fence touches no memory; its _mem and _m64 variants are plain fences
+#define ATOMIC_HANDLER_FENCE(name, op, type, size, variant, M) \
+static int op_atomic_##name##variant(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) { \
+    (void)fp; \
+    atomic_thread_fence(memory_order_seq_cst); \
+    pc += 3; \
+    NEXT(); \
+}
+
+// The seven widths of a read-modify-write op, from opcode base
+#define ATOMIC_RMW_OPS(X, base, name, kind, op) \
+    X(base + 0, i32_atomic_rmw_##name, kind, op, uint32_t, 4) \
+    X(base + 1, i64_atomic_rmw_##name, kind, op, uint64_t, 8) \
+    X(base + 2, i32_atomic_rmw8_##name##_u, kind, op, uint8_t, 1) \
+    X(base + 3, i32_atomic_rmw16_##name##_u, kind, op, uint16_t, 2) \
+    X(base + 4, i64_atomic_rmw8_##name##_u, kind, op, uint8_t, 1) \
+    X(base + 5, i64_atomic_rmw16_##name##_u, kind, op, uint16_t, 2) \
+    X(base + 6, i64_atomic_rmw32_##name##_u, kind, op, uint32_t, 4)
+
+// Every atomic instruction: X(opcode, name, handler kind, operation,
+// memory type, access size)
+#define ATOMIC_OPS(X) \
+    X(0x00, memory_atomic_notify, NOTIFY, -, uint32_t, 4) \
+    X(0x01, memory_atomic_wait32, WAIT, threads_wait32, uint32_t, 4) \
+    X(0x02, memory_atomic_wait64, WAIT, threads_wait64, uint64_t, 8) \
+    X(0x03, atomic_fence, FENCE, -, uint8_t, 0) \
+    X(0x10, i32_atomic_load, LOAD, -, uint32_t, 4) \
+    X(0x11, i64_atomic_load, LOAD, -, uint64_t, 8) \
+    X(0x12, i32_atomic_load8_u, LOAD, -, uint8_t, 1) \
+    X(0x13, i32_atomic_load16_u, LOAD, -, uint16_t, 2) \
+    X(0x14, i64_atomic_load8_u, LOAD, -, uint8_t, 1) \
+    X(0x15, i64_atomic_load16_u, LOAD, -, uint16_t, 2) \
+    X(0x16, i64_atomic_load32_u, LOAD, -, uint32_t, 4) \
+    X(0x17, i32_atomic_store, STORE, -, uint32_t, 4) \
+    X(0x18, i64_atomic_store, STORE, -, uint64_t, 8) \
+    X(0x19, i32_atomic_store8, STORE, -, uint8_t, 1) \
+    X(0x1A, i32_atomic_store16, STORE, -, uint16_t, 2) \
+    X(0x1B, i64_atomic_store8, STORE, -, uint8_t, 1) \
+    X(0x1C, i64_atomic_store16, STORE, -, uint16_t, 2) \
+    X(0x1D, i64_atomic_store32, STORE, -, uint32_t, 4) \
+    ATOMIC_RMW_OPS(X, 0x1E, add, RMW, fetch_add) \
+    ATOMIC_RMW_OPS(X, 0x25, sub, RMW, fetch_sub) \
+    ATOMIC_RMW_OPS(X, 0x2C, and, RMW, fetch_and) \
+    ATOMIC_RMW_OPS(X, 0x33, or, RMW, fetch_or) \
+    ATOMIC_RMW_OPS(X, 0x3A, xor, RMW, fetch_xor) \
+    ATOMIC_RMW_OPS(X, 0x41, xchg, RMW, exchange) \
+    ATOMIC_RMW_OPS(X, 0x48, cmpxchg, CMPXCHG, -)
+
+#define ATOMIC_DEFINE_HANDLER(opcode, name, kind, op, type, size) \
+    ATOMIC_HANDLER_##kind(name, op, type, size, , MEMORY0)
+ATOMIC_OPS(ATOMIC_DEFINE_HANDLER)
+
+#define ATOMIC_TABLE_ENTRY(opcode, name, kind, op, type, size) [opcode] = op_atomic_##name,
+static const OpFn g_atomic_ops[256] = {
+    ATOMIC_OPS(ATOMIC_TABLE_ENTRY)
+};
+
+// Handler for an atomic opcode (the 0xFE-prefixed sub-opcode); opcodes the
+// validator rejects map to unreachable
+uint64_t atomic_op(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_atomic_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_atomic_ops[opcode];
+}
+
+#define ATOMIC_DEFINE_MEM_HANDLER(opcode, name, kind, op, type, size) \
+    ATOMIC_HANDLER_##kind(name, op, type, size, _mem, MEMORYN)
+ATOMIC_OPS(ATOMIC_DEFINE_MEM_HANDLER)
+
+#define ATOMIC_MEM_TABLE_ENTRY(opcode, name, kind, op, type, size) [opcode] = op_atomic_##name##_mem,
+static const OpFn g_atomic_mem_ops[256] = {
+    ATOMIC_OPS(ATOMIC_MEM_TABLE_ENTRY)
+};
+
+// Handler for an atomic opcode on a memory other than memory 0
+uint64_t atomic_op_mem(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_atomic_mem_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_atomic_mem_ops[opcode];
+}
+
+#define ATOMIC_DEFINE_M64_HANDLER(opcode, name, kind, op, type, size) \
+    ATOMIC_HANDLER_##kind(name, op, type, size, _m64, MEMORY64)
+ATOMIC_OPS(ATOMIC_DEFINE_M64_HANDLER)
+
+#define ATOMIC_M64_TABLE_ENTRY(opcode, name, kind, op, type, size) [opcode] = op_atomic_##name##_m64,
+static const OpFn g_atomic_m64_ops[256] = {
+    ATOMIC_OPS(ATOMIC_M64_TABLE_ENTRY)
+};
+
+// Handler for an atomic opcode on a memory64 memory
+uint64_t atomic_op_m64(int opcode) {
+    if (opcode < 0 || opcode >= 256 || !g_atomic_m64_ops[opcode]) {
+        return (uint64_t)op_wasm_unreachable;
+    }
+    return (uint64_t)g_atomic_m64_ops[opcode];
+}
+
+// ============================================================================
+// Exception handling
+// ============================================================================
+//
+// try_table costs nothing until something throws: the compiler records each
+// try_table body as a pc-range scope in the module's handler table
+// (g_eh_table) and emits the catch landing pads out of line. A throw stores
+// the exception in g_exn and looks for a handler covering its own pc. With
+// none, it returns TRAP_EXCEPTION, and every call op on the way up the
+// native call chain tries its own call site (CALLEE_TRAP) before unwinding
+// further.
+
+// g_eh_table: [num_scopes, scopes..., clauses...]. Scopes are sorted by
+// end_pc, inner scopes before the scopes enclosing them
+#define EH_SCOPE_SIZE 5   // start_pc, end_pc, parent (-1 = none), first_clause, num_clauses
+#define EH_CLAUSE_SIZE 2  // tag (-1 = any), landing_pc
+
+// CatchPayload kinds (the binary encoding of the catch clause)
+#define EH_CATCH 0
+#define EH_CATCH_REF 1
+#define EH_CATCH_ALL_REF 3
+
+// An exnref is a GC struct of this type: [tag, values]
+#define EXN_TYPE_IDX UINT32_MAX
+#define EXN_HEADER_FIELDS 1
+
+// Values a thrown exception keeps inline; larger payloads are boxed at once
+#define EXN_INLINE_VALUES 32
+
+// The exception in flight on this thread. Its tag is the tag's identity,
+// which the runtime assigns per defining module and an importing module
+// shares (CompiledModule.tag_ids in MoonBit), so throws and catch clauses
+// carry it in place of the tag index. Values hold their low halves at
+// [0, n) and their v128 high halves at [n, 2n)
+typedef struct {
+    int tag;
+    int num_values;
+    uint64_t exnref;           // Boxed exception, REF_NULL until needed
+    const uint64_t* values;    // inline_values or the boxed exception's fields
+    uint64_t inline_values[2 * EXN_INLINE_VALUES];
+} ExnState;
+
+static THREAD_LOCAL ExnState g_exn;
+
+// Box the exception in flight, values lo[0..n) and hi[0..n), as an exnref.
+// Returns REF_NULL if the allocation fails
+static uint64_t exn_box(const uint64_t* lo, const uint64_t* hi, int n) {
+    GcStruct* st = gc_alloc_struct(EXN_TYPE_IDX, EXN_HEADER_FIELDS + 2 * n);
+    if (!st) {
+        return REF_NULL;
+    }
+    st->fields[0] = (uint64_t)(uint32_t)g_exn.tag;
+    uint64_t* values = st->fields + EXN_HEADER_FIELDS;
+    for (int i = 0; i < n; i++) {
+        values[i] = lo[i];
+        values[n + i] = hi ? hi[i] : 0;
+    }
+    g_exn.exnref = (uint64_t)(uintptr_t)st;
+    g_exn.values = values;
+    return g_exn.exnref;
+}
+
+// Landing pad of the innermost handler for the exception in flight thrown
+// at code index `at`, or -1 if this module has none
+static int exn_find_handler(int at) {
+    const int* table = g_eh_table;
+    if (!table || table[0] == 0) {
+        return -1;
+    }
+    int num_scopes = table[0];
+    const int* scopes = table + 1;
+    const int* clauses = scopes + num_scopes * EH_SCOPE_SIZE;
+
+    // The first scope ending after `at` is the innermost one containing it
+    // or nested inside that one, so the parent chain reaches every scope
+    // containing `at`, innermost first
+    int lo = 0;
+    int hi = num_scopes;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (scopes[mid * EH_SCOPE_SIZE + 1] > at) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    for (int s = lo; s >= 0 && s < num_scopes; s = scopes[s * EH_SCOPE_SIZE + 2]) {
+        const int* scope = scopes + s * EH_SCOPE_SIZE;
+        if (scope[0] > at) {
+            continue;
+        }
+        const int* clause = clauses + scope[3] * EH_CLAUSE_SIZE;
+        for (int c = 0; c < scope[4]; c++, clause += EH_CLAUSE_SIZE) {
+            if (clause[0] < 0 || clause[0] == g_exn.tag) {
+                return clause[1];
+            }
+        }
+    }
+    return -1;
+}
+
+// Continue at the handler for the exception in flight, where pc - 1 is the
+// code index of the throw or call that raised it; without one, unwind
+static int exn_dispatch(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int landing = exn_find_handler((int)(pc - 1 - crt->code));
+    if (landing < 0) {
+        return TRAP_EXCEPTION;
+    }
+    pc = crt->code + landing;
+    NEXT();
+}
+
+// Make the exception of tag with values[0..n) (v128 high halves V128_HI
+// slots above) the one in flight
+static int exn_raise(int tag, const uint64_t* values, int n) {
+    g_exn.tag = tag;
+    g_exn.num_values = n;
+    g_exn.exnref = REF_NULL;
+    const uint64_t* hi = g_uses_v128 ? values + V128_HI : NULL;
+    if (n <= EXN_INLINE_VALUES) {
+        for (int i = 0; i < n; i++) {
+            g_exn.inline_values[i] = values[i];
+            g_exn.inline_values[n + i] = hi ? hi[i] : 0;
+        }
+        g_exn.values = g_exn.inline_values;
+    } else if (exn_box(values, hi, n) == REF_NULL) {
+        return TRAP_STACK_OVERFLOW;
+    }
+    return TRAP_NONE;
+}
+
+// throw: immediates tag, first_slot, num_values
+int op_wasm_throw(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    int trap = exn_raise((int)pc[0], fp + pc[1], (int)pc[2]);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    MUSTTAIL return exn_dispatch(crt, pc, sp, fp);
+}
+DEFINE_OP(wasm_throw)
+
+// throw_ref: immediate slot (the exnref); rethrows the same exception
+int op_throw_ref(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t ref = fp[pc[0]];
+    if (ref == REF_NULL) {
+        TRAP(TRAP_NULL_REFERENCE);
+    }
+    GcStruct* st = (GcStruct*)(uintptr_t)ref;
+    g_exn.tag = (int)(uint32_t)st->fields[0];
+    g_exn.num_values = (st->field_count - EXN_HEADER_FIELDS) / 2;
+    g_exn.exnref = ref;
+    g_exn.values = st->fields + EXN_HEADER_FIELDS;
+    MUSTTAIL return exn_dispatch(crt, pc, sp, fp);
+}
+DEFINE_OP(throw_ref)
+
+// Landing pad entry: store the caught exception from base_slot on.
+// Immediates: base_slot, kind (EH_CATCH: its values; EH_CATCH_REF: its
+// values, then the exnref; EH_CATCH_ALL_REF: the exnref)
+int op_catch_payload(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* dst = fp + pc[0];
+    int kind = (int)pc[1];
+    pc += 2;
+    int n = 0;
+    if (kind != EH_CATCH_ALL_REF) {
+        n = g_exn.num_values;
+        for (int i = 0; i < n; i++) {
+            dst[i] = g_exn.values[i];
+            if (g_uses_v128) {
+                dst[i + V128_HI] = g_exn.values[n + i];
+            }
+        }
+    }
+    if (kind != EH_CATCH) {
+        uint64_t ref = g_exn.exnref;
+        if (ref == REF_NULL) {
+            // The inline values may hold the only references to GC objects
+            int num_values = g_exn.num_values;
+            gc_push_stack(g_exn.inline_values, (size_t)num_values);
+            ref = exn_box(g_exn.inline_values, g_exn.inline_values + num_values, num_values);
+            gc_pop_stack();
+            if (ref == REF_NULL) {
+                TRAP(TRAP_STACK_OVERFLOW);
+            }
+        }
+        dst[n] = ref;
+        if (g_uses_v128) {
+            dst[n + V128_HI] = 0;
+        }
+    }
+    NEXT();
+}
+DEFINE_OP(catch_payload)
+
+// ============================================================================
+// Stack switching
+// ============================================================================
+//
+// A continuation owns a value stack of its own. Wasm code running in it
+// still nests native run() calls, one per wasm call, but a suspension never
+// keeps them: suspend saves its frame's (pc, sp, fp) in the continuation
+// and returns TRAP_SUSPEND, and every call op on the way up to the handling
+// resume saves its own frame the same way (CALLEE_TRAP). Resuming re-enters
+// the saved frames innermost first from cont_run, one native run() at a
+// time, so the native stack never grows with the number of live
+// continuations or with the depth of a suspended one.
+//
+// cont.bind moves the continuation to a new handle with some of its values
+// already delivered; resume_throw raises an exception in it where it
+// stopped, unwinding its saved frames through their handlers.
+//
+// A resume whose continuation suspends to an outer handler is itself
+// suspended: its frame keeps the inner continuation as `child`, which is
+// resumed again when the outer continuation reaches that frame.
+//
+// Handles are the Cont pointer with a generation in bits 48-60, so resuming
+// a continuation twice (or one that has finished) traps instead of running
+// a recycled one. Finished continuations go back to a per-thread pool with
+// their stacks. The collector never runs (disable_collect), so continuation
+// stacks are not registered as roots.
+
+#define CONT_FRESH     0  // Created by cont.new, not started
+#define CONT_SUSPENDED 1  // Waiting to be resumed
+#define CONT_RUNNING   2  // Resumed (or consumed)
+#define CONT_FREE      3  // In the pool
+
+#define CONT_GEN_SHIFT 48
+#define CONT_GEN_MASK  0x1FFFULL
+#define CONT_PTR_MASK  ((1ULL << CONT_GEN_SHIFT) - 1)
+
+// A wasm frame unwound by a suspension. child is set for a frame stopped in
+// a resume of that (suspended) continuation
+typedef struct {
+    uint64_t* pc;  // Past the immediates of the suspending op
+    uint64_t* sp;
+    uint64_t* fp;
+    Cont* child;
+} ContFrame;
+
+struct Cont {
+    uint64_t* stack;        // Kept while pooled
+    int v128;               // stack has room for v128 high halves
+    ContFrame* frames;      // Suspended frames, innermost last
+    int num_frames;
+    int cap_frames;
+    int entry_pc;           // Code index of the function while fresh, else -1
+    int num_bound;          // Values cont.bind delivered ahead of the rest
+    int state;              // CONT_*
+    uint32_t gen;
+    uint64_t* resume_dst;   // Where resume delivers its values
+    Cont* next_free;
+};
+
+// One resume in progress, on the native stack of op_resume or cont_run
+struct ResumeRecord {
+    const int* handlers;   // [num_handlers, (tag, landing_pc)*]; landing -1 = switch
+    Cont* cont;            // The continuation it is running
+    int context_depth;     // Suspensions never cross a module boundary
+    ResumeRecord* parent;
+};
+
+// The suspension in flight, from suspend or switch to its resume
+typedef struct {
+    ResumeRecord* record;  // The resume handling it
+    int landing;           // Landing pad of a suspend handler, -1 for switch
+    const uint64_t* values;
+    int num_values;
+    uint64_t* resume_dst;  // Where the suspended code takes its results
+    Cont* target;          // switch: the continuation to run next
+    uint64_t cont_ref;     // The suspended continuation, for the landing pad
+} SuspendState;
+
+static THREAD_LOCAL SuspendState g_suspend;
+static THREAD_LOCAL Cont* g_cont_pool = NULL;
+
+// A continuation whose stack has room for v128 high halves if v128 is set
+static Cont* cont_alloc(int v128) {
+    Cont* c = g_cont_pool;
+    if (c) {
+        g_cont_pool = c->next_free;
+        if (v128 && !c->v128) {
+            uint64_t* stack = stack_alloc(1);
+            if (!stack) {
+                c->next_free = g_cont_pool;
+                g_cont_pool = c;
+                return NULL;
+            }
+            free(c->stack);
+            c->stack = stack;
+            c->v128 = 1;
+        }
+    } else {
+        c = (Cont*)calloc(1, sizeof(Cont));
+        if (!c) {
+            return NULL;
+        }
+        c->stack = stack_alloc(v128);
+        if (!c->stack) {
+            free(c);
+            return NULL;
+        }
+        c->v128 = v128;
+    }
+    c->num_frames = 0;
+    c->num_bound = 0;
+    c->state = CONT_FRESH;
+    return c;
+}
+
+// Return c and any suspended continuations it holds to the pool
+static void cont_free(Cont* c) {
+    for (int i = 0; i < c->num_frames; i++) {
+        if (c->frames[i].child) {
+            cont_free(c->frames[i].child);
+        }
+    }
+    c->num_frames = 0;
+    c->state = CONT_FREE;
+    c->next_free = g_cont_pool;
+    g_cont_pool = c;
+}
+
+static uint64_t cont_ref(const Cont* c) {
+    return (uint64_t)(uintptr_t)c | ((c->gen & CONT_GEN_MASK) << CONT_GEN_SHIFT);
+}
+
+// Consume the continuation a handle refers to
+static int cont_take(uint64_t ref, Cont** out) {
+    if (ref == REF_NULL) {
+        return TRAP_NULL_REFERENCE;
+    }
+    Cont* c = (Cont*)(uintptr_t)(ref & CONT_PTR_MASK);
+    if ((ref >> CONT_GEN_SHIFT) != (c->gen & CONT_GEN_MASK) ||
+        (c->state != CONT_FRESH && c->state != CONT_SUSPENDED)) {
+        return TRAP_CONT_CONSUMED;
+    }
+    c->gen++;
+    c->state = CONT_RUNNING;
+    *out = c;
+    return TRAP_NONE;
+}
+
+// Pass n values (v128 high halves V128_HI slots above) to c, after any it
+// was bound to: the arguments of a fresh continuation or the results of its
+// suspend. Returns the slot past the last one
+static uint64_t* cont_deliver(Cont* c, const uint64_t* values, int n) {
+    uint64_t* dst = (c->entry_pc >= 0 ? c->stack : c->resume_dst) + c->num_bound;
+    c->num_bound += n;
+    for (int i = 0; i < n; i++) {
+        dst[i] = values[i];
+        if (g_uses_v128) {
+            dst[i + V128_HI] = values[i + V128_HI];
+        }
+    }
+    return dst + n;
+}
+
+// Save a frame unwound by a suspension in the running continuation
+static int cont_save_frame(uint64_t* pc, uint64_t* sp, uint64_t* fp, Cont* child) {
+    Cont* c = g_resume_top->cont;
+    if (c->num_frames == c->cap_frames) {
+        int cap = c->cap_frames ? 2 * c->cap_frames : 8;
+        ContFrame* frames = (ContFrame*)realloc(c->frames, (size_t)cap * sizeof(ContFrame));
+        if (!frames) {
+            return TRAP_STACK_OVERFLOW;
+        }
+        c->frames = frames;
+        c->cap_frames = cap;
+    }
+    ContFrame* f = &c->frames[c->num_frames++];
+    f->pc = pc;
+    f->sp = sp;
+    f->fp = fp;
+    f->child = child;
+    return TRAP_SUSPEND;
+}
+
+// Landing pad (or -1 for a switch handler) of the innermost resume handling
+// tag, setting *record; -2 if there is none in this module
+static int cont_find_handler(int tag, int is_switch, ResumeRecord** record) {
+    for (ResumeRecord* r = g_resume_top;
+         r && r->context_depth == g_context_depth; r = r->parent) {
+        const int* h = r->handlers;
+        for (int i = 0; i < h[0]; i++) {
+            int landing = h[2 + 2 * i];
+            if (h[1 + 2 * i] == tag && (landing < 0) == is_switch) {
+                *record = r;
+                return landing;
+            }
+        }
+    }
+    return -2;
+}
+
+static int cont_resume(CRuntime* crt, Cont* c, uint64_t* pc, uint64_t* sp,
+                       uint64_t* fp, uint64_t** next_pc, int trap);
+
+// Run c until it returns, suspends or traps. With trap TRAP_EXCEPTION, c
+// starts by unwinding the exception in flight instead
+static int cont_run(CRuntime* crt, Cont* c, int trap) {
+    int base = 0;
+    c->num_bound = 0;
+    if (c->entry_pc >= 0) {
+        uint64_t* entry = crt->code + c->entry_pc;
+        c->entry_pc = -1;
+        if (trap == TRAP_NONE) {
+            trap = run(crt, entry, c->stack, c->stack);
+        }
+    }
+    while (c->num_frames > 0 && (trap == TRAP_NONE || trap == TRAP_EXCEPTION)) {
+        ContFrame f = c->frames[--c->num_frames];
+        base = c->num_frames;
+        if (trap == TRAP_EXCEPTION) {
+            // The frame's own handlers get the exception first
+            if (f.child) {
+                cont_free(f.child);
+            }
+            int landing = exn_find_handler((int)(f.pc - 1 - crt->code));
+            if (landing >= 0) {
+                trap = run(crt, crt->code + landing, f.sp, f.fp);
+            }
+        } else if (f.child) {
+            uint64_t* next_pc;
+            trap = cont_resume(crt, f.child, f.pc, f.sp, f.fp, &next_pc, TRAP_NONE);
+            if (trap == TRAP_EXCEPTION) {
+                int landing = exn_find_handler((int)(f.pc - 1 - crt->code));
+                if (landing >= 0) {
+                    next_pc = crt->code + landing;
+                    trap = TRAP_NONE;
+                }
+            }
+            if (trap == TRAP_NONE) {
+                trap = run(crt, next_pc, f.sp, f.fp);
+            }
+        } else {
+            trap = run(crt, f.pc, f.sp, f.fp);
+        }
+    }
+    if (trap == TRAP_SUSPEND) {
+        // Frames were saved innermost first; resume pops the innermost
+        for (int lo = base, hi = c->num_frames - 1; lo < hi; lo++, hi--) {
+            ContFrame t = c->frames[lo];
+            c->frames[lo] = c->frames[hi];
+            c->frames[hi] = t;
+        }
+    }
+    return trap;
+}
+
+// Run c, which has its values, under the handlers of the resume whose
+// immediates end at pc, starting with trap as cont_run does; on TRAP_NONE
+// continue at *next_pc (past the resume once c returns, or a handler's
+// landing pad)
+static int cont_resume(CRuntime* crt, Cont* c, uint64_t* pc, uint64_t* sp,
+                       uint64_t* fp, uint64_t** next_pc, int trap) {
+    ResumeRecord rec;
+    rec.handlers = g_eh_table + pc[-1];
+    rec.cont = c;
+    rec.context_depth = g_context_depth;
+    rec.parent = g_resume_top;
+    g_resume_top = &rec;
+    for (;;) {
+        trap = cont_run(crt, c, trap);
+        if (trap == TRAP_NONE) {
+            int num_results = (int)pc[-2];
+            uint64_t* dst = fp + pc[-4];
+            for (int i = 0; i < num_results; i++) {
+                dst[i] = c->stack[i];
+                if (g_uses_v128) {
+                    dst[i + V128_HI] = c->stack[i + V128_HI];
+                }
+            }
+            g_resume_top = rec.parent;
+            cont_free(c);
+            *next_pc = pc;
+            return TRAP_NONE;
+        }
+        if (trap != TRAP_SUSPEND) {
+            g_resume_top = rec.parent;
+            cont_free(c);
+            return trap;
+        }
+        if (g_suspend.record != &rec) {
+            // An outer resume handles it: this frame suspends with c inside
+            g_resume_top = rec.parent;
+            return cont_save_frame(pc, sp, fp, c);
+        }
+        c->state = CONT_SUSPENDED;
+        c->resume_dst = g_suspend.resume_dst;
+        if (g_suspend.landing >= 0) {
+            g_resume_top = rec.parent;
+            g_suspend.cont_ref = cont_ref(c);
+            *next_pc = crt->code + g_suspend.landing;
+            return TRAP_NONE;
+        }
+        // switch: the target takes the values and c, and runs in c's place
+        Cont* target = g_suspend.target;
+        int n = g_suspend.num_values;
+        uint64_t* dst = cont_deliver(target, g_suspend.values, n);
+        dst[0] = cont_ref(c);
+        if (g_uses_v128) {
+            dst[V128_HI] = 0;
+        }
+        c = target;
+        rec.cont = c;
+        trap = TRAP_NONE;
+    }
+}
+
+// cont.new: immediate slot (the funcref, replaced by the continuation)
+int op_cont_new(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* slot = fp + *pc++;
+    uint64_t ref = *slot;
+    if (ref == REF_NULL) {
+        TRAP(TRAP_NULL_FUNCTION_REFERENCE);
+    }
+    int func_idx = (int)(ref & 0x3FFFFFFFFFFFFFFFULL);
+    int local_idx = func_idx - g_num_imported_funcs;
+    if (local_idx < 0 || local_idx >= g_num_funcs) {
+        // Imported and other modules' functions cannot be suspended
+        TRAP(TRAP_UNREACHABLE);
+    }
+    Cont* c = cont_alloc(g_uses_v128);
+    if (!c) {
+        TRAP(TRAP_STACK_OVERFLOW);
+    }
+    c->entry_pc = g_func_entries[local_idx];
+    *slot = cont_ref(c);
+    NEXT();
+}
+DEFINE_OP(cont_new)
+
+// resume: immediates first_slot, num_args, num_results, handlers (the
+// eh_table index of the handler list); the continuation follows the args
+int op_resume(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* args = fp + pc[0];
+    int num_args = (int)pc[1];
+    Cont* c;
+    int trap = cont_take(args[num_args], &c);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    cont_deliver(c, args, num_args);
+    pc += 4;
+    uint64_t* next_pc;
+    trap = cont_resume(crt, c, pc, sp, fp, &next_pc, TRAP_NONE);
+    if (trap == TRAP_NONE) {
+        pc = next_pc;
+        NEXT();
+    }
+    if (trap == TRAP_SUSPEND) {
+        return trap;  // This frame is saved as c's parent frame
+    }
+    CALLEE_TRAP(trap);
+}
+DEFINE_OP(resume)
+
+// cont.bind: immediates first_slot, num_bound; the continuation follows
+// the values and is replaced by a new handle to it
+int op_cont_bind(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* args = fp + pc[0];
+    int n = (int)pc[1];
+    pc += 2;
+    Cont* c;
+    int trap = cont_take(args[n], &c);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    cont_deliver(c, args, n);
+    c->state = c->entry_pc >= 0 ? CONT_FRESH : CONT_SUSPENDED;
+    args[0] = cont_ref(c);
+    if (g_uses_v128) {
+        args[V128_HI] = 0;
+    }
+    NEXT();
+}
+DEFINE_OP(cont_bind)
+
+// resume_throw: immediates tag, first_slot, num_args, num_results, handlers;
+// the continuation follows the exception's values and runs only to unwind
+// it from where it stopped
+int op_resume_throw(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* args = fp + pc[1];
+    int num_args = (int)pc[2];
+    Cont* c;
+    int trap = cont_take(args[num_args], &c);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    trap = exn_raise((int)pc[0], args, num_args);
+    if (trap != TRAP_NONE) {
+        cont_free(c);
+        TRAP(trap);
+    }
+    pc += 5;
+    uint64_t* next_pc;
+    trap = cont_resume(crt, c, pc, sp, fp, &next_pc, TRAP_EXCEPTION);
+    if (trap == TRAP_NONE) {
+        pc = next_pc;
+        NEXT();
+    }
+    if (trap == TRAP_SUSPEND) {
+        return trap;
+    }
+    CALLEE_TRAP(trap);
+}
+DEFINE_OP(resume_throw)
+
+// suspend: immediates tag_idx, first_slot, num_args, num_results. The
+// results replace the args when the continuation is resumed
+int op_suspend(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt;
+    ResumeRecord* record;
+    int landing = cont_find_handler((int)pc[0], 0, &record);
+    if (landing < -1) {
+        TRAP(TRAP_UNHANDLED_TAG);
+    }
+    uint64_t* values = fp + pc[1];
+    g_suspend.record = record;
+    g_suspend.landing = landing;
+    g_suspend.values = values;
+    g_suspend.num_values = (int)pc[2];
+    g_suspend.resume_dst = values;
+    g_suspend.target = NULL;
+    return cont_save_frame(pc + 4, sp, fp, NULL);
+}
+DEFINE_OP(suspend)
+
+// switch: immediates tag_idx, first_slot, num_args, num_results; the target
+// continuation follows the args and takes them plus the suspended one
+int op_wasm_switch(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    (void)crt;
+    ResumeRecord* record;
+    if (cont_find_handler((int)pc[0], 1, &record) != -1) {
+        TRAP(TRAP_UNHANDLED_TAG);
+    }
+    uint64_t* values = fp + pc[1];
+    int n = (int)pc[2];
+    Cont* target;
+    int trap = cont_take(values[n], &target);
+    if (trap != TRAP_NONE) {
+        TRAP(trap);
+    }
+    g_suspend.record = record;
+    g_suspend.landing = -1;
+    g_suspend.values = values;
+    g_suspend.num_values = n;
+    g_suspend.resume_dst = values;
+    g_suspend.target = target;
+    return cont_save_frame(pc + 4, sp, fp, NULL);
+}
+DEFINE_OP(wasm_switch)
+
+// Landing pad entry of a resume handler: store the suspension's values and
+// the suspended continuation from base_slot on. Immediate: base_slot
+int op_suspend_payload(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    uint64_t* dst = fp + *pc++;
+    int n = g_suspend.num_values;
+    const uint64_t* values = g_suspend.values;
+    for (int i = 0; i < n; i++) {
+        dst[i] = values[i];
+        if (g_uses_v128) {
+            dst[i + V128_HI] = values[i + V128_HI];
+        }
+    }
+    dst[n] = g_suspend.cont_ref;
+    if (g_uses_v128) {
+        dst[n + V128_HI] = 0;
+    }
+    NEXT();
+}
+DEFINE_OP(suspend_payload)
+
+// ============================================================================
+// Async invocations
+// ============================================================================
+//
+// An invocation is an export call that may wait on the host. It runs in a
+// continuation under a root resume record without handlers; a host function
+// returning HOST_FUNC_PENDING suspends to that record, so its frames are
+// saved exactly as for a suspend (including those of continuations resumed
+// inside the call) and the native stack unwinds back to invocation_run.
+// The next invocation_run stores the host results in the call's frame and
+// re-enters the saved frames. An epoch check past the end of the time slice
+// suspends the same way, with no host call to wait for.
+
+#define INVOCATION_READY   0  // Not started, or given its host results
+#define INVOCATION_WAITING 1  // Waiting on a host function
+#define INVOCATION_DONE    2
+
+struct Invocation {
+    CRuntimeContext* ctx;
+    Cont* cont;              // The call's stack and suspended frames
+    ResumeRecord root;       // Pending host functions suspend to this
+    int state;               // INVOCATION_*
+    int pending_host;        // Host function index while waiting
+    uint64_t* pending_args;  // Its args, which its results replace
+    uint64_t slice;          // Epochs per time slice, 0 = no limit
+    int stdin_fd;            // Host fds serving WASI stdin and stdout, or -1
+    int stdout_fd;
+};
+
+// Global epoch, advanced by the embedder (epoch_increment); code compiled
+// with epoch checks yields once it reaches the running slice's deadline
+static _Atomic uint64_t g_epoch = 0;
+static THREAD_LOCAL uint64_t g_epoch_deadline = UINT64_MAX;
+
+static const int g_no_handlers[1] = {0};
+
+// Suspend the running invocation at a frame that continues at pc with sp.
+// Returns TRAP_NONE if there is no invocation to suspend here
+static int invocation_suspend(uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    Invocation* inv = g_invocation;
+    if (!inv || inv->root.context_depth != g_context_depth) {
+        // Not an invocation, or inside a call into another module
+        return TRAP_NONE;
+    }
+    g_suspend.record = &inv->root;
+    g_suspend.landing = -1;
+    g_suspend.values = sp;
+    g_suspend.num_values = 0;
+    g_suspend.resume_dst = sp;
+    g_suspend.target = NULL;
+    return cont_save_frame(pc, sp, fp, NULL);
+}
+
+// A native host function is pending: suspend the running invocation. args
+// are its argument slots, and the frame continues at pc with sp once the
+// results are stored over them
+static int host_pending(int host_idx, uint64_t* args, uint64_t* pc,
+                        uint64_t* sp, uint64_t* fp) {
+    int trap = invocation_suspend(pc, sp, fp);
+    if (trap == TRAP_NONE) {
+        return TRAP_HOST_FUNCTION;
+    }
+    g_invocation->pending_host = host_idx;
+    g_invocation->pending_args = args;
+    return trap;
+}
+
+// Epoch check at function entry and loop headers of code compiled for time
+// slicing: yield the running invocation once its slice is over
+int op_epoch_check(CRuntime* crt, uint64_t* pc, uint64_t* sp, uint64_t* fp) {
+    if (atomic_load_explicit(&g_epoch, memory_order_relaxed) >= g_epoch_deadline) {
+        int trap = invocation_suspend(pc, sp, fp);
+        if (trap != TRAP_NONE) {
+            return trap;
+        }
+    }
+    NEXT();
+}
+DEFINE_OP(epoch_check)
+
+uint64_t epoch_increment(void) {
+    return atomic_fetch_add_explicit(&g_epoch, 1, memory_order_relaxed) + 1;
+}
+
+int64_t invocation_new(int64_t ctx_ptr, int func_idx, const uint64_t* args,
+                       int num_args) {
+    CRuntimeContext* ctx = (CRuntimeContext*)(uintptr_t)ctx_ptr;
+    Invocation* inv = (Invocation*)calloc(1, sizeof(Invocation));
+    Cont* c = inv ? cont_alloc(ctx->uses_v128) : NULL;
+    if (!c) {
+        free(inv);
+        return 0;
+    }
+    c->entry_pc = ctx->func_entries[func_idx];
+    c->state = CONT_RUNNING;
+    for (int i = 0; i < num_args; i++) {
+        c->stack[i] = args[i];
+        if (ctx->uses_v128) {
+            c->stack[i + V128_HI] = 0;
+        }
+    }
+    inv->ctx = ctx;
+    inv->cont = c;
+    inv->root.handlers = g_no_handlers;
+    inv->root.cont = c;
+    inv->state = INVOCATION_READY;
+    inv->pending_host = -1;
+    inv->stdin_fd = -1;
+    inv->stdout_fd = -1;
+    return (int64_t)(uintptr_t)inv;
+}
+
+int invocation_run(int64_t inv_ptr, const uint64_t* results, int num_results) {
+    Invocation* inv = (Invocation*)(uintptr_t)inv_ptr;
+    if (inv->state == INVOCATION_DONE) {
+        return TRAP_UNREACHABLE;
+    }
+    if (inv->state == INVOCATION_WAITING) {
+        int n = inv->pending_host >= 0 ? g_host_funcs[inv->pending_host].num_results : 0;
+        for (int i = 0; i < n; i++) {
+            inv->pending_args[i] = i < num_results ? results[i] : 0;
+        }
+        inv->pending_host = -1;
+        inv->state = INVOCATION_READY;
+    }
+
+    // Run on the instance's state; the call is a boundary no suspension in
+    // it may cross, like a host call
+    CRuntime crt = {0};
+    WasiFdTable* prev_fds = wasi_fd_table_current();
+    load_context(inv->ctx, &crt);
+    Invocation* saved_inv = g_invocation;
+    ResumeRecord* saved_resume_top = g_resume_top;
+    uint64_t saved_deadline = g_epoch_deadline;
+    int saved_stdin = wasi_stdio_host_fd(0);
+    int saved_stdout = wasi_stdio_host_fd(1);
+    if (inv->stdin_fd >= 0 || inv->stdout_fd >= 0) {
+        wasi_set_stdio_host_fds(inv->stdin_fd, inv->stdout_fd);
+    }
+    inv->root.context_depth = g_context_depth;
+    inv->root.parent = NULL;
+    g_resume_top = &inv->root;
+    g_invocation = inv;
+    g_epoch_deadline = inv->slice
+        ? atomic_load_explicit(&g_epoch, memory_order_relaxed) + inv->slice
+        : UINT64_MAX;
+    gc_push_stack(inv->cont->stack, STACK_SIZE);
+    int trap = cont_run(&crt, inv->cont, TRAP_NONE);
+    gc_pop_stack();
+    g_epoch_deadline = saved_deadline;
+    wasi_set_stdio_host_fds(saved_stdin, saved_stdout);
+    g_invocation = saved_inv;
+    g_resume_top = saved_resume_top;
+    wasi_fd_table_activate(prev_fds);
+
+    if (trap == TRAP_SUSPEND) {
+        if (inv->pending_host < 0) {
+            return INVOCATION_YIELDED;
+        }
+        inv->state = INVOCATION_WAITING;
+        return INVOCATION_PENDING;
+    }
+    inv->state = INVOCATION_DONE;
+    return trap;
+}
+
+void invocation_set_slice(int64_t inv_ptr, uint64_t epochs) {
+    ((Invocation*)(uintptr_t)inv_ptr)->slice = epochs;
+}
+
+void invocation_set_stdio(int64_t inv_ptr, int stdin_fd, int stdout_fd) {
+    Invocation* inv = (Invocation*)(uintptr_t)inv_ptr;
+    inv->stdin_fd = stdin_fd;
+    inv->stdout_fd = stdout_fd;
+}
+
+int64_t invocation_current(void) {
+    return (int64_t)(uintptr_t)g_invocation;
+}
+
+int invocation_pending_host(int64_t inv_ptr, uint64_t* args, int num_args) {
+    Invocation* inv = (Invocation*)(uintptr_t)inv_ptr;
+    if (inv->state != INVOCATION_WAITING) {
+        return -1;
+    }
+    int n = g_host_funcs[inv->pending_host].num_params;
+    for (int i = 0; i < n && i < num_args; i++) {
+        args[i] = inv->pending_args[i];
+    }
+    return inv->pending_host;
+}
+
+void invocation_results(int64_t inv_ptr, uint64_t* results, int num_results) {
+    Invocation* inv = (Invocation*)(uintptr_t)inv_ptr;
+    for (int i = 0; i < num_results; i++) {
+        results[i] = inv->cont->stack[i];
+    }
+}
+
+void invocation_free(int64_t inv_ptr) {
+    Invocation* inv = (Invocation*)(uintptr_t)inv_ptr;
+    if (!inv) {
+        return;
+    }
+    cont_free(inv->cont);
+    free(inv);
+}
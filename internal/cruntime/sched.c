@@ -0,0 +1,673 @@
+// Work-stealing scheduler for wasm5
+//
+// Each task is an invocation (see Async invocations in op.c): an export call
+// with a wasm stack of its own, so it can stop at an epoch check or a
+// pending host call and continue later on any worker.
+//
+// Every worker owns a Chase-Lev deque of tasks: it pushes and pops at the
+// bottom, and idle workers steal from the top. New tasks, tasks that used up
+// their time slice and resumed host calls go to a shared FIFO injector;
+// workers move them to their deques in batches, and look at the injector
+// every SCHED_INJECT_INTERVAL tasks even when busy so nothing waiting there
+// starves. Idle workers park on a futex word (threads_wait32) after
+// announcing themselves in num_sleeping, so a producer that queues work
+// wakes one only when someone sleeps.
+//
+// Time slices come from the global epoch: a ticker thread advances it every
+// slice_us, and each run of a task may last until the next tick.
+
+#include "sched.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "threads.h"
+#include "wasi.h"
+
+#define SCHED_DEQUE_SIZE      1024  // Power of two
+#define SCHED_INJECT_BATCH    32    // Tasks a worker takes from the injector at once
+#define SCHED_INJECT_INTERVAL 61    // Tasks run between injector checks
+
+// Task states around a pending host call
+#define TASK_RUNNING 0
+#define TASK_PARKED  1  // Waiting for sched_task_resume
+#define TASK_RESUMED 2  // Results arrived while still running
+
+#define SCHED_TRAP_EXIT 13  // TRAP_WASI_EXIT: the guest called proc_exit
+
+typedef struct Sched Sched;
+typedef struct SchedTask SchedTask;
+
+typedef struct {
+    int64_t* contexts;
+    _Atomic int* busy;
+    int size;
+    _Atomic unsigned next;          // Where the search for a free instance starts
+    _Atomic(SchedTask*) waiting;    // Tasks that found no free instance
+    int64_t* snapshots;             // Initial state of each instance, or NULL
+} SchedPool;
+
+struct SchedTask {
+    Sched* sched;
+    SchedPool* pool;
+    int want;                       // Instance the task is bound to, or -1
+    int instance;                   // Instance it runs on, -1 before it starts
+    int func_idx;
+    int num_args;                   // Per row
+    int num_results;                // Per row
+    int num_rows;                   // Calls the task makes, one after another
+    int rows_done;
+    int64_t inv;
+    int trap;
+    int stdin_fd;                   // Host fds for WASI stdin and stdout, or -1
+    int stdout_fd;
+    int fresh;                      // Start from the instance's snapshot
+    int exit_code;                  // proc_exit code, if the guest exited
+    _Atomic int state;              // TASK_*
+    _Atomic uint32_t done;
+    uint64_t host_results[HOST_FUNC_MAX_RESULTS];
+    int num_host_results;
+    SchedTask* next;                // Injector or pool waiting list link
+    uint64_t slots[];               // Args of every row, then results
+};
+
+static uint64_t* task_results(SchedTask* t) {
+    return t->slots + (size_t)t->num_rows * (size_t)t->num_args;
+}
+
+typedef struct {
+    _Atomic int64_t top;
+    _Atomic int64_t bottom;
+    _Atomic(SchedTask*) buf[SCHED_DEQUE_SIZE];
+} Deque;
+
+typedef struct {
+    Sched* sched;
+    int index;
+    Deque deque;
+} Worker;
+
+struct Sched {
+    Worker* workers;
+    int num_workers;
+    int slice_us;
+    uint64_t slice;                 // Epochs per run, 0 = no preemption
+    ThreadsLock* inject_lock;
+    SchedTask* inject_head;
+    SchedTask* inject_tail;
+    _Atomic int inject_len;
+    _Atomic uint32_t wake_seq;      // Futex word idle workers sleep on
+    _Atomic int num_sleeping;
+    _Atomic uint32_t stop;
+    _Atomic uint32_t live_threads;
+};
+
+static THREAD_LOCAL SchedTask* g_current_task = NULL;
+
+// ============================================================================
+// Chase-Lev deque (Le, Pop, Cohen and Zappa Nardelli, PPoPP 2013)
+// ============================================================================
+
+// Owner only. Returns 0 if the deque is full
+static int deque_push(Deque* d, SchedTask* t) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - top >= SCHED_DEQUE_SIZE) {
+        return 0;
+    }
+    atomic_store_explicit(&d->buf[b & (SCHED_DEQUE_SIZE - 1)], t, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+// Owner only
+static SchedTask* deque_pop(Deque* d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (top > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    SchedTask* t = atomic_load_explicit(&d->buf[b & (SCHED_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (top == b) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &top, top + 1,
+                memory_order_seq_cst, memory_order_relaxed)) {
+            t = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return t;
+}
+
+// Any thread
+static SchedTask* deque_steal(Deque* d) {
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (top >= b) {
+        return NULL;
+    }
+    SchedTask* t = atomic_load_explicit(&d->buf[top & (SCHED_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &top, top + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return t;
+}
+
+static int deque_empty(Deque* d) {
+    return atomic_load(&d->bottom) <= atomic_load(&d->top);
+}
+
+// ============================================================================
+// Injector and parking
+// ============================================================================
+
+static void sched_wake(Sched* s) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&s->num_sleeping) > 0) {
+        atomic_fetch_add(&s->wake_seq, 1);
+        threads_notify((const void*)&s->wake_seq, 1);
+    }
+}
+
+// Append the list head..tail of n tasks to the injector
+static void inject_list(Sched* s, SchedTask* head, SchedTask* tail, int n) {
+    tail->next = NULL;
+    threads_lock_acquire(s->inject_lock);
+    if (s->inject_tail) s->inject_tail->next = head; else s->inject_head = head;
+    s->inject_tail = tail;
+    atomic_fetch_add(&s->inject_len, n);
+    threads_lock_release(s->inject_lock);
+    sched_wake(s);
+}
+
+static void inject(Sched* s, SchedTask* t) {
+    inject_list(s, t, t, 1);
+}
+
+// Take the injector's first task, moving up to SCHED_INJECT_BATCH more to
+// w's deque
+static SchedTask* inject_take(Worker* w) {
+    Sched* s = w->sched;
+    if (atomic_load_explicit(&s->inject_len, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    threads_lock_acquire(s->inject_lock);
+    SchedTask* first = s->inject_head;
+    int taken = 0;
+    if (first) {
+        s->inject_head = first->next;
+        taken = 1;
+        while (taken <= SCHED_INJECT_BATCH && s->inject_head &&
+               deque_push(&w->deque, s->inject_head)) {
+            s->inject_head = s->inject_head->next;
+            taken++;
+        }
+        if (!s->inject_head) s->inject_tail = NULL;
+    }
+    atomic_fetch_sub(&s->inject_len, taken);
+    threads_lock_release(s->inject_lock);
+    if (taken > 1) {
+        sched_wake(s);  // Others may steal the batch
+    }
+    return first;
+}
+
+static int sched_has_work(Sched* s) {
+    if (atomic_load(&s->inject_len) > 0) {
+        return 1;
+    }
+    for (int i = 0; i < s->num_workers; i++) {
+        if (!deque_empty(&s->workers[i].deque)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void worker_park(Worker* w) {
+    Sched* s = w->sched;
+    uint32_t seq = atomic_load(&s->wake_seq);
+    atomic_fetch_add(&s->num_sleeping, 1);
+    if (!sched_has_work(s) && !atomic_load(&s->stop)) {
+        threads_wait32((const uint32_t*)&s->wake_seq, seq, -1);
+    }
+    atomic_fetch_sub(&s->num_sleeping, 1);
+}
+
+static SchedTask* worker_find_task(Worker* w, unsigned* ticks) {
+    SchedTask* t;
+    if (++*ticks % SCHED_INJECT_INTERVAL == 0 && (t = inject_take(w))) {
+        return t;
+    }
+    if ((t = deque_pop(&w->deque)) || (t = inject_take(w))) {
+        return t;
+    }
+    Sched* s = w->sched;
+    for (int i = 1; i < s->num_workers; i++) {
+        Worker* victim = &s->workers[(w->index + i) % s->num_workers];
+        if ((t = deque_steal(&victim->deque))) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// Queue a task this worker will run again
+static void worker_requeue(Worker* w, SchedTask* t) {
+    if (deque_push(&w->deque, t)) {
+        sched_wake(w->sched);
+    } else {
+        inject(w->sched, t);
+    }
+}
+
+// ============================================================================
+// Instance pools
+// ============================================================================
+
+int64_t sched_pool_new(const int64_t* contexts, int num_instances) {
+    if (num_instances <= 0) {
+        return 0;
+    }
+    SchedPool* pool = (SchedPool*)calloc(1, sizeof(SchedPool));
+    int64_t* ctxs = (int64_t*)malloc((size_t)num_instances * sizeof(int64_t));
+    _Atomic int* busy = (_Atomic int*)calloc((size_t)num_instances, sizeof(_Atomic int));
+    if (!pool || !ctxs || !busy) {
+        free(pool);
+        free(ctxs);
+        free((void*)busy);
+        return 0;
+    }
+    memcpy(ctxs, contexts, (size_t)num_instances * sizeof(int64_t));
+    pool->contexts = ctxs;
+    pool->busy = busy;
+    pool->size = num_instances;
+    return (int64_t)(uintptr_t)pool;
+}
+
+void sched_pool_free(int64_t pool_ptr) {
+    SchedPool* pool = (SchedPool*)(uintptr_t)pool_ptr;
+    if (!pool) {
+        return;
+    }
+    if (pool->snapshots) {
+        for (int i = 0; i < pool->size; i++) {
+            runtime_context_snapshot_free(pool->snapshots[i]);
+        }
+    }
+    free(pool->snapshots);
+    free(pool->contexts);
+    free((void*)pool->busy);
+    free(pool);
+}
+
+int sched_pool_set_snapshot(int64_t pool_ptr, int instance, int64_t snapshot) {
+    SchedPool* pool = (SchedPool*)(uintptr_t)pool_ptr;
+    if (instance < 0 || instance >= pool->size) {
+        return -1;
+    }
+    if (!pool->snapshots) {
+        pool->snapshots = (int64_t*)calloc((size_t)pool->size, sizeof(int64_t));
+        if (!pool->snapshots) {
+            return -1;
+        }
+    }
+    runtime_context_snapshot_free(pool->snapshots[instance]);
+    pool->snapshots[instance] = snapshot;
+    return 0;
+}
+
+// Claim instance want, or any free one if want < 0. Returns it or -1
+static int pool_acquire(SchedPool* pool, int want) {
+    int expected = 0;
+    if (want >= 0) {
+        return atomic_compare_exchange_strong(&pool->busy[want], &expected, 1) ? want : -1;
+    }
+    unsigned start = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+    for (int i = 0; i < pool->size; i++) {
+        int idx = (int)((start + (unsigned)i) % (unsigned)pool->size);
+        expected = 0;
+        if (atomic_load_explicit(&pool->busy[idx], memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_strong(&pool->busy[idx], &expected, 1)) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+static int pool_available(SchedPool* pool, int want) {
+    if (want >= 0) {
+        return atomic_load(&pool->busy[want]) == 0;
+    }
+    for (int i = 0; i < pool->size; i++) {
+        if (atomic_load(&pool->busy[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Queue every waiting task again
+static void pool_drain(Sched* s, SchedPool* pool) {
+    SchedTask* head = atomic_exchange(&pool->waiting, NULL);
+    if (!head) {
+        return;
+    }
+    SchedTask* tail = head;
+    int n = 1;
+    while (tail->next) {
+        tail = tail->next;
+        n++;
+    }
+    inject_list(s, head, tail, n);
+}
+
+// Park t until an instance is released. The check after the push pairs
+// with the one in pool_release, so a release can never be missed
+static void pool_wait(Sched* s, SchedTask* t) {
+    SchedPool* pool = t->pool;
+    t->next = atomic_load(&pool->waiting);
+    while (!atomic_compare_exchange_weak(&pool->waiting, &t->next, t)) {
+    }
+    if (pool_available(pool, t->want)) {
+        pool_drain(s, pool);
+    }
+}
+
+static void pool_release(Sched* s, SchedPool* pool, int idx) {
+    atomic_store(&pool->busy[idx], 0);
+    if (atomic_load(&pool->waiting)) {
+        pool_drain(s, pool);
+    }
+}
+
+// ============================================================================
+// Workers
+// ============================================================================
+
+static void task_finish(SchedTask* t, int trap) {
+    t->trap = trap;
+    atomic_store(&t->done, 1);
+    threads_notify((const void*)&t->done, UINT32_MAX);
+}
+
+// Start the invocation of t's next row on its instance. Returns 0 if out
+// of memory
+static int task_start_row(Sched* s, SchedTask* t) {
+    const uint64_t* args = t->slots + (size_t)t->rows_done * (size_t)t->num_args;
+    t->inv = invocation_new(t->pool->contexts[t->instance], t->func_idx, args, t->num_args);
+    if (!t->inv) {
+        return 0;
+    }
+    invocation_set_slice(t->inv, s->slice);
+    invocation_set_stdio(t->inv, t->stdin_fd, t->stdout_fd);
+    t->num_host_results = 0;
+    return 1;
+}
+
+static void worker_run_task(Worker* w, SchedTask* t) {
+    Sched* s = w->sched;
+    if (t->inv == 0) {
+        int idx = pool_acquire(t->pool, t->want);
+        if (idx < 0) {
+            pool_wait(s, t);
+            return;
+        }
+        t->instance = idx;
+        if (t->fresh && t->pool->snapshots && t->pool->snapshots[idx]) {
+            runtime_context_restore(t->pool->contexts[idx], t->pool->snapshots[idx]);
+        }
+        if (!task_start_row(s, t)) {
+            pool_release(s, t->pool, idx);
+            task_finish(t, 9);  // Stack overflow: no stack to run on
+            return;
+        }
+    }
+
+    int code;
+    for (;;) {
+        atomic_store(&t->state, TASK_RUNNING);
+        g_current_task = t;
+        code = invocation_run(t->inv, t->host_results, t->num_host_results);
+        g_current_task = NULL;
+        if (code == INVOCATION_YIELDED) {
+            inject(s, t);  // Back of the line
+            return;
+        }
+        if (code == INVOCATION_PENDING) {
+            int expected = TASK_RUNNING;
+            if (!atomic_compare_exchange_strong(&t->state, &expected, TASK_PARKED)) {
+                worker_requeue(w, t);  // Resumed before it was parked
+            }
+            return;
+        }
+        if (code == SCHED_TRAP_EXIT) {
+            t->exit_code = wasi_thread_exit_code();
+        }
+        if (code == 0) {
+            uint64_t* results = task_results(t) + (size_t)t->rows_done * (size_t)t->num_results;
+            invocation_results(t->inv, results, t->num_results);
+            t->rows_done++;
+        }
+        invocation_free(t->inv);
+        t->inv = 0;
+        // A batch keeps its instance for the next row, in the same slice
+        if (code != 0 || t->rows_done == t->num_rows) {
+            break;
+        }
+        if (!task_start_row(s, t)) {
+            code = 9;
+            break;
+        }
+    }
+    pool_release(s, t->pool, t->instance);
+    task_finish(t, code);
+}
+
+static void thread_exit(Sched* s) {
+    atomic_fetch_sub(&s->live_threads, 1);
+    threads_notify((const void*)&s->live_threads, UINT32_MAX);
+}
+
+static void worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    Sched* s = w->sched;
+    unsigned ticks = 0;
+    while (!atomic_load(&s->stop)) {
+        SchedTask* t = worker_find_task(w, &ticks);
+        if (t) {
+            worker_run_task(w, t);
+        } else {
+            worker_park(w);
+        }
+    }
+    wasi_thread_cleanup();
+    thread_exit(s);
+}
+
+static void ticker_main(void* arg) {
+    Sched* s = (Sched*)arg;
+    while (!atomic_load(&s->stop)) {
+        threads_wait32((const uint32_t*)&s->stop, 0, (int64_t)s->slice_us * 1000);
+        epoch_increment();
+    }
+    thread_exit(s);
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int64_t sched_new(int num_workers, int slice_us) {
+    if (num_workers <= 0) {
+        num_workers = threads_num_cpus();
+    }
+    Sched* s = (Sched*)calloc(1, sizeof(Sched));
+    Worker* workers = (Worker*)calloc((size_t)num_workers, sizeof(Worker));
+    ThreadsLock* lock = threads_lock_new();
+    if (!s || !workers || !lock) {
+        free(s);
+        free(workers);
+        threads_lock_free(lock);
+        return 0;
+    }
+    s->workers = workers;
+    s->num_workers = num_workers;
+    s->slice_us = slice_us;
+    s->slice = slice_us > 0 ? 1 : 0;
+    s->inject_lock = lock;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].sched = s;
+        workers[i].index = i;
+    }
+    atomic_store(&s->live_threads, (uint32_t)num_workers + (slice_us > 0 ? 1 : 0));
+    for (int i = 0; i < num_workers; i++) {
+        if (threads_start(worker_main, &workers[i]) != 0) {
+            thread_exit(s);
+        }
+    }
+    if (slice_us > 0 && threads_start(ticker_main, s) != 0) {
+        thread_exit(s);
+    }
+    return (int64_t)(uintptr_t)s;
+}
+
+void sched_free(int64_t sched_ptr) {
+    Sched* s = (Sched*)(uintptr_t)sched_ptr;
+    if (!s) {
+        return;
+    }
+    atomic_store(&s->stop, 1);
+    threads_notify((const void*)&s->stop, UINT32_MAX);
+    atomic_fetch_add(&s->wake_seq, 1);
+    threads_notify((const void*)&s->wake_seq, UINT32_MAX);
+    uint32_t live;
+    while ((live = atomic_load(&s->live_threads)) > 0) {
+        threads_wait32((const uint32_t*)&s->live_threads, live, -1);
+    }
+    threads_lock_free(s->inject_lock);
+    free(s->workers);
+    free(s);
+}
+
+int sched_num_workers(int64_t sched_ptr) {
+    return ((Sched*)(uintptr_t)sched_ptr)->num_workers;
+}
+
+int64_t sched_submit(int64_t sched_ptr, int64_t pool_ptr, int instance, int func_idx,
+                     const uint64_t* args, int num_args, int num_results) {
+    return sched_submit_stdio(sched_ptr, pool_ptr, instance, func_idx, args,
+                              num_args, num_results, -1, -1, 0);
+}
+
+// Queue a task of num_rows calls
+static int64_t submit_rows(int64_t sched_ptr, int64_t pool_ptr, int instance, int func_idx,
+                           const uint64_t* args, int num_args, int num_results,
+                           int num_rows, int stdin_fd, int stdout_fd, int fresh) {
+    Sched* s = (Sched*)(uintptr_t)sched_ptr;
+    SchedPool* pool = (SchedPool*)(uintptr_t)pool_ptr;
+    if (instance >= pool->size || num_rows <= 0) {
+        return 0;
+    }
+    size_t slots = (size_t)num_rows * ((size_t)num_args + (size_t)num_results);
+    SchedTask* t = (SchedTask*)calloc(1, sizeof(SchedTask) + slots * sizeof(uint64_t));
+    if (!t) {
+        return 0;
+    }
+    t->sched = s;
+    t->pool = pool;
+    t->want = instance;
+    t->instance = -1;
+    t->func_idx = func_idx;
+    t->num_args = num_args;
+    t->num_results = num_results;
+    t->num_rows = num_rows;
+    t->stdin_fd = stdin_fd;
+    t->stdout_fd = stdout_fd;
+    t->fresh = fresh;
+    if (num_args > 0) {
+        memcpy(t->slots, args, (size_t)num_rows * (size_t)num_args * sizeof(uint64_t));
+    }
+    inject(s, t);
+    return (int64_t)(uintptr_t)t;
+}
+
+int64_t sched_submit_stdio(int64_t sched_ptr, int64_t pool_ptr, int instance, int func_idx,
+                           const uint64_t* args, int num_args, int num_results,
+                           int stdin_fd, int stdout_fd, int fresh) {
+    return submit_rows(sched_ptr, pool_ptr, instance, func_idx, args, num_args,
+                       num_results, 1, stdin_fd, stdout_fd, fresh);
+}
+
+int64_t sched_submit_batch(int64_t sched_ptr, int64_t pool_ptr, int instance, int func_idx,
+                           const uint64_t* args, int num_args, int num_results,
+                           int num_rows) {
+    return submit_rows(sched_ptr, pool_ptr, instance, func_idx, args, num_args,
+                       num_results, num_rows, -1, -1, 0);
+}
+
+// Wait for t, copy up to num_results result slots of the rows it completed
+// and release it
+static int task_wait(SchedTask* t, uint64_t* results, int num_results,
+                     int* exit_code, int* rows_done) {
+    while (!atomic_load(&t->done)) {
+        threads_wait32((const uint32_t*)&t->done, 0, -1);
+    }
+    int n = t->rows_done * t->num_results;
+    if (num_results < n) {
+        n = num_results;
+    }
+    const uint64_t* src = task_results(t);
+    for (int i = 0; i < n; i++) {
+        results[i] = src[i];
+    }
+    int trap = t->trap;
+    if (exit_code) {
+        *exit_code = t->exit_code;
+    }
+    if (rows_done) {
+        *rows_done = t->rows_done;
+    }
+    free(t);
+    return trap;
+}
+
+int sched_task_wait(int64_t task_ptr, uint64_t* results, int num_results) {
+    return task_wait((SchedTask*)(uintptr_t)task_ptr, results, num_results, NULL, NULL);
+}
+
+int sched_task_wait_exit(int64_t task_ptr, uint64_t* results, int num_results,
+                         int* exit_code) {
+    return task_wait((SchedTask*)(uintptr_t)task_ptr, results, num_results,
+                     exit_code, NULL);
+}
+
+int sched_task_wait_batch(int64_t task_ptr, uint64_t* results, int num_results,
+                          int* rows_done) {
+    return task_wait((SchedTask*)(uintptr_t)task_ptr, results, num_results,
+                     NULL, rows_done);
+}
+
+int64_t sched_current_task(void) {
+    return (int64_t)(uintptr_t)g_current_task;
+}
+
+void sched_task_resume(int64_t task_ptr, const uint64_t* results, int num_results) {
+    SchedTask* t = (SchedTask*)(uintptr_t)task_ptr;
+    int n = num_results < HOST_FUNC_MAX_RESULTS ? num_results : HOST_FUNC_MAX_RESULTS;
+    for (int i = 0; i < n; i++) {
+        t->host_results[i] = results[i];
+    }
+    t->num_host_results = n;
+    if (atomic_exchange(&t->state, TASK_RESUMED) == TASK_PARKED) {
+        inject(t->sched, t);
+    }
+}
@@ -0,0 +1,74 @@
+// Work-stealing scheduler for wasm5: runs many export calls (tasks) of many
+// instances on a fixed set of worker threads.
+
+#ifndef WASM5_SCHED_H
+#define WASM5_SCHED_H
+
+#include <stdint.h>
+
+// A pool of instances of one module, given by their runtime contexts. A task
+// runs on any free instance of its pool, or on the one it is bound to, and
+// keeps that instance until it finishes. Returns the pool or 0
+int64_t sched_pool_new(const int64_t* contexts, int num_instances);
+void sched_pool_free(int64_t pool);
+
+// Give instance its snapshot (runtime_context_snapshot), which the pool
+// takes over; tasks submitted with fresh start from it. Returns 0, or -1 if
+// out of memory
+int sched_pool_set_snapshot(int64_t pool, int instance, int64_t snapshot);
+
+// Start num_workers worker threads (<= 0: one per CPU). With slice_us > 0 a
+// task yields its worker after about slice_us microseconds, if its module
+// was compiled with epoch checks, and goes to the back of the queue.
+// Returns the scheduler or 0
+int64_t sched_new(int num_workers, int slice_us);
+
+// Stop the workers once their running tasks finish or yield. Tasks not
+// waited for yet are abandoned
+void sched_free(int64_t sched);
+
+int sched_num_workers(int64_t sched);
+
+// Queue a call of local function func_idx on an instance of pool; instance
+// >= 0 binds it to that instance. Returns the task, or 0 if out of memory
+int64_t sched_submit(int64_t sched, int64_t pool, int instance, int func_idx,
+                     const uint64_t* args, int num_args, int num_results);
+
+// sched_submit for a task whose WASI stdin and stdout are the given host fds
+// (-1 = the process's own). With fresh, the instance is first put back into
+// its snapshot state, as if newly instantiated
+int64_t sched_submit_stdio(int64_t sched, int64_t pool, int instance, int func_idx,
+                           const uint64_t* args, int num_args, int num_results,
+                           int stdin_fd, int stdout_fd, int fresh);
+
+// Queue num_rows calls of func_idx that run one after another on one
+// instance, row i taking args[i * num_args..]. The task stops at the first
+// row that traps
+int64_t sched_submit_batch(int64_t sched, int64_t pool, int instance, int func_idx,
+                           const uint64_t* args, int num_args, int num_results,
+                           int num_rows);
+
+// Block until the task finishes, copy its results and release it. Returns
+// its trap code (0 = none)
+int sched_task_wait(int64_t task, uint64_t* results, int num_results);
+
+// sched_task_wait for a batch: results holds the results of every row that
+// completed, row after row, and rows_done their number
+int sched_task_wait_batch(int64_t task, uint64_t* results, int num_results,
+                          int* rows_done);
+
+// sched_task_wait that also stores the guest's proc_exit code in exit_code
+// when the task ended with a WASI exit
+int sched_task_wait_exit(int64_t task, uint64_t* results, int num_results,
+                         int* exit_code);
+
+// The task running on this worker thread, or 0. A native host function
+// returning HOST_FUNC_PENDING keeps it to resume the task later
+int64_t sched_current_task(void);
+
+// Give a task waiting on a host function that function's results and queue
+// it again. May be called from any thread, even before the host function
+// has returned
+void sched_task_resume(int64_t task, const uint64_t* results, int num_results);
+
+#endif
@@ -0,0 +1,554 @@
+// Long-running invocation server for wasm5 (protocol in serve.h)
+//
+// Modules are compiled and instantiated once, into instance pools, before
+// serving starts; a request only parses its line, queues a task on the
+// scheduler and waits for it. Each connection has a thread of its own that
+// reads requests, so slow clients do not hold up workers, while the
+// scheduler bounds how many calls run at once. A `run` request's stdin and
+// stdout are temporary files handed to the task (invocation_set_stdio), so
+// commands on different workers do not share the process's stdio.
+
+// Feature test macros for POSIX APIs (strtok_r, nanosleep)
+#if defined(__linux__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "serve.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "sched.h"
+#include "threads.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define SERVE_MAX_VALUES  HOST_FUNC_MAX_RESULTS  // Params or results of a served export
+#define SERVE_LINE_MAX    4096                   // Longest request line
+#define SERVE_CHUNK       65536                  // Payload copy buffer
+#define SERVE_TRAP_EXIT   13                     // TRAP_WASI_EXIT: proc_exit is a normal end
+#define SERVE_ACCEPT_BACKOFF_NS 10000000         // Wait before accepting again when out of fds
+
+typedef struct {
+    char* module;
+    char* name;
+    int64_t pool;
+    int func_idx;
+    uint8_t types[2 * SERVE_MAX_VALUES];  // Params, then results
+    int num_params;
+    int num_results;
+} ServeExport;
+
+typedef struct {
+    int64_t sched;
+    ServeExport* exports;
+    int num_exports;
+    int capacity;
+    int listen_fd;  // Socket accepted on by serve_start's thread
+} Server;
+
+static char* copy_name(const uint8_t* s, int len) {
+    char* out = (char*)malloc((size_t)len + 1);
+    if (out) {
+        memcpy(out, s, (size_t)len);
+        out[len] = '\0';
+    }
+    return out;
+}
+
+int64_t serve_new(int64_t sched) {
+    Server* server = (Server*)calloc(1, sizeof(Server));
+    if (!server) {
+        return 0;
+    }
+    server->sched = sched;
+    return (int64_t)(uintptr_t)server;
+}
+
+int serve_add(int64_t server_ptr, const uint8_t* module, int module_len,
+              const uint8_t* name, int name_len, int64_t pool, int func_idx,
+              const uint8_t* types, int num_params, int num_results) {
+    Server* server = (Server*)(uintptr_t)server_ptr;
+    if (num_params > SERVE_MAX_VALUES || num_results > SERVE_MAX_VALUES) {
+        return -1;
+    }
+    for (int i = 0; i < num_params + num_results; i++) {
+        if (types[i] < HOST_TYPE_F64 || types[i] > HOST_TYPE_I32) {
+            return -1;  // Only i32, i64, f32 and f64 have a text form
+        }
+    }
+    if (server->num_exports == server->capacity) {
+        int cap = server->capacity ? server->capacity * 2 : 16;
+        ServeExport* exports = (ServeExport*)realloc(server->exports, (size_t)cap * sizeof(ServeExport));
+        if (!exports) {
+            return -1;
+        }
+        server->exports = exports;
+        server->capacity = cap;
+    }
+    ServeExport* e = &server->exports[server->num_exports];
+    e->module = copy_name(module, module_len);
+    e->name = copy_name(name, name_len);
+    if (!e->module || !e->name) {
+        free(e->module);
+        free(e->name);
+        return -1;
+    }
+    e->pool = pool;
+    e->func_idx = func_idx;
+    memcpy(e->types, types, (size_t)(num_params + num_results));
+    e->num_params = num_params;
+    e->num_results = num_results;
+    server->num_exports++;
+    return 0;
+}
+
+static const ServeExport* find_export(const Server* server, const char* module, const char* name) {
+    for (int i = 0; i < server->num_exports; i++) {
+        const ServeExport* e = &server->exports[i];
+        if (strcmp(e->module, module) == 0 && strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Parse a decimal (or C float) token as a value of the given type
+static int parse_value(const char* tok, uint8_t type, uint64_t* out) {
+    char* end = NULL;
+    errno = 0;
+    switch (type) {
+    case HOST_TYPE_I32: {
+        long long v = strtoll(tok, &end, 10);
+        if (v < INT32_MIN || v > (long long)UINT32_MAX) return -1;
+        *out = (uint64_t)(uint32_t)v;
+        break;
+    }
+    case HOST_TYPE_I64:
+        *out = tok[0] == '-' ? (uint64_t)strtoll(tok, &end, 10) : (uint64_t)strtoull(tok, &end, 10);
+        break;
+    case HOST_TYPE_F32: {
+        float f = strtof(tok, &end);
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        *out = bits;
+        break;
+    }
+    default: {
+        double d = strtod(tok, &end);
+        memcpy(out, &d, sizeof(*out));
+        break;
+    }
+    }
+    return end != tok && *end == '\0' && errno != ERANGE ? 0 : -1;
+}
+
+static int format_value(char* buf, size_t size, uint64_t v, uint8_t type) {
+    switch (type) {
+    case HOST_TYPE_I32:
+        return snprintf(buf, size, " %d", (int)(int32_t)(uint32_t)v);
+    case HOST_TYPE_I64:
+        return snprintf(buf, size, " %lld", (long long)(int64_t)v);
+    case HOST_TYPE_F32: {
+        uint32_t bits = (uint32_t)v;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return snprintf(buf, size, " %.9g", (double)f);
+    }
+    default: {
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        return snprintf(buf, size, " %.17g", d);
+    }
+    }
+}
+
+#ifndef _WIN32
+
+// A connection and its read buffer
+typedef struct {
+    Server* server;
+    int fd;
+    char buf[SERVE_LINE_MAX];
+    size_t start;
+    size_t end;
+} Conn;
+
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Read the next line into the buffer and return it, NUL-terminated without
+// the newline. NULL at end of stream, on error or if the line is too long
+static char* read_line(Conn* c) {
+    for (;;) {
+        char* nl = (char*)memchr(c->buf + c->start, '\n', c->end - c->start);
+        if (nl) {
+            char* line = c->buf + c->start;
+            *nl = '\0';
+            c->start = (size_t)(nl - c->buf) + 1;
+            return line;
+        }
+        if (c->start > 0) {
+            memmove(c->buf, c->buf + c->start, c->end - c->start);
+            c->end -= c->start;
+            c->start = 0;
+        }
+        if (c->end == sizeof(c->buf)) {
+            return NULL;
+        }
+        ssize_t n = read(c->fd, c->buf + c->end, sizeof(c->buf) - c->end);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NULL;
+        c->end += (size_t)n;
+    }
+}
+
+// Copy len bytes of the request (buffered bytes first) to fd
+static int read_payload(Conn* c, int fd, size_t len) {
+    size_t buffered = c->end - c->start;
+    size_t take = buffered < len ? buffered : len;
+    if (write_all(fd, c->buf + c->start, take) < 0) return -1;
+    c->start += take;
+    len -= take;
+    char chunk[SERVE_CHUNK];
+    while (len > 0) {
+        ssize_t n = read(c->fd, chunk, len < sizeof(chunk) ? len : sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        if (write_all(fd, chunk, (size_t)n) < 0) return -1;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int reply(Conn* c, const char* line) {
+    return write_all(c->fd, line, strlen(line));
+}
+
+static int reply_trap(Conn* c, int trap) {
+    char line[32];
+    snprintf(line, sizeof(line), "trap %d\n", trap);
+    return reply(c, line);
+}
+
+// call <module> <export> [<arg>...]
+static int serve_call(Conn* c, char* module, char* name, char** save) {
+    const ServeExport* e = find_export(c->server, module, name);
+    if (!e) {
+        return reply(c, "error unknown export\n");
+    }
+    uint64_t slots[SERVE_MAX_VALUES];
+    int n = 0;
+    for (char* tok; (tok = strtok_r(NULL, " ", save)) != NULL; n++) {
+        if (n >= e->num_params || parse_value(tok, e->types[n], &slots[n]) < 0) {
+            return reply(c, "error bad arguments\n");
+        }
+    }
+    if (n != e->num_params) {
+        return reply(c, "error bad arguments\n");
+    }
+    int64_t task = sched_submit(c->server->sched, e->pool, -1, e->func_idx, slots,
+                                e->num_params, e->num_results);
+    if (!task) {
+        return reply(c, "error out of memory\n");
+    }
+    uint64_t results[SERVE_MAX_VALUES];
+    int trap = sched_task_wait(task, results, e->num_results);
+    if (trap != 0) {
+        return reply_trap(c, trap);
+    }
+    char line[SERVE_MAX_VALUES * 32 + 8] = "ok";
+    size_t len = 2;
+    for (int i = 0; i < e->num_results; i++) {
+        len += (size_t)format_value(line + len, sizeof(line) - len, results[i],
+                                    e->types[e->num_params + i]);
+    }
+    line[len++] = '\n';
+    return write_all(c->fd, line, len);
+}
+
+// run <module> <length>, then the stdin payload
+static int serve_command(Conn* c, char* module, char** save) {
+    char* length = strtok_r(NULL, " ", save);
+    char* end = NULL;
+    long long len = length ? strtoll(length, &end, 10) : -1;
+    if (!length || *end != '\0' || len < 0) {
+        return -1;  // The payload cannot be skipped: drop the connection
+    }
+    FILE* in = tmpfile();
+    FILE* out = in ? tmpfile() : NULL;
+    int ok = out && read_payload(c, fileno(in), (size_t)len) == 0;
+    if (!ok) {
+        if (in) fclose(in);
+        if (out) fclose(out);
+        return -1;
+    }
+    const ServeExport* e = find_export(c->server, module, "_start");
+    if (!e || e->num_params != 0) {
+        fclose(in);
+        fclose(out);
+        return reply(c, "error unknown export\n");
+    }
+    lseek(fileno(in), 0, SEEK_SET);
+    // A command runs once per instance (wasi-libc's _start traps when run
+    // again), so every run starts from a freshly instantiated state
+    int64_t task = sched_submit_stdio(c->server->sched, e->pool, -1, e->func_idx, NULL, 0,
+                                      e->num_results, fileno(in), fileno(out), 1);
+    int exit_code = 0;
+    int trap = task ? sched_task_wait_exit(task, NULL, 0, &exit_code) : -1;
+    int r;
+    if (trap < 0) {
+        r = reply(c, "error out of memory\n");
+    } else if (trap != 0 && trap != SERVE_TRAP_EXIT) {
+        r = reply_trap(c, trap);
+    } else {
+        off_t size = lseek(fileno(out), 0, SEEK_END);
+        char line[32];
+        snprintf(line, sizeof(line), "ok %lld %d\n", (long long)size,
+                 trap == SERVE_TRAP_EXIT ? exit_code : 0);
+        lseek(fileno(out), 0, SEEK_SET);
+        r = reply(c, line);
+        char chunk[SERVE_CHUNK];
+        ssize_t n;
+        while (r == 0 && (n = read(fileno(out), chunk, sizeof(chunk))) > 0) {
+            r = write_all(c->fd, chunk, (size_t)n);
+        }
+    }
+    fclose(in);
+    fclose(out);
+    return r;
+}
+
+static void conn_main(void* arg) {
+    Conn* c = (Conn*)arg;
+    char* line;
+    while ((line = read_line(c)) != NULL) {
+        char* save = NULL;
+        char* kind = strtok_r(line, " ", &save);
+        char* module = kind ? strtok_r(NULL, " ", &save) : NULL;
+        int r;
+        if (kind && module && strcmp(kind, "call") == 0) {
+            char* name = strtok_r(NULL, " ", &save);
+            r = name ? serve_call(c, module, name, &save) : reply(c, "error bad request\n");
+        } else if (kind && module && strcmp(kind, "run") == 0) {
+            r = serve_command(c, module, &save);
+        } else {
+            r = reply(c, "error bad request\n");
+        }
+        if (r < 0) {
+            break;
+        }
+    }
+    close(c->fd);
+    free(c);
+}
+
+static int unix_address(struct sockaddr_un* sun, const uint8_t* path, int path_len) {
+    if (path_len <= 0 || (size_t)path_len >= sizeof(sun->sun_path)) return -1;
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, path, (size_t)path_len);
+    return 0;
+}
+
+// Bind and listen on the socket at path; the listening fd, or -1
+static int serve_listen(const uint8_t* path, int path_len) {
+    struct sockaddr_un sun;
+    if (unix_address(&sun, path, path_len) < 0) return -1;
+    // Only a stale socket is replaced; any other file at path is kept and
+    // bind fails on it
+    struct stat st;
+    if (lstat(sun.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(sun.sun_path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr*)&sun, sizeof(sun)) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        return -1;
+    }
+    // A client that goes away mid-response must not end the server
+    signal(SIGPIPE, SIG_IGN);
+    return fd;
+}
+
+// Accept connections on fd until accept fails for good
+static int serve_accept(Server* server, int fd) {
+    for (;;) {
+        int conn_fd = accept(fd, NULL, NULL);
+        if (conn_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                // Out of fds until a connection closes: retry later
+                struct timespec backoff = {0, SERVE_ACCEPT_BACKOFF_NS};
+                nanosleep(&backoff, NULL);
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        Conn* c = (Conn*)malloc(sizeof(Conn));
+        if (!c) {
+            close(conn_fd);
+            continue;
+        }
+        c->server = server;
+        c->fd = conn_fd;
+        c->start = 0;
+        c->end = 0;
+        if (threads_start(conn_main, c) != 0) {
+            close(conn_fd);
+            free(c);
+        }
+    }
+}
+
+int serve_run(int64_t server_ptr, const uint8_t* path, int path_len) {
+    int fd = serve_listen(path, path_len);
+    if (fd < 0) return -1;
+    return serve_accept((Server*)(uintptr_t)server_ptr, fd);
+}
+
+static void accept_main(void* arg) {
+    Server* server = (Server*)arg;
+    serve_accept(server, server->listen_fd);
+}
+
+int serve_start(int64_t server_ptr, const uint8_t* path, int path_len) {
+    Server* server = (Server*)(uintptr_t)server_ptr;
+    int fd = serve_listen(path, path_len);
+    if (fd < 0) return -1;
+    server->listen_fd = fd;
+    if (threads_start(accept_main, server) != 0) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+int serve_client(const uint8_t* path, int path_len, const uint8_t* request,
+                 int request_len, int stdin_payload) {
+    // Read the payload before connecting, so a slow producer holds no
+    // server thread
+    char* payload = NULL;
+    size_t payload_len = 0;
+    if (stdin_payload) {
+        size_t cap = 0;
+        char chunk[SERVE_CHUNK];
+        ssize_t n;
+        while ((n = read(0, chunk, sizeof(chunk))) > 0) {
+            if (payload_len + (size_t)n > cap) {
+                cap = (payload_len + (size_t)n) * 2;
+                char* grown = (char*)realloc(payload, cap);
+                if (!grown) {
+                    free(payload);
+                    fprintf(stderr, "Error: out of memory\n");
+                    return 1;
+                }
+                payload = grown;
+            }
+            memcpy(payload + payload_len, chunk, (size_t)n);
+            payload_len += (size_t)n;
+        }
+    }
+
+    struct sockaddr_un sun;
+    int fd = unix_address(&sun, path, path_len) == 0 ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+    if (fd < 0 || connect(fd, (struct sockaddr*)&sun, sizeof(sun)) < 0) {
+        fprintf(stderr, "Error: cannot connect to %.*s\n", path_len, (const char*)path);
+        if (fd >= 0) close(fd);
+        free(payload);
+        return 1;
+    }
+    char suffix[32];
+    if (stdin_payload) {
+        snprintf(suffix, sizeof(suffix), " %zu\n", payload_len);
+    } else {
+        strcpy(suffix, "\n");
+    }
+    int ok = write_all(fd, request, (size_t)request_len) == 0 &&
+             write_all(fd, suffix, strlen(suffix)) == 0 &&
+             write_all(fd, payload ? payload : "", payload_len) == 0;
+    free(payload);
+
+    Conn c;
+    c.fd = fd;
+    c.start = 0;
+    c.end = 0;
+    char* line = ok ? read_line(&c) : NULL;
+    int status = 1;
+    if (!line) {
+        fprintf(stderr, "Error: no response from server\n");
+    } else if (strncmp(line, "ok", 2) == 0 && request_len >= 4 &&
+               memcmp(request, "run ", 4) == 0) {
+        char* end = NULL;
+        long long len = strtoll(line + 2, &end, 10);
+        int exit_code = (int)strtol(end, NULL, 10);
+        status = read_payload(&c, 1, (size_t)len) == 0 ? exit_code : 1;
+    } else if (strncmp(line, "ok", 2) == 0) {
+        // One result per line, like `wasm5 <WASM_FILE> --invoke`
+        char* save = NULL;
+        strtok_r(line, " ", &save);
+        for (char* tok; (tok = strtok_r(NULL, " ", &save)) != NULL;) {
+            printf("%s\n", tok);
+        }
+        fflush(stdout);
+        status = 0;
+    } else {
+        fprintf(stderr, "Error: %s\n", strncmp(line, "error ", 6) == 0 ? line + 6 : line);
+    }
+    close(fd);
+    return status;
+}
+
+#else
+
+int serve_run(int64_t server_ptr, const uint8_t* path, int path_len) {
+    (void)server_ptr;
+    (void)path;
+    (void)path_len;
+    return -1;
+}
+
+int serve_start(int64_t server_ptr, const uint8_t* path, int path_len) {
+    (void)server_ptr;
+    (void)path;
+    (void)path_len;
+    return -1;
+}
+
+int serve_client(const uint8_t* path, int path_len, const uint8_t* request,
+                 int request_len, int stdin_payload) {
+    (void)path;
+    (void)path_len;
+    (void)request;
+    (void)request_len;
+    (void)stdin_payload;
+    fprintf(stderr, "Error: wasm5 serve needs Unix domain sockets\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,58 @@
+// Long-running invocation server for wasm5: answers export calls from
+// clients on a Unix domain socket, running them on warm instance pools
+// through the scheduler (sched.h).
+//
+// The protocol is line based. Each request is one line:
+//
+//   call <module> <export> [<arg>...]   Call an export; args are decimal
+//                                       (floats in C syntax)
+//   run <module> <length>               Followed by <length> bytes that the
+//                                       module's _start export reads as stdin,
+//                                       on an instance reset to its state
+//                                       right after instantiation
+//
+// and gets one response line:
+//
+//   ok [<result>...]                    The call's results
+//   ok <length> <exit>                  Followed by the run's stdout bytes;
+//                                       exit is its proc_exit code (0 if
+//                                       _start returned)
+//   trap <code>                         The call trapped (trap code)
+//   error <message>                     The request could not be served
+//
+// A connection may send any number of requests; responses come in order.
+
+#ifndef WASM5_SERVE_H
+#define WASM5_SERVE_H
+
+#include <stdint.h>
+
+// A server dispatching to tasks of the given scheduler. Returns it or 0
+int64_t serve_new(int64_t sched);
+
+// Make export name of module served: a local function of the instances in
+// pool with the given param and result type codes (types holds num_params
+// then num_results codes). Only numeric types are supported.
+// Returns 0, or -1 if the signature is not supported or out of memory
+int serve_add(int64_t server, const uint8_t* module, int module_len,
+              const uint8_t* name, int name_len, int64_t pool, int func_idx,
+              const uint8_t* types, int num_params, int num_results);
+
+// Listen on the Unix domain socket at path (replacing a stale socket file)
+// and serve connections, each on a thread of its own. Only returns on
+// error, with -1
+int serve_run(int64_t server, const uint8_t* path, int path_len);
+
+// Like serve_run, but serve from a thread of its own: returns 0 once the
+// socket is listening, or -1 if it cannot be set up
+int serve_start(int64_t server, const uint8_t* path, int path_len);
+
+// Client side: send one request line (without the newline) to the server
+// at path and write the response to stdout. With stdin_payload, the
+// request is `run` and the payload is read from stdin first. Returns 0 on
+// success (for `run`, its exit code), 1 on a trap or error (reported on
+// stderr)
+int serve_client(const uint8_t* path, int path_len, const uint8_t* request,
+                 int request_len, int stdin_payload);
+
+#endif
@@ -0,0 +1,488 @@
+// Threads support for wasm5
+//
+// memory.atomic.wait/notify use a parking lot: waiters are queued in one of
+// THREADS_BUCKETS buckets hashed by address, each guarded by its own mutex.
+// A waiter checks the value and enqueues itself under the bucket lock, so a
+// notify that follows the store it waits for can never be missed. On Linux
+// each waiter then sleeps on a private futex word; elsewhere it sleeps on a
+// condition variable. A notifier dequeues waiters and wakes them while
+// still holding the bucket lock, and a waiter only returns after retaking
+// that lock, so its (stack-allocated) queue entry outlives every wake-up.
+
+#if defined(__linux__)
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#endif
+
+#include "threads.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK ThreadsMutex;
+typedef CONDITION_VARIABLE ThreadsCond;
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+typedef pthread_mutex_t ThreadsMutex;
+typedef pthread_cond_t ThreadsCond;
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define THREADS_FUTEX 1
+#endif
+#endif
+
+#define THREADS_BUCKETS 64
+
+typedef struct Waiter {
+    const void* addr;
+    struct Waiter* next;
+    _Atomic uint32_t woken;  // Set by the notifier; the futex word on Linux
+#ifndef THREADS_FUTEX
+    ThreadsCond cond;
+#endif
+} Waiter;
+
+typedef struct {
+    ThreadsMutex lock;
+    Waiter* head;
+    Waiter* tail;
+} WaitBucket;
+
+static WaitBucket g_buckets[THREADS_BUCKETS];
+static ThreadsMutex g_memory_lock;
+static ThreadsMutex g_wasi_lock;
+
+// Live address space reservations (threads_memory_reserve)
+typedef struct {
+    uintptr_t base;
+    uint64_t size;
+} Reservation;
+
+static ThreadsMutex g_reservations_lock;
+static Reservation* g_reservations = NULL;
+static int g_num_reservations = 0;
+static int g_reservations_capacity = 0;
+
+// ============================================================================
+// Platform wrappers
+// ============================================================================
+
+#ifdef _WIN32
+
+static void mutex_init(ThreadsMutex* m) { InitializeSRWLock(m); }
+static void mutex_lock(ThreadsMutex* m) { AcquireSRWLockExclusive(m); }
+static void mutex_unlock(ThreadsMutex* m) { ReleaseSRWLockExclusive(m); }
+static void cond_init(ThreadsCond* c) { InitializeConditionVariable(c); }
+static void cond_destroy(ThreadsCond* c) { (void)c; }
+static void cond_signal(ThreadsCond* c) { WakeConditionVariable(c); }
+
+// Sleep on c for at most timeout_ns (< 0 = no limit); may wake spuriously
+static void cond_wait(ThreadsCond* c, ThreadsMutex* m, int64_t timeout_ns) {
+    DWORD ms = INFINITE;
+    if (timeout_ns >= 0) {
+        int64_t t = (timeout_ns + 999999) / 1000000;
+        ms = t >= (int64_t)INFINITE ? INFINITE - 1 : (DWORD)t;
+    }
+    SleepConditionVariableSRW(c, m, ms, 0);
+}
+
+static int64_t now_ns(void) {
+    return (int64_t)GetTickCount64() * 1000000;
+}
+
+static INIT_ONCE g_init_once = INIT_ONCE_STATIC_INIT;
+static void threads_init_all(void);
+static BOOL CALLBACK threads_init_cb(PINIT_ONCE once, PVOID param, PVOID* ctx) {
+    (void)once; (void)param; (void)ctx;
+    threads_init_all();
+    return TRUE;
+}
+static void threads_init(void) {
+    InitOnceExecuteOnce(&g_init_once, threads_init_cb, NULL, NULL);
+}
+
+#else
+
+static void mutex_init(ThreadsMutex* m) { pthread_mutex_init(m, NULL); }
+static void mutex_lock(ThreadsMutex* m) { pthread_mutex_lock(m); }
+static void mutex_unlock(ThreadsMutex* m) { pthread_mutex_unlock(m); }
+
+#ifndef THREADS_FUTEX
+static void cond_init(ThreadsCond* c) { pthread_cond_init(c, NULL); }
+static void cond_destroy(ThreadsCond* c) { pthread_cond_destroy(c); }
+static void cond_signal(ThreadsCond* c) { pthread_cond_signal(c); }
+
+static void cond_wait(ThreadsCond* c, ThreadsMutex* m, int64_t timeout_ns) {
+    if (timeout_ns < 0) {
+        pthread_cond_wait(c, m);
+        return;
+    }
+    // pthread condition variables time out against CLOCK_REALTIME
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t nsec = (int64_t)ts.tv_nsec + timeout_ns % 1000000000;
+    ts.tv_sec += (time_t)(timeout_ns / 1000000000 + nsec / 1000000000);
+    ts.tv_nsec = (long)(nsec % 1000000000);
+    pthread_cond_timedwait(c, m, &ts);
+}
+#endif
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static void threads_init_all(void);
+static void threads_init(void) {
+    pthread_once(&g_init_once, threads_init_all);
+}
+
+#endif
+
+static void threads_init_all(void) {
+    for (int i = 0; i < THREADS_BUCKETS; i++) {
+        mutex_init(&g_buckets[i].lock);
+        g_buckets[i].head = NULL;
+        g_buckets[i].tail = NULL;
+    }
+    mutex_init(&g_memory_lock);
+    mutex_init(&g_wasi_lock);
+    mutex_init(&g_reservations_lock);
+}
+
+// ============================================================================
+// Wait / notify
+// ============================================================================
+
+static WaitBucket* bucket_for(const void* addr) {
+    uintptr_t p = (uintptr_t)addr >> 2;
+    p ^= p >> 7;
+    return &g_buckets[p % THREADS_BUCKETS];
+}
+
+// Put w to sleep until it is woken or timeout_ns passes (< 0 = no limit).
+// Called and returns with the bucket lock held; may wake spuriously
+static void waiter_sleep(WaitBucket* b, Waiter* w, int64_t timeout_ns) {
+#ifdef THREADS_FUTEX
+    struct timespec ts;
+    struct timespec* tsp = NULL;
+    if (timeout_ns >= 0) {
+        ts.tv_sec = (time_t)(timeout_ns / 1000000000);
+        ts.tv_nsec = (long)(timeout_ns % 1000000000);
+        tsp = &ts;
+    }
+    mutex_unlock(&b->lock);
+    syscall(SYS_futex, (uint32_t*)&w->woken, FUTEX_WAIT_PRIVATE, 0, tsp, NULL, 0);
+    mutex_lock(&b->lock);
+#else
+    cond_wait(&w->cond, &b->lock, timeout_ns);
+#endif
+}
+
+static void waiter_wake(Waiter* w) {
+    atomic_store_explicit(&w->woken, 1, memory_order_release);
+#ifdef THREADS_FUTEX
+    syscall(SYS_futex, (uint32_t*)&w->woken, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    cond_signal(&w->cond);
+#endif
+}
+
+static void bucket_remove(WaitBucket* b, Waiter* w) {
+    Waiter* prev = NULL;
+    for (Waiter* cur = b->head; cur; prev = cur, cur = cur->next) {
+        if (cur == w) {
+            if (prev) prev->next = w->next; else b->head = w->next;
+            if (b->tail == w) b->tail = prev;
+            return;
+        }
+    }
+}
+
+static int wait_on(const void* addr, int size, uint64_t expected, int64_t timeout_ns) {
+    threads_init();
+    WaitBucket* b = bucket_for(addr);
+    mutex_lock(&b->lock);
+    uint64_t current = size == 4
+        ? (uint64_t)atomic_load((_Atomic uint32_t*)addr)
+        : atomic_load((_Atomic uint64_t*)addr);
+    if (current != expected) {
+        mutex_unlock(&b->lock);
+        return ATOMIC_WAIT_NOT_EQUAL;
+    }
+
+    Waiter w;
+    w.addr = addr;
+    w.next = NULL;
+    atomic_init(&w.woken, 0);
+#ifndef THREADS_FUTEX
+    cond_init(&w.cond);
+#endif
+    if (b->tail) b->tail->next = &w; else b->head = &w;
+    b->tail = &w;
+
+    int64_t deadline = -1;
+    if (timeout_ns >= 0) {
+        int64_t now = now_ns();
+        deadline = timeout_ns > INT64_MAX - now ? INT64_MAX : now + timeout_ns;
+    }
+    while (!atomic_load_explicit(&w.woken, memory_order_acquire)) {
+        int64_t remaining = -1;
+        if (deadline >= 0) {
+            remaining = deadline - now_ns();
+            if (remaining <= 0) break;
+        }
+        waiter_sleep(b, &w, remaining);
+    }
+
+    int result = ATOMIC_WAIT_OK;
+    if (!atomic_load_explicit(&w.woken, memory_order_acquire)) {
+        bucket_remove(b, &w);
+        result = ATOMIC_WAIT_TIMED_OUT;
+    }
+    mutex_unlock(&b->lock);
+#ifndef THREADS_FUTEX
+    cond_destroy(&w.cond);
+#endif
+    return result;
+}
+
+int threads_wait32(const uint32_t* addr, uint32_t expected, int64_t timeout_ns) {
+    return wait_on(addr, 4, expected, timeout_ns);
+}
+
+int threads_wait64(const uint64_t* addr, uint64_t expected, int64_t timeout_ns) {
+    return wait_on(addr, 8, expected, timeout_ns);
+}
+
+uint32_t threads_notify(const void* addr, uint32_t count) {
+    threads_init();
+    WaitBucket* b = bucket_for(addr);
+    uint32_t woken = 0;
+    mutex_lock(&b->lock);
+    Waiter* prev = NULL;
+    Waiter* cur = b->head;
+    while (cur && woken < count) {
+        Waiter* next = cur->next;
+        if (cur->addr == addr) {
+            if (prev) prev->next = next; else b->head = next;
+            if (b->tail == cur) b->tail = prev;
+            waiter_wake(cur);
+            woken++;
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    mutex_unlock(&b->lock);
+    return woken;
+}
+
+// ============================================================================
+// Locks
+// ============================================================================
+
+void threads_memory_lock(void) {
+    threads_init();
+    mutex_lock(&g_memory_lock);
+}
+
+void threads_memory_unlock(void) {
+    mutex_unlock(&g_memory_lock);
+}
+
+void threads_wasi_lock(void) {
+    threads_init();
+    mutex_lock(&g_wasi_lock);
+}
+
+void threads_wasi_unlock(void) {
+    mutex_unlock(&g_wasi_lock);
+}
+
+struct ThreadsLock {
+    ThreadsMutex mutex;
+};
+
+ThreadsLock* threads_lock_new(void) {
+    ThreadsLock* lock = (ThreadsLock*)malloc(sizeof(ThreadsLock));
+    if (lock) mutex_init(&lock->mutex);
+    return lock;
+}
+
+void threads_lock_free(ThreadsLock* lock) {
+#ifndef _WIN32
+    if (lock) pthread_mutex_destroy(&lock->mutex);
+#endif
+    free(lock);
+}
+
+void threads_lock_acquire(ThreadsLock* lock) {
+    mutex_lock(&lock->mutex);
+}
+
+void threads_lock_release(ThreadsLock* lock) {
+    mutex_unlock(&lock->mutex);
+}
+
+// ============================================================================
+// Address space reservations
+// ============================================================================
+
+// Record a new reservation. Returns 0, or -1 if out of memory
+static int reservation_add(void* base, uint64_t size) {
+    int err = 0;
+    mutex_lock(&g_reservations_lock);
+    if (g_num_reservations == g_reservations_capacity) {
+        int capacity = g_reservations_capacity > 0 ? g_reservations_capacity * 2 : 8;
+        Reservation* grown = (Reservation*)realloc(g_reservations,
+                                                   (size_t)capacity * sizeof(Reservation));
+        if (grown) {
+            g_reservations = grown;
+            g_reservations_capacity = capacity;
+        } else {
+            err = -1;
+        }
+    }
+    if (err == 0) {
+        g_reservations[g_num_reservations].base = (uintptr_t)base;
+        g_reservations[g_num_reservations].size = size;
+        g_num_reservations++;
+    }
+    mutex_unlock(&g_reservations_lock);
+    return err;
+}
+
+void* threads_memory_reserve(uint64_t size) {
+    if (size == 0 || size > (uint64_t)SIZE_MAX) return NULL;
+    threads_init();
+#ifdef _WIN32
+    void* p = VirtualAlloc(NULL, (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS);
+    if (p && reservation_add(p, size) != 0) {
+        VirtualFree(p, 0, MEM_RELEASE);
+        return NULL;
+    }
+    return p;
+#else
+    void* p = mmap(NULL, (size_t)size, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (reservation_add(p, size) != 0) {
+        munmap(p, (size_t)size);
+        return NULL;
+    }
+    return p;
+#endif
+}
+
+void threads_memory_release(void* addr, uint64_t size) {
+    if (!addr) return;
+    mutex_lock(&g_reservations_lock);
+    for (int i = 0; i < g_num_reservations; i++) {
+        if (g_reservations[i].base == (uintptr_t)addr) {
+            g_reservations[i] = g_reservations[--g_num_reservations];
+            break;
+        }
+    }
+    mutex_unlock(&g_reservations_lock);
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(addr, 0, MEM_RELEASE);
+#else
+    munmap(addr, (size_t)size);
+#endif
+}
+
+int threads_memory_reserved(const void* addr, uint64_t size) {
+    uintptr_t start = (uintptr_t)addr;
+    int found = 0;
+    threads_init();
+    mutex_lock(&g_reservations_lock);
+    for (int i = 0; i < g_num_reservations && !found; i++) {
+        const Reservation* r = &g_reservations[i];
+        found = start >= r->base && start - r->base <= r->size &&
+                size <= r->size - (start - r->base);
+    }
+    mutex_unlock(&g_reservations_lock);
+    return found;
+}
+
+int threads_memory_commit(void* addr, uint64_t size) {
+    if (size == 0) return 0;
+#ifdef _WIN32
+    return VirtualAlloc(addr, (SIZE_T)size, MEM_COMMIT, PAGE_READWRITE) ? 0 : -1;
+#else
+    return mprotect(addr, (size_t)size, PROT_READ | PROT_WRITE) == 0 ? 0 : -1;
+#endif
+}
+
+// ============================================================================
+// Host threads
+// ============================================================================
+
+int threads_num_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+typedef struct {
+    void (*fn)(void* arg);
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID p) {
+#else
+static void* thread_entry(void* p) {
+#endif
+    ThreadStart start = *(ThreadStart*)p;
+    free(p);
+    start.fn(start.arg);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int threads_start(void (*fn)(void* arg), void* arg) {
+    threads_init();
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return -1;
+    start->fn = fn;
+    start->arg = arg;
+
+    int ok;
+#ifdef _WIN32
+    HANDLE h = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    ok = h != NULL;
+    if (h) CloseHandle(h);
+#else
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ok = pthread_create(&tid, &attr, thread_entry, start) == 0;
+    pthread_attr_destroy(&attr);
+#endif
+    if (!ok) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
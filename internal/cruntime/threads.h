@@ -0,0 +1,68 @@
+// Threads support for wasm5: wait/notify on shared linear memory, the locks
+// that keep memory.grow and WASI calls consistent across threads, host
+// thread creation for wasi-threads, and the address space reservations that
+// back memory64 memories.
+
+#ifndef WASM5_THREADS_H
+#define WASM5_THREADS_H
+
+#include <stdint.h>
+
+// Per-thread storage for the interpreter's instance state
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// memory.atomic.wait results
+#define ATOMIC_WAIT_OK        0
+#define ATOMIC_WAIT_NOT_EQUAL 1
+#define ATOMIC_WAIT_TIMED_OUT 2
+
+// Block until addr is notified, if *addr still equals expected.
+// timeout_ns < 0 waits forever. Returns one of ATOMIC_WAIT_*
+int threads_wait32(const uint32_t* addr, uint32_t expected, int64_t timeout_ns);
+int threads_wait64(const uint64_t* addr, uint64_t expected, int64_t timeout_ns);
+
+// Wake up to count waiters blocked on addr. Returns the number woken
+uint32_t threads_notify(const void* addr, uint32_t count);
+
+// Serializes memory.grow on shared memories
+void threads_memory_lock(void);
+void threads_memory_unlock(void);
+
+// Serializes WASI calls once a second thread exists
+void threads_wasi_lock(void);
+void threads_wasi_unlock(void);
+
+// A mutex for short critical sections in runtime data structures
+typedef struct ThreadsLock ThreadsLock;
+ThreadsLock* threads_lock_new(void);  // NULL if out of memory
+void threads_lock_free(ThreadsLock* lock);
+void threads_lock_acquire(ThreadsLock* lock);
+void threads_lock_release(ThreadsLock* lock);
+
+// Reserve size bytes of address space, inaccessible until committed.
+// Returns its base or NULL
+void* threads_memory_reserve(uint64_t size);
+
+// Make size bytes at addr (page aligned, inside a reservation) readable and
+// writable; they read as zero. Returns 0, or -1 if out of memory
+int threads_memory_commit(void* addr, uint64_t size);
+
+// Release a reservation of size bytes at addr (NULL is ignored)
+void threads_memory_release(void* addr, uint64_t size);
+
+// 1 if [addr, addr + size) lies inside one reservation of
+// threads_memory_reserve, else 0
+int threads_memory_reserved(const void* addr, uint64_t size);
+
+// Number of online processors (at least 1)
+int threads_num_cpus(void);
+
+// Run fn(arg) on a new detached host thread. Returns 0, or -1 if the thread
+// could not be created
+int threads_start(void (*fn)(void* arg), void* arg);
+
+#endif
@@ -5,17 +5,26 @@
 #if defined(__linux__)
 #define _POSIX_C_SOURCE 200809L
 #define _DEFAULT_SOURCE
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // O_PATH
+#endif
 #elif defined(__APPLE__)
 // macOS: clock_gettime is available in macOS 10.12+
 #include <AvailabilityMacros.h>
+#elif defined(_WIN32)
+#define _CRT_RAND_S  // rand_s
 #endif
 
 #include "wasi.h"
+#include "wasi_uring.h"
+#include "wasi_vfs.h"
+#include "threads.h"
 
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <time.h>
 #include <errno.h>
 
@@ -28,8 +37,26 @@
 #else
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#endif
+#endif
 #endif
 
 #if !defined(_WIN32)
@@ -51,169 +78,1760 @@ typedef struct WasiContext {
 } WasiContext;
 
 static WasiContext g_wasi_ctx = {0, NULL, 0, NULL, 0, 0};
-
-// Preopen table (fd 0-2 are stdin/stdout/stderr, 3+ are directories)
-#define WASI_MAX_PREOPENS 8
+// proc_exit code of the instance that exited last on this thread
+static THREAD_LOCAL int g_thread_exit_code = 0;
+
+// Preopens (fd 0-2 are stdin/stdout/stderr, 3+ are directories, files or
+// listening sockets provided by the embedder). Fds below g_fd_base are
+// reserved for preopens; dynamic fds start at g_fd_base.
+#define WASI_MAX_PREOPENS 64
+#define WASI_DEFAULT_PREOPENS 8
 typedef struct WasiPreopen {
     int host_fd;
     const char* path;
+    uint8_t filetype;         // WASI_FILETYPE_DIRECTORY or _SOCKET_STREAM
+    uint8_t owned;            // Host fd (or VFS tree and path) was created here; release on reset
+    int8_t is_regular;        // Cached "is a regular file" flag, -1 = unknown
+    VfsNode* vfs;             // Root of an in-memory filesystem, or NULL
 } WasiPreopen;
 
-static WasiPreopen g_wasi_preopens[WASI_MAX_PREOPENS] = {
-    {0, "<stdin>"},
-    {1, "<stdout>"},
-    {2, "<stderr>"},
-    {-1, NULL},
-    {-1, NULL},
-    {-1, NULL},
-    {-1, NULL},
-    {-1, NULL},
-};
-static int g_wasi_num_preopens = 3;
+// Host fd recorded for in-memory (VFS) preopens and fds. It is never a valid
+// host fd, so a host call that is reached by mistake fails with EBADF.
+#define VFS_HOST_FD INT_MAX
 
-// Dynamic FD table for files opened via path_open
-#define MAX_WASI_FDS 256
+// Dynamic FD tables for files and sockets opened by the guest.
+// Slot i of the active table is WASI fd g_fd_base + i. Free slots are kept
+// on a stack for O(1) allocation (last freed is reused first, fresh slots in
+// ascending order); a slot taken directly by fd_renumber stays on the stack
+// and is skipped when popped.
+#define WASI_FD_TABLE_INITIAL 16
+#define WASI_DEFAULT_MAX_FDS 65536
 
 typedef struct {
     int host_fd;              // -1 if slot is free
     uint8_t filetype;         // WASI_FILETYPE_*
+    uint8_t on_free_stack;
     uint16_t flags;           // WASI_FDFLAGS_*
     uint64_t rights_base;
     uint64_t rights_inheriting;
+    VfsNode* vnode;           // In-memory file or directory, or NULL
+    uint64_t vfs_offset;      // File position of a VFS fd
 } WasiFdEntry;
 
-static WasiFdEntry g_fd_table[MAX_WASI_FDS];
-static int g_fd_table_initialized = 0;
+typedef struct RandomState RandomState;
+
+// An instance's fds. The default table holds the preopens the embedder adds;
+// each table from wasi_fd_table_new starts with its own copy of them, so
+// instances never share preopen slots. Preopen entries at and above
+// num_preopens are unused
+struct WasiFdTable {
+    WasiPreopen preopens[WASI_MAX_PREOPENS];
+    int num_preopens;
+    WasiFdEntry* entries;
+    int* free_stack;
+    int num_free;
+    int capacity;
+    int max_fds;              // 0 = g_default_max_fds
+    int num_open;
+    RandomState* random;      // The instance's random_get generator, or NULL
+};
+
+static int g_fd_base = WASI_DEFAULT_PREOPENS;
+
+static WasiFdTable g_default_fd_table = {
+    .preopens = {
+        {0, "<stdin>", WASI_FILETYPE_CHARACTER_DEVICE, 0, -1, NULL},
+        {1, "<stdout>", WASI_FILETYPE_CHARACTER_DEVICE, 0, -1, NULL},
+        {2, "<stderr>", WASI_FILETYPE_CHARACTER_DEVICE, 0, -1, NULL},
+    },
+    .num_preopens = 3,
+};
+// Active table; per thread, since threads may run different instances
+static THREAD_LOCAL WasiFdTable* g_fds = &g_default_fd_table;
+static int g_default_max_fds = WASI_DEFAULT_MAX_FDS;
+static int g_num_fd_tables = 0;   // Live tables from wasi_fd_table_new
 
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
-// Initialize the dynamic FD table
-static void init_fd_table(void) {
-    if (g_fd_table_initialized) return;
-    for (int i = 0; i < MAX_WASI_FDS; i++) {
-        g_fd_table[i].host_fd = -1;
-        g_fd_table[i].filetype = WASI_FILETYPE_UNKNOWN;
-        g_fd_table[i].flags = 0;
-        g_fd_table[i].rights_base = 0;
-        g_fd_table[i].rights_inheriting = 0;
+// Maximum number of slots (open dynamic fds) in a table
+static int fd_table_limit(const WasiFdTable* t) {
+    return t->max_fds > 0 ? t->max_fds : g_default_max_fds;
+}
+
+// Grow a table to at least min_capacity slots, within its fd limit.
+// New slots go to the bottom of the free stack so lower fds are reused first.
+// Returns 0 on success, -1 if the limit is reached or allocation fails
+static int fd_table_grow(WasiFdTable* t, int min_capacity) {
+    int limit = fd_table_limit(t);
+    if (min_capacity > limit) {
+        errno = EMFILE;
+        return -1;
+    }
+    int cap = t->capacity > 0 ? t->capacity : WASI_FD_TABLE_INITIAL;
+    while (cap < min_capacity) cap *= 2;
+    if (cap > limit) cap = limit;
+
+    WasiFdEntry* entries = (WasiFdEntry*)realloc(t->entries, (size_t)cap * sizeof(WasiFdEntry));
+    if (!entries) {
+        errno = ENOMEM;
+        return -1;
+    }
+    t->entries = entries;
+    int* free_stack = (int*)realloc(t->free_stack, (size_t)cap * sizeof(int));
+    if (!free_stack) {
+        errno = ENOMEM;
+        return -1;
+    }
+    t->free_stack = free_stack;
+
+    int added = cap - t->capacity;
+    memmove(free_stack + added, free_stack, (size_t)t->num_free * sizeof(int));
+    for (int i = 0; i < added; i++) {
+        int slot = cap - 1 - i;
+        entries[slot].host_fd = -1;
+        entries[slot].filetype = WASI_FILETYPE_UNKNOWN;
+        entries[slot].on_free_stack = 1;
+        entries[slot].flags = 0;
+        entries[slot].rights_base = 0;
+        entries[slot].rights_inheriting = 0;
+        entries[slot].vnode = NULL;
+        entries[slot].vfs_offset = 0;
+        free_stack[i] = slot;
+    }
+    t->num_free += added;
+    t->capacity = cap;
+    return 0;
+}
+
+// Allocate a new WASI fd from the active table
+// Returns WASI fd (>= g_fd_base), or -1 with errno set to EMFILE if the
+// table's fd limit is reached (ENOMEM if it cannot grow)
+static int allocate_fd(int host_fd, uint8_t filetype, uint16_t flags,
+                       uint64_t rights_base, uint64_t rights_inheriting) {
+    WasiFdTable* t = g_fds;
+    for (;;) {
+        while (t->num_free > 0) {
+            int slot = t->free_stack[--t->num_free];
+            WasiFdEntry* e = &t->entries[slot];
+            e->on_free_stack = 0;
+            if (e->host_fd >= 0) continue;   // Taken by fd_renumber
+            e->host_fd = host_fd;
+            e->filetype = filetype;
+            e->flags = flags;
+            e->rights_base = rights_base;
+            e->rights_inheriting = rights_inheriting;
+            e->vnode = NULL;
+            e->vfs_offset = 0;
+            t->num_open++;
+            return g_fd_base + slot;
+        }
+        if (fd_table_grow(t, t->capacity + 1) < 0) return -1;
+    }
+}
+
+// Free a WASI fd slot (the host fd is closed by the caller)
+static void free_fd(int wasi_fd) {
+    WasiFdTable* t = g_fds;
+    int slot = wasi_fd - g_fd_base;
+    if (slot < 0 || slot >= t->capacity || t->entries[slot].host_fd < 0) return;
+    WasiFdEntry* e = &t->entries[slot];
+    e->host_fd = -1;
+    e->filetype = WASI_FILETYPE_UNKNOWN;
+    e->flags = 0;
+    e->rights_base = 0;
+    e->rights_inheriting = 0;
+    e->vnode = NULL;
+    e->vfs_offset = 0;
+    t->num_open--;
+    if (!e->on_free_stack) {
+        e->on_free_stack = 1;
+        t->free_stack[t->num_free++] = slot;
+    }
+}
+
+// Get WasiFdEntry for a WASI fd (only for dynamic fds)
+static WasiFdEntry* get_fd_entry(int wasi_fd) {
+    int slot = wasi_fd - g_fd_base;
+    if (slot >= 0 && slot < g_fds->capacity && g_fds->entries[slot].host_fd >= 0) {
+        return &g_fds->entries[slot];
+    }
+    return NULL;
+}
+
+// In-memory node behind a WASI fd (a VFS preopen or a file opened beneath
+// one), or NULL for host fds
+static VfsNode* get_vfs_node(int wasi_fd) {
+    if (wasi_fd >= 3 && wasi_fd < g_fds->num_preopens) {
+        return g_fds->preopens[wasi_fd].vfs;
+    }
+    WasiFdEntry* entry = get_fd_entry(wasi_fd);
+    return entry ? entry->vnode : NULL;
+}
+
+// Host fds standing in for WASI stdin and stdout on this thread, -1 for
+// the process's own (see wasi_set_stdio_host_fds)
+static THREAD_LOCAL int g_stdio_redirect[2] = {-1, -1};
+
+// Get host fd from WASI fd, checking all fd sources
+// Returns host fd or -1 if invalid
+static int get_host_fd(int wasi_fd) {
+    if (wasi_fd < 0) return -1;
+
+    // stdio fds
+    if (wasi_fd < 2 && g_stdio_redirect[wasi_fd] >= 0) return g_stdio_redirect[wasi_fd];
+    if (wasi_fd < 3) return wasi_fd;
+
+    // Preopened directories (3 to g_fds->num_preopens - 1)
+    if (wasi_fd < g_fds->num_preopens) {
+        return g_fds->preopens[wasi_fd].host_fd;
+    }
+
+    // Dynamic fd table (>= g_fd_base)
+    WasiFdEntry* entry = get_fd_entry(wasi_fd);
+    return entry ? entry->host_fd : -1;
+}
+
+// 1 if the WASI fd refers to a socket (preopened listener or accepted connection)
+static int is_socket_fd(int wasi_fd) {
+    if (wasi_fd >= 3 && wasi_fd < g_fds->num_preopens) {
+        return g_fds->preopens[wasi_fd].filetype == WASI_FILETYPE_SOCKET_STREAM;
+    }
+    WasiFdEntry* entry = get_fd_entry(wasi_fd);
+    return entry && (entry->filetype == WASI_FILETYPE_SOCKET_STREAM ||
+                     entry->filetype == WASI_FILETYPE_SOCKET_DGRAM);
+}
+
+// Convert errno to WASI error code
+static uint32_t errno_to_wasi(int err) {
+    switch (err) {
+        case 0:       return WASI_ERRNO_SUCCESS;
+#ifdef EACCES
+        case EACCES:  return WASI_ERRNO_ACCES;
+#endif
+#ifdef EBADF
+        case EBADF:   return WASI_ERRNO_BADF;
+#endif
+#ifdef EEXIST
+        case EEXIST:  return WASI_ERRNO_EXIST;
+#endif
+#ifdef EINVAL
+        case EINVAL:  return WASI_ERRNO_INVAL;
+#endif
+#ifdef EIO
+        case EIO:     return WASI_ERRNO_IO;
+#endif
+#ifdef EISDIR
+        case EISDIR:  return WASI_ERRNO_ISDIR;
+#endif
+#ifdef ENOENT
+        case ENOENT:  return WASI_ERRNO_NOENT;
+#endif
+#ifdef ENOMEM
+        case ENOMEM:  return WASI_ERRNO_NOMEM;
+#endif
+#ifdef ENOSPC
+        case ENOSPC:  return WASI_ERRNO_NOSPC;
+#endif
+#ifdef ENOTDIR
+        case ENOTDIR: return WASI_ERRNO_NOTDIR;
+#endif
+#ifdef ENOTEMPTY
+        case ENOTEMPTY: return WASI_ERRNO_NOTEMPTY;
+#endif
+#ifdef EPERM
+        case EPERM:   return WASI_ERRNO_PERM;
+#endif
+#ifdef EROFS
+        case EROFS:   return WASI_ERRNO_ROFS;
+#endif
+#ifdef ESPIPE
+        case ESPIPE:  return WASI_ERRNO_SPIPE;
+#endif
+#ifdef ENAMETOOLONG
+        case ENAMETOOLONG: return WASI_ERRNO_NAMETOOLONG;
+#endif
+#ifdef EAGAIN
+        case EAGAIN:  return WASI_ERRNO_AGAIN;
+#endif
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK: return WASI_ERRNO_AGAIN;
+#endif
+#ifdef ENOTSOCK
+        case ENOTSOCK: return WASI_ERRNO_NOTSOCK;
+#endif
+#ifdef ENOTCONN
+        case ENOTCONN: return WASI_ERRNO_NOTCONN;
+#endif
+#ifdef ECONNRESET
+        case ECONNRESET: return WASI_ERRNO_CONNRESET;
+#endif
+#ifdef ECONNABORTED
+        case ECONNABORTED: return WASI_ERRNO_CONNABORTED;
+#endif
+#ifdef EPIPE
+        case EPIPE:   return WASI_ERRNO_PIPE;
+#endif
+#ifdef EMFILE
+        case EMFILE:  return WASI_ERRNO_MFILE;
+#endif
+#ifdef ENFILE
+        case ENFILE:  return WASI_ERRNO_NFILE;
+#endif
+#ifdef ELOOP
+        case ELOOP:   return WASI_ERRNO_LOOP;
+#endif
+#ifdef EXDEV
+        case EXDEV:   return WASI_ERRNO_XDEV;
+#endif
+#ifdef EFBIG
+        case EFBIG:   return WASI_ERRNO_FBIG;
+#endif
+        default:      return WASI_ERRNO_IO;
+    }
+}
+
+// ============================================================================
+// Scatter/Gather I/O
+// ============================================================================
+
+#ifdef _WIN32
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#endif
+
+// Upper bound on iovecs passed to a single readv/writev. Larger guest iovec
+// arrays are truncated, which WASI permits (callers handle short transfers).
+#if defined(IOV_MAX)
+#define WASI_MAX_IOVS IOV_MAX
+#else
+#define WASI_MAX_IOVS 1024
+#endif
+#define WASI_INLINE_IOVS 16
+
+// Host view of a guest iovec array: entries point straight into linear
+// memory, so reads and writes need no intermediate copy. Slot 0 of the
+// storage is reserved so callers can prepend one extra buffer in place.
+typedef struct HostIovecs {
+    struct iovec* iov;        // iov[0..count-1], iov[-1] is reserved
+    int count;
+    size_t total;             // Sum of iov_len
+    struct iovec* heap;       // Non-NULL if storage was malloc'd
+    struct iovec inline_iov[WASI_INLINE_IOVS + 1];
+} HostIovecs;
+
+// Translate a guest iovec array into host iovecs after bounds-checking the
+// array and every buffer it references. Returns WASI errno.
+static uint32_t host_iovecs_init(HostIovecs* h, uint8_t* mem, uint64_t mem_size,
+                                 uint32_t iovs_offset, uint32_t iovs_len) {
+    h->heap = NULL;
+    h->count = 0;
+    h->total = 0;
+    h->iov = h->inline_iov + 1;
+    if ((uint64_t)iovs_offset + (uint64_t)iovs_len * 8 > mem_size) {
+        return WASI_ERRNO_INVAL;
+    }
+    if (iovs_len > WASI_MAX_IOVS) {
+        iovs_len = WASI_MAX_IOVS;
+    }
+    if (iovs_len > WASI_INLINE_IOVS) {
+        h->heap = (struct iovec*)malloc((iovs_len + 1) * sizeof(struct iovec));
+        if (!h->heap) return WASI_ERRNO_NOMEM;
+        h->iov = h->heap + 1;
+    }
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        uint32_t buf_offset = *(uint32_t*)(mem + iovs_offset + i * 8);
+        uint32_t buf_len = *(uint32_t*)(mem + iovs_offset + i * 8 + 4);
+        if ((uint64_t)buf_offset + buf_len > mem_size) {
+            free(h->heap);
+            h->heap = NULL;
+            return WASI_ERRNO_INVAL;
+        }
+        h->iov[i].iov_base = mem + buf_offset;
+        h->iov[i].iov_len = buf_len;
+        h->total += buf_len;
+    }
+    h->count = (int)iovs_len;
+    return WASI_ERRNO_SUCCESS;
+}
+
+static void host_iovecs_free(HostIovecs* h) {
+    free(h->heap);
+    h->heap = NULL;
+}
+
+#ifdef _WIN32
+// Windows has no vectored I/O on CRT fds; emulate with one call per buffer.
+// offset < 0 means "use and advance the current file position".
+static ssize_t win_rw_iov(int host_fd, const struct iovec* iov, int iovcnt,
+                          int64_t offset, int is_write) {
+    int64_t saved_pos = -1;
+    if (offset >= 0) {
+        saved_pos = _lseeki64(host_fd, 0, SEEK_CUR);
+        if (saved_pos < 0 || _lseeki64(host_fd, offset, SEEK_SET) < 0) return -1;
+    }
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        unsigned int len = (unsigned int)iov[i].iov_len;
+        int n = is_write ? write(host_fd, iov[i].iov_base, len)
+                         : read(host_fd, iov[i].iov_base, len);
+        if (n < 0) {
+            if (total == 0) total = -1;
+            break;
+        }
+        total += n;
+        if ((unsigned int)n < len) break;
+    }
+    if (saved_pos >= 0) _lseeki64(host_fd, saved_pos, SEEK_SET);
+    return total;
+}
+#endif
+
+static ssize_t host_readv(int host_fd, const struct iovec* iov, int iovcnt) {
+#ifdef _WIN32
+    return win_rw_iov(host_fd, iov, iovcnt, -1, 0);
+#else
+    return readv(host_fd, iov, iovcnt);
+#endif
+}
+
+static ssize_t host_writev(int host_fd, const struct iovec* iov, int iovcnt) {
+#ifdef _WIN32
+    return win_rw_iov(host_fd, iov, iovcnt, -1, 1);
+#else
+    return writev(host_fd, iov, iovcnt);
+#endif
+}
+
+// writev() for sockets: a closed peer must surface as EPIPE, not SIGPIPE
+static ssize_t host_sendv(int host_fd, const struct iovec* iov, int iovcnt) {
+#if !defined(_WIN32) && defined(MSG_NOSIGNAL)
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*)iov;
+    msg.msg_iovlen = iovcnt;
+    return sendmsg(host_fd, &msg, MSG_NOSIGNAL);
+#else
+    return host_writev(host_fd, iov, iovcnt);
+#endif
+}
+
+static ssize_t host_preadv(int host_fd, const struct iovec* iov, int iovcnt,
+                           uint64_t offset) {
+#if defined(_WIN32)
+    return win_rw_iov(host_fd, iov, iovcnt, (int64_t)offset, 0);
+#elif defined(__linux__) || defined(__FreeBSD__)
+    return preadv(host_fd, iov, iovcnt, (off_t)offset);
+#else
+    // No preadv (older macOS): fall back to one pread per buffer
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        ssize_t n = pread(host_fd, iov[i].iov_base, iov[i].iov_len,
+                          (off_t)(offset + (uint64_t)total));
+        if (n < 0) return total > 0 ? total : -1;
+        total += n;
+        if ((size_t)n < iov[i].iov_len) break;
+    }
+    return total;
+#endif
+}
+
+static ssize_t host_pwritev(int host_fd, const struct iovec* iov, int iovcnt,
+                            uint64_t offset) {
+#if defined(_WIN32)
+    return win_rw_iov(host_fd, iov, iovcnt, (int64_t)offset, 1);
+#elif defined(__linux__) || defined(__FreeBSD__)
+    return pwritev(host_fd, iov, iovcnt, (off_t)offset);
+#else
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        ssize_t n = pwrite(host_fd, iov[i].iov_base, iov[i].iov_len,
+                           (off_t)(offset + (uint64_t)total));
+        if (n < 0) return total > 0 ? total : -1;
+        total += n;
+        if ((size_t)n < iov[i].iov_len) break;
+    }
+    return total;
+#endif
+}
+
+// ============================================================================
+// I/O Backend Selection
+// ============================================================================
+
+// Whether a host-backed fd refers to a regular file
+static int is_regular_fd(int wasi_fd, int host_fd) {
+    if (wasi_fd >= g_fd_base) {
+        WasiFdEntry* entry = get_fd_entry(wasi_fd);
+        return entry != NULL && entry->filetype == WASI_FILETYPE_REGULAR_FILE &&
+               entry->vnode == NULL;
+    }
+    if (wasi_fd < 0) return 0;
+    // Preopens cache the flag (fds 3 and up of the table they are in)
+    WasiPreopen* p = &g_fds->preopens[wasi_fd];
+    if (p->is_regular < 0) {
+#ifdef _WIN32
+        p->is_regular = 0;
+#else
+        struct stat st;
+        p->is_regular = (fstat(host_fd, &st) == 0 && S_ISREG(st.st_mode));
+#endif
+    }
+    return p->is_regular;
+}
+
+// Whether reads/writes on this fd go through the io_uring backend.
+// Only regular files use it; pipes, ttys and sockets stay synchronous.
+static int use_uring(int wasi_fd, int host_fd) {
+    return wasi_uring_enabled() && is_regular_fd(wasi_fd, host_fd);
+}
+
+// Select the WASI I/O backend. Returns the backend actually in use, which
+// is WASI_IO_BACKEND_SYNC if io_uring is unavailable on this host.
+int wasi_set_io_backend(int backend) {
+    if (backend == WASI_IO_BACKEND_IO_URING ||
+        backend == WASI_IO_BACKEND_IO_URING_WRITE_BEHIND) {
+        if (!wasi_uring_init(backend == WASI_IO_BACKEND_IO_URING_WRITE_BEHIND)) {
+            return WASI_IO_BACKEND_SYNC;
+        }
+        return wasi_get_io_backend();
+    }
+    wasi_uring_shutdown();
+    return WASI_IO_BACKEND_SYNC;
+}
+
+// Get the WASI I/O backend in use
+int wasi_get_io_backend(void) {
+    if (!wasi_uring_enabled()) return WASI_IO_BACKEND_SYNC;
+    return wasi_uring_write_behind() ? WASI_IO_BACKEND_IO_URING_WRITE_BEHIND
+                                     : WASI_IO_BACKEND_IO_URING;
+}
+
+// ============================================================================
+// Blocking Calls
+// ============================================================================
+
+// Guest WASI calls run under the WASI lock (wasi_call_lock), which guards
+// fd tables, output buffers and the rest of the WASI state. Host calls that
+// can wait indefinitely (reads from pipes and sockets, accept, poll_oneoff)
+// drop it while they wait, so one blocked thread does not stall the WASI
+// calls of all others. Between blocking_begin and blocking_end a call may
+// only use its locals and linear memory, never WASI state.
+
+static THREAD_LOCAL int g_wasi_locked = 0;  // This thread holds the WASI lock
+
+void wasi_call_lock(void) {
+    threads_wasi_lock();
+    g_wasi_locked = 1;
+}
+
+void wasi_call_unlock(void) {
+    g_wasi_locked = 0;
+    threads_wasi_unlock();
+}
+
+static void blocking_begin(void) {
+    if (g_wasi_locked) threads_wasi_unlock();
+}
+
+static void blocking_end(void) {
+    if (g_wasi_locked) threads_wasi_lock();
+}
+
+// ============================================================================
+// Mapped Reads
+// ============================================================================
+
+// Large reads from regular files can map the file's pages straight into
+// linear memory (MAP_FIXED | MAP_PRIVATE) instead of copying them. Only
+// whole host pages are mapped, and only where the destination address and
+// the file offset sit at the same position within a page; the rest of each
+// buffer is read normally. Guest stores to mapped pages are copy-on-write,
+// so the file is never modified.
+//
+// Pages are only mapped into memory the runtime reserved itself
+// (threads_memory_reserve, memory64 memories). Other linear memories are
+// FixedArrays owned by the MoonBit heap, whose pages must not be replaced
+// behind its back, so reads into them always copy.
+//
+// Off by default: pages the guest has not touched yet may still show later
+// changes made to the file by other processes, and truncating the file
+// under a mapping makes the next access fault. Not combined with io_uring,
+// which keeps its own readahead buffer and file position.
+#define MAPPED_READ_MIN (256 * 1024)   // Smaller reads are copied
+
+static int g_mapped_reads = 0;
+static size_t g_page_size = 0;
+static uint64_t g_mapped_read_bytes = 0;  // Bytes mapped instead of copied
+
+uint64_t wasi_mapped_read_bytes(void) {
+    return g_mapped_read_bytes;
+}
+
+// Enable or disable mapped reads. Returns whether they are enabled
+// afterwards (never on Windows)
+int wasi_set_mapped_reads(int enabled) {
+#ifdef _WIN32
+    (void)enabled;
+    return 0;
+#else
+    if (enabled && g_page_size == 0) {
+        long page = sysconf(_SC_PAGESIZE);
+        g_page_size = page > 0 ? (size_t)page : 4096;
+    }
+    g_mapped_reads = enabled != 0;
+    return g_mapped_reads;
+#endif
+}
+
+// Whether a read of h on this fd should try mapping pages
+static int use_mapped_read(int wasi_fd, int host_fd, const HostIovecs* h) {
+    return g_mapped_reads && h->total >= MAPPED_READ_MIN &&
+           !wasi_uring_enabled() && is_regular_fd(wasi_fd, host_fd);
+}
+
+#ifndef _WIN32
+// pread() until len bytes, end of file or an error. Returns the byte count,
+// or -1 if an error stopped it before anything was read
+static ssize_t pread_full(int host_fd, uint8_t* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(host_fd, buf + done, len - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return done > 0 ? (ssize_t)done : -1;
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+// Map file pages [offset, offset + len) over buf. On failure the range is
+// replaced with fresh anonymous memory, since MAP_FIXED may already have
+// discarded what was there. Returns 0 on success, -1 on failure
+static int map_file_pages(int host_fd, uint8_t* buf, size_t len, uint64_t offset) {
+    void* p = mmap(buf, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                   host_fd, (off_t)offset);
+    if (p != MAP_FAILED) return 0;
+    mmap(buf, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+    return -1;
+}
+#endif
+
+// preadv() that maps the page-aligned middle of each buffer when it lines
+// up with the file. Same contract as host_preadv
+static ssize_t mapped_preadv(int host_fd, const struct iovec* iov, int iovcnt,
+                             uint64_t offset) {
+#ifdef _WIN32
+    return host_preadv(host_fd, iov, iovcnt, offset);
+#else
+    struct stat st;
+    if (fstat(host_fd, &st) != 0) return -1;
+    uint64_t file_size = (uint64_t)st.st_size;
+    size_t page = g_page_size;
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        uint8_t* buf = (uint8_t*)iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        uint64_t pos = offset + total;
+        if (pos >= file_size) break;
+
+        // Whole pages inside both the buffer and the file are mapped
+        size_t head = 0;
+        size_t body = 0;
+        if ((uintptr_t)buf % page == pos % page && threads_memory_reserved(buf, len)) {
+            head = (page - (uintptr_t)buf % page) % page;
+            uint64_t avail = file_size - pos;
+            size_t span = avail < len ? (size_t)avail : len;
+            if (span > head) body = (span - head) / page * page;
+        }
+
+        size_t done = 0;
+        if (body > 0) {
+            ssize_t n = pread_full(host_fd, buf, head, pos);
+            if (n < 0) return total > 0 ? (ssize_t)total : -1;
+            if ((size_t)n < head) return (ssize_t)(total + (size_t)n);
+            done = head;
+            if (map_file_pages(host_fd, buf + head, body, pos + head) == 0) {
+                done += body;
+                g_mapped_read_bytes += body;
+            }
+        }
+        ssize_t n = pread_full(host_fd, buf + done, len - done, pos + done);
+        if (n < 0) return total + done > 0 ? (ssize_t)(total + done) : -1;
+        total += done + (size_t)n;
+        if (done + (size_t)n < len) break;
+    }
+    return (ssize_t)total;
+#endif
+}
+
+// readv() through mapped_preadv at the current file position
+static ssize_t mapped_readv(int host_fd, const struct iovec* iov, int iovcnt) {
+#ifdef _WIN32
+    return host_readv(host_fd, iov, iovcnt);
+#else
+    off_t pos = lseek(host_fd, 0, SEEK_CUR);
+    if (pos < 0) return host_readv(host_fd, iov, iovcnt);
+    ssize_t n = mapped_preadv(host_fd, iov, iovcnt, (uint64_t)pos);
+    if (n > 0) lseek(host_fd, pos + n, SEEK_SET);
+    return n;
+#endif
+}
+
+// ============================================================================
+// Output Buffering
+// ============================================================================
+
+// Optional userspace write buffers. Programs that print line by line would
+// otherwise issue one write() per line; buffering coalesces those writes and
+// flushes on size threshold, fd_sync/fd_datasync, proc_exit and at the end
+// of each execute() call. Disabled by default.
+#define WASI_OUTBUF_SIZE 8192
+#define WASI_MAX_OUTBUFS 8
+
+typedef struct WasiOutBuf {
+    int wasi_fd;              // -1 if slot is free
+    size_t len;
+    uint8_t data[WASI_OUTBUF_SIZE];
+} WasiOutBuf;
+
+static WasiOutBuf g_outbufs[WASI_MAX_OUTBUFS] = {
+    {-1, 0, {0}}, {-1, 0, {0}}, {-1, 0, {0}}, {-1, 0, {0}},
+    {-1, 0, {0}}, {-1, 0, {0}}, {-1, 0, {0}}, {-1, 0, {0}},
+};
+static int g_num_outbufs = 0;
+
+// Write all bytes described by iov, retrying on short writes and EINTR.
+// The iov array is consumed (modified) in the process, and *written gets
+// the number of bytes that reached the fd, also when an error stops it.
+// Returns 0 on success or -1 with errno set.
+static int write_all_iov(int host_fd, struct iovec* iov, int iovcnt, size_t* written) {
+    *written = 0;
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+        ssize_t n = host_writev(host_fd, iov,
+                                iovcnt < WASI_MAX_IOVS ? iovcnt : WASI_MAX_IOVS);
+        if (n < 0) {
+#ifdef EINTR
+            if (errno == EINTR) continue;
+#endif
+            return -1;
+        }
+        size_t done = (size_t)n;
+        *written += done;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+// Find the output buffer attached to a WASI fd, or NULL if unbuffered
+static WasiOutBuf* find_outbuf(int wasi_fd) {
+    // Redirected stdio bypasses the buffer, which belongs to the process's fd
+    if (wasi_fd < 2 && g_stdio_redirect[wasi_fd] >= 0) return NULL;
+    for (int i = 0; i < g_num_outbufs; i++) {
+        if (g_outbufs[i].wasi_fd == wasi_fd) {
+            return &g_outbufs[i];
+        }
+    }
+    return NULL;
+}
+
+// Drop the first n bytes of an output buffer, keeping the rest pending
+static void outbuf_consume(WasiOutBuf* buf, size_t n) {
+    memmove(buf->data, buf->data + n, buf->len - n);
+    buf->len -= n;
+}
+
+// Flush an output buffer to its host fd
+// Returns WASI errno; bytes that could not be written stay in the buffer
+static uint32_t flush_outbuf(WasiOutBuf* buf) {
+    if (buf == NULL || buf->len == 0) return WASI_ERRNO_SUCCESS;
+    int host_fd = buf->wasi_fd < 3 ? buf->wasi_fd : get_host_fd(buf->wasi_fd);
+    if (host_fd < 0) return WASI_ERRNO_BADF;
+    // Order after any writes still queued in the io_uring backend
+    wasi_uring_sync_fd(host_fd);
+    struct iovec iov = {buf->data, buf->len};
+    size_t written;
+    int rc = write_all_iov(host_fd, &iov, 1, &written);
+    int saved_errno = errno;
+    outbuf_consume(buf, written);
+    if (rc < 0) return errno_to_wasi(saved_errno);
+    return WASI_ERRNO_SUCCESS;
+}
+
+// Flush pending output for a WASI fd and settle io_uring state (pending
+// writes, readahead position) so the host fd reflects what the guest wrote
+static uint32_t flush_fd(int wasi_fd) {
+    uint32_t err = flush_outbuf(find_outbuf(wasi_fd));
+    if (wasi_uring_enabled()) {
+        int host_fd = get_host_fd(wasi_fd);
+        if (host_fd >= 0) wasi_uring_sync_fd(host_fd);
+    }
+    return err;
+}
+
+// Flush and detach the output buffer of a WASI fd
+static void drop_outbuf(int wasi_fd) {
+    WasiOutBuf* buf = find_outbuf(wasi_fd);
+    if (buf == NULL) return;
+    flush_outbuf(buf);
+    // Keep the buffer array compact so lookups only scan live slots
+    WasiOutBuf* last = &g_outbufs[g_num_outbufs - 1];
+    if (buf != last) {
+        buf->wasi_fd = last->wasi_fd;
+        buf->len = last->len;
+        memcpy(buf->data, last->data, last->len);
+    }
+    last->wasi_fd = -1;
+    last->len = 0;
+    g_num_outbufs--;
+}
+
+// Buffered fd_write path. Small writes are appended to the buffer; a write
+// that does not fit is sent together with the pending bytes in a single
+// writev(). Returns WASI errno and stores the number of guest bytes written
+// in *nwritten. If writing stops partway, the unwritten pending bytes stay
+// buffered, and a short count with success is returned once any guest
+// bytes went out (the next call reports the error).
+static uint32_t buffered_write(WasiOutBuf* buf, int host_fd, HostIovecs* h,
+                               size_t* nwritten) {
+    *nwritten = 0;
+    if (buf->len + h->total <= WASI_OUTBUF_SIZE) {
+        for (int i = 0; i < h->count; i++) {
+            memcpy(buf->data + buf->len, h->iov[i].iov_base, h->iov[i].iov_len);
+            buf->len += h->iov[i].iov_len;
+        }
+        *nwritten = h->total;
+        return WASI_ERRNO_SUCCESS;
+    }
+
+    // Prepend the pending bytes in the reserved slot before iov[0]
+    struct iovec* iov = h->iov;
+    int iovcnt = h->count;
+    if (buf->len > 0) {
+        iov--;
+        iov[0].iov_base = buf->data;
+        iov[0].iov_len = buf->len;
+        iovcnt++;
+    }
+    size_t pending = buf->len;
+    size_t written;
+    int rc = write_all_iov(host_fd, iov, iovcnt, &written);
+    int saved_errno = errno;
+    if (written < pending) {
+        outbuf_consume(buf, written);
+    } else {
+        buf->len = 0;
+        *nwritten = written - pending;
+    }
+    if (rc < 0 && *nwritten == 0) return errno_to_wasi(saved_errno);
+    return WASI_ERRNO_SUCCESS;
+}
+
+// Enable or disable output buffering for a stdio or preopened fd. Dynamic
+// fds are not buffered: their numbers depend on the active fd table.
+// Returns 0 on success, -1 if the fd is invalid or no buffer slot is free
+int wasi_set_fd_buffered(int wasi_fd, int enabled) {
+    if (!enabled) {
+        drop_outbuf(wasi_fd);
+        return 0;
+    }
+    if (wasi_fd <= 0 || wasi_fd >= g_fds->num_preopens) return -1;
+    if (get_host_fd(wasi_fd) < 0) return -1;
+    if (find_outbuf(wasi_fd) != NULL) return 0;
+    if (g_num_outbufs >= WASI_MAX_OUTBUFS) return -1;
+    g_outbufs[g_num_outbufs].wasi_fd = wasi_fd;
+    g_outbufs[g_num_outbufs].len = 0;
+    g_num_outbufs++;
+    return 0;
+}
+
+// Enable or disable output buffering for stdout and stderr
+void wasi_set_stdio_buffered(int enabled) {
+    wasi_set_fd_buffered(1, enabled);
+    wasi_set_fd_buffered(2, enabled);
+}
+
+// Flush all pending buffered output (called at instance teardown)
+void wasi_flush_all(void) {
+    for (int i = 0; i < g_num_outbufs; i++) {
+        flush_outbuf(&g_outbufs[i]);
+    }
+    wasi_uring_flush();
+}
+
+// ============================================================================
+// Poll State
+// ============================================================================
+
+// poll_oneoff keeps one epoll set per thread, which waits on it without the
+// WASI lock. Host fds stay registered between calls with their last
+// interest mask, so polling the same fds again costs a single epoll_wait;
+// registrations are only modified when interest changes. Registered fds
+// that fire without being subscribed are removed lazily. Clock
+// subscriptions arm a timerfd in the same set, which gives the wait
+// nanosecond resolution. A host fd closed by any thread bumps its close
+// count, so other threads re-register a reused fd number instead of
+// trusting their cached state.
+
+#if defined(__linux__)
+
+#define POLL_REG_NONE         0
+#define POLL_REG_ARMED        1   // In the epoll set with mask `events`
+#define POLL_REG_ALWAYS_READY 2   // Rejected by epoll (regular file, dir)
+
+#define POLL_TIMER_TOKEN UINT64_MAX
+
+typedef struct PollReg {
+    uint8_t state;
+    uint32_t events;        // Mask registered with epoll
+    uint32_t want;          // Mask wanted by the current call
+    uint32_t gen;           // Call that filled want/read_sub/write_sub
+    int read_sub;           // First fd_read subscription of this call, or -1
+    int write_sub;          // First fd_write subscription of this call, or -1
+    uint32_t closes;        // Close count of the fd when registered
+} PollReg;
+
+typedef struct PollState {
+    int epfd;               // -1 until first use
+    int timerfd;            // -1 until first clock subscription with fds
+    int timer_armed;
+    uint32_t gen;
+    PollReg* regs;          // Indexed by host fd
+    int num_regs;
+} PollState;
+
+static THREAD_LOCAL PollState g_poll = {-1, -1, 0, 0, NULL, 0};
+
+// Times each host fd was closed, shared by all threads
+static uint32_t* g_poll_closes = NULL;
+static int g_poll_num_closes = 0;
+
+static uint32_t poll_closes(int host_fd) {
+    return host_fd < g_poll_num_closes ? g_poll_closes[host_fd] : 0;
+}
+
+// Get the registration slot for a host fd, growing the table as needed
+static PollReg* poll_reg(int host_fd) {
+    if (host_fd >= g_poll.num_regs) {
+        int n = g_poll.num_regs ? g_poll.num_regs : 64;
+        while (n <= host_fd) n *= 2;
+        PollReg* regs = (PollReg*)realloc(g_poll.regs, (size_t)n * sizeof(PollReg));
+        if (!regs) return NULL;
+        memset(regs + g_poll.num_regs, 0, (size_t)(n - g_poll.num_regs) * sizeof(PollReg));
+        g_poll.regs = regs;
+        g_poll.num_regs = n;
+    }
+    return &g_poll.regs[host_fd];
+}
+
+// Register interest in events on host_fd.
+// Returns 0 if armed, 1 if the fd is always ready, -1 on error (errno set).
+static int poll_set_interest(int host_fd, PollReg* reg, uint32_t events) {
+    uint32_t closes = poll_closes(host_fd);
+    if (reg->closes != closes) {
+        // Closed (by any thread) since it was registered here
+        reg->state = POLL_REG_NONE;
+        reg->closes = closes;
+    }
+    if (reg->state == POLL_REG_ALWAYS_READY) return 1;
+    if (reg->state == POLL_REG_ARMED && reg->events == events) return 0;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = (uint64_t)host_fd;
+    int op = reg->state == POLL_REG_ARMED ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    int r = epoll_ctl(g_poll.epfd, op, host_fd, &ev);
+    // The fd may have been closed and reused without us noticing
+    if (r < 0 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+        r = epoll_ctl(g_poll.epfd, EPOLL_CTL_ADD, host_fd, &ev);
+    } else if (r < 0 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+        r = epoll_ctl(g_poll.epfd, EPOLL_CTL_MOD, host_fd, &ev);
+    }
+    if (r < 0) {
+        if (errno == EPERM) {
+            reg->state = POLL_REG_ALWAYS_READY;
+            return 1;
+        }
+        reg->state = POLL_REG_NONE;
+        return -1;
+    }
+    reg->state = POLL_REG_ARMED;
+    reg->events = events;
+    return 0;
+}
+
+static void poll_unregister(int host_fd, PollReg* reg) {
+    if (reg->state == POLL_REG_ARMED) {
+        epoll_ctl(g_poll.epfd, EPOLL_CTL_DEL, host_fd, NULL);
+    }
+    reg->state = POLL_REG_NONE;
+    reg->events = 0;
+}
+
+#endif
+
+// Drop cached poll state for a host fd that is about to be closed or
+// handed back to the embedder
+static void poll_forget_fd(int host_fd) {
+#if defined(__linux__)
+    if (host_fd < 0) return;
+    if (host_fd < g_poll.num_regs) {
+        poll_unregister(host_fd, &g_poll.regs[host_fd]);
+    }
+    if (host_fd >= g_poll_num_closes) {
+        int n = g_poll_num_closes ? g_poll_num_closes : 64;
+        while (n <= host_fd) n *= 2;
+        uint32_t* closes = (uint32_t*)realloc(g_poll_closes, (size_t)n * sizeof(uint32_t));
+        if (!closes) return;
+        memset(closes + g_poll_num_closes, 0, (size_t)(n - g_poll_num_closes) * sizeof(uint32_t));
+        g_poll_closes = closes;
+        g_poll_num_closes = n;
+    }
+    g_poll_closes[host_fd]++;
+#else
+    (void)host_fd;
+#endif
+}
+
+// Close this thread's epoll set and timerfd; the next poll creates new ones
+void wasi_thread_cleanup(void) {
+#if defined(__linux__)
+    if (g_poll.epfd >= 0) close(g_poll.epfd);
+    if (g_poll.timerfd >= 0) close(g_poll.timerfd);
+    free(g_poll.regs);
+    g_poll.epfd = -1;
+    g_poll.timerfd = -1;
+    g_poll.timer_armed = 0;
+    g_poll.regs = NULL;
+    g_poll.num_regs = 0;
+#endif
+}
+
+// ============================================================================
+// Directory Streams
+// ============================================================================
+
+// fd_readdir keeps the DIR stream of recently listed directories open, so a
+// listing that is read in small buffers continues where the previous call
+// stopped instead of reopening and seeking. The stream has its own open file
+// description (openat "."), so it does not move the guest's fd offset.
+// An entry that did not fit in the caller's buffer is kept for the next call.
+
+#ifndef _WIN32
+
+#define DIR_STREAM_MAX 8
+
+typedef struct DirStream {
+    int host_fd;            // -1 if slot is free
+    DIR* dir;
+    uint64_t cookie;        // Cookie of the next entry to return
+    uint32_t lru;
+    int has_pending;        // `pending` was read but not returned yet
+    uint64_t pending_next;  // Cookie after the pending entry
+    uint64_t pending_ino;
+    uint8_t pending_type;
+    uint32_t pending_namlen;
+    char pending_name[256];
+} DirStream;
+
+static DirStream g_dir_streams[DIR_STREAM_MAX] = {
+    {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}}, {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}},
+    {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}}, {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}},
+    {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}}, {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}},
+    {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}}, {-1, NULL, 0, 0, 0, 0, 0, 0, 0, {0}},
+};
+static uint32_t g_dir_stream_clock = 0;
+
+static void dir_stream_close(DirStream* ds) {
+    if (ds->dir) closedir(ds->dir);
+    ds->host_fd = -1;
+    ds->dir = NULL;
+    ds->has_pending = 0;
+}
+
+// Get the cached stream for a directory fd, opening one (and evicting the
+// least recently used) if needed. Returns NULL with errno set on failure.
+static DirStream* dir_stream_get(int host_fd) {
+    DirStream* victim = &g_dir_streams[0];
+    for (int i = 0; i < DIR_STREAM_MAX; i++) {
+        DirStream* ds = &g_dir_streams[i];
+        if (ds->host_fd == host_fd) {
+            ds->lru = ++g_dir_stream_clock;
+            return ds;
+        }
+        if (ds->host_fd < 0 || (victim->host_fd >= 0 && ds->lru < victim->lru)) {
+            victim = ds;
+        }
+    }
+
+    int fd = openat(host_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    dir_stream_close(victim);
+    victim->host_fd = host_fd;
+    victim->dir = dir;
+    victim->cookie = 0;
+    victim->lru = ++g_dir_stream_clock;
+    return victim;
+}
+
+#endif
+
+// Drop the cached stream for a host fd that is about to be closed
+static void dir_stream_forget(int host_fd) {
+#ifndef _WIN32
+    for (int i = 0; i < DIR_STREAM_MAX; i++) {
+        if (g_dir_streams[i].host_fd == host_fd) {
+            dir_stream_close(&g_dir_streams[i]);
+        }
+    }
+#else
+    (void)host_fd;
+#endif
+}
+
+// ============================================================================
+// Path Resolution
+// ============================================================================
+
+// Guest paths are resolved relative to a base directory fd (a preopen or a
+// directory opened with path_open) and may not leave it: absolute paths,
+// ".." above the base and symlinks pointing outside fail with NOTCAPABLE.
+// On Linux the kernel enforces this with openat2(RESOLVE_BENEATH); elsewhere
+// (or on kernels before 5.6) the path is checked lexically, which does not
+// catch escaping symlinks.
+//
+// Directories containing the final component are opened once as O_PATH
+// handles and cached by (base fd, relative path), so the *at() call for a
+// file deep in a tree only walks its last component. Cached handles are
+// dropped when their base fd is closed and whenever the guest renames or
+// removes a directory; changes made to the tree by other processes are not
+// tracked.
+
+#ifndef _WIN32
+
+#define DIR_HANDLE_CACHE_SIZE 64
+
+// Flags for directory handles and for probing where a path leads
+#ifdef O_PATH
+#define DIR_HANDLE_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#define PATH_PROBE_FLAGS (O_PATH | O_CLOEXEC)
+#else
+#define DIR_HANDLE_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#define PATH_PROBE_FLAGS (O_RDONLY | O_NONBLOCK | O_CLOEXEC)
+#endif
+
+typedef struct DirHandle {
+    char* path;             // NULL if slot is free
+    int base_fd;
+    int fd;                 // Handle of base_fd/path
+    uint32_t hash;
+    int pins;               // Held by an in-flight PathTarget
+} DirHandle;
+
+static DirHandle g_dir_handles[DIR_HANDLE_CACHE_SIZE];
+
+// Check that a relative path never climbs above its starting directory
+static int path_stays_beneath(const char* path) {
+    if (path[0] == '/') return 0;
+    int depth = 0;
+    const char* p = path;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 2 && p[0] == '.' && p[1] == '.') {
+            if (--depth < 0) return 0;
+        } else if (len > 0 && !(len == 1 && p[0] == '.')) {
+            depth++;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return 1;
+}
+
+// openat() that refuses to resolve outside dir_fd. Returns the host fd, or
+// -1 with errno set (EXDEV if the path escapes).
+static int open_beneath(int dir_fd, const char* path, int flags, int mode) {
+#if defined(RESOLVE_BENEATH) && defined(SYS_openat2)
+    static int have_openat2 = 1;
+    if (have_openat2) {
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = (uint64_t)flags;
+        how.mode = (flags & O_CREAT) ? (uint64_t)mode : 0;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        long fd = syscall(SYS_openat2, dir_fd, path, &how, sizeof(how));
+        if (fd >= 0 || errno != ENOSYS) return (int)fd;
+        have_openat2 = 0;
+    }
+#endif
+    if (!path_stays_beneath(path)) {
+        errno = EXDEV;
+        return -1;
+    }
+    return openat(dir_fd, path, flags, mode);
+}
+
+static void dir_handle_drop(DirHandle* h) {
+    if (!h->path) return;
+    close(h->fd);
+    free(h->path);
+    h->path = NULL;
+    h->pins = 0;
+}
+
+// Drop cached handles under a base fd (all of them if base_fd < 0)
+static void dir_handles_forget(int base_fd) {
+    for (int i = 0; i < DIR_HANDLE_CACHE_SIZE; i++) {
+        DirHandle* h = &g_dir_handles[i];
+        if (h->path && h->pins == 0 && (base_fd < 0 || h->base_fd == base_fd)) {
+            dir_handle_drop(h);
+        }
+    }
+}
+
+// Get a handle for the directory base_fd/dir, opening and caching it on a
+// miss. Returns the cache slot, or -1 with errno set. If the slot for dir is
+// pinned by another lookup, the handle is returned in *uncached instead.
+static int dir_handle_get(int base_fd, const char* dir, int* uncached) {
+    uint32_t hash = 2166136261u ^ (uint32_t)base_fd;
+    for (const char* p = dir; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    int slot = (int)(hash % DIR_HANDLE_CACHE_SIZE);
+    DirHandle* h = &g_dir_handles[slot];
+    if (h->path && h->base_fd == base_fd && h->hash == hash && strcmp(h->path, dir) == 0) {
+        return slot;
+    }
+
+    int fd = open_beneath(base_fd, dir, DIR_HANDLE_FLAGS, 0);
+    if (fd < 0) return -1;
+    char* copy = h->pins == 0 ? strdup(dir) : NULL;
+    if (!copy) {
+        *uncached = fd;
+        return -1;
+    }
+    dir_handle_drop(h);
+    h->path = copy;
+    h->base_fd = base_fd;
+    h->fd = fd;
+    h->hash = hash;
+    return slot;
+}
+
+#endif
+
+// A guest path split into the directory that holds its last component and
+// the component itself
+typedef struct PathTarget {
+    VfsNode* vfs;           // Base directory if it is in memory; `path` is then unsplit
+    int base_fd;            // Host fd of the guest's base directory
+    int dir_fd;             // Directory containing `name` (POSIX)
+    const char* name;       // Last component (POSIX), full host path (Windows)
+    char* path;             // Copy of the guest path, relative to base_fd
+    char* slash;            // Separator between dir and name, if any
+    int slot;               // Pinned g_dir_handles slot, or -1
+    int owned_fd;           // Uncached dir_fd to close, or -1
+    char inline_buf[256];
+} PathTarget;
+
+// Host fd of a directory the guest may resolve paths against
+static uint32_t get_base_dir(uint32_t dirfd, int* host_fd, const char** host_path) {
+    *host_path = NULL;
+    if (dirfd >= 3 && dirfd < (uint32_t)g_fds->num_preopens) {
+        if (g_fds->preopens[dirfd].host_fd < 0) return WASI_ERRNO_BADF;
+        if (g_fds->preopens[dirfd].filetype != WASI_FILETYPE_DIRECTORY) return WASI_ERRNO_NOTDIR;
+        *host_fd = g_fds->preopens[dirfd].host_fd;
+        *host_path = g_fds->preopens[dirfd].path;
+        return WASI_ERRNO_SUCCESS;
+    }
+#ifdef _WIN32
+    // Without *at() calls only preopens, which carry their path, can be bases
+    return WASI_ERRNO_BADF;
+#else
+    WasiFdEntry* entry = get_fd_entry((int)dirfd);
+    if (!entry) return WASI_ERRNO_BADF;
+    if (entry->filetype != WASI_FILETYPE_DIRECTORY) return WASI_ERRNO_NOTDIR;
+    *host_fd = entry->host_fd;
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
+
+static void path_release(PathTarget* t) {
+#ifndef _WIN32
+    if (t->slot >= 0) g_dir_handles[t->slot].pins--;
+    if (t->owned_fd >= 0) close(t->owned_fd);
+#else
+    if (t->name && t->name != t->path) free((char*)t->name);
+#endif
+    if (t->path && t->path != t->inline_buf) free(t->path);
+    t->path = NULL;
+}
+
+// The guest path relative to base_fd (undoes the dir/name split)
+static const char* path_full(PathTarget* t) {
+    if (t->slash) *t->slash = '/';
+    return t->path;
+}
+
+// Copy a guest path out of linear memory and resolve its directory part.
+// On success the caller must path_release() the target.
+static uint32_t path_resolve(uint32_t dirfd, uint8_t* mem, uint64_t mem_size,
+                             uint32_t path_ptr, uint32_t path_len, PathTarget* t) {
+    t->vfs = NULL;
+    t->path = NULL;
+    t->name = NULL;
+    t->slash = NULL;
+    t->slot = -1;
+    t->owned_fd = -1;
+    t->dir_fd = -1;
+
+    if ((uint64_t)path_ptr + path_len > mem_size) return WASI_ERRNO_INVAL;
+    if (path_len == 0) return WASI_ERRNO_NOENT;
+    if (memchr(mem + path_ptr, '\0', path_len)) return WASI_ERRNO_INVAL;
+
+    const char* base_path;
+    uint32_t err = get_base_dir(dirfd, &t->base_fd, &base_path);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    t->path = path_len < sizeof(t->inline_buf) ? t->inline_buf : malloc((size_t)path_len + 1);
+    if (!t->path) return WASI_ERRNO_NOMEM;
+    memcpy(t->path, mem + path_ptr, path_len);
+    t->path[path_len] = '\0';
+
+    // The VFS walks the whole path itself and keeps it beneath the base
+    t->vfs = get_vfs_node((int)dirfd);
+    if (t->vfs) {
+        t->name = t->path;
+        return WASI_ERRNO_SUCCESS;
+    }
+
+#ifdef _WIN32
+    if (!path_stays_beneath(t->path)) {
+        path_release(t);
+        return WASI_ERRNO_NOTCAPABLE;
+    }
+    if (!base_path || base_path[0] == '<') {
+        t->name = t->path;
+    } else {
+        size_t len = strlen(base_path) + 1 + path_len + 1;
+        char* full = malloc(len);
+        if (!full) {
+            path_release(t);
+            return WASI_ERRNO_NOMEM;
+        }
+        snprintf(full, len, "%s/%s", base_path, t->path);
+        t->name = full;
+    }
+    return WASI_ERRNO_SUCCESS;
+#else
+    (void)base_path;
+    if (t->path[0] == '/') {
+        path_release(t);
+        return WASI_ERRNO_NOTCAPABLE;
+    }
+
+    // Trailing slashes don't change which directory holds the last component
+    size_t len = path_len;
+    while (len > 1 && t->path[len - 1] == '/') t->path[--len] = '\0';
+
+    // "a/.." and "a/." name the directory itself, so resolve all of it
+    char* slash = strrchr(t->path, '/');
+    const char* last = slash ? slash + 1 : t->path;
+    int is_dot = strcmp(last, ".") == 0 || strcmp(last, "..") == 0;
+    const char* dir;
+    if (is_dot) {
+        dir = t->path;
+        t->name = ".";
+    } else if (slash) {
+        *slash = '\0';
+        t->slash = slash;
+        dir = t->path;
+        t->name = last;
+    } else {
+        dir = ".";
+        t->name = t->path;
+    }
+
+    if (strcmp(dir, ".") == 0) {
+        t->dir_fd = t->base_fd;
+        return WASI_ERRNO_SUCCESS;
+    }
+    int slot = dir_handle_get(t->base_fd, dir, &t->owned_fd);
+    if (slot >= 0) {
+        g_dir_handles[slot].pins++;
+        t->slot = slot;
+        t->dir_fd = g_dir_handles[slot].fd;
+    } else if (t->owned_fd >= 0) {
+        t->dir_fd = t->owned_fd;
+    } else {
+        err = errno == EXDEV ? WASI_ERRNO_NOTCAPABLE : errno_to_wasi(errno);
+        path_release(t);
+        return err;
+    }
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
+
+#ifndef _WIN32
+// Open the target itself. The last component is looked up beneath its
+// directory; if it leaves that directory (a symlink or "..") the whole path
+// is resolved again beneath the base fd.
+static int path_open_target(PathTarget* t, int flags, int mode) {
+    int fd = open_beneath(t->dir_fd, t->name, flags, mode);
+    if (fd < 0 && errno == EXDEV && t->dir_fd != t->base_fd) {
+        fd = open_beneath(t->base_fd, path_full(t), flags, mode);
+    }
+    return fd;
+}
+
+// Check a symlink-following lookup of the target stays beneath the base
+static uint32_t path_check_follow(PathTarget* t) {
+    struct stat st;
+    if (fstatat(t->dir_fd, t->name, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISLNK(st.st_mode)) {
+        return WASI_ERRNO_SUCCESS;
+    }
+    int fd = path_open_target(t, PATH_PROBE_FLAGS, 0);
+    if (fd < 0) return errno == EXDEV ? WASI_ERRNO_NOTCAPABLE : WASI_ERRNO_SUCCESS;
+    close(fd);
+    return WASI_ERRNO_SUCCESS;
+}
+#endif
+
+// Drop all cached state (poll registration, directory stream, directory
+// handles) for a host fd that is about to be closed or handed back to the
+// embedder
+static void forget_host_fd(int host_fd) {
+    poll_forget_fd(host_fd);
+    dir_stream_forget(host_fd);
+#ifndef _WIN32
+    dir_handles_forget(host_fd);
+#endif
+}
+
+// ============================================================================
+// In-Memory Filesystem
+// ============================================================================
+
+// Preopens added with wasi_add_preopen_vfs are trees of wasi_vfs.c nodes.
+// Their fds carry VFS_HOST_FD and a node reference instead of a host fd, and
+// each fd operation checks for a node before reaching the host path. Nodes
+// are shared, so a file written through one fd is visible through every
+// other fd and path that names it, and outlives its last name while open.
+
+// WASI errno for a negative errno returned by wasi_vfs.c
+static uint32_t vfs_errno(int rc) {
+    return rc == -EXDEV ? WASI_ERRNO_NOTCAPABLE : errno_to_wasi(-rc);
+}
+
+// Close the host fd or drop the node behind a dynamic fd table entry
+static void release_fd_entry(WasiFdEntry* entry) {
+    if (entry->vnode) {
+        vfs_unref(entry->vnode);
+        return;
+    }
+    forget_host_fd(entry->host_fd);
+    close(entry->host_fd);
+}
+
+// Read or write a VFS fd at `offset`, or at (and advancing) the fd position
+// if offset is negative. Appending fds always write at the end.
+static uint32_t vfs_fd_io(int wasi_fd, VfsNode* node, HostIovecs* h, int write,
+                          int64_t offset, size_t* done) {
+    WasiFdEntry* entry = get_fd_entry(wasi_fd);
+    uint64_t pos = offset >= 0 ? (uint64_t)offset : entry ? entry->vfs_offset : 0;
+    if (write && offset < 0 && entry && (entry->flags & WASI_FDFLAGS_APPEND)) {
+        pos = vfs_size(node);
+    }
+    long n = write ? vfs_pwrite(node, h->iov, h->count, pos)
+                   : vfs_pread(node, h->iov, h->count, pos);
+    if (n < 0) return vfs_errno((int)n);
+    if (offset < 0 && entry) entry->vfs_offset = pos + (uint64_t)n;
+    *done = (size_t)n;
+    return WASI_ERRNO_SUCCESS;
+}
+
+// Move the position of a VFS fd; whence is 0=SET, 1=CUR, 2=END
+static uint32_t vfs_fd_seek(int wasi_fd, VfsNode* node, int64_t offset, uint8_t whence,
+                            uint64_t* result) {
+    WasiFdEntry* entry = get_fd_entry(wasi_fd);
+    if (!entry) return WASI_ERRNO_ISDIR;   // Preopens are directories
+    int64_t base;
+    switch (whence) {
+        case 0: base = 0; break;
+        case 1: base = (int64_t)entry->vfs_offset; break;
+        case 2: base = (int64_t)vfs_size(node); break;
+        default: return WASI_ERRNO_INVAL;
+    }
+    if ((offset < 0 && base + offset < 0) || (offset > 0 && base > INT64_MAX - offset)) {
+        return WASI_ERRNO_INVAL;
+    }
+    entry->vfs_offset = (uint64_t)(base + offset);
+    *result = entry->vfs_offset;
+    return WASI_ERRNO_SUCCESS;
+}
+
+// Write a 64-byte WASI filestat for a VFS node
+static void vfs_put_filestat(uint8_t* buf, const VfsStat* st) {
+    memset(buf, 0, 64);
+    *(uint64_t*)(buf + 8) = st->ino;
+    buf[16] = st->filetype;
+    *(uint64_t*)(buf + 24) = st->nlink;
+    *(uint64_t*)(buf + 32) = st->size;
+    *(uint64_t*)(buf + 40) = st->atim;
+    *(uint64_t*)(buf + 48) = st->mtim;
+    *(uint64_t*)(buf + 56) = st->ctim;
+}
+
+// ============================================================================
+// Random Numbers
+// ============================================================================
+
+// random_get serves guests from a pool refilled in 4 KiB chunks, so small
+// requests (UUIDs, hash seeds) cost a memcpy rather than a syscall each.
+// By default the pool is filled from the OS CSPRNG (getrandom on Linux,
+// arc4random on macOS/BSD, rand_s on Windows) and requests of a pool or more
+// bypass it. WASI_RANDOM_CHACHA fills the pool with ChaCha20 keyed once from
+// the OS; after every refill the generator re-keys from its own output (fast
+// key erasure), so earlier output cannot be recovered from the state.
+// WASI_RANDOM_SEEDED is the same generator keyed from a fixed seed and
+// restarted by wasi_init, for reproducible test runs; it is predictable.
+// Bytes handed to the guest are wiped from the pool.
+//
+// The source is process-wide, but each instance has a generator and pool of
+// its own, kept with its WASI fd table (instances without one share the
+// default table's), so a seeded instance sees the same stream however its
+// calls interleave with other instances'.
+
+#define RANDOM_POOL_SIZE 4096
+
+struct RandomState {
+    uint32_t gen;             // g_random_gen this state was started for
+    int keyed;                // ChaCha20 key and counter are set
+    uint32_t key[8];
+    uint64_t counter;
+    uint32_t pool_pos;        // Bytes consumed; RANDOM_POOL_SIZE = empty
+    uint8_t pool[RANDOM_POOL_SIZE];
+};
+
+static int g_random_source = WASI_RANDOM_OS;
+static uint64_t g_random_seed = 0;   // WASI_RANDOM_SEEDED
+static uint32_t g_random_gen = 0;    // Bumped to restart every generator
+
+// Fill buf from the OS CSPRNG. Returns 0 on success, -1 on failure
+static int os_random(uint8_t* buf, size_t len) {
+#if defined(_WIN32)
+    while (len > 0) {
+        unsigned int r;
+        if (rand_s(&r) != 0) return -1;
+        size_t n = len < sizeof(r) ? len : sizeof(r);
+        memcpy(buf, &r, n);
+        buf += n;
+        len -= n;
+    }
+    return 0;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    arc4random_buf(buf, len);
+    return 0;
+#else
+#if defined(__linux__) && defined(SYS_getrandom)
+    while (len > 0) {
+        long n = syscall(SYS_getrandom, buf, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != ENOSYS) return -1;
+            break;  // Kernel before 3.17: use /dev/urandom
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    if (len == 0) return 0;
+#endif
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
     }
-    // Reserve 0-2 for stdio (not in fd_table, handled separately)
-    g_fd_table_initialized = 1;
+    close(fd);
+    return 0;
+#endif
 }
 
-// Allocate a new WASI fd from the dynamic table
-// Returns WASI fd (>= WASI_MAX_PREOPENS) or -1 if no free slots
-static int allocate_fd(int host_fd, uint8_t filetype, uint16_t flags,
-                       uint64_t rights_base, uint64_t rights_inheriting) {
-    init_fd_table();
-    // Start from WASI_MAX_PREOPENS to avoid collision with preopened fds
-    for (int i = WASI_MAX_PREOPENS; i < MAX_WASI_FDS; i++) {
-        if (g_fd_table[i].host_fd < 0) {
-            g_fd_table[i].host_fd = host_fd;
-            g_fd_table[i].filetype = filetype;
-            g_fd_table[i].flags = flags;
-            g_fd_table[i].rights_base = rights_base;
-            g_fd_table[i].rights_inheriting = rights_inheriting;
-            return i;
-        }
+// ChaCha20 with a 64-bit block counter and zero nonce. Four consecutive
+// blocks are computed side by side so compilers can keep them in vector
+// registers (about twice the throughput of one block at a time).
+#define CHACHA_LANES 4
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QR(a, b, c, d)                                               \
+    for (int l = 0; l < CHACHA_LANES; l++) {                                \
+        x[a][l] += x[b][l]; x[d][l] ^= x[a][l]; x[d][l] = CHACHA_ROTL(x[d][l], 16); \
+        x[c][l] += x[d][l]; x[b][l] ^= x[c][l]; x[b][l] = CHACHA_ROTL(x[b][l], 12); \
+        x[a][l] += x[b][l]; x[d][l] ^= x[a][l]; x[d][l] = CHACHA_ROTL(x[d][l], 8);  \
+        x[c][l] += x[d][l]; x[b][l] ^= x[c][l]; x[b][l] = CHACHA_ROTL(x[b][l], 7);  \
     }
-    return -1;  // No free slots
-}
 
-// Free a WASI fd from the dynamic table
-static void free_fd(int wasi_fd) {
-    if (wasi_fd >= WASI_MAX_PREOPENS && wasi_fd < MAX_WASI_FDS) {
-        g_fd_table[wasi_fd].host_fd = -1;
-        g_fd_table[wasi_fd].filetype = WASI_FILETYPE_UNKNOWN;
-        g_fd_table[wasi_fd].flags = 0;
-        g_fd_table[wasi_fd].rights_base = 0;
-        g_fd_table[wasi_fd].rights_inheriting = 0;
+// Keystream blocks counter .. counter + CHACHA_LANES - 1 (64 bytes each)
+static void chacha20_blocks(const uint32_t key[8], uint64_t counter, uint8_t* out) {
+    uint32_t in[16][CHACHA_LANES];
+    uint32_t x[16][CHACHA_LANES];
+    for (int l = 0; l < CHACHA_LANES; l++) {
+        uint64_t n = counter + (uint64_t)l;
+        in[0][l] = 0x61707865;
+        in[1][l] = 0x3320646e;
+        in[2][l] = 0x79622d32;
+        in[3][l] = 0x6b206574;
+        for (int i = 0; i < 8; i++) in[4 + i][l] = key[i];
+        in[12][l] = (uint32_t)n;
+        in[13][l] = (uint32_t)(n >> 32);
+        in[14][l] = 0;
+        in[15][l] = 0;
+    }
+    memcpy(x, in, sizeof(x));
+    for (int round = 0; round < 10; round++) {
+        CHACHA_QR(0, 4, 8, 12)
+        CHACHA_QR(1, 5, 9, 13)
+        CHACHA_QR(2, 6, 10, 14)
+        CHACHA_QR(3, 7, 11, 15)
+        CHACHA_QR(0, 5, 10, 15)
+        CHACHA_QR(1, 6, 11, 12)
+        CHACHA_QR(2, 7, 8, 13)
+        CHACHA_QR(3, 4, 9, 14)
+    }
+    for (int l = 0; l < CHACHA_LANES; l++) {
+        for (int i = 0; i < 16; i++) {
+            uint32_t v = x[i][l] + in[i][l];
+            uint8_t* p = out + 64 * l + 4 * i;
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+            p[2] = (uint8_t)(v >> 16);
+            p[3] = (uint8_t)(v >> 24);
+        }
     }
 }
 
-// Get host fd from WASI fd, checking all fd sources
-// Returns host fd or -1 if invalid
-static int get_host_fd(int wasi_fd) {
-    init_fd_table();
-    if (wasi_fd < 0) return -1;
-
-    // stdio fds
-    if (wasi_fd < 3) return wasi_fd;
-
-    // Preopened directories (3 to g_wasi_num_preopens - 1)
-    if (wasi_fd < g_wasi_num_preopens) {
-        return g_wasi_preopens[wasi_fd].host_fd;
-    }
+// Forget all generator state; the next request starts the stream afresh
+static void random_reset(RandomState* r) {
+    r->gen = g_random_gen;
+    r->keyed = 0;
+    r->counter = 0;
+    memset(r->key, 0, sizeof(r->key));
+    memset(r->pool, 0, sizeof(r->pool));
+    r->pool_pos = RANDOM_POOL_SIZE;
+}
 
-    // Dynamic fd table (>= WASI_MAX_PREOPENS)
-    if (wasi_fd >= WASI_MAX_PREOPENS && wasi_fd < MAX_WASI_FDS) {
-        return g_fd_table[wasi_fd].host_fd;
+// Generator of the active fd table's instance, restarted if the source
+// changed since it last ran. NULL if out of memory
+static RandomState* random_state(void) {
+    RandomState* r = g_fds->random;
+    if (!r) {
+        r = (RandomState*)malloc(sizeof(RandomState));
+        if (!r) return NULL;
+        random_reset(r);
+        g_fds->random = r;
+    } else if (r->gen != g_random_gen) {
+        random_reset(r);
     }
+    return r;
+}
 
-    return -1;
+// Wipe and free a table's generator
+static void random_state_free(WasiFdTable* t) {
+    if (!t->random) return;
+    random_reset(t->random);
+    free(t->random);
+    t->random = NULL;
 }
 
-// Get WasiFdEntry for a WASI fd (only for dynamic fds)
-static WasiFdEntry* get_fd_entry(int wasi_fd) {
-    init_fd_table();
-    if (wasi_fd >= WASI_MAX_PREOPENS && wasi_fd < MAX_WASI_FDS) {
-        if (g_fd_table[wasi_fd].host_fd >= 0) {
-            return &g_fd_table[wasi_fd];
+// Refill r's pool from the selected source. Returns 0 on success, -1 on failure
+static int random_refill(RandomState* r) {
+    if (g_random_source == WASI_RANDOM_OS) {
+        if (os_random(r->pool, RANDOM_POOL_SIZE) < 0) return -1;
+        r->pool_pos = 0;
+        return 0;
+    }
+    if (!r->keyed) {
+        if (g_random_source == WASI_RANDOM_SEEDED) {
+            memset(r->key, 0, sizeof(r->key));
+            r->key[0] = (uint32_t)g_random_seed;
+            r->key[1] = (uint32_t)(g_random_seed >> 32);
+        } else if (os_random((uint8_t*)r->key, sizeof(r->key)) < 0) {
+            return -1;
         }
+        r->counter = 0;
+        r->keyed = 1;
     }
-    return NULL;
+    for (size_t i = 0; i < RANDOM_POOL_SIZE; i += 64 * CHACHA_LANES) {
+        chacha20_blocks(r->key, r->counter, r->pool + i);
+        r->counter += CHACHA_LANES;
+    }
+    // The first 32 bytes become the next key and are never handed out
+    for (int i = 0; i < 8; i++) {
+        const uint8_t* p = r->pool + 4 * i;
+        r->key[i] = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+                    (uint32_t)p[3] << 24;
+    }
+    memset(r->pool, 0, 32);
+    r->pool_pos = 32;
+    return 0;
 }
 
-// Convert errno to WASI error code
-static uint32_t errno_to_wasi(int err) {
-    switch (err) {
-        case 0:       return WASI_ERRNO_SUCCESS;
-#ifdef EACCES
-        case EACCES:  return WASI_ERRNO_ACCES;
-#endif
-#ifdef EBADF
-        case EBADF:   return WASI_ERRNO_BADF;
-#endif
-#ifdef EEXIST
-        case EEXIST:  return WASI_ERRNO_EXIST;
-#endif
-#ifdef EINVAL
-        case EINVAL:  return WASI_ERRNO_INVAL;
-#endif
-#ifdef EIO
-        case EIO:     return WASI_ERRNO_IO;
-#endif
-#ifdef EISDIR
-        case EISDIR:  return WASI_ERRNO_ISDIR;
-#endif
-#ifdef ENOENT
-        case ENOENT:  return WASI_ERRNO_NOENT;
-#endif
-#ifdef ENOSPC
-        case ENOSPC:  return WASI_ERRNO_NOSPC;
-#endif
-#ifdef ENOTDIR
-        case ENOTDIR: return WASI_ERRNO_NOTDIR;
-#endif
-#ifdef ENOTEMPTY
-        case ENOTEMPTY: return WASI_ERRNO_NOTEMPTY;
-#endif
-#ifdef EPERM
-        case EPERM:   return WASI_ERRNO_PERM;
-#endif
-#ifdef EROFS
-        case EROFS:   return WASI_ERRNO_ROFS;
-#endif
-#ifdef ESPIPE
-        case ESPIPE:  return WASI_ERRNO_SPIPE;
-#endif
-#ifdef ENAMETOOLONG
-        case ENAMETOOLONG: return WASI_ERRNO_NAMETOOLONG;
-#endif
-        default:      return WASI_ERRNO_IO;
+// Copy random bytes from the active instance's generator to out.
+// Returns 0 on success, -1 on failure
+static int random_fill(uint8_t* out, size_t len) {
+    if (g_random_source == WASI_RANDOM_OS && len >= RANDOM_POOL_SIZE) return os_random(out, len);
+    RandomState* r = random_state();
+    if (!r) return -1;
+    while (len > 0) {
+        if (r->pool_pos == RANDOM_POOL_SIZE && random_refill(r) < 0) return -1;
+        size_t n = RANDOM_POOL_SIZE - r->pool_pos;
+        if (n > len) n = len;
+        memcpy(out, r->pool + r->pool_pos, n);
+        memset(r->pool + r->pool_pos, 0, n);
+        r->pool_pos += (uint32_t)n;
+        out += n;
+        len -= n;
     }
+    return 0;
+}
+
+// Select the random_get source and restart every instance's generator
+int wasi_set_random_source(int source, uint64_t seed) {
+    if (source < WASI_RANDOM_OS || source > WASI_RANDOM_SEEDED) return -1;
+    g_random_source = source;
+    g_random_seed = seed;
+    g_random_gen++;
+    // Wipe the default table's pool now; other tables reset on next use
+    if (g_default_fd_table.random) random_reset(g_default_fd_table.random);
+    return 0;
 }
 
 // ============================================================================
@@ -227,9 +1845,40 @@ void wasi_init(int argc, char** argv) {
     g_wasi_ctx.exit_code = 0;
     g_wasi_ctx.has_exited = 0;
 
+#ifndef _WIN32
+    // Preopen host fd numbers from an earlier run may have been reused
+    dir_handles_forget(-1);
+#endif
+
     // Initialize environment (simplified - no env vars for now)
     g_wasi_ctx.environ_count = 0;
     g_wasi_ctx.environ = NULL;
+
+    // WASM5_WASI_IO=io_uring opts into the io_uring backend (if available);
+    // io_uring-write-behind also acknowledges writes before they land
+    const char* io_backend = getenv("WASM5_WASI_IO");
+    if (io_backend != NULL && strcmp(io_backend, "io_uring") == 0) {
+        wasi_set_io_backend(WASI_IO_BACKEND_IO_URING);
+    } else if (io_backend != NULL && strcmp(io_backend, "io_uring-write-behind") == 0) {
+        wasi_set_io_backend(WASI_IO_BACKEND_IO_URING_WRITE_BEHIND);
+    }
+
+    // WASM5_WASI_MMAP=1 maps large regular-file reads into linear memory
+    const char* mapped = getenv("WASM5_WASI_MMAP");
+    if (mapped != NULL && strcmp(mapped, "1") == 0) {
+        wasi_set_mapped_reads(1);
+    }
+
+    // WASM5_WASI_RANDOM=chacha or seed:<n> selects the random_get source;
+    // a seeded stream restarts so every run sees the same bytes
+    const char* random = getenv("WASM5_WASI_RANDOM");
+    if (random != NULL && strcmp(random, "chacha") == 0) {
+        wasi_set_random_source(WASI_RANDOM_CHACHA, 0);
+    } else if (random != NULL && strncmp(random, "seed:", 5) == 0) {
+        wasi_set_random_source(WASI_RANDOM_SEEDED, strtoull(random + 5, NULL, 0));
+    } else if (g_random_source == WASI_RANDOM_SEEDED) {
+        wasi_set_random_source(WASI_RANDOM_SEEDED, g_random_seed);
+    }
 }
 
 // Get WASI exit code
@@ -237,6 +1886,11 @@ int wasi_get_exit_code(void) {
     return g_wasi_ctx.exit_code;
 }
 
+// Exit code of the last proc_exit on this thread
+int wasi_thread_exit_code(void) {
+    return g_thread_exit_code;
+}
+
 // Check if WASI has exited
 int wasi_has_exited(void) {
     return g_wasi_ctx.has_exited;
@@ -248,16 +1902,138 @@ void wasi_init_empty(void) {
     wasi_init(1, empty_argv);
 }
 
-// Add a preopened file to the WASI environment
+// Add a preopened file to the WASI environment. Preopens are added to the
+// default table; instances whose fd table is created afterwards get a copy.
 // Returns the WASI fd number (3+) or -1 on error
 int wasi_add_preopen_file(int host_fd, const char* path) {
-    if (g_wasi_num_preopens >= WASI_MAX_PREOPENS) {
+    WasiFdTable* t = &g_default_fd_table;
+    if (t->num_preopens >= g_fd_base) {
+        return -1;
+    }
+    int wasi_fd = t->num_preopens;
+    t->preopens[wasi_fd].host_fd = host_fd;
+    t->preopens[wasi_fd].path = path;
+    t->preopens[wasi_fd].filetype = WASI_FILETYPE_DIRECTORY;
+    t->preopens[wasi_fd].owned = 0;
+    t->preopens[wasi_fd].is_regular = -1;
+    t->preopens[wasi_fd].vfs = NULL;
+    t->num_preopens++;
+    return wasi_fd;
+}
+
+// Add a listening socket (TCP or Unix) to the WASI environment. The guest
+// accepts connections on it with sock_accept.
+// Returns the WASI fd number (3+) or -1 on error
+int wasi_add_preopen_socket(int host_fd) {
+    int wasi_fd = wasi_add_preopen_file(host_fd, "<socket>");
+    if (wasi_fd >= 0) {
+        g_default_fd_table.preopens[wasi_fd].filetype = WASI_FILETYPE_SOCKET_STREAM;
+    }
+    return wasi_fd;
+}
+
+// Create a non-blocking listening socket and add it as a preopen.
+// addr is "host:port" ("[v6addr]:port" for IPv6) or "unix:/path".
+// The socket is closed by wasi_reset_preopens.
+// Returns the WASI fd number (3+) or -1 on error
+int wasi_add_preopen_listener(const uint8_t* addr, int addr_len, int backlog) {
+#ifdef _WIN32
+    (void)addr;
+    (void)addr_len;
+    (void)backlog;
+    return -1;
+#else
+    char buf[256];
+    if (addr_len <= 0 || (size_t)addr_len >= sizeof(buf)) return -1;
+    if (g_default_fd_table.num_preopens >= g_fd_base) return -1;
+    memcpy(buf, addr, (size_t)addr_len);
+    buf[addr_len] = '\0';
+    if (backlog <= 0) backlog = 128;
+
+    int fd = -1;
+    if (strncmp(buf, "unix:", 5) == 0) {
+        struct sockaddr_un sun;
+        const char* path = buf + 5;
+        if (strlen(path) >= sizeof(sun.sun_path)) return -1;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (bind(fd, (struct sockaddr*)&sun, sizeof(sun)) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        // Split host and port at the last ':'; strip [] around IPv6 hosts
+        char* colon = strrchr(buf, ':');
+        if (!colon) return -1;
+        *colon = '\0';
+        char* host = buf;
+        const char* port = colon + 1;
+        size_t host_len = strlen(host);
+        if (host_len >= 2 && host[0] == '[' && host[host_len - 1] == ']') {
+            host[host_len - 1] = '\0';
+            host++;
+        }
+        struct addrinfo hints;
+        struct addrinfo* res = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+        if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) return -1;
+        for (struct addrinfo* ai = res; ai != NULL; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(res);
+        if (fd < 0) return -1;
+    }
+    int fl = fcntl(fd, F_GETFL);
+    if (listen(fd, backlog) < 0 || fl < 0 ||
+        fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        close(fd);
+        return -1;
+    }
+    int wasi_fd = wasi_add_preopen_socket(fd);
+    if (wasi_fd < 0) {
+        close(fd);
+        return -1;
+    }
+    g_default_fd_table.preopens[wasi_fd].owned = 1;
+    return wasi_fd;
+#endif
+}
+
+// Add an empty in-memory directory preopened under the guest path, filled
+// from a tar archive if tar_len > 0. The tree lives until wasi_reset_preopens.
+// Returns the WASI fd number (3+) or -1 on error (including a malformed tar)
+int wasi_add_preopen_vfs(const uint8_t* path, int path_len, const uint8_t* tar, int tar_len) {
+    if (path_len < 0 || tar_len < 0) return -1;
+    if (g_default_fd_table.num_preopens >= g_fd_base) return -1;
+    VfsNode* root = vfs_new_root();
+    if (!root) return -1;
+    if (tar_len > 0 && vfs_load_tar(root, tar, (size_t)tar_len) < 0) {
+        vfs_unref(root);
+        return -1;
+    }
+    char* copy = (char*)malloc((size_t)path_len + 1);
+    if (!copy) {
+        vfs_unref(root);
         return -1;
     }
-    int wasi_fd = g_wasi_num_preopens;
-    g_wasi_preopens[wasi_fd].host_fd = host_fd;
-    g_wasi_preopens[wasi_fd].path = path;
-    g_wasi_num_preopens++;
+    memcpy(copy, path, (size_t)path_len);
+    copy[path_len] = '\0';
+    int wasi_fd = wasi_add_preopen_file(VFS_HOST_FD, copy);
+    g_default_fd_table.preopens[wasi_fd].vfs = root;
+    g_default_fd_table.preopens[wasi_fd].owned = 1;
     return wasi_fd;
 }
 
@@ -266,17 +2042,176 @@ int wasi_add_preopen_file_ffi(int host_fd) {
     return wasi_add_preopen_file(host_fd, "<test>");
 }
 
-// Reset preopens to just stdin/stdout/stderr
+// Flush and release the preopens (fd 3+) of a table and leave it with just
+// stdin/stdout/stderr. Host fds stay open unless the table owns them
+static void preopens_release(WasiFdTable* t) {
+    // Flush and detach buffers of preopened files
+    WasiFdTable* prev = wasi_fd_table_activate(t == &g_default_fd_table ? NULL : t);
+    for (int i = 3; i < t->num_preopens; i++) {
+        flush_fd(i);
+        if (t == &g_default_fd_table) drop_outbuf(i);
+    }
+    wasi_fd_table_activate(prev);
+    for (int i = 3; i < t->num_preopens; i++) {
+        WasiPreopen* p = &t->preopens[i];
+        if (p->host_fd < 0) continue;
+        // Files opened beneath a VFS preopen keep their nodes alive until
+        // closed
+        if (p->vfs) {
+            vfs_unref(p->vfs);
+            free((char*)p->path);
+        } else {
+            forget_host_fd(p->host_fd);
+            if (p->owned) close(p->host_fd);
+            if (t != &g_default_fd_table) free((char*)p->path);
+        }
+        p->host_fd = -1;
+        p->path = NULL;
+        p->filetype = WASI_FILETYPE_UNKNOWN;
+        p->owned = 0;
+        p->is_regular = -1;
+        p->vfs = NULL;
+    }
+    t->num_preopens = 3;
+}
+
+// Copy the default table's preopens into t, a table from wasi_fd_table_new.
+// Host fds are duplicated and VFS trees shared, so the copies stay valid
+// whatever happens to the default table, until wasi_fd_table_free.
+// Returns 0, or -1 with errno set
+static int preopens_copy(WasiFdTable* t) {
+    const WasiFdTable* src = &g_default_fd_table;
+    memcpy(t->preopens, src->preopens, 3 * sizeof(WasiPreopen));
+    t->num_preopens = 3;
+    for (int i = 3; i < src->num_preopens; i++) {
+        const WasiPreopen* from = &src->preopens[i];
+        WasiPreopen* p = &t->preopens[i];
+        char* path = from->path ? strdup(from->path) : NULL;
+        if (from->path && !path) {
+            errno = ENOMEM;
+            return -1;
+        }
+        int host_fd = from->host_fd;
+        if (!from->vfs && host_fd >= 0) {
+#ifdef _WIN32
+            host_fd = _dup(host_fd);
+#else
+            host_fd = fcntl(host_fd, F_DUPFD_CLOEXEC, 0);
+#endif
+            if (host_fd < 0) {
+                free(path);
+                return -1;
+            }
+        }
+        if (from->vfs) vfs_ref(from->vfs);
+        p->host_fd = host_fd;
+        p->path = path;
+        p->filetype = from->filetype;
+        p->owned = 1;
+        p->is_regular = -1;
+        p->vfs = from->vfs;
+        t->num_preopens++;
+    }
+    return 0;
+}
+
+// Reset preopens to just stdin/stdout/stderr. The caller owns (and may
+// close) the host fds it added once this returns, except for listeners and
+// VFS trees created here; instances keep their copies
 void wasi_reset_preopens(void) {
-    // Close any open preopened files (fd 3+)
-    for (int i = 3; i < g_wasi_num_preopens; i++) {
-        if (g_wasi_preopens[i].host_fd >= 0) {
-            // Don't close - the caller is responsible for closing host fds
-            g_wasi_preopens[i].host_fd = -1;
-            g_wasi_preopens[i].path = NULL;
+    preopens_release(&g_default_fd_table);
+}
+
+// Set the preopen reservation (first dynamic fd) and the default fd limit
+// Returns 0 on success, -1 if out of range or fds/tables already exist
+int wasi_set_fd_limits(int max_preopens, int max_fds) {
+    if (max_preopens < 4 || max_preopens > WASI_MAX_PREOPENS || max_fds < 1) return -1;
+    if (max_preopens != g_fd_base) {
+        // Renumbering would invalidate preopens and fds already handed out
+        if (g_default_fd_table.num_preopens > 3 || g_default_fd_table.num_open > 0 ||
+            g_num_fd_tables > 0) {
+            return -1;
+        }
+        g_fd_base = max_preopens;
+    }
+    g_default_max_fds = max_fds;
+    return 0;
+}
+
+// Create a per-instance fd table with a copy of the current preopens (fd
+// slots are allocated on demand). Returns NULL if out of memory or fds
+WasiFdTable* wasi_fd_table_new(int max_fds) {
+    WasiFdTable* t = (WasiFdTable*)calloc(1, sizeof(WasiFdTable));
+    if (!t) return NULL;
+    t->max_fds = max_fds > 0 ? max_fds : 0;
+    if (preopens_copy(t) < 0) {
+        preopens_release(t);
+        free(t);
+        return NULL;
+    }
+    g_num_fd_tables++;
+    return t;
+}
+
+// Close all fds in a table (NULL = the default table); it stays usable
+void wasi_fd_table_close_all(WasiFdTable* table) {
+    WasiFdTable* t = table ? table : &g_default_fd_table;
+    WasiFdTable* prev = wasi_fd_table_activate(table);
+    for (int slot = 0; slot < t->capacity && t->num_open > 0; slot++) {
+        if (t->entries[slot].host_fd < 0) continue;
+        flush_fd(g_fd_base + slot);
+        release_fd_entry(&t->entries[slot]);
+        free_fd(g_fd_base + slot);
+    }
+    wasi_fd_table_activate(prev);
+}
+
+// Close all fds in a table, including its copies of the preopens, and
+// release it. The default table (NULL) is emptied but stays usable and
+// keeps its preopens. A freed table that is active is deactivated.
+void wasi_fd_table_free(WasiFdTable* table) {
+    wasi_fd_table_close_all(table);
+    if (table == NULL) return;
+    preopens_release(table);
+    if (wasi_fd_table_current() == table) {
+        wasi_fd_table_activate(NULL);
+    }
+    random_state_free(table);
+    free(table->entries);
+    free(table->free_stack);
+    free(table);
+    g_num_fd_tables--;
+}
+
+// Make a table active (NULL = default); returns the previously active one
+WasiFdTable* wasi_fd_table_activate(WasiFdTable* table) {
+    WasiFdTable* prev = wasi_fd_table_current();
+    g_fds = table ? table : &g_default_fd_table;
+    return prev;
+}
+
+WasiFdTable* wasi_fd_table_current(void) {
+    return g_fds == &g_default_fd_table ? NULL : g_fds;
+}
+
+void wasi_set_stdio_host_fds(int stdin_fd, int stdout_fd) {
+    // Settle io_uring state on fds being switched away from
+    for (int i = 0; i < 2 && wasi_uring_enabled(); i++) {
+        int old_fd = g_stdio_redirect[i];
+        if (old_fd >= 0 && old_fd != (i == 0 ? stdin_fd : stdout_fd)) {
+            wasi_uring_sync_fd(old_fd);
         }
     }
-    g_wasi_num_preopens = 3;
+    g_stdio_redirect[0] = stdin_fd;
+    g_stdio_redirect[1] = stdout_fd;
+}
+
+int wasi_stdio_host_fd(int wasi_fd) {
+    return wasi_fd >= 0 && wasi_fd < 2 ? g_stdio_redirect[wasi_fd] : -1;
+}
+
+int wasi_fd_table_count(WasiFdTable* table) {
+    return table ? table->num_open : g_default_fd_table.num_open;
 }
 
 // ============================================================================
@@ -284,15 +2219,14 @@ void wasi_reset_preopens(void) {
 // ============================================================================
 
 // WASI fd_write - write to file descriptor
-uint32_t wasi_fd_write(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_write(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t iovs_offset = (uint32_t)args[1];
     uint32_t iovs_len = (uint32_t)args[2];
     uint32_t nwritten_offset = (uint32_t)args[3];
 
-    // Bounds check for iovec array and nwritten pointer
-    if (iovs_offset + iovs_len * 8 > (uint32_t)mem_size ||
-        nwritten_offset + 4 > (uint32_t)mem_size) {
+    // Bounds check for nwritten pointer (iovecs are checked below)
+    if ((uint64_t)nwritten_offset + 4 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -302,44 +2236,63 @@ uint32_t wasi_fd_write(uint64_t* args, uint8_t* mem, int mem_size) {
         return WASI_ERRNO_BADF;
     }
 
-    size_t total_written = 0;
-
-    for (uint32_t i = 0; i < iovs_len; i++) {
-        // Read iovec from WASM memory (little-endian)
-        uint32_t buf_offset = *(uint32_t*)(mem + iovs_offset + i * 8);
-        uint32_t buf_len = *(uint32_t*)(mem + iovs_offset + i * 8 + 4);
+    // Validate all iovecs once and point them straight into linear memory
+    HostIovecs h;
+    uint32_t err = host_iovecs_init(&h, mem, mem_size, iovs_offset, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) {
+        return err;
+    }
 
-        if (buf_offset + buf_len > (uint32_t)mem_size) {
-            return WASI_ERRNO_INVAL;
+    size_t total_written = 0;
+    WasiOutBuf* outbuf = find_outbuf((int)fd);
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        err = vfs_fd_io((int)fd, vnode, &h, 1, -1, &total_written);
+    } else if (use_uring((int)fd, host_fd)) {
+        // Batched write-behind; anything still buffered goes out first
+        err = flush_outbuf(outbuf);
+        if (err == WASI_ERRNO_SUCCESS && h.count > 0) {
+            long written = wasi_uring_write(host_fd, h.iov, h.count);
+            if (written < 0) {
+                err = errno_to_wasi(errno);
+            } else {
+                total_written = (size_t)written;
+            }
         }
-
-        // Use write() syscall for all fds (works for both stdio and files)
-        ssize_t written = write(host_fd, mem + buf_offset, buf_len);
+    } else if (outbuf) {
+        err = buffered_write(outbuf, host_fd, &h, &total_written);
+    } else if (h.count > 0) {
+        // Single writev() for the whole iovec array (may be a short write);
+        // a full pipe or socket may wait for the reader
+        int socket = is_socket_fd((int)fd);
+        blocking_begin();
+        ssize_t written = socket ? host_sendv(host_fd, h.iov, h.count)
+                                 : host_writev(host_fd, h.iov, h.count);
+        int saved_errno = errno;
+        blocking_end();
+        errno = saved_errno;
         if (written < 0) {
-            *(uint32_t*)(mem + nwritten_offset) = (uint32_t)total_written;
-            return errno_to_wasi(errno);
-        }
-        total_written += (size_t)written;
-        if ((size_t)written < buf_len) {
-            break;  // Short write
+            err = errno_to_wasi(errno);
+        } else {
+            total_written = (size_t)written;
         }
     }
+    host_iovecs_free(&h);
 
     // Write nwritten back to WASM memory
     *(uint32_t*)(mem + nwritten_offset) = (uint32_t)total_written;
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI fd_read - read from file descriptor
-uint32_t wasi_fd_read(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_read(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t iovs_offset = (uint32_t)args[1];
     uint32_t iovs_len = (uint32_t)args[2];
     uint32_t nread_offset = (uint32_t)args[3];
 
     // Bounds check
-    if (iovs_offset + iovs_len * 8 > (uint32_t)mem_size ||
-        nread_offset + 4 > (uint32_t)mem_size) {
+    if ((uint64_t)nread_offset + 4 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -349,39 +2302,66 @@ uint32_t wasi_fd_read(uint64_t* args, uint8_t* mem, int mem_size) {
         return WASI_ERRNO_BADF;
     }
 
-    size_t total_read = 0;
-
-    for (uint32_t i = 0; i < iovs_len; i++) {
-        uint32_t buf_offset = *(uint32_t*)(mem + iovs_offset + i * 8);
-        uint32_t buf_len = *(uint32_t*)(mem + iovs_offset + i * 8 + 4);
+    // Make pending output visible first: prompts before a stdin read, and
+    // buffered file data before reading the same file back
+    if (fd == 0) {
+        flush_fd(1);
+        flush_fd(2);
+    }
+    int uring = use_uring((int)fd, host_fd);
+    if (uring) {
+        // Keep readahead state; the backend orders reads after writes itself
+        flush_outbuf(find_outbuf((int)fd));
+    } else {
+        flush_fd((int)fd);
+    }
 
-        if (buf_offset + buf_len > (uint32_t)mem_size) {
-            return WASI_ERRNO_INVAL;
-        }
+    HostIovecs h;
+    uint32_t err = host_iovecs_init(&h, mem, mem_size, iovs_offset, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) {
+        return err;
+    }
 
-        // Use read() syscall for all fds (works for both stdio and files)
-        ssize_t bytes_read = read(host_fd, mem + buf_offset, buf_len);
+    // Single readv() straight into linear memory
+    size_t total_read = 0;
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        err = vfs_fd_io((int)fd, vnode, &h, 0, -1, &total_read);
+    } else if (uring && h.count > 0) {
+        ssize_t bytes_read = wasi_uring_read(host_fd, h.iov, h.count);
         if (bytes_read < 0) {
-            *(uint32_t*)(mem + nread_offset) = (uint32_t)total_read;
-            return errno_to_wasi(errno);
+            err = errno_to_wasi(errno);
+        } else {
+            total_read = (size_t)bytes_read;
         }
-        total_read += (size_t)bytes_read;
-        if ((size_t)bytes_read < buf_len) {
-            break;  // EOF or short read
+    } else if (h.count > 0) {
+        // Pipes, terminals and sockets may wait for data
+        int mapped = use_mapped_read((int)fd, host_fd, &h);
+        blocking_begin();
+        ssize_t bytes_read = mapped ? mapped_readv(host_fd, h.iov, h.count)
+                                    : host_readv(host_fd, h.iov, h.count);
+        int saved_errno = errno;
+        blocking_end();
+        errno = saved_errno;
+        if (bytes_read < 0) {
+            err = errno_to_wasi(errno);
+        } else {
+            total_read = (size_t)bytes_read;
         }
     }
+    host_iovecs_free(&h);
 
     *(uint32_t*)(mem + nread_offset) = (uint32_t)total_read;
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI args_sizes_get - get sizes of command line arguments
-uint32_t wasi_args_sizes_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_args_sizes_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t argc_offset = (uint32_t)args[0];
     uint32_t argv_buf_size_offset = (uint32_t)args[1];
 
-    if (argc_offset + 4 > (uint32_t)mem_size ||
-        argv_buf_size_offset + 4 > (uint32_t)mem_size) {
+    if ((uint64_t)argc_offset + 4 > mem_size ||
+        (uint64_t)argv_buf_size_offset + 4 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -397,21 +2377,21 @@ uint32_t wasi_args_sizes_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI args_get - get command line arguments
-uint32_t wasi_args_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_args_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t argv_offset = (uint32_t)args[0];      // Array of i32 pointers
     uint32_t argv_buf_offset = (uint32_t)args[1];  // String data buffer
 
     uint32_t buf_ptr = argv_buf_offset;
     for (int i = 0; i < g_wasi_ctx.argc; i++) {
         // Write pointer to argv array
-        if (argv_offset + (uint32_t)i * 4 + 4 > (uint32_t)mem_size) {
+        if ((uint64_t)argv_offset + (uint32_t)i * 4 + 4 > mem_size) {
             return WASI_ERRNO_INVAL;
         }
         *(uint32_t*)(mem + argv_offset + i * 4) = buf_ptr;
 
         // Copy string to buffer
         size_t len = strlen(g_wasi_ctx.argv[i]) + 1;
-        if (buf_ptr + len > (uint32_t)mem_size) {
+        if ((uint64_t)buf_ptr + len > mem_size) {
             return WASI_ERRNO_INVAL;
         }
         memcpy(mem + buf_ptr, g_wasi_ctx.argv[i], len);
@@ -421,12 +2401,12 @@ uint32_t wasi_args_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI environ_sizes_get - get sizes of environment variables
-uint32_t wasi_environ_sizes_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_environ_sizes_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t count_offset = (uint32_t)args[0];
     uint32_t buf_size_offset = (uint32_t)args[1];
 
-    if (count_offset + 4 > (uint32_t)mem_size ||
-        buf_size_offset + 4 > (uint32_t)mem_size) {
+    if ((uint64_t)count_offset + 4 > mem_size ||
+        (uint64_t)buf_size_offset + 4 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -437,7 +2417,7 @@ uint32_t wasi_environ_sizes_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI environ_get - get environment variables
-uint32_t wasi_environ_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_environ_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     (void)args;
     (void)mem;
     (void)mem_size;
@@ -447,7 +2427,9 @@ uint32_t wasi_environ_get(uint64_t* args, uint8_t* mem, int mem_size) {
 
 // WASI proc_exit - exit the process
 uint32_t wasi_proc_exit(uint64_t* args) {
+    wasi_flush_all();
     g_wasi_ctx.exit_code = (int)(uint32_t)args[0];
+    g_thread_exit_code = g_wasi_ctx.exit_code;
     g_wasi_ctx.has_exited = 1;
     return 0;  // Never actually returns normally
 }
@@ -459,19 +2441,19 @@ uint32_t wasi_fd_close(uint64_t* args) {
     if (fd <= 2) {
         return WASI_ERRNO_BADF;
     }
+    flush_fd((int)fd);
+    drop_outbuf((int)fd);
 
     // Check if it's a dynamically opened fd
-    if (fd >= WASI_MAX_PREOPENS && fd < MAX_WASI_FDS) {
-        int host_fd = g_fd_table[fd].host_fd;
-        if (host_fd >= 0) {
-            close(host_fd);
-            free_fd(fd);
-            return WASI_ERRNO_SUCCESS;
-        }
+    WasiFdEntry* entry = get_fd_entry((int)fd);
+    if (entry) {
+        release_fd_entry(entry);
+        free_fd((int)fd);
+        return WASI_ERRNO_SUCCESS;
     }
 
-    // Preopened fds (3 to g_wasi_num_preopens-1) - don't close these
-    if (fd < (uint32_t)g_wasi_num_preopens) {
+    // Preopened fds (3 to g_fds->num_preopens-1) - don't close these
+    if (fd < (uint32_t)g_fds->num_preopens) {
         // Preopened directories shouldn't be closed by WASI programs
         return WASI_ERRNO_BADF;
     }
@@ -480,26 +2462,28 @@ uint32_t wasi_fd_close(uint64_t* args) {
 }
 
 // WASI fd_prestat_get - get preopen info for fd
-uint32_t wasi_fd_prestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_prestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t buf_offset = (uint32_t)args[1];
 
-    if (buf_offset + 8 > (uint32_t)mem_size) {
+    if ((uint64_t)buf_offset + 8 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
     // Check if fd is a valid preopen
-    if (fd >= (uint32_t)g_wasi_num_preopens || fd < 3) {
+    if (fd >= (uint32_t)g_fds->num_preopens || fd < 3) {
         // fd 0-2 are stdio, not preopens; fd >= num_preopens is invalid
         return WASI_ERRNO_BADF;
     }
 
-    if (g_wasi_preopens[fd].host_fd < 0) {
+    // Listening sockets are not preopened directories
+    if (g_fds->preopens[fd].host_fd < 0 ||
+        g_fds->preopens[fd].filetype == WASI_FILETYPE_SOCKET_STREAM) {
         return WASI_ERRNO_BADF;
     }
 
     // Write prestat structure (type=dir, name_len)
-    const char* path = g_wasi_preopens[fd].path;
+    const char* path = g_fds->preopens[fd].path;
     size_t path_len = path ? strlen(path) : 0;
 
     *(uint32_t*)(mem + buf_offset) = WASI_PREOPENTYPE_DIR;  // type
@@ -509,24 +2493,25 @@ uint32_t wasi_fd_prestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI fd_prestat_dir_name - get preopen directory name
-uint32_t wasi_fd_prestat_dir_name(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_prestat_dir_name(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t path_offset = (uint32_t)args[1];
     uint32_t path_len = (uint32_t)args[2];
 
-    if (path_offset + path_len > (uint32_t)mem_size) {
+    if ((uint64_t)path_offset + path_len > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
-    if (fd >= (uint32_t)g_wasi_num_preopens || fd < 3) {
+    if (fd >= (uint32_t)g_fds->num_preopens || fd < 3) {
         return WASI_ERRNO_BADF;
     }
 
-    if (g_wasi_preopens[fd].host_fd < 0) {
+    if (g_fds->preopens[fd].host_fd < 0 ||
+        g_fds->preopens[fd].filetype == WASI_FILETYPE_SOCKET_STREAM) {
         return WASI_ERRNO_BADF;
     }
 
-    const char* path = g_wasi_preopens[fd].path;
+    const char* path = g_fds->preopens[fd].path;
     size_t actual_len = path ? strlen(path) : 0;
 
     if (path_len < actual_len) {
@@ -541,12 +2526,12 @@ uint32_t wasi_fd_prestat_dir_name(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI fd_fdstat_get - get file descriptor status
-uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t buf_offset = (uint32_t)args[1];
 
     // fdstat structure is 24 bytes
-    if (buf_offset + 24 > (uint32_t)mem_size) {
+    if ((uint64_t)buf_offset + 24 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -565,7 +2550,18 @@ uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, int mem_size) {
         filetype = WASI_FILETYPE_CHARACTER_DEVICE;
         rights_base = WASI_RIGHTS_FD_WRITE;
         rights_inheriting = 0;
-    } else if (fd < (uint32_t)g_wasi_num_preopens && g_wasi_preopens[fd].host_fd >= 0) {
+    } else if (fd < (uint32_t)g_fds->num_preopens && g_fds->preopens[fd].host_fd >= 0 &&
+               g_fds->preopens[fd].filetype == WASI_FILETYPE_SOCKET_STREAM) {
+        // Preopened listening socket
+        filetype = WASI_FILETYPE_SOCKET_STREAM;
+        rights_base = WASI_RIGHTS_SOCK_ACCEPT | WASI_RIGHTS_POLL_FD_READWRITE |
+                      WASI_RIGHTS_FD_FDSTAT_SET_FLAGS;
+        rights_inheriting = WASI_RIGHTS_SOCKET_CONN;
+#ifndef _WIN32
+        int fl = fcntl(g_fds->preopens[fd].host_fd, F_GETFL);
+        if (fl >= 0 && (fl & O_NONBLOCK)) fdflags |= WASI_FDFLAGS_NONBLOCK;
+#endif
+    } else if (fd < (uint32_t)g_fds->num_preopens && g_fds->preopens[fd].host_fd >= 0) {
         // Preopened directory
         filetype = WASI_FILETYPE_DIRECTORY;
         rights_base = WASI_RIGHTS_PATH_OPEN | WASI_RIGHTS_FD_READ;
@@ -595,12 +2591,12 @@ uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI clock_time_get - get current time
-uint32_t wasi_clock_time_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_clock_time_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t clock_id = (uint32_t)args[0];
     // uint64_t precision = args[1];  // Ignored
     uint32_t time_offset = (uint32_t)args[2];
 
-    if (time_offset + 8 > (uint32_t)mem_size) {
+    if ((uint64_t)time_offset + 8 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -627,37 +2623,28 @@ uint32_t wasi_clock_time_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI random_get - get random bytes
-uint32_t wasi_random_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_random_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t buf_offset = (uint32_t)args[0];
     uint32_t buf_len = (uint32_t)args[1];
 
-    if (buf_offset + buf_len > (uint32_t)mem_size) {
+    if ((uint64_t)buf_offset + buf_len > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
-    // Simple PRNG for now (not cryptographically secure)
-    static uint64_t seed = 0;
-    if (seed == 0) {
-        seed = (uint64_t)time(NULL);
-    }
-
-    for (uint32_t i = 0; i < buf_len; i++) {
-        // LCG random
-        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
-        mem[buf_offset + i] = (uint8_t)(seed >> 33);
+    if (random_fill(mem + buf_offset, buf_len) < 0) {
+        return WASI_ERRNO_IO;
     }
-
     return WASI_ERRNO_SUCCESS;
 }
 
 // WASI fd_seek - seek to position in file
-uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     int64_t offset = (int64_t)args[1];
     uint8_t whence = (uint8_t)args[2];  // 0=SET, 1=CUR, 2=END
     uint32_t newoffset_ptr = (uint32_t)args[3];
 
-    if (newoffset_ptr + 8 > (uint32_t)mem_size) {
+    if ((uint64_t)newoffset_ptr + 8 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -666,6 +2653,12 @@ uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, int mem_size) {
     if (host_fd < 0 || fd < 3) {  // Don't allow seeking on stdio
         return WASI_ERRNO_BADF;
     }
+    flush_fd((int)fd);
+
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        return vfs_fd_seek((int)fd, vnode, offset, whence, (uint64_t*)(mem + newoffset_ptr));
+    }
 
 #ifdef _WIN32
     int host_whence;
@@ -709,11 +2702,11 @@ uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI fd_tell - get current file position
-uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t offset_ptr = (uint32_t)args[1];
 
-    if (offset_ptr + 8 > (uint32_t)mem_size) {
+    if ((uint64_t)offset_ptr + 8 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -722,6 +2715,12 @@ uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, int mem_size) {
     if (host_fd < 0 || fd < 3) {  // Don't allow tell on stdio
         return WASI_ERRNO_BADF;
     }
+    flush_fd((int)fd);
+
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        return vfs_fd_seek((int)fd, vnode, 0, 1, (uint64_t*)(mem + offset_ptr));
+    }
 
 #ifdef _WIN32
     int64_t result = _lseeki64(host_fd, 0, SEEK_CUR);
@@ -739,11 +2738,11 @@ uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, int mem_size) {
 // WASI fd_filestat_get - get file stats via fd
 // WASI filestat structure (64 bytes):
 // dev: u64, ino: u64, filetype: u8, nlink: u64, size: u64, atim: u64, mtim: u64, ctim: u64
-uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t buf_ptr = (uint32_t)args[1];
 
-    if (buf_ptr + 64 > (uint32_t)mem_size) {
+    if ((uint64_t)buf_ptr + 64 > mem_size) {
         return WASI_ERRNO_INVAL;
     }
 
@@ -752,6 +2751,15 @@ uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
     if (host_fd < 0) {
         return WASI_ERRNO_BADF;
     }
+    flush_fd((int)fd);
+
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        VfsStat vst;
+        vfs_stat(vnode, &vst);
+        vfs_put_filestat(mem + buf_ptr, &vst);
+        return WASI_ERRNO_SUCCESS;
+    }
 
 #ifdef _WIN32
     // On Windows, use _fstat64
@@ -807,11 +2815,22 @@ uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
 uint32_t wasi_fd_sync(uint64_t* args) {
     uint32_t fd = (uint32_t)args[0];
 
+    // Push buffered output to the host fd before syncing it
+    uint32_t flush_err = flush_outbuf(find_outbuf((int)fd));
+    if (flush_err != WASI_ERRNO_SUCCESS) return flush_err;
+
     // Get host fd (supports preopens and dynamic fds)
     int host_fd = get_host_fd(fd);
     if (host_fd < 0 || fd < 3) {  // Don't sync stdio
         return WASI_ERRNO_BADF;
     }
+    if (get_vfs_node((int)fd)) return WASI_ERRNO_SUCCESS;  // Nothing to persist
+
+    if (use_uring((int)fd, host_fd)) {
+        // Pending batched writes and the sync go out as one submission
+        if (wasi_uring_fsync(host_fd, 0) < 0) return errno_to_wasi(errno);
+        return WASI_ERRNO_SUCCESS;
+    }
 
 #ifdef _WIN32
     if (_commit(host_fd) < 0) {
@@ -829,11 +2848,22 @@ uint32_t wasi_fd_sync(uint64_t* args) {
 uint32_t wasi_fd_datasync(uint64_t* args) {
     uint32_t fd = (uint32_t)args[0];
 
+    // Push buffered output to the host fd before syncing it
+    uint32_t flush_err = flush_outbuf(find_outbuf((int)fd));
+    if (flush_err != WASI_ERRNO_SUCCESS) return flush_err;
+
     // Get host fd (supports preopens and dynamic fds)
     int host_fd = get_host_fd(fd);
     if (host_fd < 0 || fd < 3) {  // Don't sync stdio
         return WASI_ERRNO_BADF;
     }
+    if (get_vfs_node((int)fd)) return WASI_ERRNO_SUCCESS;  // Nothing to persist
+
+    if (use_uring((int)fd, host_fd)) {
+        // Pending batched writes and the sync go out as one submission
+        if (wasi_uring_fsync(host_fd, 1) < 0) return errno_to_wasi(errno);
+        return WASI_ERRNO_SUCCESS;
+    }
 
 #ifdef _WIN32
     if (_commit(host_fd) < 0) {
@@ -867,7 +2897,7 @@ uint32_t wasi_sched_yield(void) {
 
 // WASI path_open - open a file relative to a directory
 // Args: dirfd, dirflags, path_ptr, path_len, oflags, rights_base, rights_inheriting, fdflags, fd_ptr
-uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t dirflags = (uint32_t)args[1];  // lookupflags (e.g., symlink_follow)
     uint32_t path_ptr = (uint32_t)args[2];
@@ -878,29 +2908,12 @@ uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size) {
     uint16_t fdflags = (uint16_t)args[7];
     uint32_t fd_ptr = (uint32_t)args[8];
 
-    (void)dirflags;  // Not fully used yet
-
     // Bounds check
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (fd_ptr + 4 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-    if (path_len == 0) return WASI_ERRNO_INVAL;
-
-    // Copy path to null-terminated buffer
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
-
-    // Get base directory fd - must be a preopened directory
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
-    }
+    if ((uint64_t)fd_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
+
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
     // Translate WASI flags to host flags
     int flags = 0;
@@ -909,37 +2922,55 @@ uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size) {
     if (oflags & WASI_OFLAGS_TRUNC) flags |= O_TRUNC;
     if (fdflags & WASI_FDFLAGS_APPEND) flags |= O_APPEND;
 #ifndef _WIN32
+    if (oflags & WASI_OFLAGS_DIRECTORY) flags |= O_DIRECTORY;
+    if (!(dirflags & 1)) flags |= O_NOFOLLOW;  // dirflags & 1 = LOOKUPFLAGS_SYMLINK_FOLLOW
     if (fdflags & WASI_FDFLAGS_NONBLOCK) flags |= O_NONBLOCK;
     if (fdflags & WASI_FDFLAGS_SYNC) flags |= O_SYNC;
 #ifdef O_DSYNC
     if (fdflags & WASI_FDFLAGS_DSYNC) flags |= O_DSYNC;
 #endif
+#else
+    (void)dirflags;
 #endif
 
-    // Determine read/write mode from rights
+    // Determine read/write mode from rights (directories are read-only)
     int has_read = (rights_base & WASI_RIGHTS_FD_READ) != 0;
-    int has_write = (rights_base & WASI_RIGHTS_FD_WRITE) != 0;
+    int has_write = (rights_base & WASI_RIGHTS_FD_WRITE) != 0 &&
+                    !(oflags & WASI_OFLAGS_DIRECTORY);
     if (has_read && has_write) flags |= O_RDWR;
     else if (has_write) flags |= O_WRONLY;
     else flags |= O_RDONLY;
 
+    if (t.vfs) {
+        VfsNode* node;
+        int rc = vfs_open(t.vfs, t.path, oflags, has_write, &node);
+        path_release(&t);
+        if (rc < 0) return vfs_errno(rc);
+        uint8_t filetype = vfs_is_dir(node) ? WASI_FILETYPE_DIRECTORY : WASI_FILETYPE_REGULAR_FILE;
+        int wasi_fd = allocate_fd(VFS_HOST_FD, filetype, fdflags, rights_base, rights_inheriting);
+        if (wasi_fd < 0) {
+            err = errno_to_wasi(errno);
+            vfs_unref(node);
+            return err;
+        }
+        get_fd_entry(wasi_fd)->vnode = node;
+        *(uint32_t*)(mem + fd_ptr) = (uint32_t)wasi_fd;
+        return WASI_ERRNO_SUCCESS;
+    }
+
 #ifdef _WIN32
     flags |= _O_BINARY;
-    // Windows: construct full path (base_path + "/" + host_path)
-    char full_path[1024];
-    if (base_path && base_path[0] != '<') {
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, host_path);
-    } else {
-        snprintf(full_path, sizeof(full_path), "%s", host_path);
-    }
-    int host_fd = _open(full_path, flags, 0644);
+    int host_fd = _open(t.name, flags, 0644);
 #else
-    int host_fd = openat(base_fd, host_path, flags, 0644);
+    int host_fd = path_open_target(&t, flags, 0644);
 #endif
 
     if (host_fd < 0) {
-        return errno_to_wasi(errno);
+        err = errno == EXDEV ? WASI_ERRNO_NOTCAPABLE : errno_to_wasi(errno);
+        path_release(&t);
+        return err;
     }
+    path_release(&t);
 
     // Determine file type
     uint8_t filetype = WASI_FILETYPE_REGULAR_FILE;
@@ -967,8 +2998,9 @@ uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size) {
     // Allocate WASI fd
     int wasi_fd = allocate_fd(host_fd, filetype, fdflags, rights_base, rights_inheriting);
     if (wasi_fd < 0) {
+        err = errno_to_wasi(errno);
         close(host_fd);
-        return WASI_ERRNO_NFILE;
+        return err;
     }
 
     *(uint32_t*)(mem + fd_ptr) = (uint32_t)wasi_fd;
@@ -976,40 +3008,35 @@ uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI path_filestat_get - get file stats via path
-uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t flags = (uint32_t)args[1];  // lookupflags
     uint32_t path_ptr = (uint32_t)args[2];
     uint32_t path_len = (uint32_t)args[3];
     uint32_t buf_ptr = (uint32_t)args[4];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (buf_ptr + 64 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
+    if ((uint64_t)buf_ptr + 64 > mem_size) return WASI_ERRNO_INVAL;
 
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    if (t.vfs) {
+        VfsStat vst;
+        int rc = vfs_stat_path(t.vfs, t.path, &vst);
+        path_release(&t);
+        if (rc < 0) return vfs_errno(rc);
+        vfs_put_filestat(mem + buf_ptr, &vst);
+        return WASI_ERRNO_SUCCESS;
     }
 
 #ifdef _WIN32
-    char full_path[1024];
-    if (base_path && base_path[0] != '<') {
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, host_path);
-    } else {
-        snprintf(full_path, sizeof(full_path), "%s", host_path);
-    }
+    (void)flags;
     struct __stat64 st;
-    if (_stat64(full_path, &st) < 0) return errno_to_wasi(errno);
+    int rc = _stat64(t.name, &st);
+    int saved_errno = errno;
+    path_release(&t);
+    if (rc < 0) return errno_to_wasi(saved_errno);
     uint8_t filetype = ((st.st_mode & _S_IFDIR) ? WASI_FILETYPE_DIRECTORY :
                         (st.st_mode & _S_IFREG) ? WASI_FILETYPE_REGULAR_FILE :
                         (st.st_mode & _S_IFCHR) ? WASI_FILETYPE_CHARACTER_DEVICE :
@@ -1022,9 +3049,17 @@ uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
     uint64_t mtim = (uint64_t)st.st_mtime * 1000000000ULL;
     uint64_t ctim = (uint64_t)st.st_ctime * 1000000000ULL;
 #else
-    int stat_flags = (flags & 1) ? 0 : AT_SYMLINK_NOFOLLOW;  // flags & 1 = LOOKUPFLAGS_SYMLINK_FOLLOW
     struct stat st;
-    if (fstatat(base_fd, host_path, &st, stat_flags) < 0) return errno_to_wasi(errno);
+    int rc = fstatat(t.dir_fd, t.name, &st, AT_SYMLINK_NOFOLLOW);
+    if (rc == 0 && S_ISLNK(st.st_mode) && (flags & 1)) {  // flags & 1 = LOOKUPFLAGS_SYMLINK_FOLLOW
+        // Follow the link without leaving the base directory
+        int fd = path_open_target(&t, PATH_PROBE_FLAGS, 0);
+        rc = fd < 0 ? -1 : fstat(fd, &st);
+        if (fd >= 0) close(fd);
+    }
+    int saved_errno = errno;
+    path_release(&t);
+    if (rc < 0) return saved_errno == EXDEV ? WASI_ERRNO_NOTCAPABLE : errno_to_wasi(saved_errno);
     uint8_t filetype = (S_ISDIR(st.st_mode) ? WASI_FILETYPE_DIRECTORY :
                         S_ISREG(st.st_mode) ? WASI_FILETYPE_REGULAR_FILE :
                         S_ISCHR(st.st_mode) ? WASI_FILETYPE_CHARACTER_DEVICE :
@@ -1054,7 +3089,7 @@ uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, int mem_size) {
 }
 
 // WASI path_filestat_set_times - set file timestamps via path
-uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t flags = (uint32_t)args[1];  // lookupflags
     uint32_t path_ptr = (uint32_t)args[2];
@@ -1063,29 +3098,26 @@ uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, int mem_size
     uint64_t mtim = args[5];
     uint16_t fst_flags = (uint16_t)args[6];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
-
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    if (t.vfs) {
+        VfsNode* node;
+        int rc = vfs_open(t.vfs, t.path, 0, 0, &node);
+        path_release(&t);
+        if (rc < 0) return vfs_errno(rc);
+        rc = vfs_set_times(node, atim, mtim, fst_flags);
+        vfs_unref(node);
+        return vfs_errno(rc);
     }
 
 #ifdef _WIN32
     (void)flags;
-    (void)base_path;
     (void)atim;
     (void)mtim;
     (void)fst_flags;
+    path_release(&t);
     return WASI_ERRNO_NOSYS;
 #else
     struct timespec times[2];
@@ -1108,182 +3140,136 @@ uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, int mem_size
         times[1].tv_nsec = UTIME_OMIT;
     }
     int stat_flags = (flags & 1) ? 0 : AT_SYMLINK_NOFOLLOW;
-    if (utimensat(base_fd, host_path, times, stat_flags) < 0) return errno_to_wasi(errno);
-    return WASI_ERRNO_SUCCESS;
+    if (flags & 1) err = path_check_follow(&t);
+    if (err == WASI_ERRNO_SUCCESS && utimensat(t.dir_fd, t.name, times, stat_flags) < 0) {
+        err = errno_to_wasi(errno);
+    }
+    path_release(&t);
+    return err;
 #endif
 }
 
 // WASI path_create_directory - create a directory
-uint32_t wasi_path_create_directory(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_create_directory(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t path_ptr = (uint32_t)args[1];
     uint32_t path_len = (uint32_t)args[2];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    if (t.vfs) {
+        int rc = vfs_mkdir(t.vfs, t.path);
+        path_release(&t);
+        return vfs_errno(rc);
     }
 
 #ifdef _WIN32
-    char full_path[1024];
-    if (base_path && base_path[0] != '<') {
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, host_path);
-    } else {
-        snprintf(full_path, sizeof(full_path), "%s", host_path);
-    }
-    if (_mkdir(full_path) < 0) return errno_to_wasi(errno);
+    if (_mkdir(t.name) < 0) err = errno_to_wasi(errno);
 #else
-    if (mkdirat(base_fd, host_path, 0755) < 0) return errno_to_wasi(errno);
+    if (mkdirat(t.dir_fd, t.name, 0755) < 0) err = errno_to_wasi(errno);
 #endif
-    return WASI_ERRNO_SUCCESS;
+    path_release(&t);
+    return err;
 }
 
 // WASI path_remove_directory - remove a directory
-uint32_t wasi_path_remove_directory(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_remove_directory(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t path_ptr = (uint32_t)args[1];
     uint32_t path_len = (uint32_t)args[2];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    if (t.vfs) {
+        int rc = vfs_rmdir(t.vfs, t.path);
+        path_release(&t);
+        return vfs_errno(rc);
     }
 
 #ifdef _WIN32
-    char full_path[1024];
-    if (base_path && base_path[0] != '<') {
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, host_path);
-    } else {
-        snprintf(full_path, sizeof(full_path), "%s", host_path);
-    }
-    if (_rmdir(full_path) < 0) return errno_to_wasi(errno);
+    if (_rmdir(t.name) < 0) err = errno_to_wasi(errno);
+    path_release(&t);
 #else
-    if (unlinkat(base_fd, host_path, AT_REMOVEDIR) < 0) return errno_to_wasi(errno);
+    if (unlinkat(t.dir_fd, t.name, AT_REMOVEDIR) < 0) err = errno_to_wasi(errno);
+    path_release(&t);
+    if (err == WASI_ERRNO_SUCCESS) dir_handles_forget(-1);
 #endif
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI path_unlink_file - unlink (delete) a file
-uint32_t wasi_path_unlink_file(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_unlink_file(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t path_ptr = (uint32_t)args[1];
     uint32_t path_len = (uint32_t)args[2];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    if (t.vfs) {
+        int rc = vfs_unlink(t.vfs, t.path);
+        path_release(&t);
+        return vfs_errno(rc);
     }
 
 #ifdef _WIN32
-    char full_path[1024];
-    if (base_path && base_path[0] != '<') {
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, host_path);
-    } else {
-        snprintf(full_path, sizeof(full_path), "%s", host_path);
-    }
-    if (_unlink(full_path) < 0) return errno_to_wasi(errno);
+    if (_unlink(t.name) < 0) err = errno_to_wasi(errno);
 #else
-    if (unlinkat(base_fd, host_path, 0) < 0) return errno_to_wasi(errno);
+    if (unlinkat(t.dir_fd, t.name, 0) < 0) err = errno_to_wasi(errno);
 #endif
-    return WASI_ERRNO_SUCCESS;
+    path_release(&t);
+    return err;
 }
 
 // WASI path_rename - rename a file or directory
-uint32_t wasi_path_rename(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_rename(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t old_dirfd = (uint32_t)args[0];
     uint32_t old_path_ptr = (uint32_t)args[1];
     uint32_t old_path_len = (uint32_t)args[2];
     uint32_t new_dirfd = (uint32_t)args[3];
-    uint32_t new_path_ptr = (uint32_t)args[4];
-    uint32_t new_path_len = (uint32_t)args[5];
-
-    if (old_path_ptr + old_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (new_path_ptr + new_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (old_path_len >= 512 || new_path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char old_path[512], new_path[512];
-    memcpy(old_path, mem + old_path_ptr, old_path_len);
-    old_path[old_path_len] = '\0';
-    memcpy(new_path, mem + new_path_ptr, new_path_len);
-    new_path[new_path_len] = '\0';
-
-    int old_base_fd = -1, new_base_fd = -1;
-    const char* old_base_path = NULL;
-    const char* new_base_path = NULL;
+    uint32_t new_path_ptr = (uint32_t)args[4];
+    uint32_t new_path_len = (uint32_t)args[5];
 
-    if (old_dirfd >= 3 && old_dirfd < (uint32_t)g_wasi_num_preopens) {
-        old_base_fd = g_wasi_preopens[old_dirfd].host_fd;
-        old_base_path = g_wasi_preopens[old_dirfd].path;
-        if (old_base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    PathTarget old_t, new_t;
+    uint32_t err = path_resolve(old_dirfd, mem, mem_size, old_path_ptr, old_path_len, &old_t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+    err = path_resolve(new_dirfd, mem, mem_size, new_path_ptr, new_path_len, &new_t);
+    if (err != WASI_ERRNO_SUCCESS) {
+        path_release(&old_t);
+        return err;
     }
 
-    if (new_dirfd >= 3 && new_dirfd < (uint32_t)g_wasi_num_preopens) {
-        new_base_fd = g_wasi_preopens[new_dirfd].host_fd;
-        new_base_path = g_wasi_preopens[new_dirfd].path;
-        if (new_base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    // Nodes cannot move between the VFS and the host filesystem
+    if (old_t.vfs || new_t.vfs) {
+        err = !old_t.vfs || !new_t.vfs
+            ? WASI_ERRNO_XDEV
+            : vfs_errno(vfs_rename(old_t.vfs, old_t.path, new_t.vfs, new_t.path));
+        path_release(&old_t);
+        path_release(&new_t);
+        return err;
     }
 
 #ifdef _WIN32
-    char old_full_path[1024], new_full_path[1024];
-    if (old_base_path && old_base_path[0] != '<') {
-        snprintf(old_full_path, sizeof(old_full_path), "%s/%s", old_base_path, old_path);
-    } else {
-        snprintf(old_full_path, sizeof(old_full_path), "%s", old_path);
-    }
-    if (new_base_path && new_base_path[0] != '<') {
-        snprintf(new_full_path, sizeof(new_full_path), "%s/%s", new_base_path, new_path);
-    } else {
-        snprintf(new_full_path, sizeof(new_full_path), "%s", new_path);
-    }
-    if (rename(old_full_path, new_full_path) < 0) return errno_to_wasi(errno);
+    if (rename(old_t.name, new_t.name) < 0) err = errno_to_wasi(errno);
+    path_release(&old_t);
+    path_release(&new_t);
 #else
-    if (renameat(old_base_fd, old_path, new_base_fd, new_path) < 0) return errno_to_wasi(errno);
+    if (renameat(old_t.dir_fd, old_t.name, new_t.dir_fd, new_t.name) < 0) err = errno_to_wasi(errno);
+    path_release(&old_t);
+    path_release(&new_t);
+    // A renamed directory invalidates cached handles below its old name
+    if (err == WASI_ERRNO_SUCCESS) dir_handles_forget(-1);
 #endif
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI path_link - create a hard link
-uint32_t wasi_path_link(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_link(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t old_dirfd = (uint32_t)args[0];
     uint32_t old_flags = (uint32_t)args[1];  // lookupflags
     uint32_t old_path_ptr = (uint32_t)args[2];
@@ -1292,53 +3278,43 @@ uint32_t wasi_path_link(uint64_t* args, uint8_t* mem, int mem_size) {
     uint32_t new_path_ptr = (uint32_t)args[5];
     uint32_t new_path_len = (uint32_t)args[6];
 
-    if (old_path_ptr + old_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (new_path_ptr + new_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (old_path_len >= 512 || new_path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char old_path[512];
-    char new_path[512];
-    memcpy(old_path, mem + old_path_ptr, old_path_len);
-    memcpy(new_path, mem + new_path_ptr, new_path_len);
-    old_path[old_path_len] = '\0';
-    new_path[new_path_len] = '\0';
-
-    int old_base_fd = -1;
-    const char* old_base_path = NULL;
-    if (old_dirfd >= 3 && old_dirfd < (uint32_t)g_wasi_num_preopens) {
-        old_base_fd = g_wasi_preopens[old_dirfd].host_fd;
-        old_base_path = g_wasi_preopens[old_dirfd].path;
-        if (old_base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    PathTarget old_t, new_t;
+    uint32_t err = path_resolve(old_dirfd, mem, mem_size, old_path_ptr, old_path_len, &old_t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+    err = path_resolve(new_dirfd, mem, mem_size, new_path_ptr, new_path_len, &new_t);
+    if (err != WASI_ERRNO_SUCCESS) {
+        path_release(&old_t);
+        return err;
     }
 
-    int new_base_fd = -1;
-    const char* new_base_path = NULL;
-    if (new_dirfd >= 3 && new_dirfd < (uint32_t)g_wasi_num_preopens) {
-        new_base_fd = g_wasi_preopens[new_dirfd].host_fd;
-        new_base_path = g_wasi_preopens[new_dirfd].path;
-        if (new_base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    // Nodes cannot move between the VFS and the host filesystem
+    if (old_t.vfs || new_t.vfs) {
+        err = !old_t.vfs || !new_t.vfs
+            ? WASI_ERRNO_XDEV
+            : vfs_errno(vfs_link(old_t.vfs, old_t.path, new_t.vfs, new_t.path));
+        path_release(&old_t);
+        path_release(&new_t);
+        return err;
     }
 
 #ifdef _WIN32
     (void)old_flags;
-    (void)old_base_path;
-    (void)new_base_path;
-    return WASI_ERRNO_NOSYS;
+    err = WASI_ERRNO_NOSYS;
 #else
     int link_flags = (old_flags & 1) ? AT_SYMLINK_FOLLOW : 0;
-    if (linkat(old_base_fd, old_path, new_base_fd, new_path, link_flags) < 0) {
-        return errno_to_wasi(errno);
+    if (old_flags & 1) err = path_check_follow(&old_t);
+    if (err == WASI_ERRNO_SUCCESS &&
+        linkat(old_t.dir_fd, old_t.name, new_t.dir_fd, new_t.name, link_flags) < 0) {
+        err = errno_to_wasi(errno);
     }
-    return WASI_ERRNO_SUCCESS;
 #endif
+    path_release(&old_t);
+    path_release(&new_t);
+    return err;
 }
 
 // WASI path_readlink - read the target of a symlink
-uint32_t wasi_path_readlink(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_readlink(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t dirfd = (uint32_t)args[0];
     uint32_t path_ptr = (uint32_t)args[1];
     uint32_t path_len = (uint32_t)args[2];
@@ -1346,165 +3322,151 @@ uint32_t wasi_path_readlink(uint64_t* args, uint8_t* mem, int mem_size) {
     uint32_t buf_len = (uint32_t)args[4];
     uint32_t bufused_ptr = (uint32_t)args[5];
 
-    if (path_ptr + path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (buf_ptr + buf_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (bufused_ptr + 4 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
-
-    char host_path[512];
-    memcpy(host_path, mem + path_ptr, path_len);
-    host_path[path_len] = '\0';
-
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    if ((uint64_t)buf_ptr + buf_len > mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)bufused_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
+
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, path_ptr, path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    // The VFS has no symlinks: whatever exists at the path is not one
+    if (t.vfs) {
+        VfsStat vst;
+        int rc = vfs_stat_path(t.vfs, t.path, &vst);
+        path_release(&t);
+        return rc < 0 ? vfs_errno(rc) : WASI_ERRNO_INVAL;
     }
 
 #ifdef _WIN32
-    (void)base_path;
+    path_release(&t);
     *(uint32_t*)(mem + bufused_ptr) = 0;
     return WASI_ERRNO_NOSYS;
 #else
-    ssize_t len = readlinkat(base_fd, host_path, (char*)(mem + buf_ptr), buf_len);
-    if (len < 0) return errno_to_wasi(errno);
-    *(uint32_t*)(mem + bufused_ptr) = (uint32_t)len;
-    return WASI_ERRNO_SUCCESS;
+    ssize_t len = readlinkat(t.dir_fd, t.name, (char*)(mem + buf_ptr), buf_len);
+    if (len < 0) err = errno_to_wasi(errno);
+    else *(uint32_t*)(mem + bufused_ptr) = (uint32_t)len;
+    path_release(&t);
+    return err;
 #endif
 }
 
 // WASI path_symlink - create a symlink
-uint32_t wasi_path_symlink(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_path_symlink(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t old_path_ptr = (uint32_t)args[0];
     uint32_t old_path_len = (uint32_t)args[1];
     uint32_t dirfd = (uint32_t)args[2];
     uint32_t new_path_ptr = (uint32_t)args[3];
     uint32_t new_path_len = (uint32_t)args[4];
 
-    if (old_path_ptr + old_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (new_path_ptr + new_path_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (old_path_len >= 512 || new_path_len >= 512) return WASI_ERRNO_NAMETOOLONG;
+    if ((uint64_t)old_path_ptr + old_path_len > mem_size) return WASI_ERRNO_INVAL;
+    if (memchr(mem + old_path_ptr, '\0', old_path_len)) return WASI_ERRNO_INVAL;
 
-    char old_path[512];
-    char new_path[512];
-    memcpy(old_path, mem + old_path_ptr, old_path_len);
-    memcpy(new_path, mem + new_path_ptr, new_path_len);
-    old_path[old_path_len] = '\0';
-    new_path[new_path_len] = '\0';
-
-    int base_fd = -1;
-    const char* base_path = NULL;
-    if (dirfd >= 3 && dirfd < (uint32_t)g_wasi_num_preopens) {
-        base_fd = g_wasi_preopens[dirfd].host_fd;
-        base_path = g_wasi_preopens[dirfd].path;
-        if (base_fd < 0) return WASI_ERRNO_BADF;
-    } else {
-        return WASI_ERRNO_BADF;
+    PathTarget t;
+    uint32_t err = path_resolve(dirfd, mem, mem_size, new_path_ptr, new_path_len, &t);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    if (t.vfs) {
+        path_release(&t);
+        return WASI_ERRNO_PERM;
     }
 
 #ifdef _WIN32
-    (void)base_path;
+    path_release(&t);
     return WASI_ERRNO_NOSYS;
 #else
-    if (symlinkat(old_path, base_fd, new_path) < 0) return errno_to_wasi(errno);
-    return WASI_ERRNO_SUCCESS;
+    // The link text is not resolved here; following it later is checked
+    // against the base directory like any other path
+    char* old_path = malloc((size_t)old_path_len + 1);
+    if (!old_path) {
+        path_release(&t);
+        return WASI_ERRNO_NOMEM;
+    }
+    memcpy(old_path, mem + old_path_ptr, old_path_len);
+    old_path[old_path_len] = '\0';
+    if (symlinkat(old_path, t.dir_fd, t.name) < 0) err = errno_to_wasi(errno);
+    free(old_path);
+    path_release(&t);
+    return err;
 #endif
 }
 
 // WASI fd_pread - read from file at offset without changing position
-uint32_t wasi_fd_pread(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_pread(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t iovs_ptr = (uint32_t)args[1];
     uint32_t iovs_len = (uint32_t)args[2];
     uint64_t offset = args[3];
     uint32_t nread_ptr = (uint32_t)args[4];
 
-    if (iovs_ptr + iovs_len * 8 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (nread_ptr + 4 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)nread_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
 
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
+    flush_fd((int)fd);
 
-    size_t total_read = 0;
-    for (uint32_t i = 0; i < iovs_len; i++) {
-        uint32_t buf_ptr = *(uint32_t*)(mem + iovs_ptr + i * 8);
-        uint32_t buf_len = *(uint32_t*)(mem + iovs_ptr + i * 8 + 4);
-
-        if (buf_ptr + buf_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    HostIovecs h;
+    uint32_t err = host_iovecs_init(&h, mem, mem_size, iovs_ptr, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-#ifdef _WIN32
-        // Windows doesn't have pread, simulate with lseek + read + lseek
-        int64_t saved_pos = _lseeki64(host_fd, 0, SEEK_CUR);
-        if (saved_pos < 0) return WASI_ERRNO_IO;
-        if (_lseeki64(host_fd, (int64_t)offset + (int64_t)total_read, SEEK_SET) < 0) {
-            _lseeki64(host_fd, saved_pos, SEEK_SET);
-            return WASI_ERRNO_IO;
-        }
-        ssize_t bytes_read = read(host_fd, mem + buf_ptr, buf_len);
-        _lseeki64(host_fd, saved_pos, SEEK_SET);
-#else
-        ssize_t bytes_read = pread(host_fd, mem + buf_ptr, buf_len, (off_t)(offset + total_read));
-#endif
+    size_t total_read = 0;
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        err = offset > INT64_MAX ? WASI_ERRNO_INVAL
+                                 : vfs_fd_io((int)fd, vnode, &h, 0, (int64_t)offset, &total_read);
+    } else if (h.count > 0) {
+        ssize_t bytes_read =
+            use_uring((int)fd, host_fd) ? wasi_uring_pread(host_fd, h.iov, h.count, offset)
+            : use_mapped_read((int)fd, host_fd, &h) ? mapped_preadv(host_fd, h.iov, h.count, offset)
+            : host_preadv(host_fd, h.iov, h.count, offset);
         if (bytes_read < 0) {
-            *(uint32_t*)(mem + nread_ptr) = (uint32_t)total_read;
-            return errno_to_wasi(errno);
+            err = errno_to_wasi(errno);
+        } else {
+            total_read = (size_t)bytes_read;
         }
-        total_read += (size_t)bytes_read;
-        if ((size_t)bytes_read < buf_len) break;
     }
+    host_iovecs_free(&h);
 
     *(uint32_t*)(mem + nread_ptr) = (uint32_t)total_read;
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI fd_pwrite - write to file at offset without changing position
-uint32_t wasi_fd_pwrite(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_pwrite(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t iovs_ptr = (uint32_t)args[1];
     uint32_t iovs_len = (uint32_t)args[2];
     uint64_t offset = args[3];
     uint32_t nwritten_ptr = (uint32_t)args[4];
 
-    if (iovs_ptr + iovs_len * 8 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (nwritten_ptr + 4 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)nwritten_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
 
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
+    flush_fd((int)fd);
 
-    size_t total_written = 0;
-    for (uint32_t i = 0; i < iovs_len; i++) {
-        uint32_t buf_ptr = *(uint32_t*)(mem + iovs_ptr + i * 8);
-        uint32_t buf_len = *(uint32_t*)(mem + iovs_ptr + i * 8 + 4);
-
-        if (buf_ptr + buf_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    HostIovecs h;
+    uint32_t err = host_iovecs_init(&h, mem, mem_size, iovs_ptr, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) return err;
 
-#ifdef _WIN32
-        // Windows doesn't have pwrite, simulate
-        int64_t saved_pos = _lseeki64(host_fd, 0, SEEK_CUR);
-        if (saved_pos < 0) return WASI_ERRNO_IO;
-        if (_lseeki64(host_fd, (int64_t)offset + (int64_t)total_written, SEEK_SET) < 0) {
-            _lseeki64(host_fd, saved_pos, SEEK_SET);
-            return WASI_ERRNO_IO;
-        }
-        ssize_t bytes_written = write(host_fd, mem + buf_ptr, buf_len);
-        _lseeki64(host_fd, saved_pos, SEEK_SET);
-#else
-        ssize_t bytes_written = pwrite(host_fd, mem + buf_ptr, buf_len, (off_t)(offset + total_written));
-#endif
+    size_t total_written = 0;
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        err = offset > INT64_MAX ? WASI_ERRNO_INVAL
+                                 : vfs_fd_io((int)fd, vnode, &h, 1, (int64_t)offset, &total_written);
+    } else if (h.count > 0) {
+        ssize_t bytes_written = use_uring((int)fd, host_fd)
+            ? wasi_uring_pwrite(host_fd, h.iov, h.count, offset)
+            : host_pwritev(host_fd, h.iov, h.count, offset);
         if (bytes_written < 0) {
-            *(uint32_t*)(mem + nwritten_ptr) = (uint32_t)total_written;
-            return errno_to_wasi(errno);
+            err = errno_to_wasi(errno);
+        } else {
+            total_written = (size_t)bytes_written;
         }
-        total_written += (size_t)bytes_written;
-        if ((size_t)bytes_written < buf_len) break;
     }
+    host_iovecs_free(&h);
 
     *(uint32_t*)(mem + nwritten_ptr) = (uint32_t)total_written;
-    return WASI_ERRNO_SUCCESS;
+    return err;
 }
 
 // WASI fd_fdstat_set_flags - set fd flags
@@ -1516,6 +3478,7 @@ uint32_t wasi_fd_fdstat_set_flags(uint64_t* args) {
     if (host_fd < 0) return WASI_ERRNO_BADF;
 
 #ifndef _WIN32
+    // VFS fds only keep the flags in the fd table
     int fl = 0;
     if (flags & WASI_FDFLAGS_APPEND) fl |= O_APPEND;
     if (flags & WASI_FDFLAGS_NONBLOCK) fl |= O_NONBLOCK;
@@ -1525,7 +3488,7 @@ uint32_t wasi_fd_fdstat_set_flags(uint64_t* args) {
 #ifdef O_DSYNC
     if (flags & WASI_FDFLAGS_DSYNC) fl |= O_DSYNC;
 #endif
-    if (fcntl(host_fd, F_SETFL, fl) < 0) return errno_to_wasi(errno);
+    if (!get_vfs_node((int)fd) && fcntl(host_fd, F_SETFL, fl) < 0) return errno_to_wasi(errno);
 #endif
 
     // Update fd_table entry if it exists
@@ -1560,24 +3523,37 @@ uint32_t wasi_fd_renumber(uint64_t* args) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t to = (uint32_t)args[1];
 
-    if (fd <= 2 || to <= 2) return WASI_ERRNO_BADF;
-    if (fd < WASI_MAX_PREOPENS || to < WASI_MAX_PREOPENS) return WASI_ERRNO_BADF;
-    if (fd >= MAX_WASI_FDS || to >= MAX_WASI_FDS) return WASI_ERRNO_BADF;
+    // Only dynamic fds can be renumbered, and only onto dynamic fd numbers
+    if (fd < (uint32_t)g_fd_base || to < (uint32_t)g_fd_base) return WASI_ERRNO_BADF;
+    if (get_fd_entry((int)fd) == NULL) return WASI_ERRNO_BADF;
     if (fd == to) return WASI_ERRNO_SUCCESS;
 
-    init_fd_table();
-    if (g_fd_table[fd].host_fd < 0) return WASI_ERRNO_BADF;
+    WasiFdTable* t = g_fds;
+    uint32_t to_slot = to - (uint32_t)g_fd_base;
+    if (to_slot >= (uint32_t)fd_table_limit(t)) return WASI_ERRNO_BADF;
+    if ((int)to_slot >= t->capacity && fd_table_grow(t, (int)to_slot + 1) < 0) {
+        return WASI_ERRNO_NOMEM;
+    }
 
-    if (g_fd_table[to].host_fd >= 0) {
-        close(g_fd_table[to].host_fd);
+    flush_fd((int)fd);
+    flush_fd((int)to);
+    WasiFdEntry* src = get_fd_entry((int)fd);
+    WasiFdEntry* dst = &t->entries[to_slot];
+    if (dst->host_fd >= 0) {
+        release_fd_entry(dst);
+    } else {
+        t->num_open++;
     }
 
-    g_fd_table[to] = g_fd_table[fd];
-    g_fd_table[fd].host_fd = -1;
-    g_fd_table[fd].filetype = WASI_FILETYPE_UNKNOWN;
-    g_fd_table[fd].flags = 0;
-    g_fd_table[fd].rights_base = 0;
-    g_fd_table[fd].rights_inheriting = 0;
+    // The destination keeps its own free-stack bookkeeping
+    dst->host_fd = src->host_fd;
+    dst->filetype = src->filetype;
+    dst->flags = src->flags;
+    dst->rights_base = src->rights_base;
+    dst->rights_inheriting = src->rights_inheriting;
+    dst->vnode = src->vnode;
+    dst->vfs_offset = src->vfs_offset;
+    free_fd((int)fd);
 
     return WASI_ERRNO_SUCCESS;
 }
@@ -1589,6 +3565,13 @@ uint32_t wasi_fd_filestat_set_size(uint64_t* args) {
 
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
+    flush_fd((int)fd);
+
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        int rc = vfs_truncate(vnode, size);
+        return rc < 0 ? vfs_errno(rc) : WASI_ERRNO_SUCCESS;
+    }
 
 #ifdef _WIN32
     if (_chsize_s(host_fd, (long long)size) != 0) return errno_to_wasi(errno);
@@ -1608,6 +3591,9 @@ uint32_t wasi_fd_filestat_set_times(uint64_t* args) {
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
 
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) return vfs_errno(vfs_set_times(vnode, atim, mtim, fst_flags));
+
 #ifndef _WIN32
     struct timespec times[2];
     // Access time
@@ -1661,6 +3647,15 @@ uint32_t wasi_fd_allocate(uint64_t* args) {
 
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
+    flush_fd((int)fd);
+
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        if (offset + len < offset) return WASI_ERRNO_FBIG;
+        if (vfs_is_dir(vnode)) return WASI_ERRNO_BADF;
+        int rc = vfs_size(vnode) < offset + len ? vfs_truncate(vnode, offset + len) : 0;
+        return rc < 0 ? vfs_errno(rc) : WASI_ERRNO_SUCCESS;
+    }
 
 #if defined(__linux__)
     if (posix_fallocate(host_fd, (off_t)offset, (off_t)len) != 0) {
@@ -1683,11 +3678,11 @@ uint32_t wasi_fd_allocate(uint64_t* args) {
 }
 
 // WASI clock_res_get - get clock resolution
-uint32_t wasi_clock_res_get(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_clock_res_get(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t clock_id = (uint32_t)args[0];
     uint32_t res_ptr = (uint32_t)args[1];
 
-    if (res_ptr + 8 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)res_ptr + 8 > mem_size) return WASI_ERRNO_INVAL;
 
     if (clock_id != WASI_CLOCKID_REALTIME && clock_id != WASI_CLOCKID_MONOTONIC) {
         return WASI_ERRNO_INVAL;
@@ -1717,76 +3712,775 @@ uint32_t wasi_proc_raise(uint64_t* args) {
     return WASI_ERRNO_NOSYS;
 }
 
+// Append a dirent to a readdir buffer. An entry that does not fit is truncated
+// to fill the buffer; the guest retries from the previous d_next with a
+// larger one. Returns 1 if the whole entry fit.
+static int put_dirent(uint8_t* buf, uint32_t buf_len, uint32_t* bufused, uint64_t next,
+                      uint64_t ino, uint8_t type, const char* name, uint32_t namlen) {
+    // WASI dirent structure:
+    // d_next: u64 (cookie for next entry)
+    // d_ino: u64
+    // d_namlen: u32
+    // d_type: u8
+    // name follows at offset 24 (not null-terminated in buffer)
+    uint8_t header[24];
+    memset(header, 0, sizeof(header));
+    *(uint64_t*)(header + 0) = next;
+    *(uint64_t*)(header + 8) = ino;
+    *(uint32_t*)(header + 16) = namlen;
+    header[20] = type;
+
+    uint8_t* out = buf + *bufused;
+    uint32_t room = buf_len - *bufused;
+    if (room < 24) {
+        memcpy(out, header, room);
+        *bufused = buf_len;
+        return 0;
+    }
+    memcpy(out, header, 24);
+    if (room - 24 < namlen) {
+        memcpy(out + 24, name, room - 24);
+        *bufused = buf_len;
+        return 0;
+    }
+    memcpy(out + 24, name, namlen);
+    *bufused += 24 + namlen;
+    return 1;
+}
+
 // WASI fd_readdir - read directory entries
 // This is complex due to the cookie-based iteration and marshaling
-uint32_t wasi_fd_readdir(uint64_t* args, uint8_t* mem, int mem_size) {
+uint32_t wasi_fd_readdir(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
     uint32_t fd = (uint32_t)args[0];
     uint32_t buf_ptr = (uint32_t)args[1];
     uint32_t buf_len = (uint32_t)args[2];
     uint64_t cookie = args[3];
     uint32_t bufused_ptr = (uint32_t)args[4];
 
-    if (buf_ptr + buf_len > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
-    if (bufused_ptr + 4 > (uint32_t)mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)buf_ptr + buf_len > mem_size) return WASI_ERRNO_INVAL;
+    if ((uint64_t)bufused_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
 
     int host_fd = get_host_fd(fd);
     if (host_fd < 0) return WASI_ERRNO_BADF;
 
+    // VFS cookies are entry indices, so there is no stream to keep
+    VfsNode* vnode = get_vfs_node((int)fd);
+    if (vnode) {
+        if (!vfs_is_dir(vnode)) return WASI_ERRNO_NOTDIR;
+        uint32_t bufused = 0;
+        const char* name;
+        size_t name_len;
+        uint64_t ino;
+        uint8_t type;
+        while (bufused < buf_len && vfs_dirent(vnode, cookie, &name, &name_len, &ino, &type) &&
+               put_dirent(mem + buf_ptr, buf_len, &bufused, cookie + 1, ino, type,
+                          name, (uint32_t)name_len)) {
+            cookie++;
+        }
+        *(uint32_t*)(mem + bufused_ptr) = bufused;
+        return WASI_ERRNO_SUCCESS;
+    }
+
 #ifdef _WIN32
     // Windows: not implemented
     *(uint32_t*)(mem + bufused_ptr) = 0;
     return WASI_ERRNO_NOSYS;
 #else
-    // Open directory from fd
-    DIR* dir = fdopendir(dup(host_fd));
-    if (!dir) return errno_to_wasi(errno);
-
-    // Seek to cookie position
-    if (cookie > 0) {
-        seekdir(dir, (long)cookie);
+    DirStream* ds = dir_stream_get(host_fd);
+    if (!ds) return errno_to_wasi(errno);
+
+    // Continue from the stream position unless the guest asks for another
+    // cookie (0 rewinds, which also picks up changes to the directory)
+    if (cookie != ds->cookie) {
+        if (cookie == 0) {
+            rewinddir(ds->dir);
+        } else {
+            seekdir(ds->dir, (long)cookie);
+        }
+        ds->cookie = cookie;
+        ds->has_pending = 0;
     }
 
     uint32_t bufused = 0;
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL && bufused < buf_len) {
-        // WASI dirent structure:
-        // d_next: u64 (cookie for next entry)
-        // d_ino: u64
-        // d_namlen: u32
-        // d_type: u8
-        // name follows (not null-terminated in buffer)
-        size_t name_len = strlen(entry->d_name);
-        size_t entry_size = 24 + name_len;  // 8 + 8 + 4 + 1 + padding + name
-
-        if (bufused + entry_size > buf_len) break;
-
-        uint8_t* out = mem + buf_ptr + bufused;
-        uint64_t next_cookie = (uint64_t)telldir(dir);
-        *(uint64_t*)(out + 0) = next_cookie;  // d_next
-        *(uint64_t*)(out + 8) = entry->d_ino;  // d_ino
-        *(uint32_t*)(out + 16) = (uint32_t)name_len;  // d_namlen
-
-        // Map d_type to WASI filetype
-        uint8_t filetype = WASI_FILETYPE_UNKNOWN;
-        switch (entry->d_type) {
-            case DT_REG: filetype = WASI_FILETYPE_REGULAR_FILE; break;
-            case DT_DIR: filetype = WASI_FILETYPE_DIRECTORY; break;
-            case DT_LNK: filetype = WASI_FILETYPE_SYMBOLIC_LINK; break;
-            case DT_CHR: filetype = WASI_FILETYPE_CHARACTER_DEVICE; break;
-            case DT_BLK: filetype = WASI_FILETYPE_BLOCK_DEVICE; break;
-            case DT_SOCK: filetype = WASI_FILETYPE_SOCKET_STREAM; break;
-            default: filetype = WASI_FILETYPE_UNKNOWN; break;
-        }
-        out[20] = filetype;  // d_type
-
-        // Copy name (at offset 24, after padding)
-        memcpy(out + 24, entry->d_name, name_len);
-
-        bufused += (uint32_t)entry_size;
-    }
-
-    closedir(dir);
+    while (bufused < buf_len) {
+        if (!ds->has_pending) {
+            errno = 0;
+            struct dirent* entry = readdir(ds->dir);
+            if (!entry) {
+                if (errno != 0) return errno_to_wasi(errno);
+                break;
+            }
+            size_t name_len = strlen(entry->d_name);
+            if (name_len >= sizeof(ds->pending_name)) name_len = sizeof(ds->pending_name) - 1;
+            memcpy(ds->pending_name, entry->d_name, name_len);
+            ds->pending_namlen = (uint32_t)name_len;
+            ds->pending_ino = (uint64_t)entry->d_ino;
+
+            // Map d_type to WASI filetype
+            switch (entry->d_type) {
+                case DT_REG: ds->pending_type = WASI_FILETYPE_REGULAR_FILE; break;
+                case DT_DIR: ds->pending_type = WASI_FILETYPE_DIRECTORY; break;
+                case DT_LNK: ds->pending_type = WASI_FILETYPE_SYMBOLIC_LINK; break;
+                case DT_CHR: ds->pending_type = WASI_FILETYPE_CHARACTER_DEVICE; break;
+                case DT_BLK: ds->pending_type = WASI_FILETYPE_BLOCK_DEVICE; break;
+                case DT_SOCK: ds->pending_type = WASI_FILETYPE_SOCKET_STREAM; break;
+                default: ds->pending_type = WASI_FILETYPE_UNKNOWN; break;
+            }
+            ds->pending_next = (uint64_t)telldir(ds->dir);
+            ds->has_pending = 1;
+        }
+
+        if (!put_dirent(mem + buf_ptr, buf_len, &bufused, ds->pending_next, ds->pending_ino,
+                        ds->pending_type, ds->pending_name, ds->pending_namlen)) {
+            break;
+        }
+        ds->cookie = ds->pending_next;
+        ds->has_pending = 0;
+    }
+
     *(uint32_t*)(mem + bufused_ptr) = bufused;
     return WASI_ERRNO_SUCCESS;
 #endif
 }
+
+// ============================================================================
+// WASI poll_oneoff
+// ============================================================================
+
+#define WASI_EVENTTYPE_CLOCK    0
+#define WASI_EVENTTYPE_FD_READ  1
+#define WASI_EVENTTYPE_FD_WRITE 2
+
+#define WASI_SUBCLOCKFLAGS_ABSTIME       1
+#define WASI_EVENTRWFLAGS_HANGUP         1
+
+#define WASI_SUBSCRIPTION_SIZE 48
+#define WASI_EVENT_SIZE        32
+
+// Parsed subscription
+typedef struct PollSub {
+    uint64_t userdata;
+    uint8_t type;           // WASI_EVENTTYPE_*
+    uint8_t done;           // Event already written
+    int host_fd;
+    uint64_t deadline;      // Clock: monotonic deadline in ns
+    int next;               // Linux: next subscription on the same host fd
+} PollSub;
+
+#define POLL_INLINE_SUBS 64
+
+static uint64_t poll_now(int clock_id) {
+#ifdef _WIN32
+    if (clock_id == WASI_CLOCKID_MONOTONIC) {
+        return (uint64_t)GetTickCount64() * 1000000ULL;
+    }
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (t - 116444736000000000ULL) * 100;
+#else
+    struct timespec ts;
+    clock_gettime(clock_id == WASI_CLOCKID_REALTIME ? CLOCK_REALTIME : CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Bytes available for reading, as reported in fd_read events
+static uint64_t poll_read_nbytes(int host_fd) {
+#ifdef _WIN32
+    (void)host_fd;
+    return 0;
+#else
+    struct stat st;
+    if (fstat(host_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t pos = lseek(host_fd, 0, SEEK_CUR);
+        return (pos >= 0 && st.st_size > pos) ? (uint64_t)(st.st_size - pos) : 0;
+    }
+    int avail = 0;
+    if (ioctl(host_fd, FIONREAD, &avail) == 0 && avail > 0) {
+        return (uint64_t)avail;
+    }
+    return 0;
+#endif
+}
+
+static void poll_emit(uint8_t* out, uint32_t* nevents, PollSub* sub,
+                      uint16_t error, uint64_t nbytes, uint16_t flags) {
+    uint8_t* ev = out + (size_t)(*nevents) * WASI_EVENT_SIZE;
+    memset(ev, 0, WASI_EVENT_SIZE);
+    *(uint64_t*)(ev + 0) = sub->userdata;
+    *(uint16_t*)(ev + 8) = error;
+    *(uint8_t*)(ev + 10) = sub->type;
+    if (sub->type != WASI_EVENTTYPE_CLOCK) {
+        *(uint64_t*)(ev + 16) = nbytes;
+        *(uint16_t*)(ev + 24) = flags;
+    }
+    sub->done = 1;
+    (*nevents)++;
+}
+
+// Report an fd subscription as ready
+static void poll_emit_fd(uint8_t* out, uint32_t* nevents, PollSub* sub, int hangup) {
+    uint64_t nbytes = sub->type == WASI_EVENTTYPE_FD_READ ? poll_read_nbytes(sub->host_fd) : 0;
+    poll_emit(out, nevents, sub, WASI_ERRNO_SUCCESS, nbytes,
+              hangup ? WASI_EVENTRWFLAGS_HANGUP : 0);
+}
+
+// Report expired clock subscriptions
+static void poll_emit_clocks(uint8_t* out, uint32_t* nevents, PollSub* subs, uint32_t nsubs) {
+    uint64_t now = poll_now(WASI_CLOCKID_MONOTONIC);
+    for (uint32_t i = 0; i < nsubs; i++) {
+        if (!subs[i].done && subs[i].type == WASI_EVENTTYPE_CLOCK && subs[i].deadline <= now) {
+            poll_emit(out, nevents, &subs[i], WASI_ERRNO_SUCCESS, 0, 0);
+        }
+    }
+}
+
+#if defined(__linux__)
+
+// Wait on the cached epoll set. `deadline` is UINT64_MAX for no timeout.
+static uint32_t poll_wait_epoll(uint8_t* out, uint32_t* nevents, PollSub* subs,
+                                uint32_t nsubs, uint64_t deadline) {
+    if (g_poll.epfd < 0) {
+        g_poll.epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (g_poll.epfd < 0) return errno_to_wasi(errno);
+    }
+    uint32_t gen = ++g_poll.gen;
+
+    // Group subscriptions by host fd and work out the interest masks.
+    // Walk backwards so each fd's chain is in subscription order.
+    for (uint32_t i = nsubs; i-- > 0;) {
+        PollSub* sub = &subs[i];
+        if (sub->done || sub->type == WASI_EVENTTYPE_CLOCK) continue;
+        PollReg* reg = poll_reg(sub->host_fd);
+        if (!reg) return WASI_ERRNO_NOMEM;
+        if (reg->gen != gen) {
+            reg->gen = gen;
+            reg->want = 0;
+            reg->read_sub = -1;
+            reg->write_sub = -1;
+        }
+        if (sub->type == WASI_EVENTTYPE_FD_READ) {
+            sub->next = reg->read_sub;
+            reg->read_sub = (int)i;
+            reg->want |= EPOLLIN | EPOLLRDHUP;
+        } else {
+            sub->next = reg->write_sub;
+            reg->write_sub = (int)i;
+            reg->want |= EPOLLOUT;
+        }
+    }
+    for (uint32_t i = 0; i < nsubs; i++) {
+        PollSub* sub = &subs[i];
+        if (sub->done || sub->type == WASI_EVENTTYPE_CLOCK) continue;
+        PollReg* reg = &g_poll.regs[sub->host_fd];
+        int r = poll_set_interest(sub->host_fd, reg, reg->want);
+        if (r == 0) continue;
+        // Always ready or unpollable: settle every subscription on this fd now
+        uint16_t error = r < 0 ? (uint16_t)errno_to_wasi(errno) : WASI_ERRNO_SUCCESS;
+        for (int j = reg->read_sub; j >= 0; j = subs[j].next) {
+            if (error) poll_emit(out, nevents, &subs[j], error, 0, 0);
+            else poll_emit_fd(out, nevents, &subs[j], 0);
+        }
+        for (int j = reg->write_sub; j >= 0; j = subs[j].next) {
+            if (error) poll_emit(out, nevents, &subs[j], error, 0, 0);
+            else poll_emit_fd(out, nevents, &subs[j], 0);
+        }
+        reg->read_sub = -1;
+        reg->write_sub = -1;
+    }
+
+    int timeout = -1;
+    if (*nevents > 0 || deadline <= poll_now(WASI_CLOCKID_MONOTONIC)) {
+        timeout = 0;
+    } else if (deadline != UINT64_MAX) {
+        if (g_poll.timerfd < 0) {
+            g_poll.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (g_poll.timerfd < 0) return errno_to_wasi(errno);
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = POLL_TIMER_TOKEN;
+            if (epoll_ctl(g_poll.epfd, EPOLL_CTL_ADD, g_poll.timerfd, &ev) < 0) {
+                close(g_poll.timerfd);
+                g_poll.timerfd = -1;
+                return errno_to_wasi(errno);
+            }
+        }
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = (time_t)(deadline / 1000000000ULL);
+        its.it_value.tv_nsec = (long)(deadline % 1000000000ULL);
+        if (timerfd_settime(g_poll.timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+            return errno_to_wasi(errno);
+        }
+        g_poll.timer_armed = 1;
+    }
+
+    struct epoll_event evs[64];
+    for (;;) {
+        if (timeout != 0) blocking_begin();
+        int n = epoll_wait(g_poll.epfd, evs, 64, timeout);
+        if (timeout != 0) blocking_end();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno_to_wasi(errno);
+        }
+        int timer_fired = 0;
+        for (int k = 0; k < n; k++) {
+            if (evs[k].data.u64 == POLL_TIMER_TOKEN) {
+                uint64_t expirations;
+                if (read(g_poll.timerfd, &expirations, sizeof(expirations)) > 0) {
+                    g_poll.timer_armed = 0;
+                }
+                timer_fired = 1;
+                continue;
+            }
+            int host_fd = (int)evs[k].data.u64;
+            PollReg* reg = &g_poll.regs[host_fd];
+            if (reg->gen != gen) {
+                // Left over from an earlier call; stop watching it
+                poll_unregister(host_fd, reg);
+                continue;
+            }
+            uint32_t e = evs[k].events;
+            int hangup = (e & (EPOLLHUP | EPOLLRDHUP)) != 0;
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                for (int j = reg->read_sub; j >= 0; j = subs[j].next) {
+                    poll_emit_fd(out, nevents, &subs[j], hangup);
+                }
+                reg->read_sub = -1;
+            }
+            if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                for (int j = reg->write_sub; j >= 0; j = subs[j].next) {
+                    poll_emit_fd(out, nevents, &subs[j], hangup);
+                }
+                reg->write_sub = -1;
+            }
+        }
+        if (*nevents > 0 || timer_fired || timeout == 0) break;
+    }
+
+    // A timer that did not fire would wake the next call spuriously
+    if (g_poll.timer_armed) {
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        timerfd_settime(g_poll.timerfd, 0, &its, NULL);
+        g_poll.timer_armed = 0;
+    }
+    return WASI_ERRNO_SUCCESS;
+}
+
+#elif !defined(_WIN32)
+
+// Portable fallback: one poll() call with a per-call pollfd array
+static uint32_t poll_wait_poll(uint8_t* out, uint32_t* nevents, PollSub* subs,
+                               uint32_t nsubs, uint64_t deadline) {
+    struct pollfd inline_fds[POLL_INLINE_SUBS];
+    struct pollfd* fds = inline_fds;
+    if (nsubs > POLL_INLINE_SUBS) {
+        fds = (struct pollfd*)malloc(nsubs * sizeof(struct pollfd));
+        if (!fds) return WASI_ERRNO_NOMEM;
+    }
+    nfds_t nfds = 0;
+    for (uint32_t i = 0; i < nsubs; i++) {
+        PollSub* sub = &subs[i];
+        if (sub->done || sub->type == WASI_EVENTTYPE_CLOCK) continue;
+        fds[nfds].fd = sub->host_fd;
+        fds[nfds].events = sub->type == WASI_EVENTTYPE_FD_READ ? POLLIN : POLLOUT;
+        fds[nfds].revents = 0;
+        sub->next = (int)i;
+        nfds++;
+    }
+    for (;;) {
+        int timeout = -1;
+        uint64_t now = poll_now(WASI_CLOCKID_MONOTONIC);
+        if (*nevents > 0 || deadline <= now) {
+            timeout = 0;
+        } else if (deadline != UINT64_MAX) {
+            // Round up so we never wake before the deadline
+            uint64_t ms = (deadline - now + 999999) / 1000000;
+            timeout = ms > INT_MAX ? INT_MAX : (int)ms;
+        }
+        if (timeout != 0) blocking_begin();
+        int n = poll(fds, nfds, timeout);
+        if (timeout != 0) blocking_end();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            uint32_t err = errno_to_wasi(errno);
+            if (fds != inline_fds) free(fds);
+            return err;
+        }
+        uint32_t k = 0;
+        for (uint32_t i = 0; i < nsubs; i++) {
+            PollSub* sub = &subs[i];
+            if (sub->done || sub->type == WASI_EVENTTYPE_CLOCK) continue;
+            short re = fds[k++].revents;
+            if (re & POLLNVAL) {
+                poll_emit(out, nevents, sub, WASI_ERRNO_BADF, 0, 0);
+            } else if (re) {
+                poll_emit_fd(out, nevents, sub, (re & POLLHUP) != 0);
+            }
+        }
+        if (*nevents > 0 || timeout >= 0) break;
+    }
+    if (fds != inline_fds) free(fds);
+    return WASI_ERRNO_SUCCESS;
+}
+
+#endif
+
+// WASI poll_oneoff - wait for clock and fd events
+// Args: in_ptr, out_ptr, nsubscriptions, nevents_ptr
+uint32_t wasi_poll_oneoff(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
+    uint32_t in_ptr = (uint32_t)args[0];
+    uint32_t out_ptr = (uint32_t)args[1];
+    uint32_t nsubs = (uint32_t)args[2];
+    uint32_t nevents_ptr = (uint32_t)args[3];
+
+    if (nsubs == 0) return WASI_ERRNO_INVAL;
+    if ((uint64_t)in_ptr + (uint64_t)nsubs * WASI_SUBSCRIPTION_SIZE > mem_size ||
+        (uint64_t)out_ptr + (uint64_t)nsubs * WASI_EVENT_SIZE > mem_size ||
+        (uint64_t)nevents_ptr + 4 > mem_size) {
+        return WASI_ERRNO_INVAL;
+    }
+
+    PollSub inline_subs[POLL_INLINE_SUBS];
+    PollSub* subs = inline_subs;
+    if (nsubs > POLL_INLINE_SUBS) {
+        subs = (PollSub*)malloc((size_t)nsubs * sizeof(PollSub));
+        if (!subs) return WASI_ERRNO_NOMEM;
+    }
+
+    uint8_t* out = mem + out_ptr;
+    uint32_t nevents = 0;
+    uint32_t num_fd_subs = 0;
+    uint64_t deadline = UINT64_MAX;
+    uint64_t now = poll_now(WASI_CLOCKID_MONOTONIC);
+    uint32_t ret = WASI_ERRNO_SUCCESS;
+
+    for (uint32_t i = 0; i < nsubs; i++) {
+        const uint8_t* in = mem + in_ptr + (size_t)i * WASI_SUBSCRIPTION_SIZE;
+        PollSub* sub = &subs[i];
+        sub->userdata = *(const uint64_t*)(in + 0);
+        sub->type = *(const uint8_t*)(in + 8);
+        sub->done = 0;
+        sub->host_fd = -1;
+        sub->deadline = UINT64_MAX;
+        sub->next = -1;
+
+        if (sub->type == WASI_EVENTTYPE_CLOCK) {
+            uint32_t clock_id = *(const uint32_t*)(in + 16);
+            uint64_t timeout = *(const uint64_t*)(in + 24);
+            uint16_t flags = *(const uint16_t*)(in + 40);
+            if (clock_id != WASI_CLOCKID_REALTIME && clock_id != WASI_CLOCKID_MONOTONIC) {
+                poll_emit(out, &nevents, sub, WASI_ERRNO_INVAL, 0, 0);
+                continue;
+            }
+            // Convert to a monotonic deadline
+            if (!(flags & WASI_SUBCLOCKFLAGS_ABSTIME)) {
+                sub->deadline = timeout > UINT64_MAX - now ? UINT64_MAX - 1 : now + timeout;
+            } else if (clock_id == WASI_CLOCKID_MONOTONIC) {
+                sub->deadline = timeout;
+            } else {
+                uint64_t real = poll_now(WASI_CLOCKID_REALTIME);
+                uint64_t rel = timeout > real ? timeout - real : 0;
+                sub->deadline = rel > UINT64_MAX - now ? UINT64_MAX - 1 : now + rel;
+            }
+            if (sub->deadline < deadline) deadline = sub->deadline;
+        } else if (sub->type == WASI_EVENTTYPE_FD_READ || sub->type == WASI_EVENTTYPE_FD_WRITE) {
+            uint32_t fd = *(const uint32_t*)(in + 16);
+            sub->host_fd = get_host_fd((int)fd);
+            if (sub->host_fd < 0) {
+                poll_emit(out, &nevents, sub, WASI_ERRNO_BADF, 0, 0);
+                continue;
+            }
+            // In-memory files never block
+            VfsNode* vnode = get_vfs_node((int)fd);
+            if (vnode) {
+                WasiFdEntry* entry = get_fd_entry((int)fd);
+                uint64_t pos = entry ? entry->vfs_offset : 0;
+                uint64_t size = vfs_is_dir(vnode) ? 0 : vfs_size(vnode);
+                uint64_t nbytes = sub->type == WASI_EVENTTYPE_FD_READ && size > pos ? size - pos : 0;
+                poll_emit(out, &nevents, sub, WASI_ERRNO_SUCCESS, nbytes, 0);
+                continue;
+            }
+            num_fd_subs++;
+        } else {
+            ret = WASI_ERRNO_INVAL;
+            goto done;
+        }
+    }
+
+    // Pending output must be visible before the guest blocks
+    if (nevents == 0 && deadline > now) {
+        flush_fd(1);
+        flush_fd(2);
+    }
+
+    if (num_fd_subs > 0) {
+#if defined(__linux__)
+        ret = poll_wait_epoll(out, &nevents, subs, nsubs, deadline);
+#elif !defined(_WIN32)
+        ret = poll_wait_poll(out, &nevents, subs, nsubs, deadline);
+#else
+        // Windows CRT fds cannot be waited on; report them ready
+        for (uint32_t i = 0; i < nsubs; i++) {
+            if (!subs[i].done && subs[i].type != WASI_EVENTTYPE_CLOCK) {
+                poll_emit_fd(out, &nevents, &subs[i], 0);
+            }
+        }
+#endif
+        if (ret != WASI_ERRNO_SUCCESS) goto done;
+    } else if (nevents == 0 && deadline != UINT64_MAX) {
+        // Only clocks: sleep until the earliest deadline
+        blocking_begin();
+#ifdef _WIN32
+        uint64_t t = poll_now(WASI_CLOCKID_MONOTONIC);
+        if (deadline > t) Sleep((DWORD)((deadline - t + 999999) / 1000000));
+#else
+        struct timespec ts;
+        ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+        ts.tv_nsec = (long)(deadline % 1000000000ULL);
+#if defined(__linux__)
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+#else
+        for (;;) {
+            uint64_t t = poll_now(WASI_CLOCKID_MONOTONIC);
+            if (t >= deadline) break;
+            struct timespec rel;
+            rel.tv_sec = (time_t)((deadline - t) / 1000000000ULL);
+            rel.tv_nsec = (long)((deadline - t) % 1000000000ULL);
+            nanosleep(&rel, NULL);
+        }
+#endif
+#endif
+        blocking_end();
+    }
+    poll_emit_clocks(out, &nevents, subs, nsubs);
+    *(uint32_t*)(mem + nevents_ptr) = nevents;
+
+done:
+    if (subs != inline_subs) free(subs);
+    return ret;
+}
+
+// ============================================================================
+// WASI Sockets
+// ============================================================================
+
+// Host fd for a socket operation: fds that are known not to be sockets fail
+// with NOTSOCK, anything else is left to the host to reject
+static int get_socket_fd(uint32_t fd, uint32_t* err) {
+    int host_fd = get_host_fd((int)fd);
+    if (host_fd < 0) {
+        *err = WASI_ERRNO_BADF;
+        return -1;
+    }
+    if (fd < (uint32_t)g_fds->num_preopens && fd >= 3 &&
+        g_fds->preopens[fd].filetype != WASI_FILETYPE_SOCKET_STREAM) {
+        *err = WASI_ERRNO_NOTSOCK;
+        return -1;
+    }
+    WasiFdEntry* entry = get_fd_entry((int)fd);
+    if (entry && entry->filetype != WASI_FILETYPE_SOCKET_STREAM &&
+        entry->filetype != WASI_FILETYPE_SOCKET_DGRAM) {
+        *err = WASI_ERRNO_NOTSOCK;
+        return -1;
+    }
+    return host_fd;
+}
+
+// WASI sock_accept - accept a connection on a listening socket
+// Args: fd, flags (fdflags), result_fd_ptr
+uint32_t wasi_sock_accept(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
+    uint32_t fd = (uint32_t)args[0];
+    uint16_t flags = (uint16_t)args[1];
+    uint32_t result_ptr = (uint32_t)args[2];
+
+    if ((uint64_t)result_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
+    if (flags & ~WASI_FDFLAGS_NONBLOCK) return WASI_ERRNO_INVAL;
+
+#ifdef _WIN32
+    (void)fd;
+    (void)mem;
+    return WASI_ERRNO_NOSYS;
+#else
+    uint32_t err;
+    int host_fd = get_socket_fd(fd, &err);
+    if (host_fd < 0) return err;
+
+    int conn;
+    blocking_begin();
+    do {
+        conn = accept(host_fd, NULL, NULL);
+    } while (conn < 0 && errno == EINTR);
+    int saved_errno = errno;
+    blocking_end();
+    if (conn < 0) return errno_to_wasi(saved_errno);
+    fcntl(conn, F_SETFD, FD_CLOEXEC);
+#if defined(__linux__)
+    // Linux does not copy O_NONBLOCK from the listener
+    if (flags & WASI_FDFLAGS_NONBLOCK) {
+        fcntl(conn, F_SETFL, fcntl(conn, F_GETFL) | O_NONBLOCK);
+    }
+#else
+    int fl = fcntl(conn, F_GETFL);
+    if (fl >= 0) {
+        fl = (flags & WASI_FDFLAGS_NONBLOCK) ? (fl | O_NONBLOCK) : (fl & ~O_NONBLOCK);
+        fcntl(conn, F_SETFL, fl);
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(conn, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+#endif
+
+    int wasi_fd = allocate_fd(conn, WASI_FILETYPE_SOCKET_STREAM, flags,
+                              WASI_RIGHTS_SOCKET_CONN, 0);
+    if (wasi_fd < 0) {
+        uint32_t err = errno_to_wasi(errno);
+        close(conn);
+        return err;
+    }
+    *(uint32_t*)(mem + result_ptr) = (uint32_t)wasi_fd;
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
+
+// WASI sock_recv - receive data from a socket
+// Args: fd, ri_data (iovec ptr), ri_data_len, ri_flags, ro_datalen_ptr, ro_flags_ptr
+uint32_t wasi_sock_recv(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
+    uint32_t fd = (uint32_t)args[0];
+    uint32_t iovs_ptr = (uint32_t)args[1];
+    uint32_t iovs_len = (uint32_t)args[2];
+    uint16_t ri_flags = (uint16_t)args[3];
+    uint32_t datalen_ptr = (uint32_t)args[4];
+    uint32_t oflags_ptr = (uint32_t)args[5];
+
+    if ((uint64_t)datalen_ptr + 4 > mem_size ||
+        (uint64_t)oflags_ptr + 2 > mem_size) {
+        return WASI_ERRNO_INVAL;
+    }
+    if (ri_flags & ~(WASI_RIFLAGS_RECV_PEEK | WASI_RIFLAGS_RECV_WAITALL)) {
+        return WASI_ERRNO_INVAL;
+    }
+
+#ifdef _WIN32
+    (void)fd;
+    (void)iovs_ptr;
+    (void)iovs_len;
+    return WASI_ERRNO_NOSYS;
+#else
+    uint32_t err;
+    int host_fd = get_socket_fd(fd, &err);
+    if (host_fd < 0) return err;
+
+    HostIovecs h;
+    err = host_iovecs_init(&h, mem, mem_size, iovs_ptr, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    int msg_flags = 0;
+    if (ri_flags & WASI_RIFLAGS_RECV_PEEK) msg_flags |= MSG_PEEK;
+    if (ri_flags & WASI_RIFLAGS_RECV_WAITALL) msg_flags |= MSG_WAITALL;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = h.iov;
+    msg.msg_iovlen = h.count;
+    ssize_t n;
+    blocking_begin();
+    do {
+        n = recvmsg(host_fd, &msg, msg_flags);
+    } while (n < 0 && errno == EINTR);
+    int saved_errno = errno;
+    blocking_end();
+    host_iovecs_free(&h);
+    if (n < 0) return errno_to_wasi(saved_errno);
+
+    *(uint32_t*)(mem + datalen_ptr) = (uint32_t)n;
+    *(uint16_t*)(mem + oflags_ptr) =
+        (msg.msg_flags & MSG_TRUNC) ? WASI_ROFLAGS_RECV_DATA_TRUNCATED : 0;
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
+
+// WASI sock_send - send data on a socket
+// Args: fd, si_data (iovec ptr), si_data_len, si_flags, so_datalen_ptr
+uint32_t wasi_sock_send(uint64_t* args, uint8_t* mem, uint64_t mem_size) {
+    uint32_t fd = (uint32_t)args[0];
+    uint32_t iovs_ptr = (uint32_t)args[1];
+    uint32_t iovs_len = (uint32_t)args[2];
+    uint16_t si_flags = (uint16_t)args[3];
+    uint32_t datalen_ptr = (uint32_t)args[4];
+
+    if ((uint64_t)datalen_ptr + 4 > mem_size) return WASI_ERRNO_INVAL;
+    if (si_flags != 0) return WASI_ERRNO_INVAL;
+
+#ifdef _WIN32
+    (void)fd;
+    (void)iovs_ptr;
+    (void)iovs_len;
+    return WASI_ERRNO_NOSYS;
+#else
+    uint32_t err;
+    int host_fd = get_socket_fd(fd, &err);
+    if (host_fd < 0) return err;
+
+    HostIovecs h;
+    err = host_iovecs_init(&h, mem, mem_size, iovs_ptr, iovs_len);
+    if (err != WASI_ERRNO_SUCCESS) return err;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = h.iov;
+    msg.msg_iovlen = h.count;
+    int msg_flags = 0;
+#ifdef MSG_NOSIGNAL
+    // A closed peer must surface as PIPE, not kill the host process
+    msg_flags |= MSG_NOSIGNAL;
+#endif
+    ssize_t n;
+    blocking_begin();
+    do {
+        n = sendmsg(host_fd, &msg, msg_flags);
+    } while (n < 0 && errno == EINTR);
+    int saved_errno = errno;
+    blocking_end();
+    host_iovecs_free(&h);
+    if (n < 0) return errno_to_wasi(saved_errno);
+
+    *(uint32_t*)(mem + datalen_ptr) = (uint32_t)n;
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
+
+// WASI sock_shutdown - shut down socket send and/or receive channels
+// Args: fd, how (sdflags)
+uint32_t wasi_sock_shutdown(uint64_t* args) {
+    uint32_t fd = (uint32_t)args[0];
+    uint8_t how = (uint8_t)args[1];
+
+#ifdef _WIN32
+    (void)fd;
+    (void)how;
+    return WASI_ERRNO_NOSYS;
+#else
+    int host_how;
+    if (how == (WASI_SDFLAGS_RD | WASI_SDFLAGS_WR)) {
+        host_how = SHUT_RDWR;
+    } else if (how == WASI_SDFLAGS_RD) {
+        host_how = SHUT_RD;
+    } else if (how == WASI_SDFLAGS_WR) {
+        host_how = SHUT_WR;
+    } else {
+        return WASI_ERRNO_INVAL;
+    }
+
+    uint32_t err;
+    int host_fd = get_socket_fd(fd, &err);
+    if (host_fd < 0) return err;
+    if (shutdown(host_fd, host_how) < 0) return errno_to_wasi(errno);
+    return WASI_ERRNO_SUCCESS;
+#endif
+}
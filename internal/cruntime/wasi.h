@@ -51,6 +51,11 @@
 #define HOST_IMPORT_WASI_PATH_READLINK      46
 #define HOST_IMPORT_WASI_PROC_RAISE         47
 #define HOST_IMPORT_WASI_PATH_SYMLINK       48
+#define HOST_IMPORT_WASI_POLL_ONEOFF        49
+#define HOST_IMPORT_WASI_SOCK_ACCEPT        50
+#define HOST_IMPORT_WASI_SOCK_RECV          51
+#define HOST_IMPORT_WASI_SOCK_SEND          52
+#define HOST_IMPORT_WASI_SOCK_SHUTDOWN      53
 
 // ============================================================================
 // WASI Error Codes
@@ -58,21 +63,33 @@
 
 #define WASI_ERRNO_SUCCESS    0
 #define WASI_ERRNO_ACCES      2    // Permission denied
+#define WASI_ERRNO_AGAIN      6    // Resource unavailable, try again
 #define WASI_ERRNO_BADF       8
+#define WASI_ERRNO_CONNABORTED 13  // Connection aborted
+#define WASI_ERRNO_CONNRESET  15   // Connection reset
 #define WASI_ERRNO_EXIST      20   // File exists
+#define WASI_ERRNO_FBIG       22   // File too large
 #define WASI_ERRNO_INVAL      28
 #define WASI_ERRNO_IO         29   // I/O error
 #define WASI_ERRNO_ISDIR      31
+#define WASI_ERRNO_LOOP       32   // Too many levels of symbolic links
+#define WASI_ERRNO_MFILE      33   // Too many open files (per process)
 #define WASI_ERRNO_NAMETOOLONG 37  // Filename too long
 #define WASI_ERRNO_NFILE      41   // Too many open files in system
 #define WASI_ERRNO_NOENT      44   // No such file or directory
+#define WASI_ERRNO_NOMEM      48   // Not enough space
 #define WASI_ERRNO_NOSPC      51   // No space left on device
 #define WASI_ERRNO_NOSYS      52
+#define WASI_ERRNO_NOTCONN    53   // Socket is not connected
 #define WASI_ERRNO_NOTDIR     54
 #define WASI_ERRNO_NOTEMPTY   55   // Directory not empty
+#define WASI_ERRNO_NOTSOCK    57   // Not a socket
 #define WASI_ERRNO_PERM       63   // Operation not permitted
+#define WASI_ERRNO_PIPE       64   // Broken pipe
 #define WASI_ERRNO_ROFS       69   // Read-only file system
 #define WASI_ERRNO_SPIPE      70   // Invalid seek (pipe)
+#define WASI_ERRNO_XDEV       75   // Cross-device link
+#define WASI_ERRNO_NOTCAPABLE 76   // Path escapes the base directory
 
 // ============================================================================
 // WASI File Descriptor Types
@@ -96,6 +113,15 @@
 #define WASI_RIGHTS_FD_SEEK             (1ULL << 2)
 #define WASI_RIGHTS_FD_FDSTAT_SET_FLAGS (1ULL << 3)
 #define WASI_RIGHTS_PATH_OPEN           (1ULL << 13)
+#define WASI_RIGHTS_POLL_FD_READWRITE   (1ULL << 27)
+#define WASI_RIGHTS_SOCK_SHUTDOWN       (1ULL << 28)
+#define WASI_RIGHTS_SOCK_ACCEPT         (1ULL << 29)
+
+// Rights of an accepted connection
+#define WASI_RIGHTS_SOCKET_CONN (WASI_RIGHTS_FD_READ | WASI_RIGHTS_FD_WRITE | \
+                                 WASI_RIGHTS_FD_FDSTAT_SET_FLAGS | \
+                                 WASI_RIGHTS_POLL_FD_READWRITE | \
+                                 WASI_RIGHTS_SOCK_SHUTDOWN)
 
 // ============================================================================
 // WASI Clock IDs
@@ -129,6 +155,28 @@
 #define WASI_FDFLAGS_RSYNC    8
 #define WASI_FDFLAGS_SYNC     16
 
+// ============================================================================
+// WASI Socket Flags
+// ============================================================================
+
+#define WASI_RIFLAGS_RECV_PEEK           1
+#define WASI_RIFLAGS_RECV_WAITALL        2
+#define WASI_ROFLAGS_RECV_DATA_TRUNCATED 1
+#define WASI_SDFLAGS_RD                  1
+#define WASI_SDFLAGS_WR                  2
+
+// WASI I/O backends (wasi_set_io_backend)
+#define WASI_IO_BACKEND_SYNC      0   // Plain blocking syscalls
+#define WASI_IO_BACKEND_IO_URING  1   // io_uring with readahead (Linux)
+// io_uring with writes acknowledged before they land; not POSIX, since a
+// failed write is reported by a later call (or never, if none follows)
+#define WASI_IO_BACKEND_IO_URING_WRITE_BEHIND 2
+
+// random_get sources (wasi_set_random_source)
+#define WASI_RANDOM_OS      0   // OS CSPRNG (getrandom) through a buffered pool
+#define WASI_RANDOM_CHACHA  1   // ChaCha20 keyed from the OS CSPRNG
+#define WASI_RANDOM_SEEDED  2   // ChaCha20 keyed from a fixed seed (reproducible)
+
 // ============================================================================
 // Public WASI API (called from MoonBit FFI)
 // ============================================================================
@@ -139,6 +187,10 @@ void wasi_init(int argc, char** argv);
 // Get WASI exit code (after proc_exit)
 int wasi_get_exit_code(void);
 
+// Exit code of the last proc_exit on this thread, for embedders running
+// several instances at once (wasi_get_exit_code is the latest of any thread)
+int wasi_thread_exit_code(void);
+
 // Check if WASI has exited (via proc_exit)
 int wasi_has_exited(void);
 
@@ -152,53 +204,146 @@ int wasi_add_preopen_file(int host_fd, const char* path);
 // FFI wrapper for wasi_add_preopen_file without path (for testing)
 int wasi_add_preopen_file_ffi(int host_fd);
 
+// Add a listening socket (TCP or Unix) owned by the caller
+// Returns the WASI fd number (3+) or -1 on error
+int wasi_add_preopen_socket(int host_fd);
+
+// Create a non-blocking listening socket on addr ("host:port", "[v6]:port"
+// or "unix:/path") and add it as a preopen; closed by wasi_reset_preopens.
+// Returns the WASI fd number (3+) or -1 on error
+int wasi_add_preopen_listener(const uint8_t* addr, int addr_len, int backlog);
+
+// Add an in-memory directory preopened under the guest path, preloaded from
+// a tar archive if tar_len > 0; freed by wasi_reset_preopens.
+// Returns the WASI fd number (3+) or -1 on error
+int wasi_add_preopen_vfs(const uint8_t* path, int path_len, const uint8_t* tar, int tar_len);
+
 // Reset preopens to just stdin/stdout/stderr
 void wasi_reset_preopens(void);
 
+// Set the number of fd slots reserved for stdio and preopens (the first
+// dynamically allocated fd) and the default limit on open dynamic fds per
+// fd table. Must be called before preopens are added or fd tables created.
+// Returns 0 on success, -1 if a limit is out of range or it is too late
+int wasi_set_fd_limits(int max_preopens, int max_fds);
+
+// Per-instance tables for fds opened by the guest (path_open, sock_accept).
+// The active table serves all WASI calls; NULL means the shared default
+// table. max_fds <= 0 uses the limit from wasi_set_fd_limits.
+typedef struct WasiFdTable WasiFdTable;
+WasiFdTable* wasi_fd_table_new(int max_fds);
+
+// Close every fd still open in the table and free it
+// (the default table is only emptied)
+void wasi_fd_table_free(WasiFdTable* table);
+
+// Close every fd still open in the table, keeping the table
+void wasi_fd_table_close_all(WasiFdTable* table);
+
+// Make a table active; returns the previously active one
+WasiFdTable* wasi_fd_table_activate(WasiFdTable* table);
+WasiFdTable* wasi_fd_table_current(void);
+
+// Number of fds open in a table
+int wasi_fd_table_count(WasiFdTable* table);
+
+// Serve WASI stdin and stdout from the given host fds on this thread
+// (-1 = the process's own), e.g. to run a command on a request's payload.
+// Redirected stdio is never buffered
+void wasi_set_stdio_host_fds(int stdin_fd, int stdout_fd);
+
+// Host fd WASI fd 0 or 1 is redirected to on this thread, or -1
+int wasi_stdio_host_fd(int wasi_fd);
+
+// Enable or disable userspace output buffering for stdout and stderr
+void wasi_set_stdio_buffered(int enabled);
+
+// Enable or disable userspace output buffering for a stdio or preopened fd
+// Returns 0 on success, -1 if the fd is invalid or no buffer slot is free
+int wasi_set_fd_buffered(int wasi_fd, int enabled);
+
+// Flush all buffered output (called at the end of execute)
+void wasi_flush_all(void);
+
+// Take and release the WASI lock around a guest's WASI call. Calls that
+// block on the host release it while they wait
+void wasi_call_lock(void);
+void wasi_call_unlock(void);
+
+// Release per-thread WASI state (poll_oneoff's epoll set) of a thread that
+// is about to end
+void wasi_thread_cleanup(void);
+
+// Select the I/O backend for file reads/writes/syncs
+// Returns the backend in use (falls back to WASI_IO_BACKEND_SYNC when
+// io_uring is unavailable)
+int wasi_set_io_backend(int backend);
+
+// Get the I/O backend in use
+int wasi_get_io_backend(void);
+
+// Enable or disable mapping large regular-file reads into linear memory
+// (memories from threads_memory_reserve only; others are always copied).
+// Returns whether mapped reads are enabled (never on Windows)
+int wasi_set_mapped_reads(int enabled);
+
+// Total bytes mapped (rather than copied) by mapped reads so far
+uint64_t wasi_mapped_read_bytes(void);
+
+// Select the random_get source for all instances; seed is used by
+// WASI_RANDOM_SEEDED, which gives each instance its own stream from the seed,
+// restarted at every wasi_init. Returns 0 on success, -1 if invalid
+int wasi_set_random_source(int source, uint64_t seed);
+
 // ============================================================================
 // WASI Syscall Implementations (called from op_call_import)
 // ============================================================================
 
-uint32_t wasi_args_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_args_sizes_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_environ_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_environ_sizes_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_write(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_read(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_args_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_args_sizes_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_environ_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_environ_sizes_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_write(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_read(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_fd_close(uint64_t* args);
-uint32_t wasi_fd_prestat_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_prestat_dir_name(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_fd_prestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_prestat_dir_name(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_fdstat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_proc_exit(uint64_t* args);
-uint32_t wasi_clock_time_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_random_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_clock_time_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_random_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_open(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_seek(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_tell(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_filestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_filestat_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_fd_sync(uint64_t* args);
 uint32_t wasi_fd_datasync(uint64_t* args);
 uint32_t wasi_sched_yield(void);
-uint32_t wasi_path_create_directory(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_remove_directory(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_unlink_file(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_rename(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_path_create_directory(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_remove_directory(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_unlink_file(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_rename(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_fd_fdstat_set_flags(uint64_t* args);
 uint32_t wasi_fd_fdstat_set_rights(uint64_t* args);
-uint32_t wasi_fd_pread(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_pwrite(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_fd_readdir(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_fd_pread(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_pwrite(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_fd_readdir(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_fd_renumber(uint64_t* args);
 uint32_t wasi_fd_filestat_set_size(uint64_t* args);
 uint32_t wasi_fd_filestat_set_times(uint64_t* args);
 uint32_t wasi_fd_advise(uint64_t* args);
 uint32_t wasi_fd_allocate(uint64_t* args);
-uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_link(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_readlink(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_path_symlink(uint64_t* args, uint8_t* mem, int mem_size);
-uint32_t wasi_clock_res_get(uint64_t* args, uint8_t* mem, int mem_size);
+uint32_t wasi_path_filestat_set_times(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_link(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_readlink(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_path_symlink(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_clock_res_get(uint64_t* args, uint8_t* mem, uint64_t mem_size);
 uint32_t wasi_proc_raise(uint64_t* args);
+uint32_t wasi_poll_oneoff(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_sock_accept(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_sock_recv(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_sock_send(uint64_t* args, uint8_t* mem, uint64_t mem_size);
+uint32_t wasi_sock_shutdown(uint64_t* args);
 
 #endif // WASI_H
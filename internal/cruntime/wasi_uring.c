@@ -0,0 +1,888 @@
+// io_uring I/O backend for WASI file operations
+//
+// The guest still sees synchronous WASI calls; the backend only changes how
+// the host does the work:
+// - fd_write/fd_pwrite are submitted and waited for, so the guest gets the
+//   real byte count or error as POSIX requires. With write-behind (opt-in)
+//   data is instead copied into a staging area and queued as a linked chain
+//   of SQEs that is submitted in batches, and the write reports success
+//   before it lands: a failure surfaces at a later write, fsync or flush, and
+//   is lost if the guest never makes one. The staging area is double-buffered
+//   so one batch can be in flight while the next one fills.
+// - Sequential fd_read calls are served from a per-fd readahead buffer whose
+//   next chunk is read in the background while the guest runs.
+// - fd_sync/fd_datasync submit pending writes plus the fsync as one batch.
+//
+// Every read and write is submitted at an explicit offset. The guest-visible
+// file position is tracked here and written back to the host fd with lseek()
+// when the fd is settled (wasi_uring_sync_fd/wasi_uring_flush), so results
+// never depend on when the kernel updates f_pos for in-flight requests.
+//
+// The ring is driven with raw syscalls (no liburing dependency). When the
+// kernel headers or the syscall are unavailable, wasi_uring_init() reports 0
+// and wasi.c keeps using plain syscalls.
+
+#if defined(__linux__)
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#endif
+
+#include "wasi_uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define WASI_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef WASI_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+// ============================================================================
+// Ring State
+// ============================================================================
+
+#define URING_ENTRIES 64
+#define URING_STAGING_SIZE (128 * 1024)     // Per staging half
+#define URING_READAHEAD_SIZE (128 * 1024)
+#define URING_MAX_FILES 8
+#define URING_INLINE_IOVS 16
+
+enum {
+    URING_OP_SYNC,          // Caller waits for the result
+    URING_OP_WRITE_BEHIND,  // Fire-and-forget; errors become deferred errors
+    URING_OP_READAHEAD,     // Owned by a readahead slot
+};
+
+typedef struct UringOp {
+    int in_use;
+    int done;
+    int kind;
+    int32_t res;
+    size_t expect;          // Expected byte count (write-behind)
+    int half;               // Staging half referenced (write-behind)
+    struct iovec iov;       // Single-buffer ops keep their iovec alive here
+} UringOp;
+
+// Per-fd state: tracked file position and readahead buffer
+typedef struct UringFile {
+    int host_fd;            // -1 if slot is free
+    uint64_t pos;           // Guest-visible file position
+    int append;             // O_APPEND fd: writes land at EOF
+    int pos_valid;          // 0 after an append write until settled
+    uint8_t* buf;           // Readahead buffer (allocated on first use)
+    size_t len;             // Valid bytes in buf
+    size_t consumed;        // Bytes of buf already returned to the guest
+    int op;                 // In-flight refill op, or -1
+    int eof;
+    unsigned lru;
+} UringFile;
+
+typedef struct Uring {
+    int fd;                 // -1 if not set up
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    struct io_uring_sqe* sqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned to_submit;     // SQEs queued but not yet submitted
+    unsigned outstanding;   // Ops whose CQE has not been reaped
+    int write_behind;       // Queue writes and acknowledge them early
+    int last_write_sqe;     // Unsubmitted write-behind SQE to link from, or -1
+    int deferred_errno;     // First error from a write-behind op
+    uint8_t* staging[2];
+    size_t staging_used[2];
+    int staging_ops[2];     // Outstanding write-behind ops per half
+    int staging_cur;
+    UringOp ops[URING_ENTRIES];
+    UringFile files[URING_MAX_FILES];
+    unsigned lru_clock;
+} Uring;
+
+static Uring g_uring = {.fd = -1};
+
+// ============================================================================
+// Ring Primitives
+// ============================================================================
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// Record completions from the CQ ring into their op slots
+static void uring_reap(void) {
+    Uring* r = &g_uring;
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+        UringOp* op = &r->ops[cqe->user_data];
+        op->res = cqe->res;
+        op->done = 1;
+        r->outstanding--;
+        if (op->kind == URING_OP_WRITE_BEHIND) {
+            if (r->deferred_errno == 0) {
+                if (op->res < 0) {
+                    r->deferred_errno = -op->res;
+                } else if ((size_t)op->res < op->expect) {
+                    r->deferred_errno = EIO;
+                }
+            }
+            r->staging_ops[op->half]--;
+            op->in_use = 0;
+        }
+        head++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Submit queued SQEs and optionally wait for at least min_complete CQEs
+static int uring_enter(unsigned min_complete) {
+    Uring* r = &g_uring;
+    for (;;) {
+        unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int n = sys_io_uring_enter(r->fd, r->to_submit, min_complete, flags);
+        if (n >= 0) {
+            r->to_submit -= (unsigned)n;
+            if (r->last_write_sqe >= 0 && r->to_submit == 0) {
+                r->last_write_sqe = -1;
+            }
+            return 0;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EBUSY) {
+            uring_reap();
+            continue;
+        }
+        return -1;
+    }
+}
+
+// 1 if any write-behind op is queued or in flight
+static int wb_pending(void) {
+    return g_uring.staging_ops[0] + g_uring.staging_ops[1] > 0;
+}
+
+static int uring_alloc_op(int kind) {
+    for (int i = 0; i < URING_ENTRIES; i++) {
+        if (!g_uring.ops[i].in_use) {
+            UringOp* op = &g_uring.ops[i];
+            memset(op, 0, sizeof(*op));
+            op->in_use = 1;
+            op->kind = kind;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void uring_release_op(int idx) {
+    g_uring.ops[idx].in_use = 0;
+}
+
+// Wait until every submitted and queued op has completed
+static void uring_wait_all(void) {
+    uring_reap();
+    while (g_uring.outstanding > 0) {
+        if (uring_enter(1) < 0) break;
+        uring_reap();
+    }
+    g_uring.staging_used[0] = 0;
+    g_uring.staging_used[1] = 0;
+}
+
+// Fill the next SQE for op_idx. Returns NULL if the ring is full.
+static struct io_uring_sqe* uring_get_sqe(int op_idx) {
+    Uring* r = &g_uring;
+    unsigned tail = *r->sq_tail;
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= URING_ENTRIES) return NULL;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)op_idx;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+    r->outstanding++;
+    return sqe;
+}
+
+// Allocate an op and its SQE, draining the ring first if it is full
+static struct io_uring_sqe* uring_prep(int kind, int* op_out) {
+    int op = uring_alloc_op(kind);
+    if (op < 0) {
+        uring_wait_all();
+        op = uring_alloc_op(kind);
+        if (op < 0) return NULL;
+    }
+    struct io_uring_sqe* sqe = uring_get_sqe(op);
+    if (!sqe) {
+        uring_wait_all();
+        sqe = uring_get_sqe(op);
+        if (!sqe) {
+            uring_release_op(op);
+            return NULL;
+        }
+    }
+    *op_out = op;
+    return sqe;
+}
+
+static void prep_rw(struct io_uring_sqe* sqe, int opcode, int fd,
+                    const struct iovec* iov, int iovcnt, int64_t offset) {
+    sqe->opcode = (uint8_t)opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = (uint32_t)iovcnt;
+    sqe->off = (uint64_t)offset;
+}
+
+// Submit everything queued so far and wait for op_idx. Returns its result.
+static int32_t uring_wait_op(int op_idx) {
+    UringOp* op = &g_uring.ops[op_idx];
+    uring_reap();
+    while (!op->done) {
+        if (uring_enter(1) < 0) {
+            return -errno;
+        }
+        uring_reap();
+    }
+    return op->res;
+}
+
+// Submit a single read/write and wait for it
+static long uring_sync_rw(int opcode, int fd, const struct iovec* iov,
+                          int iovcnt, int64_t offset) {
+    int op;
+    struct io_uring_sqe* sqe = uring_prep(URING_OP_SYNC, &op);
+    if (!sqe) {
+        errno = EAGAIN;
+        return -1;
+    }
+    prep_rw(sqe, opcode, fd, iov, iovcnt, offset);
+    int32_t res = uring_wait_op(op);
+    uring_release_op(op);
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return res;
+}
+
+static size_t iov_total(const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+// ============================================================================
+// File State and Readahead
+// ============================================================================
+
+static UringFile* file_find(int host_fd) {
+    for (int i = 0; i < URING_MAX_FILES; i++) {
+        if (g_uring.files[i].host_fd == host_fd) return &g_uring.files[i];
+    }
+    return NULL;
+}
+
+// Wait for an in-flight refill and record its result
+static int ra_complete_refill(UringFile* f) {
+    if (f->op < 0) return 0;
+    int32_t res = uring_wait_op(f->op);
+    uring_release_op(f->op);
+    f->op = -1;
+    f->consumed = 0;
+    if (res < 0) {
+        f->len = 0;
+        return res;
+    }
+    f->len = (size_t)res;
+    f->eof = (res == 0);
+    return 0;
+}
+
+// Start reading the next chunk at f->pos in the background
+static void ra_start_refill(UringFile* f) {
+    f->len = 0;
+    f->consumed = 0;
+    if (!f->buf) {
+        f->buf = (uint8_t*)malloc(URING_READAHEAD_SIZE);
+        if (!f->buf) return;
+    }
+    int op;
+    struct io_uring_sqe* sqe = uring_prep(URING_OP_READAHEAD, &op);
+    if (!sqe) return;
+    UringOp* o = &g_uring.ops[op];
+    o->iov.iov_base = f->buf;
+    o->iov.iov_len = URING_READAHEAD_SIZE;
+    prep_rw(sqe, IORING_OP_READV, f->host_fd, &o->iov, 1, (int64_t)f->pos);
+    f->op = op;
+    uring_enter(0);
+}
+
+// Throw away readahead data (e.g. before the file is modified)
+static void ra_discard(UringFile* f) {
+    if (f->op >= 0) {
+        uring_wait_op(f->op);
+        uring_release_op(f->op);
+        f->op = -1;
+    }
+    f->len = 0;
+    f->consumed = 0;
+    f->eof = 0;
+}
+
+// Complete pending writes, write the tracked position back to the host fd
+// and release the slot
+static void file_settle(UringFile* f) {
+    ra_discard(f);
+    if (wb_pending()) uring_wait_all();
+    if (f->pos_valid) {
+        lseek(f->host_fd, (off_t)f->pos, SEEK_SET);
+    } else {
+        lseek(f->host_fd, 0, SEEK_END);
+    }
+    f->host_fd = -1;
+}
+
+// Find or create the state for host_fd, starting from its current position
+static UringFile* file_get(int host_fd) {
+    UringFile* f = file_find(host_fd);
+    if (f) {
+        f->lru = ++g_uring.lru_clock;
+        return f;
+    }
+    off_t pos = lseek(host_fd, 0, SEEK_CUR);
+    if (pos < 0) return NULL;
+    for (int i = 0; i < URING_MAX_FILES; i++) {
+        UringFile* slot = &g_uring.files[i];
+        if (slot->host_fd < 0) {
+            f = slot;
+            break;
+        }
+        if (f == NULL || slot->lru < f->lru) f = slot;
+    }
+    if (f->host_fd >= 0) file_settle(f);
+    int fl = fcntl(host_fd, F_GETFL);
+    f->host_fd = host_fd;
+    f->pos = (uint64_t)pos;
+    f->append = fl >= 0 && (fl & O_APPEND) != 0;
+    f->pos_valid = 1;
+    f->len = 0;
+    f->consumed = 0;
+    f->op = -1;
+    f->eof = 0;
+    f->lru = ++g_uring.lru_clock;
+    return f;
+}
+
+// Copy len bytes from src into the iovec array, starting skip bytes in
+static void copy_to_iov(const struct iovec* iov, int iovcnt, size_t skip,
+                        const uint8_t* src, size_t len) {
+    for (int i = 0; i < iovcnt && len > 0; i++) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        size_t n = iov[i].iov_len - skip;
+        if (n > len) n = len;
+        memcpy((uint8_t*)iov[i].iov_base + skip, src, n);
+        src += n;
+        len -= n;
+        skip = 0;
+    }
+}
+
+// Read directly into the iovec array (past the first skip bytes) at offset
+static long read_direct(int fd, const struct iovec* iov, int iovcnt,
+                        size_t skip, uint64_t offset) {
+    struct iovec inline_iov[URING_INLINE_IOVS];
+    struct iovec* tmp = inline_iov;
+    if (iovcnt > URING_INLINE_IOVS) {
+        tmp = (struct iovec*)malloc((size_t)iovcnt * sizeof(struct iovec));
+        if (!tmp) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    int n = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        tmp[n].iov_base = (uint8_t*)iov[i].iov_base + skip;
+        tmp[n].iov_len = iov[i].iov_len - skip;
+        skip = 0;
+        n++;
+    }
+    long res = uring_sync_rw(IORING_OP_READV, fd, tmp, n, (int64_t)offset);
+    if (tmp != inline_iov) free(tmp);
+    return res;
+}
+
+// ============================================================================
+// Write-behind
+// ============================================================================
+
+// Submit the current staging half; later writes go to the other half
+static void wb_submit_batch(void) {
+    Uring* r = &g_uring;
+    if (r->to_submit > 0) {
+        uring_enter(0);
+    }
+    r->last_write_sqe = -1;
+    int next = r->staging_cur ^ 1;
+    // The other half may still be referenced by an earlier batch
+    uring_reap();
+    while (r->staging_ops[next] > 0) {
+        if (uring_enter(1) < 0) break;
+        uring_reap();
+    }
+    r->staging_used[next] = 0;
+    r->staging_cur = next;
+}
+
+static long wb_queue(int host_fd, const struct iovec* iov, int iovcnt,
+                     int64_t offset) {
+    Uring* r = &g_uring;
+    if (r->deferred_errno != 0) {
+        errno = r->deferred_errno;
+        r->deferred_errno = 0;
+        return -1;
+    }
+    size_t total = iov_total(iov, iovcnt);
+    if (total == 0) return 0;
+
+    if (!r->write_behind || total > URING_STAGING_SIZE / 2) {
+        // Synchronous or large write: complete earlier writes, then write
+        // straight from guest memory without staging
+        uring_wait_all();
+        return uring_sync_rw(IORING_OP_WRITEV, host_fd, iov, iovcnt, offset);
+    }
+    if (r->staging_used[r->staging_cur] + total > URING_STAGING_SIZE) {
+        wb_submit_batch();
+    }
+
+    // Extend the previous unsubmitted write when this one directly follows
+    // it, both in the file and in staging. Small sequential writes then cost
+    // a memcpy rather than an SQE each.
+    if (r->last_write_sqe >= 0) {
+        struct io_uring_sqe* prev = &r->sqes[r->last_write_sqe];
+        UringOp* po = &r->ops[prev->user_data];
+        uint8_t* dst = r->staging[r->staging_cur] + r->staging_used[r->staging_cur];
+        if (prev->fd == host_fd && po->half == r->staging_cur &&
+            (uint8_t*)po->iov.iov_base + po->iov.iov_len == dst &&
+            prev->off + po->iov.iov_len == (uint64_t)offset) {
+            size_t off = 0;
+            for (int i = 0; i < iovcnt; i++) {
+                memcpy(dst + off, iov[i].iov_base, iov[i].iov_len);
+                off += iov[i].iov_len;
+            }
+            r->staging_used[r->staging_cur] += total;
+            po->iov.iov_len += total;
+            po->expect += total;
+            return (long)total;
+        }
+    }
+
+    int half = r->staging_cur;
+    int op;
+    struct io_uring_sqe* sqe = uring_prep(URING_OP_WRITE_BEHIND, &op);
+    if (!sqe) {
+        errno = EAGAIN;
+        return -1;
+    }
+    // uring_prep may have drained the ring and reset staging
+    half = r->staging_cur;
+    int earlier_in_flight = wb_pending() && r->last_write_sqe < 0;
+    uint8_t* dst = r->staging[half] + r->staging_used[half];
+    size_t off = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(dst + off, iov[i].iov_base, iov[i].iov_len);
+        off += iov[i].iov_len;
+    }
+    r->staging_used[half] += total;
+    r->staging_ops[half]++;
+
+    UringOp* o = &r->ops[op];
+    o->expect = total;
+    o->half = half;
+    o->iov.iov_base = dst;
+    o->iov.iov_len = total;
+    prep_rw(sqe, IORING_OP_WRITEV, host_fd, &o->iov, 1, offset);
+
+    // Keep writes ordered: chain to the previous queued write, or wait for
+    // the previously submitted batch before starting this one
+    if (r->last_write_sqe >= 0) {
+        r->sqes[r->last_write_sqe].flags |= IOSQE_IO_LINK;
+    } else if (earlier_in_flight) {
+        sqe->flags |= IOSQE_IO_DRAIN;
+    }
+    r->last_write_sqe = (int)(sqe - r->sqes);
+
+    if (r->outstanding >= URING_ENTRIES / 2) {
+        wb_submit_batch();
+    }
+    return (long)total;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int wasi_uring_enabled(void) {
+    return g_uring.fd >= 0;
+}
+
+int wasi_uring_write_behind(void) {
+    return g_uring.fd >= 0 && g_uring.write_behind;
+}
+
+int wasi_uring_init(int write_behind) {
+    Uring* r = &g_uring;
+    if (r->fd >= 0) {
+        // Queued writes must land before writes become synchronous
+        if (!write_behind) wasi_uring_flush();
+        r->write_behind = write_behind;
+        return 1;
+    }
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = sys_io_uring_setup(URING_ENTRIES, &p);
+    if (fd < 0) return 0;
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+    void* sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    void* cq = sq;
+    if (!single) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            munmap(sq, sq_size);
+            close(fd);
+            return 0;
+        }
+    }
+    size_t sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    uint8_t* staging = (uint8_t*)malloc(2 * URING_STAGING_SIZE);
+    if (sqes == MAP_FAILED || !staging) {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        free(staging);
+        if (!single) munmap(cq, cq_size);
+        munmap(sq, sq_size);
+        close(fd);
+        return 0;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->fd = fd;
+    r->sq_ring = sq;
+    r->sq_ring_size = sq_size;
+    r->cq_ring = cq;
+    r->cq_ring_size = single ? 0 : cq_size;
+    r->sqes_size = sqes_size;
+    r->sq_head = (unsigned*)((uint8_t*)sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)((uint8_t*)sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)((uint8_t*)sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)((uint8_t*)sq + p.sq_off.array);
+    r->cq_head = (unsigned*)((uint8_t*)cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)((uint8_t*)cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)((uint8_t*)cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)((uint8_t*)cq + p.cq_off.cqes);
+    r->sqes = (struct io_uring_sqe*)sqes;
+    r->write_behind = write_behind;
+    r->last_write_sqe = -1;
+    r->staging[0] = staging;
+    r->staging[1] = staging + URING_STAGING_SIZE;
+    for (int i = 0; i < URING_MAX_FILES; i++) {
+        r->files[i].host_fd = -1;
+        r->files[i].op = -1;
+    }
+    return 1;
+}
+
+void wasi_uring_shutdown(void) {
+    Uring* r = &g_uring;
+    if (r->fd < 0) return;
+    wasi_uring_flush();
+    for (int i = 0; i < URING_MAX_FILES; i++) {
+        free(r->files[i].buf);
+    }
+    free(r->staging[0]);
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring_size > 0) munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+long wasi_uring_read(int host_fd, const struct iovec* iov, int iovcnt) {
+    // Reads must observe earlier writes
+    if (wb_pending()) {
+        uring_wait_all();
+    }
+    UringFile* f = file_find(host_fd);
+    if (f && !f->pos_valid) {
+        // Position after append writes is only known once they land
+        file_settle(f);
+        f = NULL;
+    }
+    size_t want = iov_total(iov, iovcnt);
+    if (!f) {
+        // First read: read in place. A full read suggests a sequential
+        // stream, so start reading ahead.
+        f = file_get(host_fd);
+        if (!f) return -1;
+        long n = uring_sync_rw(IORING_OP_READV, host_fd, iov, iovcnt, (int64_t)f->pos);
+        if (n < 0) return -1;
+        f->pos += (uint64_t)n;
+        if (n > 0 && (size_t)n == want) ra_start_refill(f);
+        return n;
+    }
+    f->lru = ++g_uring.lru_clock;
+
+    size_t copied = 0;
+    if (f->op < 0 && f->consumed == f->len) {
+        f->eof = 0;  // Retry at EOF in case the file has grown
+    }
+    while (copied < want) {
+        int err = ra_complete_refill(f);
+        if (err < 0) {
+            ra_discard(f);
+            if (copied > 0) return (long)copied;
+            errno = -err;
+            return -1;
+        }
+        size_t avail = f->len - f->consumed;
+        if (avail == 0) {
+            if (f->eof) break;
+            if (want - copied >= URING_READAHEAD_SIZE || !f->buf) {
+                // Large request: read straight into guest memory
+                long n = read_direct(host_fd, iov, iovcnt, copied, f->pos);
+                if (n < 0) {
+                    if (copied > 0) break;
+                    return -1;
+                }
+                f->pos += (uint64_t)n;
+                copied += (size_t)n;
+                if (n == 0) f->eof = 1;
+                break;
+            }
+            ra_start_refill(f);
+            if (f->op < 0) break;
+            continue;
+        }
+        size_t n = want - copied;
+        if (n > avail) n = avail;
+        copy_to_iov(iov, iovcnt, copied, f->buf + f->consumed, n);
+        f->consumed += n;
+        f->pos += n;
+        copied += n;
+    }
+    // Keep the next chunk in flight while the guest processes this one
+    if (f->op < 0 && f->consumed == f->len && !f->eof) {
+        ra_start_refill(f);
+    }
+    return (long)copied;
+}
+
+long wasi_uring_pread(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    if (wb_pending()) {
+        uring_wait_all();
+    }
+    return uring_sync_rw(IORING_OP_READV, host_fd, iov, iovcnt, (int64_t)offset);
+}
+
+long wasi_uring_write(int host_fd, const struct iovec* iov, int iovcnt) {
+    UringFile* f = file_get(host_fd);
+    if (!f) return -1;
+    ra_discard(f);
+    // O_APPEND fds ignore the offset and write at EOF
+    long n = wb_queue(host_fd, iov, iovcnt, (int64_t)f->pos);
+    if (n > 0) {
+        if (f->append) {
+            f->pos_valid = 0;
+        } else {
+            f->pos += (uint64_t)n;
+        }
+    }
+    return n;
+}
+
+long wasi_uring_pwrite(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    UringFile* f = file_find(host_fd);
+    if (f) ra_discard(f);
+    return wb_queue(host_fd, iov, iovcnt, (int64_t)offset);
+}
+
+int wasi_uring_fsync(int host_fd, int datasync) {
+    Uring* r = &g_uring;
+    int op;
+    struct io_uring_sqe* sqe = uring_prep(URING_OP_SYNC, &op);
+    if (!sqe) {
+        errno = EAGAIN;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = host_fd;
+    sqe->fsync_flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+    // Run after every write queued or submitted before it
+    sqe->flags |= IOSQE_IO_DRAIN;
+    r->last_write_sqe = -1;
+    int32_t res = uring_wait_op(op);
+    uring_release_op(op);
+    uring_wait_all();
+    if (r->deferred_errno != 0) {
+        errno = r->deferred_errno;
+        r->deferred_errno = 0;
+        return -1;
+    }
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return 0;
+}
+
+void wasi_uring_sync_fd(int host_fd) {
+    if (g_uring.fd < 0) return;
+    if (wb_pending()) {
+        uring_wait_all();
+    }
+    UringFile* f = file_find(host_fd);
+    if (f) file_settle(f);
+}
+
+int wasi_uring_flush(void) {
+    Uring* r = &g_uring;
+    if (r->fd < 0) return 0;
+    for (int i = 0; i < URING_MAX_FILES; i++) {
+        if (r->files[i].host_fd >= 0) file_settle(&r->files[i]);
+    }
+    uring_wait_all();
+    if (r->deferred_errno != 0) {
+        errno = r->deferred_errno;
+        r->deferred_errno = 0;
+        return -1;
+    }
+    return 0;
+}
+
+#else  // !WASI_HAVE_IO_URING
+
+int wasi_uring_init(int write_behind) {
+    (void)write_behind;
+    return 0;
+}
+
+void wasi_uring_shutdown(void) {
+}
+
+int wasi_uring_enabled(void) {
+    return 0;
+}
+
+int wasi_uring_write_behind(void) {
+    return 0;
+}
+
+long wasi_uring_read(int host_fd, const struct iovec* iov, int iovcnt) {
+    (void)host_fd;
+    (void)iov;
+    (void)iovcnt;
+    errno = ENOSYS;
+    return -1;
+}
+
+long wasi_uring_pread(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    (void)host_fd;
+    (void)iov;
+    (void)iovcnt;
+    (void)offset;
+    errno = ENOSYS;
+    return -1;
+}
+
+long wasi_uring_write(int host_fd, const struct iovec* iov, int iovcnt) {
+    (void)host_fd;
+    (void)iov;
+    (void)iovcnt;
+    errno = ENOSYS;
+    return -1;
+}
+
+long wasi_uring_pwrite(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    (void)host_fd;
+    (void)iov;
+    (void)iovcnt;
+    (void)offset;
+    errno = ENOSYS;
+    return -1;
+}
+
+int wasi_uring_fsync(int host_fd, int datasync) {
+    (void)host_fd;
+    (void)datasync;
+    errno = ENOSYS;
+    return -1;
+}
+
+void wasi_uring_sync_fd(int host_fd) {
+    (void)host_fd;
+}
+
+int wasi_uring_flush(void) {
+    return 0;
+}
+
+#endif  // WASI_HAVE_IO_URING
@@ -0,0 +1,57 @@
+// io_uring I/O backend for WASI file operations
+// Optional; every entry point falls back to reporting "unavailable" on
+// platforms or kernels without io_uring, and wasi.c then uses plain syscalls.
+
+#ifndef WASI_URING_H
+#define WASI_URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct iovec;
+
+// Set up the ring, or switch write-behind on an existing one. Write-behind
+// acknowledges writes before they land (not POSIX: errors are deferred).
+// Returns 1 if io_uring is usable, 0 otherwise.
+int wasi_uring_init(int write_behind);
+
+// Drain all pending work and release the ring.
+void wasi_uring_shutdown(void);
+
+// 1 if the ring is set up and in use
+int wasi_uring_enabled(void);
+
+// 1 if the ring is in use with write-behind
+int wasi_uring_write_behind(void);
+
+// All I/O functions below return the byte count, or -1 with errno set.
+// They complete synchronously from the caller's point of view.
+
+// Read at the current file position. Sequential reads are served from a
+// readahead buffer that is refilled in the background.
+long wasi_uring_read(int host_fd, const struct iovec* iov, int iovcnt);
+
+// Read at an explicit offset (file position unchanged)
+long wasi_uring_pread(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset);
+
+// Write at the current file position / at an explicit offset.
+// Without write-behind the write completes before returning. With it, data
+// is copied into a staging area and submitted in batches; errors from
+// earlier batched writes are reported by the next write or fsync.
+long wasi_uring_write(int host_fd, const struct iovec* iov, int iovcnt);
+long wasi_uring_pwrite(int host_fd, const struct iovec* iov, int iovcnt, uint64_t offset);
+
+// Submit pending writes for all fds followed by an fsync of host_fd, and
+// wait for the batch. Returns 0 or -1 with errno set.
+int wasi_uring_fsync(int host_fd, int datasync);
+
+// Complete pending writes and drop readahead state for host_fd, leaving the
+// host file position where the guest expects it. Call before any operation
+// that observes the file position or size.
+void wasi_uring_sync_fd(int host_fd);
+
+// Complete all pending work and drop all readahead state.
+// Returns 0, or -1 with errno set to the first deferred write error.
+int wasi_uring_flush(void);
+
+#endif // WASI_URING_H
@@ -0,0 +1,754 @@
+// In-memory filesystem for WASI preopens
+//
+// A tree of reference-counted nodes. Directories keep their entries in an
+// array (the readdir order) with an open-addressing hash index over it, so
+// lookups stay O(1) in large directories. Regular files are a single growable
+// buffer. Every directory entry, open fd and preopen holds a reference; a
+// removed file stays readable through fds that still have it open.
+
+#include "wasi_vfs.h"
+#include "wasi.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+typedef struct VfsDirent {
+    char* name;
+    size_t name_len;
+    uint32_t hash;
+    VfsNode* node;
+} VfsDirent;
+
+struct VfsNode {
+    uint8_t filetype;       // WASI_FILETYPE_DIRECTORY or _REGULAR_FILE
+    uint32_t refs;
+    uint32_t nlink;         // Directory entries naming this node
+    uint64_t ino;
+    uint64_t atim;
+    uint64_t mtim;
+    uint64_t ctim;
+
+    // Regular files
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+
+    // Directories
+    VfsNode* parent;        // NULL for roots and removed directories
+    VfsDirent* entries;
+    uint32_t count;
+    uint32_t entries_cap;
+    uint32_t* index;        // entry index + 1, 0 = empty slot
+    uint32_t index_cap;     // Power of two, at least 2 * count
+};
+
+static uint64_t g_vfs_next_ino = 1;
+
+static uint64_t vfs_now(void) {
+    struct timespec ts;
+    if (timespec_get(&ts, TIME_UTC) == 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static VfsNode* node_new(uint8_t filetype) {
+    VfsNode* node = (VfsNode*)calloc(1, sizeof(VfsNode));
+    if (!node) return NULL;
+    node->filetype = filetype;
+    node->refs = 1;
+    node->ino = g_vfs_next_ino++;
+    node->atim = node->mtim = node->ctim = vfs_now();
+    return node;
+}
+
+VfsNode* vfs_new_root(void) {
+    return node_new(WASI_FILETYPE_DIRECTORY);
+}
+
+int vfs_is_dir(const VfsNode* node) {
+    return node->filetype == WASI_FILETYPE_DIRECTORY;
+}
+
+void vfs_ref(VfsNode* node) {
+    node->refs++;
+}
+
+void vfs_unref(VfsNode* node) {
+    if (--node->refs > 0) return;
+    if (vfs_is_dir(node)) {
+        for (uint32_t i = 0; i < node->count; i++) {
+            VfsNode* child = node->entries[i].node;
+            child->nlink--;
+            if (vfs_is_dir(child)) child->parent = NULL;
+            free(node->entries[i].name);
+            vfs_unref(child);
+        }
+        free(node->entries);
+        free(node->index);
+    } else {
+        free(node->data);
+    }
+    free(node);
+}
+
+// ============================================================================
+// Directory Entries
+// ============================================================================
+
+static uint32_t name_hash(const char* name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Slot in dir->index holding `name`, or the empty slot where it would go
+static uint32_t index_slot(const VfsNode* dir, const char* name, size_t len, uint32_t hash) {
+    uint32_t mask = dir->index_cap - 1;
+    uint32_t slot = hash & mask;
+    for (;;) {
+        uint32_t i = dir->index[slot];
+        if (i == 0) return slot;
+        const VfsDirent* e = &dir->entries[i - 1];
+        if (e->hash == hash && e->name_len == len && memcmp(e->name, name, len) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static void index_fill(VfsNode* dir) {
+    memset(dir->index, 0, dir->index_cap * sizeof(uint32_t));
+    for (uint32_t i = 0; i < dir->count; i++) {
+        const VfsDirent* e = &dir->entries[i];
+        dir->index[index_slot(dir, e->name, e->name_len, e->hash)] = i + 1;
+    }
+}
+
+static int index_grow(VfsNode* dir, uint32_t cap) {
+    uint32_t* index = (uint32_t*)malloc(cap * sizeof(uint32_t));
+    if (!index) return -ENOMEM;
+    free(dir->index);
+    dir->index = index;
+    dir->index_cap = cap;
+    index_fill(dir);
+    return 0;
+}
+
+static VfsNode* dir_find(const VfsNode* dir, const char* name, size_t len) {
+    if (dir->count == 0) return NULL;
+    uint32_t i = dir->index[index_slot(dir, name, len, name_hash(name, len))];
+    return i ? dir->entries[i - 1].node : NULL;
+}
+
+// Add an entry; takes a new reference to node
+static int dir_insert(VfsNode* dir, const char* name, size_t len, VfsNode* node) {
+    if (dir->count == dir->entries_cap) {
+        uint32_t cap = dir->entries_cap ? dir->entries_cap * 2 : 8;
+        VfsDirent* entries = (VfsDirent*)realloc(dir->entries, cap * sizeof(VfsDirent));
+        if (!entries) return -ENOMEM;
+        dir->entries = entries;
+        dir->entries_cap = cap;
+    }
+    if ((dir->count + 1) * 2 > dir->index_cap) {
+        int rc = index_grow(dir, dir->index_cap ? dir->index_cap * 2 : 16);
+        if (rc < 0) return rc;
+    }
+    char* copy = (char*)malloc(len + 1);
+    if (!copy) return -ENOMEM;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+
+    VfsDirent* e = &dir->entries[dir->count];
+    e->name = copy;
+    e->name_len = len;
+    e->hash = name_hash(name, len);
+    e->node = node;
+    dir->index[index_slot(dir, name, len, e->hash)] = ++dir->count;
+
+    vfs_ref(node);
+    node->nlink++;
+    if (vfs_is_dir(node)) node->parent = dir;
+    dir->mtim = dir->ctim = vfs_now();
+    return 0;
+}
+
+// Remove an entry and drop its reference. The last entry moves into the
+// hole, so readdir cookies past it shift (as they may on any filesystem).
+static void dir_remove(VfsNode* dir, const char* name, size_t len) {
+    uint32_t i = dir->index[index_slot(dir, name, len, name_hash(name, len))];
+    if (i == 0) return;
+    VfsDirent removed = dir->entries[i - 1];
+    dir->entries[i - 1] = dir->entries[--dir->count];
+    index_fill(dir);
+    dir->mtim = dir->ctim = vfs_now();
+
+    free(removed.name);
+    removed.node->nlink--;
+    removed.node->ctim = dir->mtim;
+    if (vfs_is_dir(removed.node)) removed.node->parent = NULL;
+    vfs_unref(removed.node);
+}
+
+// ============================================================================
+// Path Resolution
+// ============================================================================
+
+// Walk path components from base. Returns the node in *out; with `parent`
+// set the last component is not walked but returned in *last/*last_len
+// (empty if the path has none, e.g. "a/").
+static int walk(VfsNode* base, const char* path, int parent, VfsNode** out,
+                const char** last, size_t* last_len) {
+    if (path[0] == '/') return -EXDEV;
+    const char* end = path + strlen(path);
+    if (parent) {
+        while (end > path && end[-1] == '/') end--;
+        const char* p = end;
+        while (p > path && p[-1] != '/') p--;
+        *last = p;
+        *last_len = (size_t)(end - p);
+        end = p;
+    }
+
+    VfsNode* cur = base;
+    int depth = 0;
+    const char* p = path;
+    while (p < end) {
+        const char* slash = memchr(p, '/', (size_t)(end - p));
+        size_t len = slash ? (size_t)(slash - p) : (size_t)(end - p);
+        if (len == 0 || (len == 1 && p[0] == '.')) {
+            // Empty or "." component
+        } else if (len == 2 && p[0] == '.' && p[1] == '.') {
+            if (depth == 0) return -EXDEV;
+            if (!cur->parent) return -ENOENT;
+            cur = cur->parent;
+            depth--;
+        } else {
+            if (!vfs_is_dir(cur)) return -ENOTDIR;
+            VfsNode* next = dir_find(cur, p, len);
+            if (!next) return -ENOENT;
+            cur = next;
+            depth++;
+        }
+        p += len + 1;
+    }
+    if (parent && !vfs_is_dir(cur)) return -ENOTDIR;
+
+    // A trailing "." or ".." names a directory that already exists; let the
+    // caller see it as a plain walk of the whole path
+    if (parent && (*last_len == 0 || (*last_len == 1 && (*last)[0] == '.') ||
+                   (*last_len == 2 && (*last)[0] == '.' && (*last)[1] == '.'))) {
+        if (*last_len == 2) {
+            if (depth == 0) return -EXDEV;
+            if (!cur->parent) return -ENOENT;
+            cur = cur->parent;
+        }
+        *last_len = 0;
+    }
+    *out = cur;
+    return 0;
+}
+
+static int lookup(VfsNode* base, const char* path, VfsNode** out) {
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    int rc = walk(base, path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+    if (len == 0) {
+        *out = dir;
+        return 0;
+    }
+    *out = dir_find(dir, name, len);
+    return *out ? 0 : -ENOENT;
+}
+
+// ============================================================================
+// Path Operations
+// ============================================================================
+
+int vfs_open(VfsNode* base, const char* path, uint16_t oflags, int write, VfsNode** out) {
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    int rc = walk(base, path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+
+    VfsNode* node = len == 0 ? dir : dir_find(dir, name, len);
+    if (node) {
+        if ((oflags & WASI_OFLAGS_CREAT) && (oflags & WASI_OFLAGS_EXCL)) return -EEXIST;
+        if ((oflags & WASI_OFLAGS_DIRECTORY) && !vfs_is_dir(node)) return -ENOTDIR;
+        if (vfs_is_dir(node) && (write || (oflags & WASI_OFLAGS_TRUNC))) return -EISDIR;
+        if (oflags & WASI_OFLAGS_TRUNC) {
+            rc = vfs_truncate(node, 0);
+            if (rc < 0) return rc;
+        }
+        vfs_ref(node);
+    } else {
+        if (!(oflags & WASI_OFLAGS_CREAT)) return -ENOENT;
+        if (oflags & WASI_OFLAGS_DIRECTORY) return -EINVAL;
+        node = node_new(WASI_FILETYPE_REGULAR_FILE);
+        if (!node) return -ENOMEM;
+        rc = dir_insert(dir, name, len, node);
+        if (rc < 0) {
+            vfs_unref(node);
+            return rc;
+        }
+    }
+    *out = node;
+    return 0;
+}
+
+int vfs_mkdir(VfsNode* base, const char* path) {
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    int rc = walk(base, path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+    if (len == 0 || dir_find(dir, name, len)) return -EEXIST;
+    VfsNode* node = node_new(WASI_FILETYPE_DIRECTORY);
+    if (!node) return -ENOMEM;
+    rc = dir_insert(dir, name, len, node);
+    vfs_unref(node);
+    return rc;
+}
+
+int vfs_rmdir(VfsNode* base, const char* path) {
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    int rc = walk(base, path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+    if (len == 0) return -EINVAL;
+    VfsNode* node = dir_find(dir, name, len);
+    if (!node) return -ENOENT;
+    if (!vfs_is_dir(node)) return -ENOTDIR;
+    if (node->count > 0) return -ENOTEMPTY;
+    dir_remove(dir, name, len);
+    return 0;
+}
+
+int vfs_unlink(VfsNode* base, const char* path) {
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    int rc = walk(base, path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+    if (len == 0) return -EISDIR;
+    VfsNode* node = dir_find(dir, name, len);
+    if (!node) return -ENOENT;
+    if (vfs_is_dir(node)) return -EISDIR;
+    dir_remove(dir, name, len);
+    return 0;
+}
+
+int vfs_rename(VfsNode* old_base, const char* old_path, VfsNode* new_base, const char* new_path) {
+    VfsNode *old_dir, *new_dir;
+    const char *old_name, *new_name;
+    size_t old_len, new_len;
+    int rc = walk(old_base, old_path, 1, &old_dir, &old_name, &old_len);
+    if (rc < 0) return rc;
+    rc = walk(new_base, new_path, 1, &new_dir, &new_name, &new_len);
+    if (rc < 0) return rc;
+    if (old_len == 0 || new_len == 0) return -EINVAL;
+
+    VfsNode* node = dir_find(old_dir, old_name, old_len);
+    if (!node) return -ENOENT;
+    VfsNode* target = dir_find(new_dir, new_name, new_len);
+    if (target == node) return 0;
+
+    // A directory cannot move beneath itself
+    if (vfs_is_dir(node)) {
+        for (VfsNode* d = new_dir; d; d = d->parent) {
+            if (d == node) return -EINVAL;
+        }
+    }
+    if (target) {
+        if (vfs_is_dir(node) && !vfs_is_dir(target)) return -ENOTDIR;
+        if (!vfs_is_dir(node) && vfs_is_dir(target)) return -EISDIR;
+        if (vfs_is_dir(target) && target->count > 0) return -ENOTEMPTY;
+    }
+
+    // Insert under the new name first so a failed insert leaves the tree as is
+    vfs_ref(node);
+    if (target) dir_remove(new_dir, new_name, new_len);
+    rc = dir_insert(new_dir, new_name, new_len, node);
+    if (rc == 0) {
+        dir_remove(old_dir, old_name, old_len);
+        if (vfs_is_dir(node)) node->parent = new_dir;
+    }
+    vfs_unref(node);
+    return rc;
+}
+
+int vfs_link(VfsNode* old_base, const char* old_path, VfsNode* new_base, const char* new_path) {
+    VfsNode* node;
+    int rc = lookup(old_base, old_path, &node);
+    if (rc < 0) return rc;
+    if (vfs_is_dir(node)) return -EPERM;
+    VfsNode* dir;
+    const char* name;
+    size_t len;
+    rc = walk(new_base, new_path, 1, &dir, &name, &len);
+    if (rc < 0) return rc;
+    if (len == 0 || dir_find(dir, name, len)) return -EEXIST;
+    rc = dir_insert(dir, name, len, node);
+    if (rc == 0) node->ctim = vfs_now();
+    return rc;
+}
+
+int vfs_stat_path(VfsNode* base, const char* path, VfsStat* st) {
+    VfsNode* node;
+    int rc = lookup(base, path, &node);
+    if (rc < 0) return rc;
+    vfs_stat(node, st);
+    return 0;
+}
+
+// ============================================================================
+// File Data
+// ============================================================================
+
+uint64_t vfs_size(const VfsNode* file) {
+    return file->size;
+}
+
+static int reserve(VfsNode* file, uint64_t size) {
+    if (size <= file->capacity) return 0;
+    if (size > (uint64_t)SIZE_MAX / 2) return -EFBIG;
+    uint64_t cap = file->capacity ? file->capacity : 256;
+    while (cap < size) cap *= 2;
+    uint8_t* data = (uint8_t*)realloc(file->data, (size_t)cap);
+    if (!data) return -ENOMEM;
+    file->data = data;
+    file->capacity = cap;
+    return 0;
+}
+
+int vfs_truncate(VfsNode* file, uint64_t size) {
+    if (vfs_is_dir(file)) return -EISDIR;
+    if (size > file->size) {
+        int rc = reserve(file, size);
+        if (rc < 0) return rc;
+        memset(file->data + file->size, 0, (size_t)(size - file->size));
+    }
+    file->size = size;
+    file->mtim = file->ctim = vfs_now();
+    return 0;
+}
+
+long vfs_pread(VfsNode* file, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    if (vfs_is_dir(file)) return -EISDIR;
+    uint64_t pos = offset;
+    for (int i = 0; i < iovcnt && pos < file->size; i++) {
+        uint64_t n = file->size - pos;
+        if (n > iov[i].iov_len) n = iov[i].iov_len;
+        memcpy(iov[i].iov_base, file->data + pos, (size_t)n);
+        pos += n;
+    }
+    file->atim = vfs_now();
+    return pos > offset ? (long)(pos - offset) : 0;
+}
+
+long vfs_pwrite(VfsNode* file, const struct iovec* iov, int iovcnt, uint64_t offset) {
+    if (vfs_is_dir(file)) return -EISDIR;
+    uint64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+    if (total == 0) return 0;
+    if (offset + total < offset) return -EFBIG;
+
+    int rc = reserve(file, offset + total);
+    if (rc < 0) return rc;
+    if (offset > file->size) memset(file->data + file->size, 0, (size_t)(offset - file->size));
+    uint64_t pos = offset;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(file->data + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    if (pos > file->size) file->size = pos;
+    file->mtim = file->ctim = vfs_now();
+    return (long)total;
+}
+
+// ============================================================================
+// Metadata
+// ============================================================================
+
+void vfs_stat(const VfsNode* node, VfsStat* st) {
+    st->ino = node->ino;
+    st->filetype = node->filetype;
+    st->nlink = node->nlink;
+    st->size = vfs_is_dir(node) ? node->count : node->size;
+    st->atim = node->atim;
+    st->mtim = node->mtim;
+    st->ctim = node->ctim;
+}
+
+int vfs_set_times(VfsNode* node, uint64_t atim, uint64_t mtim, uint16_t fst_flags) {
+    uint64_t now = vfs_now();
+    if (fst_flags & 1) node->atim = now;        // FSTFLAGS_ATIM_NOW
+    else if (fst_flags & 2) node->atim = atim;  // FSTFLAGS_ATIM
+    if (fst_flags & 4) node->mtim = now;        // FSTFLAGS_MTIM_NOW
+    else if (fst_flags & 8) node->mtim = mtim;  // FSTFLAGS_MTIM
+    node->ctim = now;
+    return 0;
+}
+
+int vfs_dirent(VfsNode* dir, uint64_t cookie, const char** name, size_t* name_len,
+               uint64_t* ino, uint8_t* filetype) {
+    if (cookie < 2) {
+        VfsNode* node = cookie == 0 || !dir->parent ? dir : dir->parent;
+        *name = cookie == 0 ? "." : "..";
+        *name_len = (size_t)cookie + 1;
+        *ino = node->ino;
+        *filetype = WASI_FILETYPE_DIRECTORY;
+        return 1;
+    }
+    if (cookie - 2 >= dir->count) return 0;
+    const VfsDirent* e = &dir->entries[cookie - 2];
+    *name = e->name;
+    *name_len = e->name_len;
+    *ino = e->node->ino;
+    *filetype = e->node->filetype;
+    return 1;
+}
+
+// ============================================================================
+// Tar Preload
+// ============================================================================
+
+// Parse a numeric header field: octal text, or base-256 if the high bit of
+// the first byte is set (GNU extension for large values)
+static uint64_t tar_number(const uint8_t* field, size_t len) {
+    uint64_t v = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < len; i++) v = (v << 8) | field[i];
+        return v;
+    }
+    for (size_t i = 0; i < len && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7') v = (v << 3) | (uint64_t)(field[i] - '0');
+    }
+    return v;
+}
+
+// Length of a NUL-padded header field
+static size_t tar_field_len(const uint8_t* field, size_t max) {
+    size_t n = 0;
+    while (n < max && field[n]) n++;
+    return n;
+}
+
+static int tar_checksum_ok(const uint8_t* h) {
+    uint64_t sum = 0;
+    for (int i = 0; i < 512; i++) sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    return sum == tar_number(h + 148, 8);
+}
+
+// Create the directories of `path` (up to but not including its last
+// component) beneath root; returns the innermost one
+static int tar_mkdirs(VfsNode* root, char* path, VfsNode** out, char** last) {
+    VfsNode* dir = root;
+    char* p = path;
+    for (;;) {
+        while (*p == '/') p++;
+        char* slash = strchr(p, '/');
+        if (!slash) break;
+        size_t len = (size_t)(slash - p);
+        if (len == 2 && p[0] == '.' && p[1] == '.') return -EXDEV;
+        if (!(len == 1 && p[0] == '.') && len > 0) {
+            VfsNode* next = dir_find(dir, p, len);
+            if (!next) {
+                next = node_new(WASI_FILETYPE_DIRECTORY);
+                if (!next) return -ENOMEM;
+                int rc = dir_insert(dir, p, len, next);
+                vfs_unref(next);
+                if (rc < 0) return rc;
+            } else if (!vfs_is_dir(next)) {
+                return -ENOTDIR;
+            }
+            dir = next;
+        }
+        p = slash + 1;
+    }
+    if (strcmp(p, "..") == 0) return -EXDEV;
+    *out = dir;
+    *last = p;
+    return 0;
+}
+
+// Find the value of `key` in a pax extended header; returns a malloc'd copy
+static char* pax_value(const uint8_t* data, size_t len, const char* key) {
+    size_t key_len = strlen(key);
+    size_t off = 0;
+    while (off < len) {
+        // "<length> <key>=<value>\n", length counting the whole record
+        size_t rec = 0;
+        size_t i = off;
+        while (i < len && data[i] >= '0' && data[i] <= '9' && rec <= len) {
+            rec = rec * 10 + (size_t)(data[i++] - '0');
+        }
+        // The record must hold its length, the space and the newline
+        if (rec > len - off || rec < (i - off) + 2 || i >= len || data[i] != ' ' ||
+            data[off + rec - 1] != '\n') {
+            return NULL;
+        }
+        const uint8_t* kv = data + i + 1;
+        size_t kv_len = off + rec - (i + 1) - 1;  // Without the newline
+        if (kv_len > key_len && memcmp(kv, key, key_len) == 0 && kv[key_len] == '=') {
+            size_t n = kv_len - key_len - 1;
+            char* value = (char*)malloc(n + 1);
+            if (!value) return NULL;
+            memcpy(value, kv + key_len + 1, n);
+            value[n] = '\0';
+            return value;
+        }
+        off += rec;
+    }
+    return NULL;
+}
+
+int vfs_load_tar(VfsNode* root, const uint8_t* data, size_t len) {
+    int added = 0;
+    char* long_name = NULL;      // From a GNU 'L' or pax 'x' header
+    char* long_link = NULL;      // From a GNU 'K' or pax 'x' header
+    int rc = 0;
+    size_t off = 0;
+    while (off + 512 <= len) {
+        const uint8_t* h = data + off;
+        int zero = 1;
+        for (int i = 0; i < 512 && zero; i++) zero = h[i] == 0;
+        if (zero) break;
+        if (!tar_checksum_ok(h)) {
+            rc = -EINVAL;
+            break;
+        }
+        uint64_t size = tar_number(h + 124, 12);
+        uint64_t mtime = tar_number(h + 136, 12);
+        uint8_t type = h[156];
+        size_t body = off + 512;
+        if (size > len - body) {
+            rc = -EINVAL;
+            break;
+        }
+        off = body + (size_t)((size + 511) & ~(uint64_t)511);
+
+        if (type == 'L' || type == 'K') {
+            char* s = (char*)malloc((size_t)size + 1);
+            if (!s) {
+                rc = -ENOMEM;
+                break;
+            }
+            memcpy(s, data + body, (size_t)size);
+            s[size] = '\0';
+            char** slot = type == 'L' ? &long_name : &long_link;
+            free(*slot);
+            *slot = s;
+            continue;
+        }
+        if (type == 'x') {
+            char* path = pax_value(data + body, (size_t)size, "path");
+            char* link = pax_value(data + body, (size_t)size, "linkpath");
+            if (path) {
+                free(long_name);
+                long_name = path;
+            }
+            if (link) {
+                free(long_link);
+                long_link = link;
+            }
+            continue;
+        }
+
+        // ustar splits long names into prefix (155 bytes) + name (100 bytes)
+        char name_buf[257];
+        const char* name = long_name;
+        if (!name) {
+            size_t n = 0;
+            if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+                n = tar_field_len(h + 345, 155);
+                memcpy(name_buf, h + 345, n);
+                name_buf[n++] = '/';
+            }
+            size_t m = tar_field_len(h, 100);
+            memcpy(name_buf + n, h, m);
+            name_buf[n + m] = '\0';
+            name = name_buf;
+        }
+        char link_buf[101];
+        const char* link = long_link;
+        if (!link) {
+            size_t m = tar_field_len(h + 157, 100);
+            memcpy(link_buf, h + 157, m);
+            link_buf[m] = '\0';
+            link = link_buf;
+        }
+
+        if (type == '0' || type == '\0' || type == '7' || type == '5' || type == '1') {
+            // Directories are walked like "dir/" so every component is made
+            size_t plen = strlen(name);
+            char* path = (char*)malloc(plen + 2);
+            if (!path) {
+                rc = -ENOMEM;
+                break;
+            }
+            memcpy(path, name, plen + 1);
+            if (type == '5' && plen > 0 && path[plen - 1] != '/') {
+                path[plen] = '/';
+                path[plen + 1] = '\0';
+            }
+            VfsNode* dir;
+            char* last;
+            rc = tar_mkdirs(root, path, &dir, &last);
+            size_t last_len = rc == 0 ? strlen(last) : 0;
+            if (rc == 0 && type == '5') {
+                dir->mtim = mtime * 1000000000ULL;
+            } else if (rc == 0 && last_len > 0 && strcmp(last, ".") != 0) {
+                VfsNode* node = NULL;
+                if (type == '1') {
+                    rc = lookup(root, link, &node);
+                    if (rc == 0 && vfs_is_dir(node)) rc = -EPERM;
+                    if (rc == 0) vfs_ref(node);
+                } else {
+                    node = node_new(WASI_FILETYPE_REGULAR_FILE);
+                    if (!node) rc = -ENOMEM;
+                    if (rc == 0 && size > 0) {
+                        rc = reserve(node, size);
+                        if (rc == 0) {
+                            memcpy(node->data, data + body, (size_t)size);
+                            node->size = size;
+                        }
+                    }
+                    if (node) node->mtim = mtime * 1000000000ULL;
+                }
+                // A later entry for the same name replaces the earlier one
+                VfsNode* existing = rc == 0 ? dir_find(dir, last, last_len) : NULL;
+                if (existing && vfs_is_dir(existing)) rc = -EISDIR;
+                if (rc == 0 && existing) dir_remove(dir, last, last_len);
+                if (rc == 0) rc = dir_insert(dir, last, last_len, node);
+                if (node) vfs_unref(node);
+            }
+            free(path);
+            if (rc < 0) break;
+            added++;
+        }
+        // Symlinks, devices, FIFOs and global pax headers are skipped
+        free(long_name);
+        free(long_link);
+        long_name = NULL;
+        long_link = NULL;
+    }
+    free(long_name);
+    free(long_link);
+    return rc < 0 ? rc : added;
+}
@@ -0,0 +1,73 @@
+// In-memory filesystem for WASI preopens
+// Directories and regular files backed by growable buffers that live only in
+// host memory. wasi.c maps fds of VFS preopens (and files opened beneath
+// them) onto these nodes; nothing here touches the host filesystem.
+//
+// Functions returning int return 0 (or a count) on success and a negative
+// errno on failure. A path that climbs above its base directory fails with
+// -EXDEV. There are no symlinks.
+
+#ifndef WASI_VFS_H
+#define WASI_VFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct iovec;
+
+typedef struct VfsNode VfsNode;
+
+typedef struct VfsStat {
+    uint64_t ino;
+    uint8_t filetype;       // WASI_FILETYPE_DIRECTORY or _REGULAR_FILE
+    uint64_t nlink;
+    uint64_t size;
+    uint64_t atim;
+    uint64_t mtim;
+    uint64_t ctim;
+} VfsStat;
+
+// Create an empty root directory (one reference, held by the caller)
+VfsNode* vfs_new_root(void);
+
+// References are held by directory entries, open fds and preopens; a node is
+// freed (and a directory drops its entries) when the last one goes away
+void vfs_ref(VfsNode* node);
+void vfs_unref(VfsNode* node);
+
+int vfs_is_dir(const VfsNode* node);
+
+// Open `path` beneath base, honouring WASI oflags (CREAT, DIRECTORY, EXCL,
+// TRUNC). A directory cannot be opened for writing. On success *out holds a
+// new reference.
+int vfs_open(VfsNode* base, const char* path, uint16_t oflags, int write, VfsNode** out);
+
+int vfs_mkdir(VfsNode* base, const char* path);
+int vfs_rmdir(VfsNode* base, const char* path);
+int vfs_unlink(VfsNode* base, const char* path);
+int vfs_rename(VfsNode* old_base, const char* old_path, VfsNode* new_base, const char* new_path);
+int vfs_link(VfsNode* old_base, const char* old_path, VfsNode* new_base, const char* new_path);
+int vfs_stat_path(VfsNode* base, const char* path, VfsStat* st);
+
+// File data. Reads return the byte count (0 at end of file); writes past the
+// end zero-fill the gap.
+long vfs_pread(VfsNode* file, const struct iovec* iov, int iovcnt, uint64_t offset);
+long vfs_pwrite(VfsNode* file, const struct iovec* iov, int iovcnt, uint64_t offset);
+int vfs_truncate(VfsNode* file, uint64_t size);
+uint64_t vfs_size(const VfsNode* file);
+
+void vfs_stat(const VfsNode* node, VfsStat* st);
+
+// Set timestamps; fst_flags are WASI fstflags (ATIM, ATIM_NOW, MTIM, MTIM_NOW)
+int vfs_set_times(VfsNode* node, uint64_t atim, uint64_t mtim, uint16_t fst_flags);
+
+// Directory entry at `cookie`: 0 is ".", 1 is "..", then one per entry.
+// Returns 1 and fills the outputs, or 0 past the last entry.
+int vfs_dirent(VfsNode* dir, uint64_t cookie, const char** name, size_t* name_len,
+               uint64_t* ino, uint8_t* filetype);
+
+// Add the contents of a ustar/pax archive beneath root (regular files,
+// directories and hard links). Returns the number of entries added.
+int vfs_load_tar(VfsNode* root, const uint8_t* data, size_t len);
+
+#endif // WASI_VFS_H
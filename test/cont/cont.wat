@@ -0,0 +1,177 @@
+;; Stack switching: cont.new, cont.bind, resume, resume_throw, suspend and
+;; switch
+(module
+  (type $ft0 (func))
+  (type $ct0 (cont $ft0))
+  (type $gft (func (param i32)))
+  (type $gct (cont $gft))
+  (type $ift (func (result i32)))
+  (type $ict (cont $ift))
+  (type $aft (func (param i32) (result i32)))
+  (type $act (cont $aft))
+  (rec
+    (type $sft (func (param i32 (ref null $sbk)) (result i32)))
+    (type $sak (cont $sft))
+    (type $bft (func (param i32 (ref null $sak)) (result i32)))
+    (type $sbk (cont $bft)))
+
+  (tag $yield (param i32))
+  (tag $ask (param i32) (result i32))
+  (tag $sw (result i32))
+  (tag $e (param i32))
+
+  (elem declare func $gen $nop $inner $middle $a $b $thrower $add1 $catcher)
+
+  (func $emit (param $v i32)
+    (suspend $yield (local.get $v))
+  )
+
+  ;; Yields n, n-1, ..., 1 from a nested call
+  (func $gen (type $gft) (param $n i32)
+    (loop $next
+      (if (local.get $n)
+        (then
+          (call $emit (local.get $n))
+          (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+          (br $next))))
+  )
+
+  ;; Sum of everything the generator yields
+  (func (export "sum") (param $n i32) (result i32)
+    (local $k (ref null $ct0))
+    (local $sum i32)
+    (block $done
+      (block $on_yield (result i32 (ref $ct0))
+        (resume $gct (on $yield $on_yield)
+          (local.get $n) (cont.new $gct (ref.func $gen)))
+        (br $done))
+      (local.set $k)
+      (local.set $sum)
+      (loop $next
+        (block $on_yield (result i32 (ref $ct0))
+          (resume $ct0 (on $yield $on_yield) (local.get $k))
+          (br $done))
+        (local.set $k)
+        (local.set $sum (i32.add (local.get $sum)))
+        (br $next)))
+    (local.get $sum)
+  )
+
+  (func $leaf (param $x i32) (result i32)
+    (i32.add (suspend $ask (local.get $x)) (i32.const 100))
+  )
+
+  (func $inner (type $ift) (result i32)
+    (i32.add (call $leaf (i32.const 5)) (i32.const 1))
+  )
+
+  ;; Handles $yield only, so $ask passes through to the outer resume
+  (func $middle (type $ift) (result i32)
+    (block $on_yield (result i32 (ref $ict))
+      (return
+        (i32.mul
+          (resume $ict (on $yield $on_yield) (cont.new $ict (ref.func $inner)))
+          (i32.const 2))))
+    (unreachable)
+  )
+
+  ;; Suspends through an inner resume, answers 10x the question, and
+  ;; resumes the whole chain: ((5 * 10 + 100) + 1) * 2
+  (func (export "nested") (result i32)
+    (local $k (ref null $act))
+    (block $on_ask (result i32 (ref $act))
+      (return
+        (resume $ict (on $ask $on_ask) (cont.new $ict (ref.func $middle)))))
+    (local.set $k)
+    (resume $act (i32.mul (i32.const 10)) (local.get $k))
+  )
+
+  ;; a switches to b with 7; b switches back with 8; a returns 1008
+  (func $a (type $ift) (result i32)
+    (switch $sbk $sw (i32.const 7) (cont.new $sbk (ref.func $b)))
+    (drop)
+    (i32.add (i32.const 1000))
+  )
+
+  (func $b (type $bft) (param $v i32) (param $k (ref null $sak)) (result i32)
+    (switch $sak $sw (i32.add (local.get $v) (i32.const 1)) (local.get $k))
+    (drop)
+  )
+
+  (func (export "switch") (result i32)
+    (resume $ict (on $sw switch) (cont.new $ict (ref.func $a)))
+  )
+
+  (func $nop (type $ft0))
+
+  ;; A continuation can only be resumed once
+  (func (export "resume_twice")
+    (local $k (ref null $ct0))
+    (local.set $k (cont.new $ct0 (ref.func $nop)))
+    (resume $ct0 (local.get $k))
+    (resume $ct0 (local.get $k))
+  )
+
+  ;; No resume handles the tag
+  (func (export "unhandled")
+    (suspend $yield (i32.const 1))
+  )
+
+  (func $thrower (type $ft0)
+    (throw $e (i32.const 42))
+  )
+
+  ;; An exception leaves the continuation and is caught by the resumer
+  (func (export "throw_through") (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (resume $ct0 (cont.new $ct0 (ref.func $thrower))))
+      (i32.const -1))
+  )
+
+  ;; 41 bound ahead of resuming a fresh continuation
+  (func $add1 (type $aft) (param $x i32) (result i32)
+    (i32.add (local.get $x) (i32.const 1))
+  )
+
+  (func (export "bind") (result i32)
+    (resume $ict (cont.bind $act $ict (i32.const 41) (cont.new $act (ref.func $add1))))
+  )
+
+  ;; As nested, with the answer bound to the suspended continuation
+  (func (export "bind_suspended") (result i32)
+    (local $k (ref null $act))
+    (block $on_ask (result i32 (ref $act))
+      (return
+        (resume $ict (on $ask $on_ask) (cont.new $ict (ref.func $middle)))))
+    (local.set $k)
+    (resume $ict (cont.bind $act $ict (i32.mul (i32.const 10)) (local.get $k)))
+  )
+
+  (func $catcher (type $ift) (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (suspend $yield (i32.const 1)))
+      (i32.const -1))
+    (i32.add (i32.const 1000))
+  )
+
+  ;; The exception is raised at the suspend and caught inside: 1005
+  (func (export "resume_throw") (result i32)
+    (local $k (ref null $ict))
+    (block $on_yield (result i32 (ref $ict))
+      (return
+        (resume $ict (on $yield $on_yield) (cont.new $ict (ref.func $catcher)))))
+    (local.set $k)
+    (drop)
+    (resume_throw $ict $e (i32.const 5) (local.get $k))
+  )
+
+  ;; A fresh continuation does not run; the exception reaches the resumer
+  (func (export "resume_throw_fresh") (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (resume_throw $ct0 $e (i32.const 7) (cont.new $ct0 (ref.func $nop))))
+      (i32.const -1))
+  )
+)
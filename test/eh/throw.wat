@@ -0,0 +1,119 @@
+;; Exception handling: throw, try_table catch clauses and throw_ref
+(module
+  (tag $e (param i32))
+  (tag $pair (param i32 i64))
+  (tag $empty)
+
+  ;; No throw: the try_table body completes normally
+  (func (export "no_throw") (param $x i32) (result i32)
+    (block $h (result i32)
+      (try_table (result i32) (catch $e $h)
+        (i32.add (local.get $x) (i32.const 1))
+      )
+      (return)
+    )
+    (i32.const -1)
+  )
+
+  ;; The payload reaches the catch label
+  (func (export "simple") (param $x i32) (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (throw $e (i32.mul (local.get $x) (i32.const 3)))
+      )
+      (i32.const -1)
+    )
+  )
+
+  ;; The innermost matching clause wins; non-matching tags pass through
+  (func (export "nested") (param $x i32) (result i32)
+    (block $outer (result i32)
+      (block $inner (result i32 i64)
+        (try_table (catch $e $outer)
+          (try_table (catch $pair $inner)
+            (if (local.get $x)
+              (then (throw $pair (i32.const 20) (i64.const 5))))
+            (throw $e (i32.const 10))
+          )
+        )
+        (unreachable)
+      )
+      ;; $inner receives (i32, i64); keep the i32
+      (drop)
+      (i32.const 100)
+      (i32.add)
+    )
+  )
+
+  (func $dive (param $depth i32)
+    (if (i32.eqz (local.get $depth))
+      (then (throw $e (i32.const 42))))
+    (call $dive (i32.sub (local.get $depth) (i32.const 1)))
+  )
+
+  ;; Unwinds through $depth frames of $dive
+  (func (export "deep") (param $depth i32) (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (call $dive (local.get $depth))
+      )
+      (i32.const -1)
+    )
+  )
+
+  ;; catch_ref captures the exception; throw_ref rethrows it to an outer handler
+  (func (export "rethrow") (param $x i32) (result i32)
+    (block $h (result i32)
+      (try_table (catch $e $h)
+        (block $r (result i32 exnref)
+          (try_table (catch_ref $e $r)
+            (throw $e (local.get $x))
+          )
+          (unreachable)
+        )
+        (throw_ref)
+      )
+      (i32.const -1)
+    )
+  )
+
+  ;; catch_all and catch_all_ref ignore the payload
+  (func (export "catch_all") (result i32)
+    (block $h
+      (try_table (catch_all $h)
+        (throw $pair (i32.const 1) (i64.const 2))
+      )
+      (return (i32.const -1))
+    )
+    (block $h2 (result exnref)
+      (try_table (catch_all_ref $h2)
+        (throw $empty)
+      )
+      (return (i32.const -2))
+    )
+    (if (result i32) (ref.is_null)
+      (then (i32.const 0))
+      (else (i32.const 7)))
+  )
+
+  ;; A tag without params
+  (func (export "empty") (result i32)
+    (block $h
+      (try_table (catch $empty $h)
+        (throw $empty)
+      )
+      (return (i32.const 0))
+    )
+    (i32.const 1)
+  )
+
+  ;; No handler: the exception leaves the export as a trap
+  (func (export "uncaught") (result i32)
+    (throw $e (i32.const 1))
+  )
+
+  ;; throw_ref on null traps
+  (func (export "throw_null") (result i32)
+    (throw_ref (ref.null exn))
+  )
+)
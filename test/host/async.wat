@@ -0,0 +1,36 @@
+;; Test imports registered with register_async_host_func: calls that wait
+;; on the host are suspended and resumed with the host's results
+(module
+  (import "env" "fetch" (func $fetch (param i32) (result i32)))
+
+  (type $unop (func (param i32) (result i32)))
+  (table 1 funcref)
+  (elem (i32.const 0) $fetch)
+
+  ;; Sum of fetch(base + i) for i in 0..n
+  (func (export "sum_fetched") (param $base i32) (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc i32)
+    (block $done
+      (loop $next
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (i32.add
+            (local.get $acc)
+            (call $fetch (i32.add (local.get $base) (local.get $i)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $next)
+      )
+    )
+    (local.get $acc)
+  )
+
+  (func (export "fetch_tail") (param i32) (result i32)
+    (return_call $fetch (i32.add (local.get 0) (i32.const 1)))
+  )
+
+  ;; Calls through a table cannot wait on the host and trap
+  (func (export "fetch_indirect") (param i32) (result i32)
+    (call_indirect (type $unop) (local.get 0) (i32.const 0))
+  )
+)
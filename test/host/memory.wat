@@ -0,0 +1,31 @@
+;; Test host access to linear memory through views and bulk copies
+(module
+  (memory (export "memory") 1)
+
+  ;; Sum of len bytes at ptr
+  (func (export "sum") (param $ptr i32) (param $len i32) (result i32)
+    (local $acc i32)
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $len)))
+        (local.set $acc
+          (i32.add (local.get $acc) (i32.load8_u (local.get $ptr))))
+        (local.set $ptr (i32.add (local.get $ptr) (i32.const 1)))
+        (local.set $len (i32.sub (local.get $len) (i32.const 1)))
+        (br $next)
+      )
+    )
+    (local.get $acc)
+  )
+
+  ;; Load an i64 the host stored
+  (func (export "load64") (param $ptr i32) (result i64)
+    (i64.load (local.get $ptr))
+  )
+
+  ;; Store an i32 and an f64 for the host to read
+  (func (export "store") (param $ptr i32) (param $v i32) (param $f f64)
+    (i32.store (local.get $ptr) (local.get $v))
+    (f64.store offset=4 (local.get $ptr) (local.get $f))
+  )
+)
@@ -0,0 +1,42 @@
+;; Test imports bound to native host functions (test/host_funcs.c):
+;; direct, tail and indirect calls, linear memory access and traps
+(module
+  (import "env" "add" (func $add (param i32 i32) (result i32)))
+  (import "env" "fill" (func $fill (param i32 i32 i32)))
+  (import "env" "count" (func $count (result i64)))
+
+  (memory (export "memory") 1)
+  (type $binop (func (param i32 i32) (result i32)))
+  (table 1 funcref)
+  (elem (i32.const 0) $add)
+
+  (func (export "add") (param i32 i32) (result i32)
+    (call $add (local.get 0) (local.get 1))
+  )
+
+  (func (export "add_tail") (param i32 i32) (result i32)
+    (return_call $add (local.get 0) (local.get 1))
+  )
+
+  (func (export "add_indirect") (param i32 i32) (result i32)
+    (call_indirect (type $binop) (local.get 0) (local.get 1) (i32.const 0))
+  )
+
+  ;; fill writes "AAAA" at 16, read back as an i32
+  (func (export "fill_load") (result i32)
+    (call $fill (i32.const 16) (i32.const 4) (i32.const 0x41))
+    (i32.load (i32.const 16))
+  )
+
+  ;; fill past the end of memory traps
+  (func (export "fill_oob") (result i32)
+    (call $fill (i32.const 65534) (i32.const 4) (i32.const 0))
+    (i32.const 1)
+  )
+
+  ;; The counter lives in the host function's env
+  (func (export "count_twice") (result i64)
+    (drop (call $count))
+    (call $count)
+  )
+)
@@ -0,0 +1,42 @@
+// Native host functions for host_func_test.mbt
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../internal/cruntime/host.h"
+
+// env.add: (i32, i32) -> i32
+static int host_add(void* env, const uint64_t* args, uint64_t* results,
+                    uint8_t* mem, uint64_t mem_size) {
+    (void)env; (void)mem; (void)mem_size;
+    results[0] = (uint32_t)((uint32_t)args[0] + (uint32_t)args[1]);
+    return 0;
+}
+
+// env.fill: (ptr, len, byte) -> (), memset in linear memory; traps when the
+// range is out of bounds
+static int host_fill(void* env, const uint64_t* args, uint64_t* results,
+                     uint8_t* mem, uint64_t mem_size) {
+    (void)env; (void)results;
+    uint64_t ptr = (uint32_t)args[0];
+    uint64_t len = (uint32_t)args[1];
+    if (ptr + len > mem_size) return 1;
+    memset(mem + ptr, (int)(uint8_t)args[2], (size_t)len);
+    return 0;
+}
+
+// env.count: () -> i64, increments the counter env points to
+static int host_count(void* env, const uint64_t* args, uint64_t* results,
+                      uint8_t* mem, uint64_t mem_size) {
+    (void)args; (void)mem; (void)mem_size;
+    int64_t* counter = (int64_t*)env;
+    results[0] = (uint64_t)++*counter;
+    return 0;
+}
+
+static int64_t g_counter = 0;
+
+uint64_t host_test_add(void) { return (uint64_t)(uintptr_t)&host_add; }
+uint64_t host_test_fill(void) { return (uint64_t)(uintptr_t)&host_fill; }
+uint64_t host_test_count(void) { return (uint64_t)(uintptr_t)&host_count; }
+uint64_t host_test_counter(void) { return (uint64_t)(uintptr_t)&g_counter; }
@@ -0,0 +1,108 @@
+;; wasm:js-string builtins over i16 char code arrays and imported string
+;; constants, as the MoonBit wasm-gc backend uses them
+(module
+  (type $chars (array (mut i16)))
+  (type $box (struct (field anyref)))
+  (import "wasm:js-string" "fromCharCodeArray"
+    (func $from_array (param (ref null $chars) i32 i32) (result (ref extern))))
+  (import "wasm:js-string" "intoCharCodeArray"
+    (func $into_array (param externref (ref null $chars) i32) (result i32)))
+  (import "wasm:js-string" "concat"
+    (func $concat (param externref externref) (result (ref extern))))
+  (import "wasm:js-string" "equals"
+    (func $equals (param externref externref) (result i32)))
+  (import "wasm:js-string" "compare"
+    (func $compare (param externref externref) (result i32)))
+  (import "wasm:js-string" "length"
+    (func $length (param externref) (result i32)))
+  (import "wasm:js-string" "charCodeAt"
+    (func $char_code_at (param externref i32) (result i32)))
+  (import "wasm:js-string" "substring"
+    (func $substring (param externref i32 i32) (result (ref extern))))
+  (import "_" "hello" (global $hello (ref extern)))
+  (import "_" "w\c3\b6rld" (global $world (ref extern)))
+
+  ;; Strings reachable only in their any.convert_extern form
+  (global $kept (mut anyref) (ref.null any))
+  (global $boxed (mut (ref null $box)) (ref.null $box))
+
+  ;; "hello" spelled out in a char code array
+  (func $hello_array (result (ref $chars))
+    (array.new_fixed $chars 5
+      (i32.const 104) (i32.const 101) (i32.const 108) (i32.const 108) (i32.const 111)))
+
+  ;; The constant matches the string built from its char codes
+  (func (export "from_array_equals") (result i32)
+    (call $equals
+      (call $from_array (call $hello_array) (i32.const 0) (i32.const 5))
+      (global.get $hello)))
+
+  ;; Copy "hello" into an array at 2 and sum the copied char codes
+  (func (export "into_array") (result i32)
+    (local $arr (ref $chars))
+    (local.set $arr (array.new_default $chars (i32.const 8)))
+    (drop (call $into_array (global.get $hello) (local.get $arr) (i32.const 2)))
+    (i32.add
+      (array.get_u $chars (local.get $arr) (i32.const 2))
+      (array.get_u $chars (local.get $arr) (i32.const 6))))
+
+  ;; Length of "hello" ++ "wörld" and its char code at i
+  (func (export "concat_length") (result i32)
+    (call $length (call $concat (global.get $hello) (global.get $world))))
+  (func (export "char_code_at") (param $i i32) (result i32)
+    (call $char_code_at
+      (call $concat (global.get $hello) (global.get $world)) (local.get $i)))
+
+  ;; substring(hello, start, end) equals "ell"
+  (func (export "substring_equals") (param $start i32) (param $end i32) (result i32)
+    (call $equals
+      (call $substring (global.get $hello) (local.get $start) (local.get $end))
+      (call $substring (global.get $hello) (i32.const 1) (i32.const 4))))
+  (func (export "substring_length") (param $start i32) (param $end i32) (result i32)
+    (call $length
+      (call $substring (global.get $hello) (local.get $start) (local.get $end))))
+
+  (func (export "compare") (result i32)
+    (call $compare (global.get $hello) (global.get $world)))
+  (func (export "equals_null") (result i32)
+    (call $equals (ref.null extern) (ref.null extern)))
+  ;; Tail call: the builtin runs through the generic import path
+  (func (export "length_tail") (result i32)
+    (return_call $length (global.get $world)))
+  ;; Keep "hello" ++ "wörld" in a global and "wörld" ++ "hello" in a struct
+  ;; field, both converted to anyref
+  (func (export "keep_converted")
+    (global.set $kept
+      (any.convert_extern (call $concat (global.get $hello) (global.get $world))))
+    (global.set $boxed
+      (struct.new $box
+        (any.convert_extern (call $concat (global.get $world) (global.get $hello))))))
+  ;; Allocate and drop n strings of ten "x", the size of the kept ones, so
+  ;; that freed string memory would be reused
+  (func (export "churn") (param $n i32)
+    (local $xs (ref $chars))
+    (local.set $xs (array.new $chars (i32.const 120) (i32.const 10)))
+    (loop $next
+      (if (local.get $n)
+        (then
+          (drop (call $from_array (local.get $xs) (i32.const 0) (i32.const 10)))
+          (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+          (br $next)))))
+  ;; Length of the kept strings concatenated, and their first char codes
+  (func (export "kept_length") (result i32)
+    (call $length
+      (call $concat
+        (extern.convert_any (global.get $kept))
+        (extern.convert_any (struct.get $box 0 (global.get $boxed))))))
+  (func (export "kept_chars") (result i32)
+    (i32.or
+      (call $char_code_at (extern.convert_any (global.get $kept)) (i32.const 0))
+      (i32.shl
+        (call $char_code_at
+          (extern.convert_any (struct.get $box 0 (global.get $boxed))) (i32.const 0))
+        (i32.const 16))))
+
+  ;; Not a string: traps
+  (func (export "length_null") (result i32)
+    (call $length (ref.null extern)))
+)
@@ -0,0 +1,27 @@
+;; memory64: i64 addresses, sizes and bulk ops, and a heap past 4 GiB
+(module
+  (memory $m i64 1 81920)
+  (memory $small 1 1)
+  (data (memory $m) (i64.const 16) "\01\02\03\04")
+  (data $passive "\07\07\07\07")
+
+  (func (export "load") (param $addr i64) (result i32)
+    (i32.load (local.get $addr)))
+  (func (export "store_load") (param $addr i64) (param $v i64) (result i64)
+    (i64.store offset=8 (local.get $addr) (local.get $v))
+    (i64.load offset=8 (local.get $addr)))
+
+  ;; Grow by n pages; returns the old size (-1 on failure)
+  (func (export "grow") (param $n i64) (result i64)
+    (memory.grow (local.get $n)))
+  (func (export "size") (result i64)
+    (memory.size))
+
+  ;; Fill and init at addr, then copy 8 bytes to the memory32 memory
+  (func (export "bulk") (param $addr i64) (result i64)
+    (memory.fill (local.get $addr) (i32.const 0x11) (i64.const 4))
+    (memory.init $passive $m
+      (i64.add (local.get $addr) (i64.const 4)) (i32.const 0) (i32.const 4))
+    (memory.copy $small $m (i32.const 0) (local.get $addr) (i32.const 8))
+    (i64.load $small (i32.const 0)))
+)
@@ -0,0 +1,48 @@
+;; Multi-memory: two memories with their own data, sizes and bounds
+(module
+  (memory $a 1 2)
+  (memory $b 1 4)
+  (data (memory $a) (i32.const 0) "\01\02\03\04")
+  (data (memory $b) (i32.const 0) "\0a\0b\0c\0d")
+  (data $passive "\07\07\07\07")
+
+  ;; Word at 0 of each memory
+  (func (export "load_a") (result i32)
+    (i32.load $a (i32.const 0)))
+  (func (export "load_b") (result i32)
+    (i32.load $b (i32.const 0)))
+
+  ;; Store to memory $b leaves memory $a untouched
+  (func (export "store_b") (param $v i64) (result i64)
+    (i64.store $b offset=8 (i32.const 0) (local.get $v))
+    (i64.add
+      (i64.load $a offset=8 (i32.const 0))
+      (i64.load $b offset=8 (i32.const 0))))
+
+  ;; Grow memory $b by n pages; returns old size * 100 + new size
+  (func (export "grow_b") (param $n i32) (result i32)
+    (i32.add
+      (i32.mul (memory.grow $b (local.get $n)) (i32.const 100))
+      (memory.size $b)))
+  (func (export "size_a") (result i32)
+    (memory.size $a))
+
+  ;; Copy 4 bytes from memory $b to memory $a at 16
+  (func (export "copy_b_to_a") (result i32)
+    (memory.copy $a $b (i32.const 16) (i32.const 0) (i32.const 4))
+    (i32.load $a (i32.const 16)))
+
+  ;; Fill and init in memory $b
+  (func (export "fill_init_b") (result i32)
+    (memory.fill $b (i32.const 32) (i32.const 0x11) (i32.const 4))
+    (memory.init $passive $b (i32.const 36) (i32.const 0) (i32.const 4))
+    (i32.xor
+      (i32.load $b (i32.const 32))
+      (i32.load $b (i32.const 36))))
+
+  ;; Load at byte addr of a memory; out of bounds traps
+  (func (export "load8_a") (param $addr i32) (result i32)
+    (i32.load8_u $a (local.get $addr)))
+  (func (export "load8_b") (param $addr i32) (result i32)
+    (i32.load8_u $b (local.get $addr)))
+)
@@ -0,0 +1,44 @@
+;; v128.const in every lane shape, and v128 values through params and results
+
+(module
+  (func (export "i8x16") (result v128)
+    (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15))
+  (func (export "i16x8") (result v128)
+    (v128.const i16x8 -1 0 1 0x7fff -0x8000 2 3 4))
+  (func (export "i32x4") (result v128)
+    (v128.const i32x4 0xffffffff -1 0x80000000 1))
+  (func (export "i64x2") (result v128)
+    (v128.const i64x2 -1 0x0123456789abcdef))
+  (func (export "f32x4") (result v128)
+    (v128.const f32x4 1.0 -0.0 inf -inf))
+  (func (export "f64x2") (result v128)
+    (v128.const f64x2 0.5 -2))
+  (func (export "i32x4-as-i64x2") (result v128)
+    (v128.const i32x4 1 2 3 4))
+  (func (export "id") (param v128) (result v128) (local.get 0))
+  (func (export "swap") (param v128 v128) (result v128 v128)
+    (local.get 1) (local.get 0))
+)
+
+(assert_return (invoke "i8x16")
+  (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15))
+(assert_return (invoke "i16x8")
+  (v128.const i16x8 65535 0 1 32767 32768 2 3 4))
+(assert_return (invoke "i32x4")
+  (v128.const i32x4 -1 0xffffffff -0x80000000 1))
+(assert_return (invoke "i64x2")
+  (v128.const i64x2 0xffffffffffffffff 0x0123456789abcdef))
+(assert_return (invoke "f32x4") (v128.const f32x4 1 -0 inf -inf))
+(assert_return (invoke "f64x2") (v128.const f64x2 0.5 -2.0))
+(assert_return (invoke "i32x4-as-i64x2")
+  (v128.const i64x2 0x0000000200000001 0x0000000400000003))
+
+(assert_return (invoke "id" (v128.const i32x4 1 2 3 4))
+  (v128.const i32x4 1 2 3 4))
+(assert_return (invoke "id" (v128.const f32x4 nan -nan 0x1p-149 -0x1p127))
+  (v128.const f32x4 nan -nan 0x1p-149 -0x1p127))
+(assert_return (invoke "id" (v128.const i64x2 -1 -1))
+  (v128.const i8x16 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1 -1))
+(assert_return
+  (invoke "swap" (v128.const i64x2 1 2) (v128.const i64x2 3 4))
+  (v128.const i64x2 3 4) (v128.const i64x2 1 2))
@@ -0,0 +1,25 @@
+;; f32x4 add, sub, mul and div, with infinities, signed zeros and NaNs
+
+(module
+  (func (export "f32x4.add") (param v128 v128) (result v128)
+    (f32x4.add (local.get 0) (local.get 1)))
+  (func (export "f32x4.sub") (param v128 v128) (result v128)
+    (f32x4.sub (local.get 0) (local.get 1)))
+  (func (export "f32x4.mul") (param v128 v128) (result v128)
+    (f32x4.mul (local.get 0) (local.get 1)))
+  (func (export "f32x4.div") (param v128 v128) (result v128)
+    (f32x4.div (local.get 0) (local.get 1)))
+)
+
+(assert_return
+  (invoke "f32x4.add" (v128.const f32x4 1 -0.0 inf 0x1p127) (v128.const f32x4 2 0.0 1 0x1p127))
+  (v128.const f32x4 3 0.0 inf inf))
+(assert_return
+  (invoke "f32x4.sub" (v128.const f32x4 inf 1 nan 0) (v128.const f32x4 inf 1 1 -0.0))
+  (v128.const f32x4 nan:canonical 0 nan:arithmetic 0))
+(assert_return
+  (invoke "f32x4.mul" (v128.const f32x4 2 -0.0 inf 3) (v128.const f32x4 0.5 1 0 -1))
+  (v128.const f32x4 1 -0.0 nan:canonical -3))
+(assert_return
+  (invoke "f32x4.div" (v128.const f32x4 1 1 0 -1) (v128.const f32x4 4 0 0 0))
+  (v128.const f32x4 0.25 inf nan:canonical -inf))
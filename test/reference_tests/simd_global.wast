@@ -0,0 +1,37 @@
+;; v128 globals: initialisers, global.get and global.set, exports and imports
+
+(module
+  (global (export "a") v128 (v128.const i32x4 1 2 3 4))
+  (global $b (mut v128) (v128.const i64x2 -1 0))
+  (global $n (mut i32) (i32.const 7))
+
+  (func (export "get-a") (result v128) (global.get 0))
+  (func (export "get-b") (result v128) (global.get $b))
+  (func (export "set-b") (param v128) (global.set $b (local.get 0)))
+  (func (export "add-b") (param i32) (result i32)
+    (global.set $b (i32x4.add (global.get $b) (i32x4.splat (local.get 0))))
+    (i32x4.extract_lane 3 (global.get $b)))
+  ;; Scalar globals next to v128 ones are unaffected
+  (func (export "get-n") (result i32) (global.get $n))
+)
+
+(assert_return (get "a") (v128.const i32x4 1 2 3 4))
+(assert_return (invoke "get-a") (v128.const i32x4 1 2 3 4))
+(assert_return (invoke "get-b") (v128.const i64x2 -1 0))
+(assert_return (invoke "set-b" (v128.const i32x4 10 20 30 40)))
+(assert_return (invoke "get-b") (v128.const i32x4 10 20 30 40))
+(assert_return (invoke "add-b" (i32.const 1)) (i32.const 41))
+(assert_return (invoke "get-b") (v128.const i32x4 11 21 31 41))
+(assert_return (invoke "get-n") (i32.const 7))
+
+(register "M")
+
+(module
+  (global $x (import "M" "a") v128)
+  (global $y v128 (global.get $x))
+  (func (export "get-y") (result v128) (global.get $y))
+  (func (export "x-lane") (result i32) (i32x4.extract_lane 3 (global.get $x)))
+)
+
+(assert_return (invoke "get-y") (v128.const i32x4 1 2 3 4))
+(assert_return (invoke "x-lane") (i32.const 4))
@@ -0,0 +1,25 @@
+;; i32x4 add, sub, mul and neg, with wrapping
+
+(module
+  (func (export "i32x4.add") (param v128 v128) (result v128)
+    (i32x4.add (local.get 0) (local.get 1)))
+  (func (export "i32x4.sub") (param v128 v128) (result v128)
+    (i32x4.sub (local.get 0) (local.get 1)))
+  (func (export "i32x4.mul") (param v128 v128) (result v128)
+    (i32x4.mul (local.get 0) (local.get 1)))
+  (func (export "i32x4.neg") (param v128) (result v128)
+    (i32x4.neg (local.get 0)))
+)
+
+(assert_return
+  (invoke "i32x4.add" (v128.const i32x4 1 2 3 4) (v128.const i32x4 0xffffffff 0x7fffffff 0 -4))
+  (v128.const i32x4 0 0x80000001 3 0))
+(assert_return
+  (invoke "i32x4.sub" (v128.const i32x4 0 0x80000000 5 -1) (v128.const i32x4 1 1 5 -1))
+  (v128.const i32x4 -1 0x7fffffff 0 0))
+(assert_return
+  (invoke "i32x4.mul" (v128.const i32x4 0x10000 -3 7 0x40000000) (v128.const i32x4 0x10000 3 -1 4))
+  (v128.const i32x4 0 -9 -7 0))
+(assert_return
+  (invoke "i32x4.neg" (v128.const i32x4 0 1 -1 0x80000000))
+  (v128.const i32x4 0 -1 1 0x80000000))
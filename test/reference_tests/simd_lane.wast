@@ -0,0 +1,92 @@
+;; Lane extraction and replacement, splat, shuffle and swizzle
+
+(module
+  (func (export "i8x16_extract_lane_s") (param v128) (result i32)
+    (i8x16.extract_lane_s 15 (local.get 0)))
+  (func (export "i8x16_extract_lane_u") (param v128) (result i32)
+    (i8x16.extract_lane_u 15 (local.get 0)))
+  (func (export "i16x8_extract_lane_s") (param v128) (result i32)
+    (i16x8.extract_lane_s 7 (local.get 0)))
+  (func (export "i16x8_extract_lane_u") (param v128) (result i32)
+    (i16x8.extract_lane_u 7 (local.get 0)))
+  (func (export "i32x4_extract_lane") (param v128) (result i32)
+    (i32x4.extract_lane 3 (local.get 0)))
+  (func (export "i64x2_extract_lane") (param v128) (result i64)
+    (i64x2.extract_lane 1 (local.get 0)))
+  (func (export "f32x4_extract_lane") (param v128) (result f32)
+    (f32x4.extract_lane 2 (local.get 0)))
+  (func (export "f64x2_extract_lane") (param v128) (result f64)
+    (f64x2.extract_lane 1 (local.get 0)))
+
+  (func (export "i8x16_replace_lane") (param v128 i32) (result v128)
+    (i8x16.replace_lane 15 (local.get 0) (local.get 1)))
+  (func (export "i32x4_replace_lane") (param v128 i32) (result v128)
+    (i32x4.replace_lane 0 (local.get 0) (local.get 1)))
+  (func (export "i64x2_replace_lane") (param v128 i64) (result v128)
+    (i64x2.replace_lane 1 (local.get 0) (local.get 1)))
+  (func (export "f64x2_replace_lane") (param v128 f64) (result v128)
+    (f64x2.replace_lane 0 (local.get 0) (local.get 1)))
+
+  (func (export "i32x4_splat") (param i32) (result v128)
+    (i32x4.splat (local.get 0)))
+  (func (export "i8x16_shuffle") (param v128 v128) (result v128)
+    (i8x16.shuffle 16 1 18 3 20 5 22 7 24 9 26 11 28 13 30 15
+      (local.get 0) (local.get 1)))
+  (func (export "i8x16_swizzle") (param v128 v128) (result v128)
+    (i8x16.swizzle (local.get 0) (local.get 1)))
+)
+
+(assert_return
+  (invoke "i8x16_extract_lane_s"
+    (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 0xff))
+  (i32.const -1))
+(assert_return
+  (invoke "i8x16_extract_lane_u"
+    (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 0xff))
+  (i32.const 255))
+(assert_return
+  (invoke "i16x8_extract_lane_s" (v128.const i16x8 0 0 0 0 0 0 0 0x8000))
+  (i32.const -32768))
+(assert_return
+  (invoke "i16x8_extract_lane_u" (v128.const i16x8 0 0 0 0 0 0 0 0x8000))
+  (i32.const 32768))
+(assert_return
+  (invoke "i32x4_extract_lane" (v128.const i32x4 1 2 3 -1))
+  (i32.const -1))
+(assert_return
+  (invoke "i64x2_extract_lane" (v128.const i64x2 1 0x8000000000000000))
+  (i64.const 0x8000000000000000))
+(assert_return
+  (invoke "f32x4_extract_lane" (v128.const f32x4 1 2 -3.5 4))
+  (f32.const -3.5))
+(assert_return
+  (invoke "f64x2_extract_lane" (v128.const f64x2 1 inf))
+  (f64.const inf))
+
+(assert_return
+  (invoke "i8x16_replace_lane" (v128.const i64x2 0 0) (i32.const 0x1ff))
+  (v128.const i8x16 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 -1))
+(assert_return
+  (invoke "i32x4_replace_lane" (v128.const i32x4 1 2 3 4) (i32.const 7))
+  (v128.const i32x4 7 2 3 4))
+(assert_return
+  (invoke "i64x2_replace_lane" (v128.const i64x2 1 2) (i64.const -1))
+  (v128.const i64x2 1 -1))
+(assert_return
+  (invoke "f64x2_replace_lane" (v128.const f64x2 1 2) (f64.const -0.5))
+  (v128.const f64x2 -0.5 2))
+
+(assert_return (invoke "i32x4_splat" (i32.const 5)) (v128.const i32x4 5 5 5 5))
+(assert_return (invoke "i32x4_splat" (i32.const -1))
+  (v128.const i8x16 255 255 255 255 255 255 255 255 255 255 255 255 255 255 255 255))
+(assert_return
+  (invoke "i8x16_shuffle"
+    (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15)
+    (v128.const i8x16 16 17 18 19 20 21 22 23 24 25 26 27 28 29 30 31))
+  (v128.const i8x16 16 1 18 3 20 5 22 7 24 9 26 11 28 13 30 15))
+;; Indices out of range select 0
+(assert_return
+  (invoke "i8x16_swizzle"
+    (v128.const i8x16 16 17 18 19 20 21 22 23 24 25 26 27 28 29 30 31)
+    (v128.const i8x16 15 14 13 12 11 10 9 8 7 6 5 4 3 2 16 255))
+  (v128.const i8x16 31 30 29 28 27 26 25 24 23 22 21 20 19 18 0 0))
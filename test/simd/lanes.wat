@@ -0,0 +1,257 @@
+;; Per-lane SIMD results for edge cases: signed zeros and NaN in float
+;; min/max/pmin/pmax, rounding, saturating conversions and arithmetic,
+;; narrowing, wrapping dot products and shift counts past the lane width.
+;; Each case returns its result as the low and high i64 halves
+(module
+  (func $halves (param $v v128) (result i64 i64)
+    (i64x2.extract_lane 0 (local.get $v))
+    (i64x2.extract_lane 1 (local.get $v))
+  )
+
+  ;; Bitmask of f32 lanes holding a canonical NaN (either sign)
+  (func $nan_f32 (param $v v128) (result i32)
+    (i32x4.bitmask
+      (i32x4.eq (v128.and (local.get $v) (v128.const i32x4 0x7fffffff 0x7fffffff 0x7fffffff 0x7fffffff))
+                (v128.const i32x4 0x7fc00000 0x7fc00000 0x7fc00000 0x7fc00000)))
+  )
+
+  ;; Bitmask of f64 lanes holding a canonical NaN (either sign)
+  (func $nan_f64 (param $v v128) (result i32)
+    (i64x2.bitmask
+      (i64x2.eq (v128.and (local.get $v) (v128.const i64x2 0x7fffffffffffffff 0x7fffffffffffffff))
+                (v128.const i64x2 0x7ff8000000000000 0x7ff8000000000000)))
+  )
+
+  (func (export "f32x4_min_zero") (result i64 i64)
+    (call $halves (f32x4.min (v128.const f32x4 -0 0 -1.0 2.0) (v128.const f32x4 0 -0 1.0 -inf)))
+  )
+
+  (func (export "f32x4_max_zero") (result i64 i64)
+    (call $halves (f32x4.max (v128.const f32x4 -0 0 -1.0 2.0) (v128.const f32x4 0 -0 1.0 -inf)))
+  )
+
+  (func (export "f64x2_min_zero") (result i64 i64)
+    (call $halves (f64x2.min (v128.const f64x2 -0 0) (v128.const f64x2 0 -0)))
+  )
+
+  (func (export "f64x2_max_zero") (result i64 i64)
+    (call $halves (f64x2.max (v128.const f64x2 -0 0) (v128.const f64x2 0 -0)))
+  )
+
+  (func (export "f32x4_pmin") (result i64 i64)
+    (call $halves (f32x4.pmin (v128.const f32x4 -0 0 nan 1.0) (v128.const f32x4 0 -0 1.0 nan)))
+  )
+
+  (func (export "f32x4_pmax") (result i64 i64)
+    (call $halves (f32x4.pmax (v128.const f32x4 -0 0 nan 1.0) (v128.const f32x4 0 -0 1.0 nan)))
+  )
+
+  (func (export "f64x2_pmin") (result i64 i64)
+    (call $halves (f64x2.pmin (v128.const f64x2 -0 2.0) (v128.const f64x2 0 nan)))
+  )
+
+  (func (export "f32x4_nearest") (result i64 i64)
+    (call $halves (f32x4.nearest (v128.const f32x4 0.5 1.5 -0.5 -2.5)))
+  )
+
+  (func (export "f64x2_nearest") (result i64 i64)
+    (call $halves (f64x2.nearest (v128.const f64x2 -0.5 2.5)))
+  )
+
+  (func (export "f32x4_ceil") (result i64 i64)
+    (call $halves (f32x4.ceil (v128.const f32x4 -0.5 1.25 -1.5 0)))
+  )
+
+  (func (export "f32x4_floor") (result i64 i64)
+    (call $halves (f32x4.floor (v128.const f32x4 0.5 -0.5 -0 1.5)))
+  )
+
+  (func (export "f32x4_trunc") (result i64 i64)
+    (call $halves (f32x4.trunc (v128.const f32x4 -0.75 2.75 -2.75 0.25)))
+  )
+
+  (func (export "f32x4_neg") (result i64 i64)
+    (call $halves (f32x4.neg (v128.const f32x4 0 -0 1.0 -inf)))
+  )
+
+  (func (export "f32x4_sqrt") (result i64 i64)
+    (call $halves (f32x4.sqrt (v128.const f32x4 -0 4.0 0.25 inf)))
+  )
+
+  (func (export "i32x4_trunc_sat_f32x4_s") (result i64 i64)
+    (call $halves
+      (i32x4.trunc_sat_f32x4_s
+        (v128.const f32x4 nan 3000000000.0 -3000000000.0 -1.875)))
+  )
+
+  (func (export "i32x4_trunc_sat_f32x4_u") (result i64 i64)
+    (call $halves (i32x4.trunc_sat_f32x4_u (v128.const f32x4 nan 5000000000.0 -1.875 4294967040.0)))
+  )
+
+  (func (export "i32x4_trunc_sat_f64x2_s_zero") (result i64 i64)
+    (call $halves (i32x4.trunc_sat_f64x2_s_zero (v128.const f64x2 -inf 10000000000.0)))
+  )
+
+  (func (export "i32x4_trunc_sat_f64x2_u_zero") (result i64 i64)
+    (call $halves (i32x4.trunc_sat_f64x2_u_zero (v128.const f64x2 nan 4294967295.875)))
+  )
+
+  (func (export "f32x4_convert_i32x4_u") (result i64 i64)
+    (call $halves (f32x4.convert_i32x4_u (v128.const i32x4 4294967295 1 16777217 2147483649)))
+  )
+
+  (func (export "f32x4_demote_f64x2_zero") (result i64 i64)
+    (call $halves (f32x4.demote_f64x2_zero (v128.const f64x2 1e+300 -0)))
+  )
+
+  (func (export "i16x8_q15mulr_sat_s") (result i64 i64)
+    (call $halves
+      (i16x8.q15mulr_sat_s
+        (v128.const i16x8 -32768 -32768 16384 -1 32767 100 -100 0)
+        (v128.const i16x8 -32768 32767 16384 1 32767 -200 -200 5)))
+  )
+
+  (func (export "i8x16_add_sat_s") (result i64 i64)
+    (call $halves
+      (i8x16.add_sat_s
+        (v128.const i8x16 127 -128 100 -100 1 2 3 4 0 0 0 0 0 0 0 0)
+        (v128.const i8x16 1 -1 27 -29 -1 -2 3 4 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i8x16_add_sat_u") (result i64 i64)
+    (call $halves
+      (i8x16.add_sat_u
+        (v128.const i8x16 255 250 1 128 0 0 0 0 0 0 0 0 0 0 0 0)
+        (v128.const i8x16 1 10 2 128 0 0 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i16x8_sub_sat_u") (result i64 i64)
+    (call $halves
+      (i16x8.sub_sat_u
+        (v128.const i16x8 0 5 65535 1 0 0 0 0)
+        (v128.const i16x8 1 3 65535 65535 0 0 0 0)))
+  )
+
+  (func (export "i16x8_sub_sat_s") (result i64 i64)
+    (call $halves
+      (i16x8.sub_sat_s
+        (v128.const i16x8 -32768 32767 5 0 0 0 0 0)
+        (v128.const i16x8 1 -1 10 -32768 0 0 0 0)))
+  )
+
+  (func (export "i8x16_narrow_i16x8_u") (result i64 i64)
+    (call $halves
+      (i8x16.narrow_i16x8_u
+        (v128.const i16x8 -1 256 255 128 0 0 0 0)
+        (v128.const i16x8 32767 -32768 1 0 0 0 0 0)))
+  )
+
+  (func (export "i16x8_narrow_i32x4_s") (result i64 i64)
+    (call $halves
+      (i16x8.narrow_i32x4_s
+        (v128.const i32x4 70000 -70000 5 -5)
+        (v128.const i32x4 32768 -32769 0 1)))
+  )
+
+  (func (export "i16x8_narrow_i32x4_u") (result i64 i64)
+    (call $halves
+      (i16x8.narrow_i32x4_u
+        (v128.const i32x4 70000 -70000 65535 65536)
+        (v128.const i32x4 32768 -1 0 1)))
+  )
+
+  (func (export "i32x4_dot_i16x8_s") (result i64 i64)
+    (call $halves
+      (i32x4.dot_i16x8_s
+        (v128.const i16x8 -32768 -32768 3 4 -1 1 0 0)
+        (v128.const i16x8 -32768 -32768 5 6 2 2 0 0)))
+  )
+
+  (func (export "i8x16_abs") (result i64 i64)
+    (call $halves (i8x16.abs (v128.const i8x16 -128 -1 5 0 127 -127 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i64x2_abs") (result i64 i64)
+    (call $halves (i64x2.abs (v128.const i64x2 -9223372036854775808 -5)))
+  )
+
+  (func (export "i8x16_avgr_u") (result i64 i64)
+    (call $halves
+      (i8x16.avgr_u
+        (v128.const i8x16 255 0 1 200 0 0 0 0 0 0 0 0 0 0 0 0)
+        (v128.const i8x16 255 1 2 100 0 0 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i8x16_popcnt") (result i64 i64)
+    (call $halves (i8x16.popcnt (v128.const i8x16 255 0 1 128 85 7 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i16x8_extadd_pairwise_i8x16_u") (result i64 i64)
+    (call $halves
+      (i16x8.extadd_pairwise_i8x16_u
+        (v128.const i8x16 255 255 255 255 1 2 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "i32x4_extmul_low_i16x8_s") (result i64 i64)
+    (call $halves
+      (i32x4.extmul_low_i16x8_s
+        (v128.const i16x8 -32768 32767 -1 2 9 9 9 9)
+        (v128.const i16x8 -32768 -32768 -1 -3 9 9 9 9)))
+  )
+
+  (func (export "i64x2_extmul_high_i32x4_u") (result i64 i64)
+    (call $halves
+      (i64x2.extmul_high_i32x4_u
+        (v128.const i32x4 0 0 4294967295 3)
+        (v128.const i32x4 0 0 4294967295 5)))
+  )
+
+  (func (export "i8x16_swizzle") (result i64 i64)
+    (call $halves
+      (i8x16.swizzle
+        (v128.const i8x16 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25)
+        (v128.const i8x16 15 0 16 255 128 1 2 3 4 5 6 7 8 9 10 17)))
+  )
+
+  (func (export "i32x4_shl_33") (result i64 i64)
+    (call $halves (i32x4.shl (v128.const i32x4 1 2147483648 3 4294967295) (i32.const 33)))
+  )
+
+  (func (export "i8x16_shr_s_9") (result i64 i64)
+    (call $halves
+      (i8x16.shr_s
+        (v128.const i8x16 -128 127 -1 64 0 0 0 0 0 0 0 0 0 0 0 0)
+        (i32.const 9)))
+  )
+
+  (func (export "i16x8_shr_u_17") (result i64 i64)
+    (call $halves (i16x8.shr_u (v128.const i16x8 32768 65535 2 3 0 0 0 0) (i32.const 17)))
+  )
+
+  (func (export "i64x2_shr_s_65") (result i64 i64)
+    (call $halves (i64x2.shr_s (v128.const i64x2 -9223372036854775808 6) (i32.const 65)))
+  )
+
+  ;; NaN in either operand gives a canonical NaN: 0x77 (min lanes 0-2, max lanes 0-2)
+  (func (export "f32x4_min_max_nan") (result i32)
+    (i32.or
+      (call $nan_f32 (f32x4.min (v128.const f32x4 nan 1 nan 0) (v128.const f32x4 1 nan nan 0)))
+      (i32.shl
+        (call $nan_f32 (f32x4.max (v128.const f32x4 nan 1 nan 0) (v128.const f32x4 1 nan nan 0)))
+        (i32.const 4)))
+  )
+
+  ;; 0xF (both lanes of min and of max)
+  (func (export "f64x2_min_max_nan") (result i32)
+    (i32.or
+      (call $nan_f64 (f64x2.min (v128.const f64x2 nan 1) (v128.const f64x2 1 nan)))
+      (i32.shl
+        (call $nan_f64 (f64x2.max (v128.const f64x2 nan 1) (v128.const f64x2 1 nan)))
+        (i32.const 2)))
+  )
+
+  ;; sqrt of a negative number or NaN is NaN: 0xB (lanes 0, 1 and 3)
+  (func (export "f32x4_sqrt_nan") (result i32)
+    (call $nan_f32 (f32x4.sqrt (v128.const f32x4 -1 nan 4 -inf)))
+  )
+)
@@ -0,0 +1,87 @@
+;; Test v128 values through locals, calls, blocks, select and memory
+(module
+  (memory 1)
+
+  ;; Sum of the four i32 lanes
+  (func $hsum (param $v v128) (result i32)
+    (i32.add
+      (i32.add (i32x4.extract_lane 0 (local.get $v)) (i32x4.extract_lane 1 (local.get $v)))
+      (i32.add (i32x4.extract_lane 2 (local.get $v)) (i32x4.extract_lane 3 (local.get $v))))
+  )
+
+  (func $scale (param $v v128) (param $k i32) (result v128)
+    (i32x4.mul (local.get $v) (i32x4.splat (local.get $k)))
+  )
+
+  ;; v128 params and results across calls: 10 * k
+  (func (export "dot") (param $k i32) (result i32)
+    (call $hsum (call $scale (v128.const i32x4 1 2 3 4) (local.get $k)))
+  )
+
+  ;; Store 0..n-1 and sum them four lanes at a time (n a multiple of 4)
+  (func (export "sum_memory") (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc v128)
+    (block $filled
+      (loop $fill
+        (br_if $filled (i32.ge_u (local.get $i) (local.get $n)))
+        (i32.store (i32.shl (local.get $i) (i32.const 2)) (local.get $i))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $fill)
+      )
+    )
+    (local.set $i (i32.const 0))
+    (block $done
+      (loop $next
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (i32x4.add (local.get $acc) (v128.load (i32.shl (local.get $i) (i32.const 2)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 4)))
+        (br $next)
+      )
+    )
+    (call $hsum (local.get $acc))
+  )
+
+  ;; Byte reversal, low half read back as an i64
+  (func (export "shuffle") (result i64)
+    (i64x2.extract_lane 0
+      (i8x16.shuffle 15 14 13 12 11 10 9 8 7 6 5 4 3 2 1 0
+        (v128.const i8x16 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15)
+        (v128.const i8x16 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0)))
+  )
+
+  (func (export "select") (param $c i32) (result i32)
+    (call $hsum
+      (select (v128.const i32x4 1 1 1 1) (v128.const i32x4 2 2 2 2) (local.get $c)))
+  )
+
+  ;; v128 block and if results
+  (func (export "blocks") (param $x i32) (result i32)
+    (i32.add
+      (i32x4.extract_lane 2 (block (result v128) (i32x4.splat (local.get $x))))
+      (i32x4.extract_lane 1
+        (if (result v128) (local.get $x)
+          (then (v128.const i32x4 7 7 7 7))
+          (else (v128.const i32x4 9 9 9 9)))))
+  )
+
+  (func (export "bitmask") (result i32)
+    (i32x4.bitmask
+      (i32x4.lt_s (v128.const i32x4 1 -2 3 -4) (v128.const i32x4 0 0 0 0)))
+  )
+
+  ;; min(-0, +0) is -0 and min(1, -1) is -1
+  (func (export "fmin") (result i64)
+    (i64x2.extract_lane 0
+      (f32x4.min (v128.const f32x4 -0 1 nan 2) (v128.const f32x4 0 -1 3 nan)))
+  )
+
+  ;; Saturating narrow: 300 -> 127, -300 -> -128
+  (func (export "narrow") (result i32)
+    (i32x4.extract_lane 0
+      (i8x16.narrow_i16x8_s
+        (v128.const i16x8 300 -300 5 0 0 0 0 0)
+        (v128.const i16x8 0 0 0 0 0 0 0 0)))
+  )
+)
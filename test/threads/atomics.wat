@@ -0,0 +1,75 @@
+;; Test atomic loads, stores, read-modify-writes and wait/notify on a
+;; shared memory
+(module
+  (memory 1 1 shared)
+
+  ;; n atomic increments of the word at 8
+  (func (export "counter") (param $n i32) (result i32)
+    (i32.atomic.store (i32.const 8) (i32.const 0))
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (drop (i32.atomic.rmw.add (i32.const 8) (i32.const 1)))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (i32.atomic.load (i32.const 8))
+  )
+
+  ;; Old values of add, sub, and, or, xor and xchg on 16, packed as bytes
+  (func (export "rmw") (result i64)
+    (i64.atomic.store (i32.const 16) (i64.const 0x10))
+    (i64.or
+      (i64.or
+        (i64.or
+          (i64.shl (i64.atomic.rmw.add (i32.const 16) (i64.const 0x05)) (i64.const 40))   ;; 0x10 -> 0x15
+          (i64.shl (i64.atomic.rmw.sub (i32.const 16) (i64.const 0x03)) (i64.const 32)))  ;; 0x15 -> 0x12
+        (i64.or
+          (i64.shl (i64.atomic.rmw.and (i32.const 16) (i64.const 0x33)) (i64.const 24))   ;; 0x12 -> 0x12
+          (i64.shl (i64.atomic.rmw.or (i32.const 16) (i64.const 0x40)) (i64.const 16)))) ;; 0x12 -> 0x52
+      (i64.or
+        (i64.shl (i64.atomic.rmw.xor (i32.const 16) (i64.const 0x0F)) (i64.const 8))      ;; 0x52 -> 0x5D
+        (i64.atomic.rmw.xchg (i32.const 16) (i64.const 0x77))))                          ;; 0x5D -> 0x77
+  )
+
+  ;; cmpxchg on the word at 24 (holding 7): old value * 100 + new value
+  (func (export "cmpxchg") (param $expected i32) (param $replacement i32) (result i32)
+    (local $old i32)
+    (i32.atomic.store (i32.const 24) (i32.const 7))
+    (local.set $old
+      (i32.atomic.rmw.cmpxchg (i32.const 24) (local.get $expected) (local.get $replacement)))
+    (i32.add
+      (i32.mul (local.get $old) (i32.const 100))
+      (i32.atomic.load (i32.const 24)))
+  )
+
+  ;; Narrow ops touch only their bytes; cmpxchg wraps the expected value
+  (func (export "narrow") (result i32)
+    (i32.store (i32.const 32) (i32.const 0x11223344))
+    (drop (i32.atomic.rmw8.cmpxchg_u (i32.const 32) (i32.const 0x1144) (i32.const 0xAA)))
+    (drop (i32.atomic.rmw16.add_u (i32.const 34) (i32.const 0xFFFF)))
+    (i32.atomic.load (i32.const 32))
+  )
+
+  (func (export "load8") (result i64)
+    (i64.atomic.load8_u (i32.const 33))
+  )
+
+  ;; 1: the value differs
+  (func (export "wait_not_equal") (result i32)
+    (memory.atomic.wait32 (i32.const 40) (i32.const 1) (i64.const -1))
+  )
+
+  ;; 2: nothing notifies within 1ms
+  (func (export "wait_timeout") (result i32)
+    (memory.atomic.wait64 (i32.const 48) (i64.const 0) (i64.const 1000000))
+  )
+
+  ;; No waiters
+  (func (export "notify") (result i32)
+    (memory.atomic.notify (i32.const 40) (i32.const 1))
+  )
+
+  (func (export "unaligned") (result i32)
+    (i32.atomic.load (i32.const 2))
+  )
+)
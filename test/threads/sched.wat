@@ -0,0 +1,29 @@
+;; Scheduled export calls: a loop long enough to be preempted, a
+;; per-instance counter and a division that traps on zero
+(module
+  (global $calls (mut i32) (i32.const 0))
+
+  ;; n + (n - 1) + ... + 1
+  (func (export "sum") (param $n i64) (result i64)
+    (local $acc i64)
+    (block $done
+      (loop $next
+        (br_if $done (i64.eqz (local.get $n)))
+        (local.set $acc (i64.add (local.get $acc) (local.get $n)))
+        (local.set $n (i64.sub (local.get $n) (i64.const 1)))
+        (br $next)
+      )
+    )
+    (local.get $acc)
+  )
+
+  ;; Number of calls of this instance so far, including this one
+  (func (export "bump") (result i32)
+    (global.set $calls (i32.add (global.get $calls) (i32.const 1)))
+    (global.get $calls)
+  )
+
+  (func (export "div") (param $n i64) (result i64)
+    (i64.div_u (i64.const 1000) (local.get $n))
+  )
+)
@@ -0,0 +1,19 @@
+;; A served module: an export to call and a command whose _start, like
+;; wasi-libc's crt1, traps when it runs twice on the same instance
+(module
+  (import "wasi_snapshot_preview1" "proc_exit" (func $proc_exit (param i32)))
+  (memory (export "memory") 1)
+
+  (func (export "add") (param $a i32) (param $b i32) (result i32)
+    (i32.add (local.get $a) (local.get $b))
+  )
+
+  ;; The flag at address 0 marks that _start has run
+  (func (export "_start")
+    (if (i32.load (i32.const 0))
+      (then (unreachable))
+    )
+    (i32.store (i32.const 0) (i32.const 1))
+    (call $proc_exit (i32.const 7))
+  )
+)
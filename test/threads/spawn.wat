@@ -0,0 +1,44 @@
+;; wasi-threads: spawn threads that each add their start argument to a
+;; shared counter and wake the main thread
+(module
+  (import "env" "memory" (memory 1 1 shared))
+  (import "wasi" "thread-spawn" (func $thread_spawn (param i32) (result i32)))
+
+  ;; Instances start with fresh globals
+  (global $started (mut i32) (i32.const 0))
+
+  (func (export "wasi_thread_start") (param $tid i32) (param $arg i32)
+    (global.set $started (i32.add (global.get $started) (i32.const 1)))
+    ;; Thread ids are positive
+    (if (i32.le_s (local.get $tid) (i32.const 0)) (then (unreachable)))
+    (drop (i32.atomic.rmw.add (i32.const 0) (local.get $arg)))
+    (drop (i32.atomic.rmw.add (i32.const 4) (global.get $started)))
+    (drop (memory.atomic.notify (i32.const 4) (i32.const 1)))
+  )
+
+  ;; Spawn n threads with arguments 1..n and wait until all of them ran;
+  ;; returns the sum of the arguments, or a negative value on failure
+  (func (export "run") (param $n i32) (result i32)
+    (local $i i32)
+    (local $done i32)
+    (i32.atomic.store (i32.const 0) (i32.const 0))
+    (i32.atomic.store (i32.const 4) (i32.const 0))
+    (block $spawned
+      (loop $spawn
+        (br_if $spawned (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (if (i32.le_s (call $thread_spawn (local.get $i)) (i32.const 0))
+          (then (return (i32.const -1))))
+        (br $spawn)))
+    (block $all
+      (loop $wait
+        (local.set $done (i32.atomic.load (i32.const 4)))
+        (br_if $all (i32.ge_u (local.get $done) (local.get $n)))
+        (drop (memory.atomic.wait32 (i32.const 4) (local.get $done) (i64.const -1)))
+        (br $wait)))
+    ;; More than n would mean instances shared $started
+    (if (i32.ne (i32.atomic.load (i32.const 4)) (local.get $n))
+      (then (return (i32.const -2))))
+    (i32.atomic.load (i32.const 0))
+  )
+)
@@ -0,0 +1,8 @@
+;; An imported string constant without any wasm:js-string builtin
+(module
+  (import "_" "hello" (global $hello (ref extern)))
+
+  (func (export "hello") (result externref)
+    (global.get $hello)
+  )
+)
@@ -0,0 +1,11 @@
+;; Strings without GC types: a wasm:js-string builtin and an imported
+;; string constant, both allocated in the loading thread's heap
+(module
+  (import "wasm:js-string" "length"
+    (func $length (param externref) (result i32)))
+  (import "_" "hello" (global $hello (ref extern)))
+
+  (func (export "hello_length") (result i32)
+    (call $length (global.get $hello))
+  )
+)
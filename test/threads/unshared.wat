@@ -0,0 +1,17 @@
+;; Atomics on an unshared memory: wait traps, everything else works
+(module
+  (memory 1)
+
+  (func (export "add") (result i32)
+    (drop (i32.atomic.rmw.add (i32.const 0) (i32.const 3)))
+    (i32.atomic.rmw.add (i32.const 0) (i32.const 4))
+  )
+
+  (func (export "notify") (result i32)
+    (memory.atomic.notify (i32.const 0) (i32.const 1))
+  )
+
+  (func (export "wait") (result i32)
+    (memory.atomic.wait32 (i32.const 0) (i32.const 0) (i64.const 0))
+  )
+)
@@ -0,0 +1,32 @@
+;; Test scatter/gather fd_read/fd_write with multiple iovecs (fd 3)
+;; Reads "Hello, WASI" into two separate buffers with one fd_read, then
+;; writes them back in swapped order with one fd_write:
+;; "Hello, WASI" -> "Hello, WASIWASIHello, "
+(module
+  (import "wasi_snapshot_preview1" "fd_read"
+    (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (func (export "_start")
+    ;; Read iovecs at 200: (ptr=0, len=7), (ptr=100, len=4)
+    (i32.store (i32.const 200) (i32.const 0))
+    (i32.store (i32.const 204) (i32.const 7))
+    (i32.store (i32.const 208) (i32.const 100))
+    (i32.store (i32.const 212) (i32.const 4))
+
+    ;; fd_read(fd=3, iovs=200, iovs_len=2, nread=240)
+    (drop (call $fd_read (i32.const 3) (i32.const 200) (i32.const 2) (i32.const 240)))
+
+    ;; Write iovecs at 220: (ptr=100, len=4), (ptr=0, len=7)
+    (i32.store (i32.const 220) (i32.const 100))
+    (i32.store (i32.const 224) (i32.const 4))
+    (i32.store (i32.const 228) (i32.const 0))
+    (i32.store (i32.const 232) (i32.const 7))
+
+    ;; fd_write(fd=3, iovs=220, iovs_len=2, nwritten=244)
+    (drop (call $fd_write (i32.const 3) (i32.const 220) (i32.const 2) (i32.const 244)))
+  )
+)
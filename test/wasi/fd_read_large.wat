@@ -0,0 +1,23 @@
+;; Test a large fd_read from the preopened file (fd 3) into a page-aligned
+;; buffer, then write the bytes back (appended, as the read moved the file
+;; position to the end), so the file ends up holding its content twice
+(module
+  (import "wasi_snapshot_preview1" "fd_read"
+    (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 16)
+
+  (func (export "_start")
+    ;; Read iovec at 0: ptr=65536, len=983040 (the rest of memory)
+    (i32.store (i32.const 0) (i32.const 65536))
+    (i32.store (i32.const 4) (i32.const 983040))
+    (drop (call $fd_read (i32.const 3) (i32.const 0) (i32.const 1) (i32.const 16)))
+
+    ;; Write iovec at 8: ptr=65536, len=nread
+    (i32.store (i32.const 8) (i32.const 65536))
+    (i32.store (i32.const 12) (i32.load (i32.const 16)))
+    (drop (call $fd_write (i32.const 3) (i32.const 8) (i32.const 1) (i32.const 20)))
+  )
+)
@@ -0,0 +1,22 @@
+;; fd_read_large.wat with a memory64 memory, which the runtime reserves
+;; itself, so mapped reads can map the file's pages into it
+(module
+  (import "wasi_snapshot_preview1" "fd_read"
+    (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") i64 16)
+
+  (func (export "_start")
+    ;; Read iovec at 0: ptr=65536, len=983040 (the rest of memory)
+    (i32.store (i64.const 0) (i32.const 65536))
+    (i32.store (i64.const 4) (i32.const 983040))
+    (drop (call $fd_read (i32.const 3) (i32.const 0) (i32.const 1) (i32.const 16)))
+
+    ;; Write iovec at 8: ptr=65536, len=nread
+    (i32.store (i64.const 8) (i32.const 65536))
+    (i32.store (i64.const 12) (i32.load (i64.const 16)))
+    (drop (call $fd_write (i32.const 3) (i32.const 8) (i32.const 1) (i32.const 20)))
+  )
+)
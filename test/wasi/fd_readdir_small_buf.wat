@@ -0,0 +1,83 @@
+;; Test fd_readdir with a buffer too small for more than one entry (dir is fd 4)
+;; Creates a.txt, b.txt and c.txt, then lists the directory 40 bytes at a
+;; time the way wasi-libc does: complete entries are consumed, the next call
+;; starts at the last complete entry's d_next, and a call that returns less
+;; than the buffer size ends the listing. Expects 5 entries (., .., 3 files).
+;; Writes "ok" on success, "no" otherwise
+(module
+  (import "wasi_snapshot_preview1" "path_open"
+    (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"
+    (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_readdir"
+    (func $fd_readdir (param i32 i32 i32 i64 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 0) "a.txt")
+  (data (i32.const 8) "b.txt")
+  (data (i32.const 16) "c.txt")
+  (data (i32.const 200) "ok")
+  (data (i32.const 210) "no")
+
+  ;; Create an empty file with path_open(dirfd=4, path, O_CREAT)
+  (func $create (param $path i32)
+    (if (i32.eqz (call $path_open
+          (i32.const 4) (i32.const 0) (local.get $path) (i32.const 5)
+          (i32.const 1) (i64.const 70) (i64.const 0) (i32.const 0)
+          (i32.const 100)))
+      (then (drop (call $fd_close (i32.load (i32.const 100))))))
+  )
+
+  (func $write (param $ptr i32)
+    (i32.store (i32.const 108) (local.get $ptr))
+    (i32.store (i32.const 112) (i32.const 2))
+    (drop (call $fd_write (i32.const 3) (i32.const 108) (i32.const 1) (i32.const 120)))
+  )
+
+  (func (export "_start")
+    (local $cookie i64)
+    (local $used i32)
+    (local $off i32)
+    (local $size i32)
+    (local $count i32)
+
+    (call $create (i32.const 0))
+    (call $create (i32.const 8))
+    (call $create (i32.const 16))
+
+    (block $done
+      (loop $next_buf
+        ;; fd_readdir(fd=4, buf=1024, buf_len=40, cookie, bufused=300)
+        (if (call $fd_readdir (i32.const 4) (i32.const 1024) (i32.const 40)
+                              (local.get $cookie) (i32.const 300))
+          (then (call $write (i32.const 210)) (return)))
+        (local.set $used (i32.load (i32.const 300)))
+
+        ;; Consume complete entries
+        (local.set $off (i32.const 0))
+        (block $partial
+          (loop $entry
+            (br_if $partial (i32.gt_u (i32.add (local.get $off) (i32.const 24))
+                                      (local.get $used)))
+            (local.set $size (i32.add (i32.const 24)
+              (i32.load (i32.add (i32.const 1040) (local.get $off)))))
+            (br_if $partial (i32.gt_u (i32.add (local.get $off) (local.get $size))
+                                      (local.get $used)))
+            (local.set $cookie (i64.load (i32.add (i32.const 1024) (local.get $off))))
+            (local.set $count (i32.add (local.get $count) (i32.const 1)))
+            (local.set $off (i32.add (local.get $off) (local.get $size)))
+            (br $entry)))
+
+        (br_if $done (i32.lt_u (local.get $used) (i32.const 40)))
+        ;; A full buffer without a complete entry would never make progress
+        (if (i32.eqz (local.get $off))
+          (then (call $write (i32.const 210)) (return)))
+        (br $next_buf)))
+
+    (call $write (select (i32.const 200) (i32.const 210)
+                         (i32.eq (local.get $count) (i32.const 5))))
+  )
+)
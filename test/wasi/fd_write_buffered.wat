@@ -0,0 +1,31 @@
+;; Test buffered fd_write to preopened file (fd 3)
+;; Writes two lines (the second as two iovecs), then reads the first line
+;; back with fd_pread, which must observe the buffered bytes, and appends it
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_pread"
+    (func $fd_pread (param i32 i32 i32 i64 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  ;; "line1\n" at offset 0, "line" at offset 8, "2\n" at offset 12
+  (data (i32.const 0) "line1\n")
+  (data (i32.const 8) "line")
+  (data (i32.const 12) "2\n")
+
+  ;; iovec at offset 32: ptr=0, len=6
+  (data (i32.const 32) "\00\00\00\00\06\00\00\00")
+  ;; iovecs at offset 40: (ptr=8, len=4), (ptr=12, len=2)
+  (data (i32.const 40) "\08\00\00\00\04\00\00\00\0c\00\00\00\02\00\00\00")
+  ;; iovec at offset 56: ptr=100, len=5 (pread target / final write source)
+  (data (i32.const 56) "\64\00\00\00\05\00\00\00")
+
+  (func (export "_start")
+    (drop (call $fd_write (i32.const 3) (i32.const 32) (i32.const 1) (i32.const 80)))
+    (drop (call $fd_write (i32.const 3) (i32.const 40) (i32.const 2) (i32.const 80)))
+    ;; fd_pread(fd=3, iovs=56, iovs_len=1, offset=0, nread=80)
+    (drop (call $fd_pread (i32.const 3) (i32.const 56) (i32.const 1) (i64.const 0) (i32.const 80)))
+    (drop (call $fd_write (i32.const 3) (i32.const 56) (i32.const 1) (i32.const 80)))
+  )
+)
@@ -0,0 +1,20 @@
+;; Test fd_write to the preopened file (fd 3) from a memory64 memory: WASI
+;; sees the memory itself, not memory 0's 32-bit placeholder. The string
+;; sits past the first 64KiB page, in memory grown at run time
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") i64 1)
+
+  ;; "Hello, memory64!" at offset 65536 (16 bytes) after growing
+  (func (export "_start")
+    (drop (memory.grow (i64.const 1)))
+    (i64.store (i64.const 65536) (i64.const 0x6d202c6f6c6c6548))
+    (i64.store (i64.const 65544) (i64.const 0x21343679726f6d65))
+    ;; iovec at offset 0: ptr=65536, len=16
+    (i32.store (i64.const 0) (i32.const 65536))
+    (i32.store (i64.const 4) (i32.const 16))
+    (drop (call $fd_write (i32.const 3) (i32.const 0) (i32.const 1) (i32.const 8)))
+  )
+)
@@ -0,0 +1,91 @@
+;; Test path resolution beneath the base directory using preopened dir (fd 4):
+;; escaping paths fail with NOTCAPABLE (76), a directory opened with path_open
+;; works as a base, and paths longer than 512 bytes resolve
+(module
+  (import "wasi_snapshot_preview1" "path_open"
+    (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_create_directory"
+    (func $path_create_directory (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"
+    (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 0) "../escape")
+  (data (i32.const 16) "/etc/passwd")
+  (data (i32.const 32) "sub/../../x")
+  (data (i32.const 48) "sub")
+  (data (i32.const 56) "f.txt")
+  (data (i32.const 200) "ok")
+  (data (i32.const 210) "no")
+
+  (global $failed (mut i32) (i32.const 0))
+
+  (func $expect (param $got i32) (param $want i32)
+    (if (i32.ne (local.get $got) (local.get $want))
+      (then (global.set $failed (i32.const 1)))
+    )
+  )
+
+  ;; path_open(dirfd, path, oflags) with read/write rights, result fd at 100
+  (func $open (param $dirfd i32) (param $ptr i32) (param $len i32) (param $oflags i32) (result i32)
+    (call $path_open
+      (local.get $dirfd)
+      (i32.const 0)   ;; dirflags
+      (local.get $ptr)
+      (local.get $len)
+      (local.get $oflags)
+      (i64.const 70)  ;; rights_base = FD_READ|FD_WRITE|FD_SEEK
+      (i64.const 0)   ;; rights_inheriting
+      (i32.const 0)   ;; fdflags
+      (i32.const 100) ;; result fd ptr
+    )
+  )
+
+  (func (export "_start")
+    (local $dirfd i32)
+    (local $i i32)
+
+    ;; Paths that leave the preopen
+    (call $expect (call $open (i32.const 4) (i32.const 0) (i32.const 9) (i32.const 1)) (i32.const 76))
+    (call $expect (call $open (i32.const 4) (i32.const 16) (i32.const 11) (i32.const 0)) (i32.const 76))
+    (call $expect (call $path_create_directory (i32.const 4) (i32.const 48) (i32.const 3)) (i32.const 0))
+    (call $expect (call $open (i32.const 4) (i32.const 32) (i32.const 11) (i32.const 1)) (i32.const 76))
+
+    ;; "sub" opened as a directory is a base for further lookups
+    (call $expect (call $open (i32.const 4) (i32.const 48) (i32.const 3) (i32.const 2)) (i32.const 0))
+    (local.set $dirfd (i32.load (i32.const 100)))
+    (call $expect (call $open (local.get $dirfd) (i32.const 56) (i32.const 5) (i32.const 1)) (i32.const 0))
+    (drop (call $fd_close (i32.load (i32.const 100))))
+    (call $expect (call $open (local.get $dirfd) (i32.const 0) (i32.const 9) (i32.const 1)) (i32.const 76))
+    (drop (call $fd_close (local.get $dirfd)))
+
+    ;; "sub/" + "./" x 300 + "f.txt" (609 bytes) at 1024
+    (i32.store (i32.const 1024) (i32.load (i32.const 48)))
+    (i32.store8 (i32.const 1027) (i32.const 0x2f))
+    (local.set $i (i32.const 0))
+    (loop $dots
+      (i32.store16 (i32.add (i32.const 1028) (i32.shl (local.get $i) (i32.const 1))) (i32.const 0x2f2e))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $dots (i32.lt_u (local.get $i) (i32.const 300)))
+    )
+    (i32.store (i32.const 1628) (i32.load (i32.const 56)))
+    (i32.store8 (i32.const 1632) (i32.load8_u (i32.const 60)))
+    (call $expect (call $open (i32.const 4) (i32.const 1024) (i32.const 609) (i32.const 0)) (i32.const 0))
+    (drop (call $fd_close (i32.load (i32.const 100))))
+
+    (if (global.get $failed)
+      (then
+        (i32.store (i32.const 108) (i32.const 210))
+        (i32.store (i32.const 112) (i32.const 2))
+      )
+      (else
+        (i32.store (i32.const 108) (i32.const 200))
+        (i32.store (i32.const 112) (i32.const 2))
+      )
+    )
+    (drop (call $fd_write (i32.const 3) (i32.const 108) (i32.const 1) (i32.const 120)))
+  )
+)
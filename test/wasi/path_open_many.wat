@@ -0,0 +1,64 @@
+;; Test the growable fd table with many open files (dir is fd 4)
+;; 1. path_open "many.txt" 600 times without closing: fds 8, 9, ... 607
+;; 2. Close fd 100; the next path_open reuses it
+;; 3. fd_renumber fd 8 to 5000 (beyond the current table size);
+;;    fd 8 is then closed (BADF) and fd 5000 closes normally
+;; Writes "ok" on success, "no" otherwise
+(module
+  (import "wasi_snapshot_preview1" "path_open"
+    (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_renumber"
+    (func $fd_renumber (param i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"
+    (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 0) "many.txt")
+  (data (i32.const 200) "ok")
+  (data (i32.const 210) "no")
+
+  ;; path_open(dirfd=4, "many.txt", O_CREAT) -> fd, or -1 on error
+  (func $open (result i32)
+    (if (call $path_open
+          (i32.const 4) (i32.const 0) (i32.const 0) (i32.const 8)
+          (i32.const 1) (i64.const 70) (i64.const 0) (i32.const 0)
+          (i32.const 100))
+      (then (return (i32.const -1))))
+    (i32.load (i32.const 100))
+  )
+
+  (func $write (param $ptr i32)
+    (i32.store (i32.const 108) (local.get $ptr))
+    (i32.store (i32.const 112) (i32.const 2))
+    (drop (call $fd_write (i32.const 3) (i32.const 108) (i32.const 1) (i32.const 120)))
+  )
+
+  (func (export "_start")
+    (local $i i32)
+    (local $ok i32)
+    (local.set $ok (i32.const 1))
+
+    (loop $open_all
+      (if (i32.ne (call $open) (i32.add (local.get $i) (i32.const 8)))
+        (then (local.set $ok (i32.const 0))))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $open_all (i32.lt_u (local.get $i) (i32.const 600))))
+
+    (if (call $fd_close (i32.const 100))
+      (then (local.set $ok (i32.const 0))))
+    (if (i32.ne (call $open) (i32.const 100))
+      (then (local.set $ok (i32.const 0))))
+
+    (if (call $fd_renumber (i32.const 8) (i32.const 5000))
+      (then (local.set $ok (i32.const 0))))
+    (if (i32.ne (call $fd_close (i32.const 8)) (i32.const 8))
+      (then (local.set $ok (i32.const 0))))
+    (if (call $fd_close (i32.const 5000))
+      (then (local.set $ok (i32.const 0))))
+
+    (call $write (select (i32.const 200) (i32.const 210) (local.get $ok)))
+  )
+)
@@ -0,0 +1,63 @@
+;; Test poll_oneoff with clock and fd_read subscriptions (fd 3)
+;; 1. A single 1ms relative clock must fire with its userdata: writes "clock"
+;; 2. fd_read on the (regular) preopened file plus a 10s clock must report
+;;    only the fd event, without waiting for the clock: writes " fd"
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "poll_oneoff"
+    (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 1000) "clock fd")
+
+  ;; Subscriptions at 0 (48 bytes each), events at 200 (32 bytes each),
+  ;; nevents at 300, iovec at 400, nwritten at 408
+
+  (func $write (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 400) (local.get $ptr))
+    (i32.store (i32.const 404) (local.get $len))
+    (drop (call $fd_write (i32.const 3) (i32.const 400) (i32.const 1) (i32.const 408)))
+  )
+
+  (func (export "_start")
+    ;; Subscription 0: userdata=42, clock, monotonic, timeout=1ms, relative
+    (i64.store (i32.const 0) (i64.const 42))
+    (i32.store8 (i32.const 8) (i32.const 0))
+    (i32.store (i32.const 16) (i32.const 1))
+    (i64.store (i32.const 24) (i64.const 1000000))
+    (i64.store (i32.const 32) (i64.const 0))
+    (i32.store16 (i32.const 40) (i32.const 0))
+
+    (if (i32.and
+          (i32.and
+            (i32.eqz (call $poll_oneoff (i32.const 0) (i32.const 200) (i32.const 1) (i32.const 300)))
+            (i32.eq (i32.load (i32.const 300)) (i32.const 1)))
+          (i32.and
+            (i64.eq (i64.load (i32.const 200)) (i64.const 42))
+            (i32.eqz (i32.load8_u (i32.const 210)))))
+      (then (call $write (i32.const 1000) (i32.const 5))))
+
+    ;; Subscription 0: userdata=7, fd_read on fd 3
+    (i64.store (i32.const 0) (i64.const 7))
+    (i32.store8 (i32.const 8) (i32.const 1))
+    (i32.store (i32.const 16) (i32.const 3))
+    ;; Subscription 1: userdata=8, clock, monotonic, timeout=10s, relative
+    (i64.store (i32.const 48) (i64.const 8))
+    (i32.store8 (i32.const 56) (i32.const 0))
+    (i32.store (i32.const 64) (i32.const 1))
+    (i64.store (i32.const 72) (i64.const 10000000000))
+    (i64.store (i32.const 80) (i64.const 0))
+    (i32.store16 (i32.const 88) (i32.const 0))
+
+    (if (i32.and
+          (i32.and
+            (i32.eqz (call $poll_oneoff (i32.const 0) (i32.const 200) (i32.const 2) (i32.const 300)))
+            (i32.eq (i32.load (i32.const 300)) (i32.const 1)))
+          (i32.and
+            (i64.eq (i64.load (i32.const 200)) (i64.const 7))
+            (i32.eq (i32.load8_u (i32.const 210)) (i32.const 1))))
+      (then (call $write (i32.const 1005) (i32.const 3))))
+  )
+)
@@ -0,0 +1,112 @@
+;; Test poll_oneoff readiness on a pipe: read end fd 4, write end fd 5; the
+;; preopened file is fd 3
+;; 1. fd_read on the empty pipe plus a 1ms clock reports only the clock: writes "idle"
+;; 2. After 3 bytes are written, fd_read plus a 10s clock reports only the
+;;    fd, with nbytes = 3: writes " ready"
+;; 3. 127 subscriptions alternating fd_read on fd 4 and fd_write on fd 5,
+;;    plus a 10s clock, report all 127 fd events and no clock: writes " many"
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "poll_oneoff"
+    (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 13000) "idle ready many")
+  (data (i32.const 13100) "abc")
+
+  ;; Subscriptions at 0 (48 bytes each), events at 8192 (32 bytes each),
+  ;; nevents at 12800, iovec at 12900, nwritten at 12908
+
+  (func $write_fd (param $fd i32) (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 12900) (local.get $ptr))
+    (i32.store (i32.const 12904) (local.get $len))
+    (drop (call $fd_write (local.get $fd) (i32.const 12900) (i32.const 1) (i32.const 12908)))
+  )
+
+  (func $write (param $ptr i32) (param $len i32)
+    (call $write_fd (i32.const 3) (local.get $ptr) (local.get $len))
+  )
+
+  ;; Subscription i: fd_read (type 1) or fd_write (type 2) on fd, userdata i
+  (func $sub_fd (param $i i32) (param $type i32) (param $fd i32)
+    (local $p i32)
+    (local.set $p (i32.mul (local.get $i) (i32.const 48)))
+    (i64.store (local.get $p) (i64.extend_i32_u (local.get $i)))
+    (i32.store8 (i32.add (local.get $p) (i32.const 8)) (local.get $type))
+    (i32.store (i32.add (local.get $p) (i32.const 16)) (local.get $fd))
+  )
+
+  ;; Subscription i: relative monotonic clock, userdata i
+  (func $sub_clock (param $i i32) (param $ns i64)
+    (local $p i32)
+    (local.set $p (i32.mul (local.get $i) (i32.const 48)))
+    (i64.store (local.get $p) (i64.extend_i32_u (local.get $i)))
+    (i32.store8 (i32.add (local.get $p) (i32.const 8)) (i32.const 0))
+    (i32.store (i32.add (local.get $p) (i32.const 16)) (i32.const 1))
+    (i64.store (i32.add (local.get $p) (i32.const 24)) (local.get $ns))
+    (i64.store (i32.add (local.get $p) (i32.const 32)) (i64.const 0))
+    (i32.store16 (i32.add (local.get $p) (i32.const 40)) (i32.const 0))
+  )
+
+  ;; poll_oneoff over the first n subscriptions; number of events, or -1
+  (func $poll (param $n i32) (result i32)
+    (if (call $poll_oneoff (i32.const 0) (i32.const 8192) (local.get $n) (i32.const 12800))
+      (then (return (i32.const -1))))
+    (i32.load (i32.const 12800))
+  )
+
+  (func (export "_start")
+    (local $i i32)
+    (local $ev i32)
+    (local $ok i32)
+    (local $sum i32)
+
+    (call $sub_fd (i32.const 0) (i32.const 1) (i32.const 4))
+    (call $sub_clock (i32.const 1) (i64.const 1000000))
+    (if (i32.and
+          (i32.eq (call $poll (i32.const 2)) (i32.const 1))
+          (i64.eq (i64.load (i32.const 8192)) (i64.const 1)))
+      (then (call $write (i32.const 13000) (i32.const 4))))
+
+    (call $write_fd (i32.const 5) (i32.const 13100) (i32.const 3))
+    (call $sub_clock (i32.const 1) (i64.const 10000000000))
+    (if (i32.and
+          (i32.and
+            (i32.eq (call $poll (i32.const 2)) (i32.const 1))
+            (i64.eqz (i64.load (i32.const 8192))))
+          (i32.and
+            (i32.eq (i32.load8_u (i32.const 8202)) (i32.const 1))
+            (i64.eq (i64.load (i32.const 8208)) (i64.const 3))))
+      (then (call $write (i32.const 13004) (i32.const 6))))
+
+    (block $done
+      (loop $fill
+        (br_if $done (i32.ge_u (local.get $i) (i32.const 127)))
+        (call $sub_fd (local.get $i)
+          (i32.add (i32.const 1) (i32.and (local.get $i) (i32.const 1)))
+          (i32.add (i32.const 4) (i32.and (local.get $i) (i32.const 1))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $fill)
+      )
+    )
+    (call $sub_clock (i32.const 127) (i64.const 10000000000))
+    (local.set $ok (i32.eq (call $poll (i32.const 128)) (i32.const 127)))
+    ;; Every event succeeded, and the userdata cover 0..126 exactly once
+    (local.set $i (i32.const 0))
+    (block $checked
+      (loop $check
+        (br_if $checked (i32.ge_u (local.get $i) (i32.const 127)))
+        (local.set $ev (i32.add (i32.const 8192) (i32.mul (local.get $i) (i32.const 32))))
+        (if (i32.load16_u (i32.add (local.get $ev) (i32.const 8)))
+          (then (local.set $ok (i32.const 0))))
+        (local.set $sum (i32.add (local.get $sum) (i32.wrap_i64 (i64.load (local.get $ev)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $check)
+      )
+    )
+    (if (i32.and (local.get $ok) (i32.eq (local.get $sum) (i32.const 8001)))
+      (then (call $write (i32.const 13010) (i32.const 5))))
+  )
+)
@@ -0,0 +1,20 @@
+;; Test random_get output directly - writes 32 random bytes to fd 3
+(module
+  (import "wasi_snapshot_preview1" "random_get"
+    (func $random_get (param i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (func (export "_start")
+    ;; random_get(buf=0, len=32); two calls so the pool is drawn twice
+    (drop (call $random_get (i32.const 0) (i32.const 16)))
+    (drop (call $random_get (i32.const 16) (i32.const 16)))
+
+    ;; iovec at 108: ptr=0, len=32
+    (i32.store (i32.const 108) (i32.const 0))
+    (i32.store (i32.const 112) (i32.const 32))
+    (drop (call $fd_write (i32.const 3) (i32.const 108) (i32.const 1) (i32.const 120)))
+  )
+)
@@ -0,0 +1,12 @@
+;; Draw 8 random bytes per call and return them as an i64
+(module
+  (import "wasi_snapshot_preview1" "random_get"
+    (func $random_get (param i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (func (export "draw") (result i64)
+    (drop (call $random_get (i32.const 0) (i32.const 8)))
+    (i64.load (i32.const 0))
+  )
+)
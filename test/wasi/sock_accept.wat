@@ -0,0 +1,63 @@
+;; Test sock_accept/sock_recv against a preopened listener (fd 4) with no
+;; pending connections; the preopened file is fd 3
+;; 1. sock_accept on the non-blocking listener returns AGAIN (6): writes "again"
+;; 2. fd_read on the listener plus a 1ms clock reports only the clock: writes " clock"
+;; 3. sock_recv on the regular file returns NOTSOCK (57): writes " notsock"
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "poll_oneoff"
+    (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_accept"
+    (func $sock_accept (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_recv"
+    (func $sock_recv (param i32 i32 i32 i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 1000) "again clock notsock")
+
+  ;; Subscriptions at 0 (48 bytes each), events at 200 (32 bytes each),
+  ;; nevents at 300, iovec at 400, nwritten at 408, accepted fd at 500,
+  ;; recv iovec at 600, recv buffer at 700, ro_datalen at 800, ro_flags at 804
+
+  (func $write (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 400) (local.get $ptr))
+    (i32.store (i32.const 404) (local.get $len))
+    (drop (call $fd_write (i32.const 3) (i32.const 400) (i32.const 1) (i32.const 408)))
+  )
+
+  (func (export "_start")
+    (if (i32.eq (call $sock_accept (i32.const 4) (i32.const 0) (i32.const 500))
+                (i32.const 6))
+      (then (call $write (i32.const 1000) (i32.const 5))))
+
+    ;; Subscription 0: userdata=7, fd_read on the listener
+    (i64.store (i32.const 0) (i64.const 7))
+    (i32.store8 (i32.const 8) (i32.const 1))
+    (i32.store (i32.const 16) (i32.const 4))
+    ;; Subscription 1: userdata=8, clock, monotonic, timeout=1ms, relative
+    (i64.store (i32.const 48) (i64.const 8))
+    (i32.store8 (i32.const 56) (i32.const 0))
+    (i32.store (i32.const 64) (i32.const 1))
+    (i64.store (i32.const 72) (i64.const 1000000))
+    (i64.store (i32.const 80) (i64.const 0))
+    (i32.store16 (i32.const 88) (i32.const 0))
+
+    (if (i32.and
+          (i32.and
+            (i32.eqz (call $poll_oneoff (i32.const 0) (i32.const 200) (i32.const 2) (i32.const 300)))
+            (i32.eq (i32.load (i32.const 300)) (i32.const 1)))
+          (i32.and
+            (i64.eq (i64.load (i32.const 200)) (i64.const 8))
+            (i32.eqz (i32.load8_u (i32.const 210)))))
+      (then (call $write (i32.const 1005) (i32.const 6))))
+
+    (i32.store (i32.const 600) (i32.const 700))
+    (i32.store (i32.const 604) (i32.const 16))
+    (if (i32.eq (call $sock_recv (i32.const 3) (i32.const 600) (i32.const 1)
+                                 (i32.const 0) (i32.const 800) (i32.const 804))
+                (i32.const 57))
+      (then (call $write (i32.const 1011) (i32.const 8))))
+  )
+)
@@ -0,0 +1,62 @@
+;; Serve one connection on a preopened listener (fd 4); the test has
+;; connected and sent "ping" before _start runs. The preopened file is fd 3
+;; 1. sock_accept returns a connection: writes "accept"
+;; 2. sock_recv reads the client's bytes: writes " " and the bytes
+;; 3. sock_send sends "pong" in full: writes " send"
+;; 4. sock_shutdown(WR) ends the stream, so the client sees EOF: writes " shutdown"
+(module
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"
+    (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_accept"
+    (func $sock_accept (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_recv"
+    (func $sock_recv (param i32 i32 i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_send"
+    (func $sock_send (param i32 i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "sock_shutdown"
+    (func $sock_shutdown (param i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 1000) "accept send shutdown pong")
+
+  ;; iovec at 400, nwritten at 408, accepted fd at 500, recv iovec at 600,
+  ;; recv buffer at 700 (with a leading space at 699), ro_datalen at 800,
+  ;; ro_flags at 804, send iovec at 900, sent length at 908
+
+  (func $write (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 400) (local.get $ptr))
+    (i32.store (i32.const 404) (local.get $len))
+    (drop (call $fd_write (i32.const 3) (i32.const 400) (i32.const 1) (i32.const 408)))
+  )
+
+  (func (export "_start")
+    (local $conn i32)
+    (if (call $sock_accept (i32.const 4) (i32.const 0) (i32.const 500))
+      (then (return)))
+    (local.set $conn (i32.load (i32.const 500)))
+    (call $write (i32.const 1000) (i32.const 6))
+
+    (i32.store (i32.const 600) (i32.const 700))
+    (i32.store (i32.const 604) (i32.const 16))
+    (if (i32.eqz (call $sock_recv (local.get $conn) (i32.const 600) (i32.const 1)
+                                  (i32.const 0) (i32.const 800) (i32.const 804)))
+      (then
+        (i32.store8 (i32.const 699) (i32.const 32))
+        (call $write (i32.const 699) (i32.add (i32.load (i32.const 800)) (i32.const 1)))))
+
+    (i32.store (i32.const 900) (i32.const 1021))
+    (i32.store (i32.const 904) (i32.const 4))
+    (if (i32.and
+          (i32.eqz (call $sock_send (local.get $conn) (i32.const 900) (i32.const 1)
+                                    (i32.const 0) (i32.const 908)))
+          (i32.eq (i32.load (i32.const 908)) (i32.const 4)))
+      (then (call $write (i32.const 1006) (i32.const 5))))
+
+    (if (i32.eqz (call $sock_shutdown (local.get $conn) (i32.const 2)))
+      (then (call $write (i32.const 1011) (i32.const 9))))
+    (drop (call $fd_close (local.get $conn)))
+  )
+)
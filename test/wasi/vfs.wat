@@ -0,0 +1,127 @@
+;; Test an in-memory preopen (fd 4) loaded from test/wasi/vfs_fixture.tar:
+;; read a file from the archive, create/write/seek/read a new one, stat it,
+;; list the root with fd_readdir, unlink it and check paths cannot escape.
+;; Copies hello.txt to fd 3, then writes "ok" if every check passed
+(module
+  (import "wasi_snapshot_preview1" "path_open"
+    (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_read"
+    (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_seek"
+    (func $fd_seek (param i32 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"
+    (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_readdir"
+    (func $fd_readdir (param i32 i32 i32 i64 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_filestat_get"
+    (func $path_filestat_get (param i32 i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_unlink_file"
+    (func $path_unlink_file (param i32 i32 i32) (result i32)))
+
+  (memory (export "memory") 1)
+
+  (data (i32.const 0) "hello.txt")
+  (data (i32.const 16) "docs/../new.txt")
+  (data (i32.const 32) "../x")
+  (data (i32.const 40) "abc")
+  (data (i32.const 48) "new.txt")
+  (data (i32.const 200) "ok")
+  (data (i32.const 210) "no")
+
+  (global $failed (mut i32) (i32.const 0))
+
+  (func $expect (param $got i32) (param $want i32)
+    (if (i32.ne (local.get $got) (local.get $want))
+      (then (global.set $failed (i32.const 1)))
+    )
+  )
+
+  ;; path_open(4, path, oflags) with read/write rights, result fd at 100
+  (func $open (param $ptr i32) (param $len i32) (param $oflags i32) (result i32)
+    (call $path_open
+      (i32.const 4)
+      (i32.const 0)   ;; dirflags
+      (local.get $ptr)
+      (local.get $len)
+      (local.get $oflags)
+      (i64.const 70)  ;; rights_base = FD_READ|FD_WRITE|FD_SEEK
+      (i64.const 0)   ;; rights_inheriting
+      (i32.const 0)   ;; fdflags
+      (i32.const 100) ;; result fd ptr
+    )
+  )
+
+  ;; Read or write one buffer through the iovec at 108; returns the count
+  (func $read (param $fd i32) (param $ptr i32) (param $len i32) (result i32)
+    (i32.store (i32.const 108) (local.get $ptr))
+    (i32.store (i32.const 112) (local.get $len))
+    (call $expect (call $fd_read (local.get $fd) (i32.const 108) (i32.const 1) (i32.const 120)) (i32.const 0))
+    (i32.load (i32.const 120))
+  )
+
+  (func $write (param $fd i32) (param $ptr i32) (param $len i32) (result i32)
+    (i32.store (i32.const 108) (local.get $ptr))
+    (i32.store (i32.const 112) (local.get $len))
+    (call $expect (call $fd_write (local.get $fd) (i32.const 108) (i32.const 1) (i32.const 120)) (i32.const 0))
+    (i32.load (i32.const 120))
+  )
+
+  (func (export "_start")
+    (local $fd i32)
+    (local $n i32)
+    (local $used i32)
+    (local $off i32)
+    (local $count i32)
+
+    ;; hello.txt comes from the archive; copy it to the output file
+    (call $expect (call $open (i32.const 0) (i32.const 9) (i32.const 0)) (i32.const 0))
+    (local.set $fd (i32.load (i32.const 100)))
+    (local.set $n (call $read (local.get $fd) (i32.const 256) (i32.const 64)))
+    (call $expect (local.get $n) (i32.const 15))
+    (drop (call $write (i32.const 3) (i32.const 256) (local.get $n)))
+    (drop (call $fd_close (local.get $fd)))
+
+    ;; Create new.txt through docs/.., write "abc", seek back and read it
+    (call $expect (call $open (i32.const 16) (i32.const 15) (i32.const 1)) (i32.const 0))
+    (local.set $fd (i32.load (i32.const 100)))
+    (call $expect (call $write (local.get $fd) (i32.const 40) (i32.const 3)) (i32.const 3))
+    (call $expect (call $fd_seek (local.get $fd) (i64.const 0) (i32.const 0) (i32.const 400)) (i32.const 0))
+    (call $expect (call $read (local.get $fd) (i32.const 256) (i32.const 64)) (i32.const 3))
+    (call $expect (i32.load8_u (i32.const 258)) (i32.const 0x63))
+    (drop (call $fd_close (local.get $fd)))
+
+    ;; filestat: regular file (4) of size 3
+    (call $expect (call $path_filestat_get (i32.const 4) (i32.const 0) (i32.const 48) (i32.const 7) (i32.const 128)) (i32.const 0))
+    (call $expect (i32.load8_u (i32.const 144)) (i32.const 4))
+    (call $expect (i32.load (i32.const 160)) (i32.const 3))
+
+    ;; ".", "..", hello.txt, docs and new.txt
+    (call $expect (call $fd_readdir (i32.const 4) (i32.const 1024) (i32.const 4096) (i64.const 0) (i32.const 120)) (i32.const 0))
+    (local.set $used (i32.load (i32.const 120)))
+    (block $parsed
+      (loop $entry
+        (br_if $parsed (i32.ge_u (local.get $off) (local.get $used)))
+        (local.set $count (i32.add (local.get $count) (i32.const 1)))
+        (local.set $off
+          (i32.add (local.get $off)
+            (i32.add (i32.const 24) (i32.load offset=1040 (local.get $off)))))
+        (br $entry)
+      )
+    )
+    (call $expect (local.get $count) (i32.const 5))
+
+    ;; Unlink, then the name is gone
+    (call $expect (call $path_unlink_file (i32.const 4) (i32.const 48) (i32.const 7)) (i32.const 0))
+    (call $expect (call $path_filestat_get (i32.const 4) (i32.const 0) (i32.const 48) (i32.const 7) (i32.const 128)) (i32.const 44))
+
+    ;; The preopen is the root of the tree
+    (call $expect (call $open (i32.const 32) (i32.const 4) (i32.const 1)) (i32.const 76))
+
+    (if (global.get $failed)
+      (then (drop (call $write (i32.const 3) (i32.const 210) (i32.const 2))))
+      (else (drop (call $write (i32.const 3) (i32.const 200) (i32.const 2))))
+    )
+  )
+)
@@ -0,0 +1,88 @@
+// Native socket and pipe helpers for wasi_test.mbt: a client for guests
+// that serve connections on a preopened listener, and pipes for poll tests
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Connect to the Unix socket at path and send data. Returns the connected
+// fd, or -1 on error
+int test_sock_connect_send(const uint8_t* path, int path_len,
+                           const uint8_t* data, int data_len) {
+#ifdef _WIN32
+    (void)path; (void)path_len; (void)data; (void)data_len;
+    return -1;
+#else
+    struct sockaddr_un sun;
+    if (path_len < 0 || (size_t)path_len >= sizeof(sun.sun_path)) return -1;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    memcpy(sun.sun_path, path, (size_t)path_len);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&sun, sizeof(sun)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int sent = 0;
+    while (sent < data_len) {
+        ssize_t n = send(fd, data + sent, (size_t)(data_len - sent), 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        sent += (int)n;
+    }
+    return fd;
+#endif
+}
+
+// Read from fd until EOF or buf is full, then close it. Returns the byte
+// count, or -1 on error
+int test_sock_recv_close(int fd, uint8_t* buf, int cap) {
+#ifdef _WIN32
+    (void)fd; (void)buf; (void)cap;
+    return -1;
+#else
+    int got = 0;
+    while (got < cap) {
+        ssize_t n = recv(fd, buf + got, (size_t)(cap - got), 0);
+        if (n < 0) {
+            close(fd);
+            return -1;
+        }
+        if (n == 0) break;
+        got += (int)n;
+    }
+    close(fd);
+    return got;
+#endif
+}
+
+// Create a pipe, storing the read end in fds[0] and the write end in fds[1].
+// Returns 0, or -1 on error
+int test_pipe(int* fds) {
+#ifdef _WIN32
+    (void)fds;
+    return -1;
+#else
+    return pipe(fds);
+#endif
+}
+
+// Close a host fd. Returns 0, or -1 on error
+int test_close(int fd) {
+#ifdef _WIN32
+    (void)fd;
+    return -1;
+#else
+    return close(fd);
+#endif
+}